@@ -0,0 +1,66 @@
+#ifndef __ALIGNEDMEMORY_H__
+#define __ALIGNEDMEMORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+// Frame buffers are 64 byte aligned so SIMD kernels can use aligned and
+// streaming loads/stores and rows don't straddle cache lines.
+#define FRAME_ALIGNMENT 64
+
+// Heap allocations made through AlignedAlloc, and through operator new in
+// programs that count it too (the decode suite). Read by the benchmarks.
+struct AllocationStats
+{
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> count;
+};
+
+inline AllocationStats& GetAllocationStats()
+{
+	static AllocationStats s_stats;
+	return s_stats;
+}
+
+inline void CountAllocation(size_t size)
+{
+	AllocationStats& stats = GetAllocationStats();
+	stats.bytes.fetch_add(size, std::memory_order_relaxed);
+	stats.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void* AlignedAlloc(size_t size, size_t alignment = FRAME_ALIGNMENT)
+{
+	CountAllocation(size);
+#if defined(_MSC_VER)
+	return _aligned_malloc(size, alignment);
+#else
+	void* p = NULL;
+	if (posix_memalign(&p, alignment, size) != 0) {
+		return NULL;
+	}
+	return p;
+#endif
+}
+
+inline void AlignedFree(void* p)
+{
+#if defined(_MSC_VER)
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+inline size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+#endif
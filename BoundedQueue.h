@@ -0,0 +1,102 @@
+#ifndef __BOUNDEDQUEUE_H__
+#define __BOUNDEDQUEUE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Fixed capacity lock free queue for any number of producers and consumers
+// (D. Vyukov's bounded MPMC queue). Each cell carries a sequence number that
+// says whether it is free for the push or the pop of a given position, so
+// TryPush / TryPop are one CAS on the happy path. capacity is rounded up to a
+// power of two.
+template <class T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(uint32_t capacity)
+	{
+		uint32_t size = 2;
+		while (size < capacity) {
+			size *= 2;
+		}
+		m_mask = size - 1;
+		m_pCells = new Cell[size];
+		for (uint32_t i = 0; i < size; ++i) {
+			m_pCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		m_enqueuePos.store(0, std::memory_order_relaxed);
+		m_dequeuePos.store(0, std::memory_order_relaxed);
+	}
+
+	~BoundedQueue() { delete[] m_pCells; }
+
+	uint32_t Capacity() const { return m_mask + 1; }
+
+	// Returns false when the queue is full.
+	bool TryPush(const T& value)
+	{
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell* pCell = &m_pCells[pos & m_mask];
+			size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+			if (diff == 0) {
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					pCell->value = value;
+					pCell->sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns false when the queue is empty.
+	bool TryPop(T* pValue)
+	{
+		size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell* pCell = &m_pCells[pos & m_mask];
+			size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					*pValue = pCell->value;
+					pCell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+
+	Cell* m_pCells;
+	uint32_t m_mask;
+	// Kept on separate cache lines so producers and consumers don't share one.
+	alignas(64) std::atomic<size_t> m_enqueuePos;
+	alignas(64) std::atomic<size_t> m_dequeuePos;
+};
+
+#endif
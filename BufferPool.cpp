@@ -0,0 +1,80 @@
+#include "BufferPool.h"
+#include "AlignedMemory.h"
+
+#include <string.h>
+
+BufferPool::BufferPool(size_t bufferSize, uint32_t capacity)
+	: m_refCount(1)
+{
+	m_bufferSize = AlignUp(bufferSize ? bufferSize : 1, FRAME_ALIGNMENT);
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.capacity = capacity ? capacity : 1;
+	m_free.reserve(m_stats.capacity);
+}
+
+BufferPool::~BufferPool()
+{
+	for (size_t i = 0; i < m_free.size(); ++i) {
+		AlignedFree(m_free[i]);
+	}
+}
+
+void* BufferPool::Acquire(bool block)
+{
+	void* pBuffer = NULL;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_free.empty() && m_stats.allocated == m_stats.capacity) {
+			if (!block) {
+				m_stats.exhausted++;
+				return NULL;
+			}
+			m_stats.waited++;
+			m_bufferFree.wait(lock, [this] { return !m_free.empty() || m_stats.allocated < m_stats.capacity; });
+		}
+		if (!m_free.empty()) {
+			pBuffer = m_free.back();
+			m_free.pop_back();
+		}
+		else {
+			// Reserve the slot now, allocate outside the lock.
+			m_stats.allocated++;
+		}
+		m_stats.acquired++;
+		m_stats.inUse++;
+		if (m_stats.inUse > m_stats.highWater) {
+			m_stats.highWater = m_stats.inUse;
+		}
+	}
+	if (pBuffer == NULL) {
+		pBuffer = AlignedAlloc(m_bufferSize);
+		if (pBuffer == NULL) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.allocated--;
+				m_stats.inUse--;
+			}
+			m_bufferFree.notify_one();
+			return NULL;
+		}
+	}
+	AddRef();
+	return pBuffer;
+}
+
+void BufferPool::Recycle(void* pBuffer)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(pBuffer);
+		m_stats.inUse--;
+	}
+	m_bufferFree.notify_one();
+	Release();
+}
+
+BufferPoolStats BufferPool::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
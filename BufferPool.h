@@ -0,0 +1,61 @@
+#ifndef __BUFFERPOOL_H__
+#define __BUFFERPOOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+struct BufferPoolStats
+{
+	uint32_t capacity;
+	uint32_t allocated;	// buffers allocated so far, at most capacity
+	uint32_t inUse;
+	uint32_t highWater;	// most buffers in use at once
+	uint64_t acquired;
+	uint64_t waited;	// blocking acquires that had to wait for a buffer
+	uint64_t exhausted;	// non blocking acquires that got nothing
+};
+
+// Fixed number of FRAME_ALIGNMENT aligned buffers of one size, recycled
+// instead of freed. Buffers are allocated on first use. Reference counted
+// like IFrameOwner: every buffer out of the pool holds a reference, so the
+// creator can Release() the pool while buffers are still in use.
+class BufferPool
+{
+public:
+	BufferPool(size_t bufferSize, uint32_t capacity);
+
+	void AddRef() { ++m_refCount; }
+	void Release()
+	{
+		if (--m_refCount == 0) {
+			delete this;
+		}
+	}
+
+	size_t BufferSize() const { return m_bufferSize; }
+
+	// Returns a free buffer. With all of them in use, waits for Recycle() if
+	// block is set, otherwise returns NULL.
+	void* Acquire(bool block);
+	// Gives a buffer from Acquire() back.
+	void Recycle(void* pBuffer);
+
+	BufferPoolStats GetStats();
+
+private:
+	~BufferPool();
+
+	std::atomic<long> m_refCount;
+	size_t m_bufferSize;
+	std::mutex m_mutex;
+	std::condition_variable m_bufferFree;
+	std::vector<void*> m_free;
+	BufferPoolStats m_stats;
+};
+
+#endif
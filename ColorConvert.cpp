@@ -0,0 +1,478 @@
+#include "ColorConvert.h"
+#include "AlignedMemory.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+
+// Kr / Kb of the matrices (ITU-R BT.601 and BT.709).
+static void GetMatrixWeights(YuvMatrix matrix, double* pKr, double* pKb)
+{
+	*pKr = matrix == YUV_MATRIX_BT709 ? 0.2126 : 0.299;
+	*pKb = matrix == YUV_MATRIX_BT709 ? 0.0722 : 0.114;
+}
+
+// Y scale and B, G, R weights of Cb / Cr, after the range expansion.
+struct YuvMatrixDouble
+{
+	double yOffset;
+	double yScale;
+	double bu, gu, gv, rv;
+};
+
+static void GetYuvMatrixDouble(YuvMatrix matrix, YuvRange range, YuvMatrixDouble* pM)
+{
+	double kr, kb;
+	GetMatrixWeights(matrix, &kr, &kb);
+	double kg = 1.0 - kr - kb;
+	double cScale = range == YUV_RANGE_LIMITED ? 255.0 / 224.0 : 1.0;
+	pM->yOffset = range == YUV_RANGE_LIMITED ? 16.0 : 0.0;
+	pM->yScale = range == YUV_RANGE_LIMITED ? 255.0 / 219.0 : 1.0;
+	pM->bu = 2.0 * (1.0 - kb) * cScale;
+	pM->gu = -2.0 * kb * (1.0 - kb) / kg * cScale;
+	pM->gv = -2.0 * kr * (1.0 - kr) / kg * cScale;
+	pM->rv = 2.0 * (1.0 - kr) * cScale;
+}
+
+static int16_t Q15(double v)
+{
+	double q = floor(v * 32768.0 + 0.5);
+	return (int16_t)(q > 32767.0 ? 32767.0 : q < -32767.0 ? -32767.0 : q);
+}
+
+void GetYuvCoefficients(YuvMatrix matrix, YuvRange range, YuvCoefficients* pCoef)
+{
+	YuvMatrixDouble m;
+	GetYuvMatrixDouble(matrix, range, &m);
+	pCoef->yOffset = (int16_t)m.yOffset;
+	pCoef->yFrac = Q15(m.yScale - 1.0);
+	pCoef->buInt = (int16_t)m.bu;
+	pCoef->buFrac = Q15(m.bu - pCoef->buInt);
+	pCoef->guFrac = Q15(m.gu);
+	pCoef->gvFrac = Q15(m.gv);
+	pCoef->rvInt = (int16_t)m.rv;
+	pCoef->rvFrac = Q15(m.rv - pCoef->rvInt);
+}
+
+// Scalar versions of PADDSW, PMULHRSW and the final rounding shift, so the
+// reference kernel is bit exact with the SIMD ones.
+static inline int32_t AddSat16(int32_t a, int32_t b)
+{
+	int32_t s = a + b;
+	return s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+}
+
+static inline int32_t MulHrs16(int32_t a, int32_t b)
+{
+	return (a * b + 0x4000) >> 15;
+}
+
+static inline uint8_t ToPixel(int32_t v)
+{
+	v = AddSat16(v, 32) >> 6;
+	return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static inline void YuvToBgr(int y8, int u8, int v8, const YuvCoefficients* c, uint8_t* pBgr)
+{
+	int32_t y = (y8 - c->yOffset) * 64;
+	y = AddSat16(y, MulHrs16(y, c->yFrac));
+	int32_t u = (u8 - 128) * 64;
+	int32_t v = (v8 - 128) * 64;
+	pBgr[0] = ToPixel(AddSat16(AddSat16(y, u * c->buInt), MulHrs16(u, c->buFrac)));
+	pBgr[1] = ToPixel(AddSat16(AddSat16(y, MulHrs16(u, c->guFrac)), MulHrs16(v, c->gvFrac)));
+	pBgr[2] = ToPixel(AddSat16(AddSat16(y, v * c->rvInt), MulHrs16(v, c->rvFrac)));
+}
+
+void NV12RowToBGRA(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef)
+{
+	for (uint32_t x = 0; x < width; ++x) {
+		YuvToBgr(pY[x], pUV[x & ~1u], pUV[x | 1u], pCoef, pDst + x * 4);
+		pDst[x * 4 + 3] = 255;
+	}
+}
+
+void NV12RowToRGB24(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef)
+{
+	for (uint32_t x = 0; x < width; ++x) {
+		YuvToBgr(pY[x], pUV[x & ~1u], pUV[x | 1u], pCoef, pDst + x * 3);
+	}
+}
+
+#if defined(CPU_X86)
+// The coefficients broadcast to 16 bit lanes.
+struct YuvVectors128
+{
+	__m128i yOffset, yFrac, buInt, buFrac, guFrac, gvFrac, rvInt, rvFrac;
+};
+
+TARGET_SSSE3 static void LoadYuvVectors128(const YuvCoefficients* c, YuvVectors128* pK)
+{
+	pK->yOffset = _mm_set1_epi16(c->yOffset);
+	pK->yFrac = _mm_set1_epi16(c->yFrac);
+	pK->buInt = _mm_set1_epi16(c->buInt);
+	pK->buFrac = _mm_set1_epi16(c->buFrac);
+	pK->guFrac = _mm_set1_epi16(c->guFrac);
+	pK->gvFrac = _mm_set1_epi16(c->gvFrac);
+	pK->rvInt = _mm_set1_epi16(c->rvInt);
+	pK->rvFrac = _mm_set1_epi16(c->rvFrac);
+}
+
+// Eight pixels in 16 bit lanes, same arithmetic as YuvToBgr.
+TARGET_SSSE3 static inline void YuvToBgr8SSSE3(__m128i y, __m128i u, __m128i v, const YuvVectors128& k,
+	__m128i* pB, __m128i* pG, __m128i* pR)
+{
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i round = _mm_set1_epi16(32);
+	y = _mm_slli_epi16(_mm_sub_epi16(y, k.yOffset), 6);
+	y = _mm_adds_epi16(y, _mm_mulhrs_epi16(y, k.yFrac));
+	u = _mm_slli_epi16(_mm_sub_epi16(u, c128), 6);
+	v = _mm_slli_epi16(_mm_sub_epi16(v, c128), 6);
+	__m128i b = _mm_adds_epi16(_mm_adds_epi16(y, _mm_mullo_epi16(u, k.buInt)), _mm_mulhrs_epi16(u, k.buFrac));
+	__m128i g = _mm_adds_epi16(_mm_adds_epi16(y, _mm_mulhrs_epi16(u, k.guFrac)), _mm_mulhrs_epi16(v, k.gvFrac));
+	__m128i r = _mm_adds_epi16(_mm_adds_epi16(y, _mm_mullo_epi16(v, k.rvInt)), _mm_mulhrs_epi16(v, k.rvFrac));
+	*pB = _mm_srai_epi16(_mm_adds_epi16(b, round), 6);
+	*pG = _mm_srai_epi16(_mm_adds_epi16(g, round), 6);
+	*pR = _mm_srai_epi16(_mm_adds_epi16(r, round), 6);
+}
+
+// Converts 16 pixels to four registers of four B, G, R, A pixels each.
+TARGET_SSSE3 static inline void YuvToBgra16SSSE3(const uint8_t* pY, const uint8_t* pUV, const YuvVectors128& k,
+	__m128i* pOut)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi8(-1);
+	const __m128i dupU = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+	const __m128i dupV = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+	__m128i y = _mm_loadu_si128((const __m128i*)pY);
+	__m128i uv = _mm_loadu_si128((const __m128i*)pUV);
+	__m128i u = _mm_shuffle_epi8(uv, dupU);
+	__m128i v = _mm_shuffle_epi8(uv, dupV);
+	__m128i b0, g0, r0, b1, g1, r1;
+	YuvToBgr8SSSE3(_mm_unpacklo_epi8(y, zero), _mm_unpacklo_epi8(u, zero), _mm_unpacklo_epi8(v, zero), k, &b0, &g0, &r0);
+	YuvToBgr8SSSE3(_mm_unpackhi_epi8(y, zero), _mm_unpackhi_epi8(u, zero), _mm_unpackhi_epi8(v, zero), k, &b1, &g1, &r1);
+	__m128i b = _mm_packus_epi16(b0, b1);
+	__m128i g = _mm_packus_epi16(g0, g1);
+	__m128i r = _mm_packus_epi16(r0, r1);
+	__m128i bgLo = _mm_unpacklo_epi8(b, g);
+	__m128i bgHi = _mm_unpackhi_epi8(b, g);
+	__m128i raLo = _mm_unpacklo_epi8(r, alpha);
+	__m128i raHi = _mm_unpackhi_epi8(r, alpha);
+	pOut[0] = _mm_unpacklo_epi16(bgLo, raLo);
+	pOut[1] = _mm_unpackhi_epi16(bgLo, raLo);
+	pOut[2] = _mm_unpacklo_epi16(bgHi, raHi);
+	pOut[3] = _mm_unpackhi_epi16(bgHi, raHi);
+}
+
+TARGET_SSSE3 void NV12RowToBGRASSSE3(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width,
+	const YuvCoefficients* pCoef)
+{
+	YuvVectors128 k;
+	LoadYuvVectors128(pCoef, &k);
+	uint32_t x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i bgra[4];
+		YuvToBgra16SSSE3(pY + x, pUV + x, k, bgra);
+		uint8_t* d = pDst + (size_t)x * 4;
+		_mm_storeu_si128((__m128i*)(d + 0), bgra[0]);
+		_mm_storeu_si128((__m128i*)(d + 16), bgra[1]);
+		_mm_storeu_si128((__m128i*)(d + 32), bgra[2]);
+		_mm_storeu_si128((__m128i*)(d + 48), bgra[3]);
+	}
+	NV12RowToBGRA(pY + x, pUV + x, pDst + (size_t)x * 4, width - x, pCoef);
+}
+
+TARGET_SSSE3 void NV12RowToRGB24SSSE3(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width,
+	const YuvCoefficients* pCoef)
+{
+	const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	YuvVectors128 k;
+	LoadYuvVectors128(pCoef, &k);
+	uint32_t x = 0;
+	// Each store writes 4 bytes past its 12, which the next store or the
+	// next 2 pixels of the row overwrite.
+	for (; x + 18 <= width; x += 16) {
+		__m128i bgra[4];
+		YuvToBgra16SSSE3(pY + x, pUV + x, k, bgra);
+		uint8_t* d = pDst + (size_t)x * 3;
+		_mm_storeu_si128((__m128i*)(d + 0), _mm_shuffle_epi8(bgra[0], dropAlpha));
+		_mm_storeu_si128((__m128i*)(d + 12), _mm_shuffle_epi8(bgra[1], dropAlpha));
+		_mm_storeu_si128((__m128i*)(d + 24), _mm_shuffle_epi8(bgra[2], dropAlpha));
+		_mm_storeu_si128((__m128i*)(d + 36), _mm_shuffle_epi8(bgra[3], dropAlpha));
+	}
+	NV12RowToRGB24(pY + x, pUV + x, pDst + (size_t)x * 3, width - x, pCoef);
+}
+
+struct YuvVectors256
+{
+	__m256i yOffset, yFrac, buInt, buFrac, guFrac, gvFrac, rvInt, rvFrac;
+};
+
+TARGET_AVX2 static void LoadYuvVectors256(const YuvCoefficients* c, YuvVectors256* pK)
+{
+	pK->yOffset = _mm256_set1_epi16(c->yOffset);
+	pK->yFrac = _mm256_set1_epi16(c->yFrac);
+	pK->buInt = _mm256_set1_epi16(c->buInt);
+	pK->buFrac = _mm256_set1_epi16(c->buFrac);
+	pK->guFrac = _mm256_set1_epi16(c->guFrac);
+	pK->gvFrac = _mm256_set1_epi16(c->gvFrac);
+	pK->rvInt = _mm256_set1_epi16(c->rvInt);
+	pK->rvFrac = _mm256_set1_epi16(c->rvFrac);
+}
+
+TARGET_AVX2 static inline void YuvToBgr16AVX2(__m256i y, __m256i u, __m256i v, const YuvVectors256& k,
+	__m256i* pB, __m256i* pG, __m256i* pR)
+{
+	const __m256i c128 = _mm256_set1_epi16(128);
+	const __m256i round = _mm256_set1_epi16(32);
+	y = _mm256_slli_epi16(_mm256_sub_epi16(y, k.yOffset), 6);
+	y = _mm256_adds_epi16(y, _mm256_mulhrs_epi16(y, k.yFrac));
+	u = _mm256_slli_epi16(_mm256_sub_epi16(u, c128), 6);
+	v = _mm256_slli_epi16(_mm256_sub_epi16(v, c128), 6);
+	__m256i b = _mm256_adds_epi16(_mm256_adds_epi16(y, _mm256_mullo_epi16(u, k.buInt)), _mm256_mulhrs_epi16(u, k.buFrac));
+	__m256i g = _mm256_adds_epi16(_mm256_adds_epi16(y, _mm256_mulhrs_epi16(u, k.guFrac)), _mm256_mulhrs_epi16(v, k.gvFrac));
+	__m256i r = _mm256_adds_epi16(_mm256_adds_epi16(y, _mm256_mullo_epi16(v, k.rvInt)), _mm256_mulhrs_epi16(v, k.rvFrac));
+	*pB = _mm256_srai_epi16(_mm256_adds_epi16(b, round), 6);
+	*pG = _mm256_srai_epi16(_mm256_adds_epi16(g, round), 6);
+	*pR = _mm256_srai_epi16(_mm256_adds_epi16(r, round), 6);
+}
+
+// Converts 32 pixels to four registers of eight B, G, R, A pixels each. Every
+// 128 bit lane works on its own 16 pixels, whose UV bytes sit in the same lane.
+TARGET_AVX2 static inline void YuvToBgra32AVX2(const uint8_t* pY, const uint8_t* pUV, const YuvVectors256& k,
+	__m256i* pOut)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alpha = _mm256_set1_epi8(-1);
+	const __m256i dupU = _mm256_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14,
+		0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+	const __m256i dupV = _mm256_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15,
+		1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+	__m256i y = _mm256_loadu_si256((const __m256i*)pY);
+	__m256i uv = _mm256_loadu_si256((const __m256i*)pUV);
+	__m256i u = _mm256_shuffle_epi8(uv, dupU);
+	__m256i v = _mm256_shuffle_epi8(uv, dupV);
+	__m256i b0, g0, r0, b1, g1, r1;
+	YuvToBgr16AVX2(_mm256_unpacklo_epi8(y, zero), _mm256_unpacklo_epi8(u, zero), _mm256_unpacklo_epi8(v, zero), k,
+		&b0, &g0, &r0);
+	YuvToBgr16AVX2(_mm256_unpackhi_epi8(y, zero), _mm256_unpackhi_epi8(u, zero), _mm256_unpackhi_epi8(v, zero), k,
+		&b1, &g1, &r1);
+	__m256i b = _mm256_packus_epi16(b0, b1);
+	__m256i g = _mm256_packus_epi16(g0, g1);
+	__m256i r = _mm256_packus_epi16(r0, r1);
+	__m256i bgLo = _mm256_unpacklo_epi8(b, g);
+	__m256i bgHi = _mm256_unpackhi_epi8(b, g);
+	__m256i raLo = _mm256_unpacklo_epi8(r, alpha);
+	__m256i raHi = _mm256_unpackhi_epi8(r, alpha);
+	// Pixels 0-3 | 16-19, 4-7 | 20-23, 8-11 | 24-27, 12-15 | 28-31.
+	__m256i p0 = _mm256_unpacklo_epi16(bgLo, raLo);
+	__m256i p1 = _mm256_unpackhi_epi16(bgLo, raLo);
+	__m256i p2 = _mm256_unpacklo_epi16(bgHi, raHi);
+	__m256i p3 = _mm256_unpackhi_epi16(bgHi, raHi);
+	pOut[0] = _mm256_permute2x128_si256(p0, p1, 0x20);
+	pOut[1] = _mm256_permute2x128_si256(p2, p3, 0x20);
+	pOut[2] = _mm256_permute2x128_si256(p0, p1, 0x31);
+	pOut[3] = _mm256_permute2x128_si256(p2, p3, 0x31);
+}
+
+TARGET_AVX2 void NV12RowToBGRAAVX2(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width,
+	const YuvCoefficients* pCoef)
+{
+	YuvVectors256 k;
+	LoadYuvVectors256(pCoef, &k);
+	uint32_t x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i bgra[4];
+		YuvToBgra32AVX2(pY + x, pUV + x, k, bgra);
+		uint8_t* d = pDst + (size_t)x * 4;
+		_mm256_storeu_si256((__m256i*)(d + 0), bgra[0]);
+		_mm256_storeu_si256((__m256i*)(d + 32), bgra[1]);
+		_mm256_storeu_si256((__m256i*)(d + 64), bgra[2]);
+		_mm256_storeu_si256((__m256i*)(d + 96), bgra[3]);
+	}
+	NV12RowToBGRASSSE3(pY + x, pUV + x, pDst + (size_t)x * 4, width - x, pCoef);
+}
+
+TARGET_AVX2 void NV12RowToRGB24AVX2(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width,
+	const YuvCoefficients* pCoef)
+{
+	const __m256i dropAlpha = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	// Joins the 12 bytes of each lane into the low 24.
+	const __m256i joinLanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	YuvVectors256 k;
+	LoadYuvVectors256(pCoef, &k);
+	uint32_t x = 0;
+	// Each store writes 8 bytes past its 24, overwritten by the next store or
+	// the next 3 pixels of the row.
+	for (; x + 35 <= width; x += 32) {
+		__m256i bgra[4];
+		YuvToBgra32AVX2(pY + x, pUV + x, k, bgra);
+		uint8_t* d = pDst + (size_t)x * 3;
+		for (int i = 0; i < 4; ++i) {
+			__m256i bgr = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(bgra[i], dropAlpha), joinLanes);
+			_mm256_storeu_si256((__m256i*)(d + 24 * i), bgr);
+		}
+	}
+	NV12RowToRGB24SSSE3(pY + x, pUV + x, pDst + (size_t)x * 3, width - x, pCoef);
+}
+#endif
+
+uint32_t GetNV12RowKernels(RgbFormat format, NV12RowFunc* pFuncs, const char** pNames, uint32_t max)
+{
+	uint32_t n = 0;
+	bool bgra = format == RGB_FORMAT_BGRA;
+	if (n < max) {
+		pFuncs[n] = bgra ? NV12RowToBGRA : NV12RowToRGB24;
+		pNames[n++] = "scalar";
+	}
+#if defined(CPU_X86)
+	unsigned int features = GetCpuFeatures();
+	if ((features & CPU_FEATURE_SSSE3) && n < max) {
+		pFuncs[n] = bgra ? NV12RowToBGRASSSE3 : NV12RowToRGB24SSSE3;
+		pNames[n++] = "SSSE3";
+	}
+	if ((features & CPU_FEATURE_AVX2) && (features & CPU_FEATURE_SSSE3) && n < max) {
+		pFuncs[n] = bgra ? NV12RowToBGRAAVX2 : NV12RowToRGB24AVX2;
+		pNames[n++] = "AVX2";
+	}
+#endif
+	return n;
+}
+
+NV12RowFunc SelectNV12RowKernel(RgbFormat format)
+{
+	NV12RowFunc funcs[3];
+	const char* names[3];
+	uint32_t n = GetNV12RowKernels(format, funcs, names, 3);
+	return funcs[n - 1];
+}
+
+void ConvertNV12ToRgb(const NV12Frame* pFrame, YuvMatrix matrix, YuvRange range, RgbFormat format,
+	uint8_t* pDst, ptrdiff_t dstPitch)
+{
+	YuvCoefficients coef;
+	GetYuvCoefficients(matrix, range, &coef);
+	NV12RowFunc convertRow = SelectNV12RowKernel(format);
+	const uint8_t* pUV = pFrame->pUV;
+	uint32_t pitchUV = pFrame->pitchUV;
+	std::vector<uint8_t> neutral;
+	if (pUV == NULL) {
+		// Luma only frame: every row gets the same neutral chroma row.
+		neutral.assign((pFrame->width + 1) & ~1u, 128);
+		pUV = neutral.data();
+		pitchUV = 0;
+	}
+	for (uint32_t y = 0; y < pFrame->height; ++y) {
+		convertRow(pFrame->pY + (size_t)y * pFrame->pitchY, pUV + (size_t)(y / 2) * pitchUV,
+			pDst + (ptrdiff_t)y * dstPitch, pFrame->width, &coef);
+	}
+}
+
+bool AllocateRgbFrame(uint32_t width, uint32_t height, RgbFormat format, RgbFrame* pFrame)
+{
+	uint32_t pitch = (uint32_t)AlignUp((size_t)width * RgbBytesPerPixel(format), FRAME_ALIGNMENT);
+	uint8_t* pData = (uint8_t*)AlignedAlloc((size_t)pitch * height);
+	if (pData == NULL) {
+		return false;
+	}
+	pFrame->pData = pData;
+	pFrame->pitch = pitch;
+	pFrame->width = width;
+	pFrame->height = height;
+	pFrame->format = format;
+	pFrame->timestamp = 0;
+	pFrame->pOwner = CreateHeapFrameOwner(pData);
+	return true;
+}
+
+void ReleaseFrame(RgbFrame* pFrame)
+{
+	if (pFrame->pOwner) {
+		pFrame->pOwner->Release();
+	}
+	memset(pFrame, 0, sizeof(*pFrame));
+}
+
+static uint32_t NextRandom(uint32_t* pState)
+{
+	*pState = *pState * 1664525u + 1013904223u;
+	return *pState >> 8;
+}
+
+// Straight from the matrix in double precision, rounded once at the end.
+static void ReferenceRow(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width,
+	const YuvMatrixDouble& m, uint32_t bytesPerPixel)
+{
+	for (uint32_t x = 0; x < width; ++x) {
+		double y = (pY[x] - m.yOffset) * m.yScale;
+		double u = pUV[x & ~1u] - 128.0;
+		double v = pUV[x | 1u] - 128.0;
+		double bgr[3] = { y + m.bu * u, y + m.gu * u + m.gv * v, y + m.rv * v };
+		for (int c = 0; c < 3; ++c) {
+			double p = floor(bgr[c] + 0.5);
+			pDst[x * bytesPerPixel + c] = (uint8_t)(p < 0.0 ? 0.0 : p > 255.0 ? 255.0 : p);
+		}
+		if (bytesPerPixel == 4) {
+			pDst[x * 4 + 3] = 255;
+		}
+	}
+}
+
+uint32_t VerifyColorKernels(uint32_t rows, uint32_t seed, int* pMaxError)
+{
+	const uint32_t maxWidth = 300;
+	// Room for the rows plus what the RGB24 kernels may write past them.
+	std::vector<uint8_t> y(maxWidth), uv(maxWidth + 1), expected(maxWidth * 4), scalar(maxWidth * 4 + 64),
+		actual(maxWidth * 4 + 64);
+	uint32_t state = seed;
+	uint32_t mismatches = 0;
+	int maxError = 0;
+
+	for (int format = RGB_FORMAT_BGRA; format <= RGB_FORMAT_RGB24; ++format) {
+		NV12RowFunc funcs[3];
+		const char* names[3];
+		uint32_t numKernels = GetNV12RowKernels((RgbFormat)format, funcs, names, 3);
+		uint32_t bpp = RgbBytesPerPixel((RgbFormat)format);
+		for (int matrix = YUV_MATRIX_BT601; matrix <= YUV_MATRIX_BT709; ++matrix) {
+			for (int range = YUV_RANGE_FULL; range <= YUV_RANGE_LIMITED; ++range) {
+				YuvCoefficients coef;
+				YuvMatrixDouble m;
+				GetYuvCoefficients((YuvMatrix)matrix, (YuvRange)range, &coef);
+				GetYuvMatrixDouble((YuvMatrix)matrix, (YuvRange)range, &m);
+				for (uint32_t r = 0; r < rows; ++r) {
+					uint32_t width = 1 + NextRandom(&state) % maxWidth;
+					for (uint32_t i = 0; i < maxWidth; ++i) {
+						y[i] = (uint8_t)NextRandom(&state);
+						uv[i] = (uint8_t)NextRandom(&state);
+					}
+					ReferenceRow(y.data(), uv.data(), expected.data(), width, m, bpp);
+					funcs[0](y.data(), uv.data(), scalar.data(), width, &coef);
+					for (uint32_t i = 0; i < width * bpp; ++i) {
+						int d = scalar[i] > expected[i] ? scalar[i] - expected[i] : expected[i] - scalar[i];
+						if (d > maxError) {
+							maxError = d;
+						}
+						if (d > 1) {
+							mismatches++;
+						}
+					}
+					for (uint32_t k = 1; k < numKernels; ++k) {
+						funcs[k](y.data(), uv.data(), actual.data(), width, &coef);
+						if (memcmp(scalar.data(), actual.data(), (size_t)width * bpp) != 0) {
+							mismatches++;
+						}
+					}
+				}
+			}
+		}
+	}
+	if (pMaxError) {
+		*pMaxError = maxError;
+	}
+	return mismatches;
+}
@@ -0,0 +1,104 @@
+#ifndef __COLORCONVERT_H__
+#define __COLORCONVERT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CpuFeatures.h"
+#include "NV12Frame.h"
+
+// YCbCr to RGB matrix (MF_MT_YUV_MATRIX).
+enum YuvMatrix
+{
+	YUV_MATRIX_BT601,	// JFIF and SD video
+	YUV_MATRIX_BT709,	// HD video
+};
+
+// Code range of the samples (MF_MT_VIDEO_NOMINAL_RANGE).
+enum YuvRange
+{
+	YUV_RANGE_FULL,	// 0..255, what JPEG uses
+	YUV_RANGE_LIMITED,	// Y 16..235, Cb / Cr 16..240
+};
+
+// Output pixel layouts, named like their MFVideoFormat_* counterparts.
+enum RgbFormat
+{
+	RGB_FORMAT_BGRA,	// B, G, R, 255 (MFVideoFormat_RGB32 / ARGB32)
+	RGB_FORMAT_RGB24,	// B, G, R (MFVideoFormat_RGB24)
+};
+
+inline uint32_t RgbBytesPerPixel(RgbFormat format)
+{
+	return format == RGB_FORMAT_BGRA ? 4 : 3;
+}
+
+// A decoded frame in an RGB format, rows pitch bytes apart.
+struct RgbFrame
+{
+	uint8_t* pData;
+	uint32_t pitch;
+	uint32_t width;
+	uint32_t height;
+	RgbFormat format;
+	int64_t timestamp;	// 100ns units like MF sample times
+	IFrameOwner* pOwner;
+};
+
+// Allocates a heap backed frame with 64 byte aligned rows.
+bool AllocateRgbFrame(uint32_t width, uint32_t height, RgbFormat format, RgbFrame* pFrame);
+
+// Drops the frame's reference and clears the descriptor.
+void ReleaseFrame(RgbFrame* pFrame);
+
+// Fixed point form of a matrix and range, shared by all kernels so they are
+// bit exact with each other. Samples are scaled to 1/64 units in 16 bits;
+// the "f" terms are Q15 fractions (PMULHRSW), the "i" terms small integers.
+struct YuvCoefficients
+{
+	int16_t yOffset;	// 0 or 16
+	int16_t yFrac;	// Y scale - 1
+	int16_t buInt, buFrac;	// B from Cb
+	int16_t guFrac, gvFrac;	// G from Cb and Cr
+	int16_t rvInt, rvFrac;	// R from Cr
+};
+
+void GetYuvCoefficients(YuvMatrix matrix, YuvRange range, YuvCoefficients* pCoef);
+
+// Converts one row of 'width' pixels. pUV is the NV12 chroma row for it.
+typedef void (*NV12RowFunc)(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width,
+	const YuvCoefficients* pCoef);
+
+// Scalar reference kernels.
+void NV12RowToBGRA(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef);
+void NV12RowToRGB24(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef);
+
+#if defined(CPU_X86)
+// 16 / 32 pixels per step, the rest of the row with the scalar kernel.
+void NV12RowToBGRASSSE3(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef);
+void NV12RowToRGB24SSSE3(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef);
+void NV12RowToBGRAAVX2(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef);
+void NV12RowToRGB24AVX2(const uint8_t* pY, const uint8_t* pUV, uint8_t* pDst, uint32_t width, const YuvCoefficients* pCoef);
+#endif
+
+// Kernels this CPU can run for 'format', scalar first, fastest last. Returns
+// how many were stored (at most 'max').
+uint32_t GetNV12RowKernels(RgbFormat format, NV12RowFunc* pFuncs, const char** pNames, uint32_t max);
+
+// Returns the fastest kernel for this CPU (GetCpuFeatures()).
+NV12RowFunc SelectNV12RowKernel(RgbFormat format);
+
+// Converts a decoded frame through its pitches, e.g. straight from the
+// decoder output. Rows are dstPitch bytes apart; a negative pitch with pDst
+// on the last row writes bottom-up like BMP. Chroma is upsampled by repeating
+// each sample over its 2x2 pixels. Luma only frames (pUV NULL) come out gray.
+void ConvertNV12ToRgb(const NV12Frame* pFrame, YuvMatrix matrix, YuvRange range, RgbFormat format,
+	uint8_t* pDst, ptrdiff_t dstPitch);
+
+// Converts 'rows' pseudo random rows of varying width with every kernel, matrix,
+// range and format. Counts pixels more than 1 away from a double precision
+// reference and SIMD rows that differ from the scalar kernel. *pMaxError gets
+// the largest difference from the reference.
+uint32_t VerifyColorKernels(uint32_t rows, uint32_t seed, int* pMaxError);
+
+#endif
@@ -0,0 +1,79 @@
+#include "CpuFeatures.h"
+
+#if defined(CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+static unsigned int s_featureMask = ~0u;
+
+#if defined(CPU_X86)
+static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, leaf, subleaf);
+	for (int i = 0; i < 4; ++i) {
+		regs[i] = (unsigned int)r[i];
+	}
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+static unsigned int DetectCpuFeatures()
+{
+	unsigned int regs[4];
+	unsigned int features = 0;
+
+	cpuid(0, 0, regs);
+	unsigned int maxLeaf = regs[0];
+	if (maxLeaf < 1) {
+		return 0;
+	}
+	cpuid(1, 0, regs);
+	if (regs[3] & (1u << 26)) features |= CPU_FEATURE_SSE2;
+	if (regs[2] & (1u << 9)) features |= CPU_FEATURE_SSSE3;
+	if (regs[2] & (1u << 19)) features |= CPU_FEATURE_SSE41;
+
+	// AVX2 also needs the OS to save the YMM registers (OSXSAVE + XCR0 bits 1,2).
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	if (maxLeaf >= 7 && osxsave && avx && (xgetbv0() & 0x6) == 0x6) {
+		cpuid(7, 0, regs);
+		if (regs[1] & (1u << 5)) features |= CPU_FEATURE_AVX2;
+	}
+	return features;
+}
+#else
+static unsigned int DetectCpuFeatures()
+{
+	return 0;
+}
+#endif
+
+unsigned int GetCpuFeatures()
+{
+	static const unsigned int detected = DetectCpuFeatures();
+	return detected & s_featureMask;
+}
+
+void SetCpuFeatureMask(unsigned int mask)
+{
+	s_featureMask = mask;
+}
@@ -0,0 +1,37 @@
+#ifndef __CPUFEATURES_H__
+#define __CPUFEATURES_H__
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#endif
+
+// Instruction set extensions used by the SIMD kernels.
+enum CpuFeature
+{
+	CPU_FEATURE_SSE2 = 0x01,
+	CPU_FEATURE_SSSE3 = 0x02,
+	CPU_FEATURE_SSE41 = 0x04,
+	CPU_FEATURE_AVX2 = 0x08,
+};
+
+// MSVC lets any function use any intrinsic, gcc/clang need the target attribute.
+#if defined(CPU_X86) && !defined(_MSC_VER)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_SSSE3
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+// Returns the CPU_FEATURE_* bits supported by both the CPU and the OS,
+// restricted by the mask set with SetCpuFeatureMask().
+unsigned int GetCpuFeatures();
+
+// Restricts the reported features, e.g. to force the scalar path when testing.
+void SetCpuFeatureMask(unsigned int mask);
+
+#endif
@@ -0,0 +1,314 @@
+#include "DecodeBenchmark.h"
+#include "AlignedMemory.h"
+#include "ColorConvert.h"
+#include "FrameScheduler.h"
+#include "GuidNames.h"
+#include "JpegDecoder.h"
+#include "Logger.h"
+#include "SoftMJPEGDecoder.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RunHuffmanBenchmark(const uint8_t* const* ppFrames, const size_t* pLengths, uint32_t count, uint32_t iterations)
+{
+	SoftMJPEGDecoder decoder;
+	JpegHeader header;
+	NV12Frame frame;
+	uint64_t checksum = 0;
+	uint64_t bytes = 0;
+	uint32_t decoded = 0;
+
+	// Entropy decoding only.
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		for (uint32_t f = 0; f < count; ++f) {
+			uint64_t sum;
+			if (ParseJpegHeader(ppFrames[f], pLengths[f], &header) != S_OK ||
+				DecodeJpegCoefficients(&header, &sum) != S_OK) {
+				continue;
+			}
+			checksum += sum;
+			bytes += header.scanLen;
+			decoded++;
+		}
+	}
+	double huffmanMs = ElapsedMs(start);
+
+	// Full decode to NV12.
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		for (uint32_t f = 0; f < count; ++f) {
+			if (decoder.DecodeOneFrame(ppFrames[f], pLengths[f], &frame) == S_OK) {
+				ReleaseFrame(&frame);
+			}
+		}
+	}
+	double decodeMs = ElapsedMs(start);
+
+	if (decoded == 0) {
+		printf("Huffman benchmark: no decodable frames\n");
+		return;
+	}
+	printf("Huffman benchmark: %u frames, %.1f MB/s entropy decode, %.2f ms/frame entropy, %.2f ms/frame full decode (checksum %llx)\n",
+		decoded, bytes / huffmanMs / 1000.0, huffmanMs / decoded, decodeMs / decoded, (unsigned long long)checksum);
+	printf("Header cache: %llu hits, %llu misses\n", (unsigned long long)decoder.m_headerCache.Hits(),
+		(unsigned long long)decoder.m_headerCache.Misses());
+}
+
+void RunRestartScalingBenchmark(const uint8_t* const* ppFrames, const size_t* pLengths, uint32_t count,
+	uint32_t iterations, uint32_t maxThreads)
+{
+	JpegHeader header;
+	uint32_t withRestarts = 0;
+	double baseMs = 0.0;
+
+	for (uint32_t f = 0; f < count; ++f) {
+		if (ParseJpegHeader(ppFrames[f], pLengths[f], &header) == S_OK && header.restartInterval) {
+			withRestarts++;
+		}
+	}
+	printf("Restart scaling benchmark: %u of %u frames have restart markers\n", withRestarts, count);
+
+	for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+		SoftMJPEGDecoder decoder;
+		NV12Frame frame;
+		uint32_t decoded = 0;
+
+		decoder.SetThreadCount(threads);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; ++i) {
+			for (uint32_t f = 0; f < count; ++f) {
+				if (decoder.DecodeOneFrame(ppFrames[f], pLengths[f], &frame) == S_OK) {
+					ReleaseFrame(&frame);
+					decoded++;
+				}
+			}
+		}
+		double ms = decoded ? ElapsedMs(start) / decoded : 0.0;
+		if (threads == 1) {
+			baseMs = ms;
+		}
+		printf("  %2u threads: %.2f ms/frame, speedup %.2fx\n", threads, ms, ms > 0.0 ? baseMs / ms : 0.0);
+	}
+}
+
+static void OnBenchmarkFrame(void* pContext, uint64_t sequence, NV12Frame* pFrame)
+{
+	uint64_t* pExpected = (uint64_t*)pContext;
+	if (sequence != *pExpected) {
+		printf("  out of order: got %llu, expected %llu\n", (unsigned long long)sequence, (unsigned long long)*pExpected);
+	}
+	*pExpected = sequence + 1;
+	ReleaseFrame(pFrame);
+}
+
+void RunFrameSchedulerBenchmark(const uint8_t* const* ppFrames, const size_t* pLengths, uint32_t count,
+	uint32_t iterations, uint32_t maxDecoders)
+{
+	double baseMs = 0.0;
+
+	printf("Frame scheduler benchmark: %u frames x %u\n", count, iterations);
+	for (uint32_t decoders = 1; decoders <= maxDecoders; ++decoders) {
+		std::vector<SoftMJPEGDecoder> softDecoders(decoders);
+		std::vector<IMJPEGDecoder*> ppDecoders;
+		for (uint32_t i = 0; i < decoders; ++i) {
+			ppDecoders.push_back(&softDecoders[i]);
+		}
+		uint64_t expected = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		{
+			FrameScheduler scheduler(ppDecoders.data(), decoders, 2 * decoders);
+			scheduler.SetCallback(OnBenchmarkFrame, &expected);
+			for (uint32_t i = 0; i < iterations; ++i) {
+				for (uint32_t f = 0; f < count; ++f) {
+					CompressedFrame input = { ppFrames[f], pLengths[f], (int64_t)(i * count + f), NULL, NULL };
+					scheduler.Submit(&input, true);
+				}
+			}
+			scheduler.Drain();
+
+			FrameSchedulerStats stats = scheduler.GetStats();
+			double ms = stats.delivered ? ElapsedMs(start) / stats.delivered : 0.0;
+			if (decoders == 1) {
+				baseMs = ms;
+			}
+			printf("  %2u decoders: %.2f ms/frame, speedup %.2fx, %llu failed, max queue %u, max reorder %u, reorder wait mean %.2f ms max %.2f ms\n",
+				decoders, ms, ms > 0.0 ? baseMs / ms : 0.0, (unsigned long long)stats.failed, stats.maxQueueDepth,
+				stats.maxReorderDepth, stats.meanReorderMs, stats.maxReorderMs);
+		}
+	}
+}
+
+static const char* FindGuidNameLinear(const GuidName* pNames, uint32_t count, const PortableGuid& guid)
+{
+	for (uint32_t i = 0; i < count; ++i) {
+		if (GuidEqual(pNames[i].guid, guid)) {
+			return pNames[i].name;
+		}
+	}
+	return NULL;
+}
+
+void RunGuidNameBenchmark(uint32_t iterations)
+{
+	const GuidNameRegistry& table = GetFormatGuidNames();
+	std::vector<GuidName> names;
+	for (uint32_t i = 0; i < GUID_NAME_TABLE_SIZE; ++i) {
+		if (table.Slot(i).name) {
+			names.push_back(table.Slot(i));
+		}
+	}
+	// Unknown GUIDs cost a full scan of the chain.
+	std::vector<PortableGuid> hits, misses;
+	for (size_t i = 0; i < names.size(); ++i) {
+		PortableGuid g = names[i].guid;
+		hits.push_back(g);
+		g.data4[7] ^= 0x5A;
+		misses.push_back(g);
+	}
+
+	printf("GUID name benchmark: %u names, max probe %u, %u iterations\n", table.Count(), table.MaxProbe(), iterations);
+	for (int pass = 0; pass < 2; ++pass) {
+		const std::vector<PortableGuid>& guids = pass ? misses : hits;
+		uint32_t found = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (uint32_t it = 0; it < iterations; ++it) {
+			for (size_t i = 0; i < guids.size(); ++i) {
+				found += table.Find(guids[i]) != NULL;
+			}
+		}
+		double hashNs = ElapsedMs(start) * 1e6 / ((double)iterations * guids.size());
+		start = std::chrono::steady_clock::now();
+		for (uint32_t it = 0; it < iterations; ++it) {
+			for (size_t i = 0; i < guids.size(); ++i) {
+				found += FindGuidNameLinear(names.data(), (uint32_t)names.size(), guids[i]) != NULL;
+			}
+		}
+		double linearNs = ElapsedMs(start) * 1e6 / ((double)iterations * guids.size());
+		printf("  %s: hash %.1f ns, linear %.1f ns per lookup (%u found)\n", pass ? "misses" : "hits", hashNs, linearNs, found);
+	}
+}
+
+// Stands in for per-frame work so the loops aren't optimized away.
+static volatile uint32_t s_loggerSink;
+
+void RunLoggerBenchmark(uint32_t iterations)
+{
+	FILE* f = tmpfile();
+	if (f == NULL) {
+		printf("Logger benchmark: no temporary file\n");
+		return;
+	}
+	LogFlush();
+	LogSetOutput(f);
+	int level = g_logLevel.load();
+	// Batches fit in the ring, so the producer side is timed without drops.
+	const uint32_t batch = LOG_RING_SIZE / 2;
+	iterations = (iterations + batch - 1) / batch * batch;
+	double ms[5] = { 0 };
+
+	for (uint32_t done = 0; done < iterations; done += batch) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < batch; ++i) {
+			s_loggerSink = i;
+		}
+		ms[0] += ElapsedMs(start);
+
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < batch; ++i) {
+			s_loggerSink = i;
+			LOG_DEBUG("GetEvent eventType=%d\n", i);
+		}
+		ms[1] += ElapsedMs(start);
+
+		LogSetLevel(LOG_LEVEL_WARN);
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < batch; ++i) {
+			s_loggerSink = i;
+			LogWrite(LOG_LEVEL_INFO, "GetEvent eventType=%d\n", i);
+		}
+		ms[2] += ElapsedMs(start);
+		LogSetLevel(LOG_LEVEL_INFO);
+
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < batch; ++i) {
+			s_loggerSink = i;
+			LOG_INFO("GetEvent eventType=%d\n", i);
+		}
+		ms[3] += ElapsedMs(start);
+		LogFlush();
+
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < batch; ++i) {
+			s_loggerSink = i;
+			fprintf(f, "GetEvent eventType=%d\n", i);
+		}
+		fflush(f);
+		ms[4] += ElapsedMs(start);
+	}
+	LogFlush();
+	LogSetOutput(NULL);
+	LogSetLevel(level);
+	fclose(f);
+
+	static const char* const names[5] = { "no logging", "LOG_DEBUG compiled out", "runtime filtered", "LOG_INFO to ring", "fprintf" };
+	printf("Logger benchmark: %u calls, %llu dropped\n", iterations, (unsigned long long)LogDropped());
+	for (int i = 0; i < 5; ++i) {
+		printf("  %-24s %7.2f ns/call\n", names[i], ms[i] * 1e6 / iterations);
+	}
+}
+
+void RunColorConvertBenchmark(uint32_t width, uint32_t height, uint32_t iterations)
+{
+	NV12Frame frame;
+	if (!AllocateNV12Frame(width, height, (uint32_t)AlignUp(width, FRAME_ALIGNMENT), height, &frame)) {
+		printf("Color conversion benchmark: out of memory\n");
+		return;
+	}
+	uint32_t state = 1;
+	for (size_t i = 0; i < NV12FrameSize(&frame); ++i) {
+		state = state * 1664525u + 1013904223u;
+		frame.pY[i] = (uint8_t)(state >> 24);
+	}
+	uint32_t dstPitch = (uint32_t)AlignUp((size_t)width * 4, FRAME_ALIGNMENT);
+	uint8_t* pDst = (uint8_t*)AlignedAlloc((size_t)dstPitch * height);
+	if (pDst == NULL) {
+		ReleaseFrame(&frame);
+		printf("Color conversion benchmark: out of memory\n");
+		return;
+	}
+	YuvCoefficients coef;
+	GetYuvCoefficients(YUV_MATRIX_BT601, YUV_RANGE_FULL, &coef);
+
+	printf("Color conversion benchmark: %u x %u, %u iterations\n", width, height, iterations);
+	for (int format = RGB_FORMAT_BGRA; format <= RGB_FORMAT_RGB24; ++format) {
+		NV12RowFunc funcs[3];
+		const char* names[3];
+		uint32_t numKernels = GetNV12RowKernels((RgbFormat)format, funcs, names, 3);
+		double baseMs = 0.0;
+		for (uint32_t k = 0; k < numKernels; ++k) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < iterations; ++i) {
+				for (uint32_t y = 0; y < height; ++y) {
+					funcs[k](frame.pY + (size_t)y * frame.pitchY, frame.pUV + (size_t)(y / 2) * frame.pitchUV,
+						pDst + (size_t)y * dstPitch, width, &coef);
+				}
+			}
+			double ms = ElapsedMs(start) / iterations;
+			if (k == 0) {
+				baseMs = ms;
+			}
+			printf("  %-5s %-6s %6.3f ms/frame, %7.1f Mpixel/s, speedup %.2fx\n", format == RGB_FORMAT_BGRA ? "BGRA" : "RGB24",
+				names[k], ms, (double)width * height / ms / 1000.0, ms > 0.0 ? baseMs / ms : 0.0);
+		}
+	}
+	AlignedFree(pDst);
+	ReleaseFrame(&frame);
+}
@@ -0,0 +1,36 @@
+#ifndef __DECODEBENCHMARK_H__
+#define __DECODEBENCHMARK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decodes a set of compressed frames (e.g. captured from the camera)
+// 'iterations' times with the software decoder and prints the Huffman only
+// throughput and the full decode time per frame.
+void RunHuffmanBenchmark(const uint8_t* const* ppFrames, const size_t* pLengths, uint32_t count, uint32_t iterations);
+
+// Decodes the frames with 1 to maxThreads threads and prints the time per
+// frame and the speedup. Only frames with restart markers decode in parallel.
+void RunRestartScalingBenchmark(const uint8_t* const* ppFrames, const size_t* pLengths, uint32_t count,
+	uint32_t iterations, uint32_t maxThreads);
+
+// Decodes the frames through a FrameScheduler with 1 to maxDecoders software
+// decoders and prints the throughput, queue depth and reorder latency.
+void RunFrameSchedulerBenchmark(const uint8_t* const* ppFrames, const size_t* pLengths, uint32_t count,
+	uint32_t iterations, uint32_t maxDecoders);
+
+// Looks every name in GetFormatGuidNames() up 'iterations' times through the
+// hash table and with a linear scan like the old if chain, hits and misses.
+void RunGuidNameBenchmark(uint32_t iterations);
+
+// Times a decode style loop with no logging, with LOG_DEBUG (compiled out at
+// the default LOG_MIN_LEVEL), with a runtime filtered LogWrite, with LOG_INFO
+// into the per-thread ring and with fprintf, all writing to a temporary file.
+void RunLoggerBenchmark(uint32_t iterations);
+
+// Converts a width x height NV12 frame of random samples to BGRA and RGB24
+// 'iterations' times with each available kernel and prints ms per frame and
+// Mpixel/s.
+void RunColorConvertBenchmark(uint32_t width, uint32_t height, uint32_t iterations);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef __DECODEOPTIONS_H__
+#define __DECODEOPTIONS_H__
+
+#include <stdint.h>
+
+// Output size of a scaled decode, log2 of the divisor.
+enum DecodeScale
+{
+	DECODE_SCALE_FULL = 0,
+	DECODE_SCALE_1_2 = 1,	// 4x4 IDCT
+	DECODE_SCALE_1_4 = 2,	// 2x2 IDCT
+	DECODE_SCALE_1_8 = 3,	// DC only, e.g. preview tiles
+};
+
+struct DecodeRect
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;	// 0 for the whole frame
+	uint32_t height;
+};
+
+// What DecodeOneFrame produces, see IMJPEGDecoder::SetDecodeOptions. The
+// default (zero) options give the full NV12 frame.
+struct DecodeOptions
+{
+	DecodeScale scale;	// width and height divided by 1 << scale, rounded up
+	// Region of interest in pixels of the full frame. Only the MCUs under it
+	// are transformed and written, as a packed NV12 frame (pitch = width
+	// rounded up to even).
+	DecodeRect crop;
+	// Y plane only (pUV NULL), e.g. for motion detection or barcodes. Chroma
+	// blocks are entropy decoded to get past them but not transformed. Crops
+	// are packed with pitch = width.
+	bool lumaOnly;
+};
+
+// Per frame counts of a crop decode, see IMJPEGDecoder::GetLastFrameStats.
+struct DecodeFrameStats
+{
+	uint32_t mcus;	// in the frame
+	uint32_t skippedMcus;	// outside the crop, no IDCT or output
+	uint32_t unreadMcus;	// of those, not even entropy decoded: past the crop or in restart intervals jumped over
+};
+
+inline void GetDefaultDecodeOptions(DecodeOptions* pOptions)
+{
+	pOptions->scale = DECODE_SCALE_FULL;
+	pOptions->crop.x = 0;
+	pOptions->crop.y = 0;
+	pOptions->crop.width = 0;
+	pOptions->crop.height = 0;
+	pOptions->lumaOnly = false;
+}
+
+inline bool HasDecodeCrop(const DecodeOptions& options)
+{
+	return options.crop.width != 0 && options.crop.height != 0;
+}
+
+inline bool IsDefaultDecodeOptions(const DecodeOptions& options)
+{
+	return options.scale == DECODE_SCALE_FULL && !HasDecodeCrop(options) && !options.lumaOnly;
+}
+
+// The part of the scaled width x height frame that a decode with 'options'
+// returns: the crop scaled, widened to even positions for the 4:2:0 chroma
+// and clipped to the frame. Empty (width 0) when the crop misses the frame.
+inline void GetDecodedRect(const DecodeOptions& options, uint32_t width, uint32_t height, DecodeRect* pRect)
+{
+	uint32_t round = (1u << options.scale) - 1;
+	uint32_t scaledWidth = (width + round) >> options.scale;
+	uint32_t scaledHeight = (height + round) >> options.scale;
+	if (!HasDecodeCrop(options)) {
+		pRect->x = 0;
+		pRect->y = 0;
+		pRect->width = scaledWidth;
+		pRect->height = scaledHeight;
+		return;
+	}
+	uint32_t x0 = (options.crop.x >> options.scale) & ~1u;
+	uint32_t y0 = (options.crop.y >> options.scale) & ~1u;
+	uint64_t x1 = ((((uint64_t)options.crop.x + options.crop.width + round) >> options.scale) + 1) & ~1ull;
+	uint64_t y1 = ((((uint64_t)options.crop.y + options.crop.height + round) >> options.scale) + 1) & ~1ull;
+	x1 = x1 < scaledWidth ? x1 : scaledWidth;
+	y1 = y1 < scaledHeight ? y1 : scaledHeight;
+	pRect->x = x0;
+	pRect->y = y0;
+	pRect->width = x1 > x0 ? (uint32_t)(x1 - x0) : 0;
+	pRect->height = y1 > y0 ? (uint32_t)(y1 - y0) : 0;
+}
+
+// Size of the frames decoded from width x height frames with 'options'.
+inline void GetDecodedSize(const DecodeOptions& options, uint32_t width, uint32_t height,
+	uint32_t* pWidth, uint32_t* pHeight)
+{
+	DecodeRect rect;
+	GetDecodedRect(options, width, height, &rect);
+	*pWidth = rect.width;
+	*pHeight = rect.height;
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "DecodePipeline.h"
+#include "FrameTrace.h"
+
+#include <chrono>
+#include <stdio.h>
+
+DecodePipeline::DecodePipeline(ITransformBackend* pBackend, uint32_t maxInFlight)
+{
+	m_pBackend = pBackend;
+	m_maxInFlight = maxInFlight ? maxInFlight : 1;
+	m_callback = NULL;
+	m_pCallbackContext = NULL;
+	m_needInput = 0;
+	m_inFlight = 0;
+	m_nextSequence = 0;
+	m_failed = 0;
+}
+
+DecodePipeline::~DecodePipeline()
+{
+	Flush();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (!m_results.empty()) {
+		ReleaseFrame(&m_results.front().frame);
+		m_results.pop_front();
+	}
+}
+
+void DecodePipeline::SetCallback(DecodedFrameCallback callback, void* pContext)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_callback = callback;
+	m_pCallbackContext = pContext;
+}
+
+bool DecodePipeline::Submit(void* pInput, int64_t timestamp, bool block)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_inFlight >= m_maxInFlight) {
+		if (!block) {
+			return false;
+		}
+		m_spaceAvailable.wait(lock, [this] { return m_inFlight < m_maxInFlight; });
+	}
+	Job job = { pInput, timestamp, m_nextSequence++ };
+	m_queued.push_back(job);
+	m_inFlight++;
+	FeedLocked();
+	return true;
+}
+
+// Hands queued frames to the transform for every outstanding "need input".
+// Runs under the lock so inputs reach the transform in submit order.
+void DecodePipeline::FeedLocked()
+{
+	while (m_needInput > 0 && !m_queued.empty()) {
+		Job job = m_queued.front();
+		m_queued.pop_front();
+		m_needInput--;
+		m_inTransform.push_back(job);
+		TRACE_BEGIN(TRACE_PROCESS_INPUT, job.timestamp);
+		bool ok = m_pBackend->ProcessInput(job.pInput);
+		TRACE_END(TRACE_PROCESS_INPUT, job.timestamp);
+		if (!ok) {
+			printf("DecodePipeline ProcessInput failed seq=%llu\n", (unsigned long long)job.sequence);
+			m_inTransform.pop_back();
+			m_failed++;
+			m_inFlight--;
+			m_spaceAvailable.notify_all();
+		}
+	}
+}
+
+void DecodePipeline::OnNeedInput()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_needInput++;
+	FeedLocked();
+}
+
+void DecodePipeline::OnHaveOutput()
+{
+	Result result;
+	DecodedFrameCallback callback;
+	void* pContext;
+
+	TRACE_BEGIN(TRACE_PROCESS_OUTPUT, -1);
+	bool ok = m_pBackend->ProcessOutput(&result.frame);
+	TRACE_END(TRACE_PROCESS_OUTPUT, -1);
+	if (!ok) {
+		// The transform had a frame for the oldest input but it could not be
+		// collected. Count it as failed so Drain() and Submit() don't wait for it.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_inTransform.empty()) {
+			printf("DecodePipeline ProcessOutput failed seq=%llu\n", (unsigned long long)m_inTransform.front().sequence);
+			m_inTransform.pop_front();
+			m_failed++;
+			m_inFlight--;
+			m_spaceAvailable.notify_all();
+		}
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_inTransform.empty()) {
+			printf("DecodePipeline output without input\n");
+			ReleaseFrame(&result.frame);
+			return;
+		}
+		// MJPEG frames are independent, so output order equals input order.
+		Job job = m_inTransform.front();
+		m_inTransform.pop_front();
+		result.sequence = job.sequence;
+		result.frame.timestamp = job.timestamp;
+		TRACE_INSTANT(TRACE_DELIVER, job.timestamp);
+		callback = m_callback;
+		pContext = m_pCallbackContext;
+		if (callback == NULL) {
+			m_results.push_back(result);
+			m_resultAvailable.notify_one();
+			m_spaceAvailable.notify_all();
+			return;
+		}
+	}
+	callback(pContext, result.sequence, &result.frame);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_inFlight--;
+	m_spaceAvailable.notify_all();
+}
+
+bool DecodePipeline::Poll(NV12Frame* pFrame, uint64_t* pSequence, uint32_t timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_resultAvailable.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !m_results.empty(); })) {
+		return false;
+	}
+	*pFrame = m_results.front().frame;
+	if (pSequence) {
+		*pSequence = m_results.front().sequence;
+	}
+	m_results.pop_front();
+	m_inFlight--;
+	m_spaceAvailable.notify_all();
+	return true;
+}
+
+void DecodePipeline::Drain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_spaceAvailable.wait(lock, [this] { return m_inFlight == (uint32_t)m_results.size(); });
+}
+
+void DecodePipeline::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (!m_queued.empty()) {
+		m_pBackend->ReleaseInput(m_queued.front().pInput);
+		m_queued.pop_front();
+		m_inFlight--;
+	}
+	m_spaceAvailable.notify_all();
+}
+
+uint32_t DecodePipeline::InFlight()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_inFlight;
+}
+
+uint64_t DecodePipeline::Failed()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_failed;
+}
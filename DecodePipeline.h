@@ -0,0 +1,96 @@
+#ifndef __DECODEPIPELINE_H__
+#define __DECODEPIPELINE_H__
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "NV12Frame.h"
+
+// The part of an asynchronous transform the pipeline drives. The MFT binding
+// lives in MJPEGDecoder; anything that raises "need input" / "have output"
+// events (e.g. a mock with configurable latency) can drive it as well.
+class ITransformBackend
+{
+public:
+	virtual ~ITransformBackend() {}
+	// Hands one compressed frame to the transform. Takes ownership of pInput.
+	virtual bool ProcessInput(void* pInput) = 0;
+	// Collects the next decoded frame after a "have output" event.
+	virtual bool ProcessOutput(NV12Frame* pFrame) = 0;
+	// Drops an input that was never handed to the transform.
+	virtual void ReleaseInput(void* pInput) = 0;
+};
+
+// Called on the transform's event thread for every decoded frame, in submit
+// order. The callee owns pFrame and must ReleaseFrame() it.
+typedef void (*DecodedFrameCallback)(void* pContext, uint64_t sequence, NV12Frame* pFrame);
+
+// Keeps up to maxInFlight frames inside the transform so capture, decode and
+// consumption overlap. Submit() queues input, the transform's events feed it
+// and collect output, and results come back through Poll() or a callback.
+class DecodePipeline
+{
+public:
+	DecodePipeline(ITransformBackend* pBackend, uint32_t maxInFlight);
+	~DecodePipeline();
+
+	void SetCallback(DecodedFrameCallback callback, void* pContext);
+
+	// Queues a frame. Blocks while maxInFlight frames are pending unless
+	// block is false, in which case it returns false and keeps no reference.
+	bool Submit(void* pInput, int64_t timestamp, bool block);
+
+	// Waits up to timeoutMs for the next decoded frame (without a callback).
+	bool Poll(NV12Frame* pFrame, uint64_t* pSequence, uint32_t timeoutMs);
+
+	// Waits until every submitted frame has been delivered or has failed.
+	void Drain();
+
+	// Drops queued input that hasn't reached the transform yet.
+	void Flush();
+
+	// Event entry points, called from the transform's event thread.
+	void OnNeedInput();
+	void OnHaveOutput();
+
+	uint32_t InFlight();
+	// Frames that ProcessInput or ProcessOutput dropped; they are never delivered.
+	uint64_t Failed();
+	uint32_t MaxInFlight() const { return m_maxInFlight; }
+
+private:
+	struct Job
+	{
+		void* pInput;
+		int64_t timestamp;
+		uint64_t sequence;
+	};
+	struct Result
+	{
+		NV12Frame frame;
+		uint64_t sequence;
+	};
+
+	void FeedLocked();
+
+	ITransformBackend* m_pBackend;
+	uint32_t m_maxInFlight;
+	DecodedFrameCallback m_callback;
+	void* m_pCallbackContext;
+
+	std::mutex m_mutex;
+	std::condition_variable m_spaceAvailable;
+	std::condition_variable m_resultAvailable;
+	std::deque<Job> m_queued;	// submitted, waiting for a "need input" event
+	std::deque<Job> m_inTransform;	// handed to the transform, oldest first
+	std::deque<Result> m_results;
+	uint32_t m_needInput;	// "need input" events not yet answered
+	uint32_t m_inFlight;
+	uint64_t m_nextSequence;
+	uint64_t m_failed;
+};
+
+#endif
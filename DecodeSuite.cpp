@@ -0,0 +1,341 @@
+#include "DecodeSuite.h"
+#include "AlignedMemory.h"
+#include "ColorConvert.h"
+#include "CpuFeatures.h"
+#include "FrameDump.h"
+#include "JpegParser.h"
+#include "NV12Repack.h"
+#include "ReplaySource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+static const struct
+{
+	uint32_t step;
+	const char* name;
+} s_steps[] = {
+	{ DECODE_STEP_DECODE, "decode" },
+	{ DECODE_STEP_REPACK, "repack" },
+	{ DECODE_STEP_COLOR, "color" },
+	{ DECODE_STEP_DUMP, "dump" },
+	{ DECODE_STEP_FUSED, "fused" },
+};
+
+static uint64_t EstimateTraffic(uint32_t step, uint32_t width, uint32_t height, bool lumaOnly)
+{
+	uint64_t nv12 = (uint64_t)width * height * (lumaOnly ? 2 : 3) / 2;
+	uint64_t bgra = (uint64_t)width * height * 4;
+	switch (step) {
+	case DECODE_STEP_REPACK:
+		return 3 * nv12;	// decoded, read, written packed
+	case DECODE_STEP_COLOR:
+		return 2 * nv12 + bgra;
+	case DECODE_STEP_DUMP:
+		return 2 * nv12;
+	case DECODE_STEP_FUSED:
+		return bgra;	// the NV12 band stays in cache
+	default:
+		return nv12;
+	}
+}
+
+// CPU time of the whole process in ms, so decoder worker threads count too.
+static double ProcessCpuMs()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+		return 0.0;
+	}
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) / 10000.0;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#endif
+}
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+// Grows an aligned scratch buffer; the steps reuse it across frames.
+static uint8_t* EnsureBuffer(uint8_t** ppBuffer, size_t* pCapacity, size_t size)
+{
+	if (size > *pCapacity) {
+		AlignedFree(*ppBuffer);
+		*ppBuffer = (uint8_t*)AlignedAlloc(size);
+		*pCapacity = *ppBuffer ? size : 0;
+	}
+	return *ppBuffer;
+}
+
+struct StepBuffers
+{
+	YuvMatrix matrix;	// of the backend being measured
+	YuvRange range;
+	uint8_t* pPacked;
+	size_t packedCapacity;
+	uint8_t* pBgra;
+	size_t bgraCapacity;
+	std::string yName;
+	std::string uvName;
+};
+
+static bool RunStep(uint32_t step, const NV12Frame* pFrame, StepBuffers* pBuffers)
+{
+	switch (step) {
+	case DECODE_STEP_REPACK: {
+		uint8_t* pDst = EnsureBuffer(&pBuffers->pPacked, &pBuffers->packedCapacity,
+			NV12PackedSize(pFrame->width, pFrame->height));
+		if (pDst == NULL) {
+			return false;
+		}
+		NV12Repack(pFrame->pY, pFrame->pitchY, pFrame->pUV, pFrame->pitchUV, pFrame->width, pFrame->height, pDst);
+		return true;
+	}
+	case DECODE_STEP_COLOR: {
+		uint8_t* pDst = EnsureBuffer(&pBuffers->pBgra, &pBuffers->bgraCapacity, (size_t)pFrame->width * 4 * pFrame->height);
+		if (pDst == NULL) {
+			return false;
+		}
+		ConvertNV12ToRgb(pFrame, pBuffers->matrix, pBuffers->range, RGB_FORMAT_BGRA, pDst, (ptrdiff_t)pFrame->width * 4);
+		return true;
+	}
+	case DECODE_STEP_DUMP:
+		return SaveNV12Planes(pFrame, IMAGE_FORMAT_PGM, pBuffers->yName.c_str(), pBuffers->uvName.c_str());
+	default:
+		return true;
+	}
+}
+
+static bool DecodeAndRunStep(IMJPEGDecoder* pDecoder, const CompressedFrame* pInput, uint32_t step,
+	StepBuffers* pBuffers)
+{
+	if (step == DECODE_STEP_FUSED) {
+		RgbFrame rgb;
+		if (pDecoder->DecodeOneFrameRgb(pInput->pData, pInput->len, RGB_FORMAT_BGRA, &rgb) != S_OK) {
+			return false;
+		}
+		ReleaseFrame(&rgb);
+		return true;
+	}
+	NV12Frame frame;
+	if (pDecoder->DecodeOneFrame(pInput->pData, pInput->len, &frame) != S_OK) {
+		return false;
+	}
+	bool ok = RunStep(step, &frame, pBuffers);
+	ReleaseFrame(&frame);
+	return ok;
+}
+
+static void RunOne(const ReplaySource& source, const DecodeSuiteBackend& backend, uint32_t step, const char* stepName,
+	const DecodeSuiteOptions& options, StepBuffers* pBuffers, DecodeSuiteResult* pResult)
+{
+	uint32_t count = source.FrameCount();
+	if (options.maxFrames && count > options.maxFrames) {
+		count = options.maxFrames;
+	}
+	std::vector<double> latencies;
+	latencies.reserve((size_t)count * options.iterations);
+	CompressedFrame input;
+
+	pResult->step = stepName;
+	DecodeOptions decodeOptions;
+	backend.pDecoder->GetDecodeOptions(&decodeOptions);
+	pResult->trafficBytes = EstimateTraffic(step, pResult->width, pResult->height, decodeOptions.lumaOnly);
+	pResult->frames = 0;
+	pResult->failed = 0;
+	uint64_t skippedMcus = 0;
+	uint64_t unreadMcus = 0;
+
+	// One untimed frame warms the header cache, pools and file pages.
+	source.GetFrame(0, &input);
+	DecodeAndRunStep(backend.pDecoder, &input, step, pBuffers);
+
+	AllocationStats& allocs = GetAllocationStats();
+	uint64_t allocBytes = allocs.bytes.load();
+	uint64_t allocCount = allocs.count.load();
+	double cpuStart = ProcessCpuMs();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < options.iterations; ++i) {
+		for (uint32_t f = 0; f < count; ++f) {
+			source.GetFrame(f, &input);
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+			if (!DecodeAndRunStep(backend.pDecoder, &input, step, pBuffers)) {
+				pResult->failed++;
+				continue;
+			}
+			latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+			pResult->frames++;
+			DecodeFrameStats stats;
+			backend.pDecoder->GetLastFrameStats(&stats);
+			skippedMcus += stats.skippedMcus;
+			unreadMcus += stats.unreadMcus;
+		}
+	}
+	pResult->wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	pResult->cpuMs = ProcessCpuMs() - cpuStart;
+	pResult->allocBytes = allocs.bytes.load() - allocBytes;
+	pResult->allocCount = allocs.count.load() - allocCount;
+
+	std::sort(latencies.begin(), latencies.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < latencies.size(); ++i) {
+		sum += latencies[i];
+	}
+	pResult->fps = pResult->wallMs > 0.0 ? pResult->frames * 1000.0 / pResult->wallMs : 0.0;
+	pResult->meanMs = latencies.empty() ? 0.0 : sum / latencies.size();
+	pResult->p50Ms = Percentile(latencies, 50.0);
+	pResult->p90Ms = Percentile(latencies, 90.0);
+	pResult->p99Ms = Percentile(latencies, 99.0);
+	pResult->maxMs = latencies.empty() ? 0.0 : latencies.back();
+	pResult->skippedMcus = pResult->frames ? (double)skippedMcus / pResult->frames : 0.0;
+	pResult->unreadMcus = pResult->frames ? (double)unreadMcus / pResult->frames : 0.0;
+}
+
+std::vector<DecodeSuiteResult> RunDecodeSuite(const char* const* ppFiles, uint32_t fileCount,
+	const DecodeSuiteBackend* pBackends, uint32_t backendCount, const DecodeSuiteOptions& options)
+{
+	std::vector<DecodeSuiteResult> results;
+	StepBuffers buffers = {};
+	if (options.dumpPrefix) {
+		buffers.yName = std::string(options.dumpPrefix) + "_y.pgm";
+		buffers.uvName = std::string(options.dumpPrefix) + "_uv.pgm";
+	}
+
+	printf("Decode suite: %u files, %u backends, %u iterations\n", fileCount, backendCount, options.iterations);
+	for (uint32_t file = 0; file < fileCount; ++file) {
+		ReplaySource source;
+		JpegHeader header;
+		CompressedFrame first;
+		if (source.Open(ppFiles[file]) != S_OK || source.FrameCount() == 0) {
+			printf("  %s: no frames\n", ppFiles[file]);
+			continue;
+		}
+		source.GetFrame(0, &first);
+		if (ParseJpegHeader(first.pData, first.len, &header) != S_OK) {
+			printf("  %s: first frame doesn't parse\n", ppFiles[file]);
+			continue;
+		}
+		uint32_t fps = source.FileFps() > 0.0 ? (uint32_t)(source.FileFps() + 0.5) : (uint32_t)REPLAY_DEFAULT_FPS;
+
+		for (uint32_t b = 0; b < backendCount; ++b) {
+			IMJPEGDecoder* pDecoder = pBackends[b].pDecoder;
+			if (pDecoder->Configure(header.width, header.height, fps) != S_OK || pDecoder->Start() != S_OK) {
+				printf("  %s: %s doesn't start at %u x %u\n", ppFiles[file], pBackends[b].name, header.width, header.height);
+				continue;
+			}
+			pDecoder->GetColorSpace(&buffers.matrix, &buffers.range);
+			DecodeOptions decodeOptions;
+			uint32_t width, height;
+			pDecoder->GetDecodeOptions(&decodeOptions);
+			GetDecodedSize(decodeOptions, header.width, header.height, &width, &height);
+			size_t twoPass = (size_t)-1;	// index of the color step result
+			for (size_t s = 0; s < sizeof(s_steps) / sizeof(s_steps[0]); ++s) {
+				if (!(options.steps & s_steps[s].step) || (s_steps[s].step == DECODE_STEP_DUMP && !options.dumpPrefix)) {
+					continue;
+				}
+				// NV12Repack needs a UV plane.
+				if (s_steps[s].step == DECODE_STEP_REPACK && decodeOptions.lumaOnly) {
+					continue;
+				}
+				DecodeSuiteResult result;
+				result.file = ppFiles[file];
+				result.backend = pBackends[b].name;
+				result.width = width;
+				result.height = height;
+				RunOne(source, pBackends[b], s_steps[s].step, s_steps[s].name, options, &buffers, &result);
+				printf("  %4u x %-4u %-12s %-6s %8.1f fps, p50 %.2f p90 %.2f p99 %.2f max %.2f ms, cpu %.2f ms/frame, %.1f KB / %.1f allocs, %.1f MB traffic per frame, %llu failed\n",
+					result.width, result.height, result.backend.c_str(), result.step, result.fps, result.p50Ms,
+					result.p90Ms, result.p99Ms, result.maxMs, result.frames ? result.cpuMs / result.frames : 0.0,
+					result.frames ? result.allocBytes / 1024.0 / result.frames : 0.0,
+					result.frames ? (double)result.allocCount / result.frames : 0.0, result.trafficBytes / 1e6,
+					(unsigned long long)result.failed);
+				if (result.skippedMcus > 0.0) {
+					printf("  %4u x %-4u %-12s %-6s %.0f MCUs skipped per frame, %.0f of them not entropy decoded\n",
+						result.width, result.height, result.backend.c_str(), result.step, result.skippedMcus, result.unreadMcus);
+				}
+				if (s_steps[s].step == DECODE_STEP_COLOR) {
+					twoPass = results.size();
+				}
+				if (s_steps[s].step == DECODE_STEP_FUSED && twoPass != (size_t)-1 && results[twoPass].frames && result.frames) {
+					const DecodeSuiteResult& color = results[twoPass];
+					double saved = color.meanMs - result.meanMs;
+					printf("  %4u x %-4u %-12s fused vs two-pass: %.2f ms/frame saved (%.0f%%), %.1f MB/frame less traffic\n",
+						result.width, result.height, result.backend.c_str(), saved, 100.0 * saved / color.meanMs,
+						(color.trafficBytes - result.trafficBytes) / 1e6);
+				}
+				results.push_back(result);
+			}
+		}
+	}
+	AlignedFree(buffers.pPacked);
+	AlignedFree(buffers.pBgra);
+	return results;
+}
+
+static void WriteJsonString(FILE* f, const char* s)
+{
+	fputc('"', f);
+	for (; *s; ++s) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\') {
+			fprintf(f, "\\%c", c);
+		}
+		else if (c < 0x20) {
+			fprintf(f, "\\u%04x", c);
+		}
+		else {
+			fputc(c, f);
+		}
+	}
+	fputc('"', f);
+}
+
+bool WriteDecodeSuiteJson(const char* fileName, const DecodeSuiteOptions& options,
+	const std::vector<DecodeSuiteResult>& results)
+{
+	FILE* f = fopen(fileName, "w");
+	if (f == NULL) {
+		printf("Failed to create %s\n", fileName);
+		return false;
+	}
+	fprintf(f, "{\n  \"iterations\": %u,\n  \"maxFrames\": %u,\n  \"cpuFeatures\": %u,\n  \"results\": [",
+		options.iterations, options.maxFrames, GetCpuFeatures());
+	for (size_t i = 0; i < results.size(); ++i) {
+		const DecodeSuiteResult& r = results[i];
+		fprintf(f, "%s\n    {\"file\": ", i ? "," : "");
+		WriteJsonString(f, r.file.c_str());
+		fprintf(f, ", \"backend\": ");
+		WriteJsonString(f, r.backend.c_str());
+		fprintf(f, ", \"step\": \"%s\", \"width\": %u, \"height\": %u, \"frames\": %llu, \"failed\": %llu, "
+			"\"fps\": %.2f, \"wallMs\": %.3f, \"cpuMs\": %.3f, \"meanMs\": %.4f, \"p50Ms\": %.4f, \"p90Ms\": %.4f, "
+			"\"p99Ms\": %.4f, \"maxMs\": %.4f, \"allocBytes\": %llu, \"allocCount\": %llu, \"trafficBytes\": %llu, "
+			"\"skippedMcus\": %.1f, \"unreadMcus\": %.1f}",
+			r.step, r.width, r.height, (unsigned long long)r.frames, (unsigned long long)r.failed, r.fps, r.wallMs,
+			r.cpuMs, r.meanMs, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, (unsigned long long)r.allocBytes,
+			(unsigned long long)r.allocCount, (unsigned long long)r.trafficBytes, r.skippedMcus, r.unreadMcus);
+	}
+	fprintf(f, "\n  ]\n}\n");
+	bool ok = ferror(f) == 0;
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+	return ok;
+}
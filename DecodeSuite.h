@@ -0,0 +1,74 @@
+#ifndef __DECODESUITE_H__
+#define __DECODESUITE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "IMJPEGDecoder.h"
+
+// Work done on each decoded frame, timed together with the decode.
+enum DecodeSuiteStep
+{
+	DECODE_STEP_DECODE = 0x01,	// decode only, the baseline
+	DECODE_STEP_REPACK = 0x02,	// + NV12Repack to packed NV12, not for luma only backends
+	DECODE_STEP_COLOR = 0x04,	// + ConvertNV12ToRgb to BGRA
+	DECODE_STEP_DUMP = 0x08,	// + saving the planes as PGM files
+	DECODE_STEP_FUSED = 0x10,	// DecodeOneFrameRgb to BGRA, compared with DECODE_STEP_COLOR
+	DECODE_STEP_ALL = 0x1F,
+};
+
+struct DecodeSuiteBackend
+{
+	const char* name;
+	IMJPEGDecoder* pDecoder;
+};
+
+struct DecodeSuiteOptions
+{
+	uint32_t iterations;	// passes over each corpus file
+	uint32_t maxFrames;	// frames used from each file, 0 for all
+	uint32_t steps;	// DECODE_STEP_* bits
+	const char* dumpPrefix;	// file name prefix for DECODE_STEP_DUMP, NULL skips the step
+};
+
+// One corpus file through one backend and one step.
+struct DecodeSuiteResult
+{
+	std::string file;
+	std::string backend;
+	const char* step;
+	uint32_t width;	// of the decoded frames, see IMJPEGDecoder::GetDecodeOptions
+	uint32_t height;
+	uint64_t frames;	// decoded and processed
+	uint64_t failed;
+	double wallMs;
+	double cpuMs;	// process CPU time, worker threads included
+	double fps;
+	double meanMs;	// per frame latency, decode + step
+	double p50Ms;
+	double p90Ms;
+	double p99Ms;
+	double maxMs;
+	uint64_t allocBytes;	// see AllocationStats in AlignedMemory.h
+	uint64_t allocCount;
+	// Frame sized buffers written and read back per frame, i.e. the memory
+	// traffic beyond the caches at 720p and up. Estimated from the step.
+	uint64_t trafficBytes;
+	double skippedMcus;	// per frame, outside the backend's crop (IMJPEGDecoder::GetLastFrameStats)
+	double unreadMcus;	// of those, not entropy decoded either
+};
+
+// Replays every corpus file (any ReplaySource container) as fast as possible
+// through each backend and each requested step. Each backend is configured
+// and started for the size of each file. Prints a line per result.
+std::vector<DecodeSuiteResult> RunDecodeSuite(const char* const* ppFiles, uint32_t fileCount,
+	const DecodeSuiteBackend* pBackends, uint32_t backendCount, const DecodeSuiteOptions& options);
+
+// Writes the results as JSON for regression tracking.
+bool WriteDecodeSuiteJson(const char* fileName, const DecodeSuiteOptions& options,
+	const std::vector<DecodeSuiteResult>& results);
+
+#endif
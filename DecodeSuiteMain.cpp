@@ -0,0 +1,163 @@
+// Command line decode benchmark. Runs the software decoder without Media
+// Foundation, so it builds on Linux too; not part of the Visual Studio project
+// (see "Decode suite:" in README.md).
+//
+//   decode_suite [-i iterations] [-n frames] [-t threads] [-s] [-c x,y,w,h] [-y] [-d dump_prefix] [-o results.json] corpus...
+//   decode_suite -k
+#include "AlignedMemory.h"
+#include "ColorConvert.h"
+#include "DecodeBenchmark.h"
+#include "DecodeSuite.h"
+#include "SoftMJPEGDecoder.h"
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// Counts operator new as well, so the suite reports every heap allocation.
+void* operator new(size_t size)
+{
+	void* p = malloc(size ? size : 1);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	CountAllocation(size);
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+static void PrintUsage()
+{
+	printf("usage: decode_suite [-i iterations] [-n frames] [-t threads] [-s] [-c x,y,w,h] [-y] [-d dump_prefix] [-o results.json] corpus...\n");
+	printf("       decode_suite -k\n");
+	printf("  corpus files are JPEG streams, MJPEG AVIs or indexed files (ReplaySource.h)\n");
+	printf("  -s also runs the software decoder at 1/2, 1/4 and 1/8 scale\n");
+	printf("  -c also runs the software decoder on that crop rectangle only\n");
+	printf("  -y also runs the software decoder with luma only output\n");
+	printf("  -k checks the color conversion kernels against a double precision reference and times them\n");
+}
+
+int main(int argc, char** argv)
+{
+	DecodeSuiteOptions options = { 5, 0, DECODE_STEP_ALL, NULL };
+	const char* jsonFileName = NULL;
+	uint32_t threads = std::thread::hardware_concurrency();
+	bool scaled = false;
+	DecodeRect crop = { 0, 0, 0, 0 };
+	bool lumaOnly = false;
+	std::vector<const char*> files;
+
+	for (int i = 1; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-i") == 0 && hasValue) {
+			options.iterations = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-n") == 0 && hasValue) {
+			options.maxFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-t") == 0 && hasValue) {
+			threads = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-s") == 0) {
+			scaled = true;
+		}
+		else if (strcmp(argv[i], "-c") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%u,%u,%u,%u", &crop.x, &crop.y, &crop.width, &crop.height) != 4 ||
+				crop.width == 0 || crop.height == 0) {
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-y") == 0) {
+			lumaOnly = true;
+		}
+		else if (strcmp(argv[i], "-d") == 0 && hasValue) {
+			options.dumpPrefix = argv[++i];
+		}
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) {
+			jsonFileName = argv[++i];
+		}
+		else if (strcmp(argv[i], "-k") == 0) {
+			int maxError;
+			uint32_t mismatches = VerifyColorKernels(10000, 1, &maxError);
+			printf("Color conversion: %u mismatches, max error %d\n", mismatches, maxError);
+			RunColorConvertBenchmark(1920, 1080, 100);
+			RunColorConvertBenchmark(3840, 2160, 20);
+			return mismatches ? 1 : 0;
+		}
+		else if (argv[i][0] == '-') {
+			PrintUsage();
+			return 1;
+		}
+		else {
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.empty() || options.iterations == 0) {
+		PrintUsage();
+		return 1;
+	}
+
+	// Single threaded, and with restart intervals split across threads.
+	SoftMJPEGDecoder soft;
+	SoftMJPEGDecoder softThreaded;
+	char threadedName[32];
+	std::vector<DecodeSuiteBackend> backends;
+	backends.push_back({ "software", &soft });
+	if (threads > 1) {
+		softThreaded.SetThreadCount(threads);
+		snprintf(threadedName, sizeof(threadedName), "software x%u", threads);
+		backends.push_back({ threadedName, &softThreaded });
+	}
+	// Scaled decodes for previews, single threaded.
+	static const char* s_scaleNames[3] = { "software 1/2", "software 1/4", "software 1/8" };
+	SoftMJPEGDecoder softScaled[3];
+	if (scaled) {
+		for (uint32_t s = 0; s < 3; ++s) {
+			DecodeOptions decodeOptions;
+			GetDefaultDecodeOptions(&decodeOptions);
+			decodeOptions.scale = (DecodeScale)(DECODE_SCALE_1_2 + s);
+			softScaled[s].SetDecodeOptions(decodeOptions);
+			backends.push_back({ s_scaleNames[s], &softScaled[s] });
+		}
+	}
+	// Region of interest, single threaded like the scaled backends.
+	SoftMJPEGDecoder softCrop;
+	if (crop.width) {
+		DecodeOptions decodeOptions;
+		GetDefaultDecodeOptions(&decodeOptions);
+		decodeOptions.crop = crop;
+		softCrop.SetDecodeOptions(decodeOptions);
+		backends.push_back({ "software crop", &softCrop });
+	}
+	// Y plane only, for consumers that don't need color.
+	SoftMJPEGDecoder softLuma;
+	if (lumaOnly) {
+		DecodeOptions decodeOptions;
+		GetDefaultDecodeOptions(&decodeOptions);
+		decodeOptions.lumaOnly = true;
+		softLuma.SetDecodeOptions(decodeOptions);
+		backends.push_back({ "software luma", &softLuma });
+	}
+
+	std::vector<DecodeSuiteResult> results = RunDecodeSuite(files.data(), (uint32_t)files.size(), backends.data(),
+		(uint32_t)backends.size(), options);
+	if (jsonFileName) {
+		if (!WriteDecodeSuiteJson(jsonFileName, options, results)) {
+			return 1;
+		}
+		printf("Results written to %s\n", jsonFileName);
+	}
+	return results.empty() ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+#include "FrameArena.h"
+#include "AlignedMemory.h"
+
+#include <string.h>
+
+#define SPAN_ALIGNMENT 32	// alignas of SpanHeader
+
+FrameArena::FrameArena(size_t initialSize)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_pCurrent = NewChunk(AlignUp(initialSize ? initialSize : 1, SPAN_ALIGNMENT));
+}
+
+FrameArena::~FrameArena()
+{
+	// Spans still in use are dropped with their chunks.
+	for (size_t i = 0; i < m_retired.size(); ++i) {
+		AlignedFree(m_retired[i]->pBase);
+		delete m_retired[i];
+	}
+	if (m_pCurrent) {
+		AlignedFree(m_pCurrent->pBase);
+		delete m_pCurrent;
+	}
+}
+
+FrameArena::Chunk* FrameArena::NewChunk(size_t size)
+{
+	uint8_t* pBase = (uint8_t*)AlignedAlloc(size);
+	if (pBase == NULL) {
+		return NULL;
+	}
+	Chunk* pChunk = new Chunk;
+	pChunk->pBase = pBase;
+	pChunk->size = size;
+	pChunk->head = 0;
+	pChunk->tail = 0;
+	pChunk->wrap = size;
+	pChunk->live = 0;
+	m_stats.mallocs++;
+	m_stats.chunkSize = size;
+	return pChunk;
+}
+
+// Finds room for total bytes after head, or at the start once the oldest
+// span is far enough in. head only catches up with tail when the chunk is
+// empty, so head == tail always means empty.
+bool FrameArena::Place(Chunk* pChunk, size_t total, size_t* pOffset)
+{
+	if (pChunk->live == 0) {
+		pChunk->head = 0;
+		pChunk->tail = 0;
+		pChunk->wrap = pChunk->size;
+	}
+	if (pChunk->head >= pChunk->tail) {
+		if (pChunk->size - pChunk->head >= total) {
+			*pOffset = pChunk->head;
+			pChunk->head += total;
+			return true;
+		}
+		if (pChunk->tail > total) {
+			pChunk->wrap = pChunk->head;
+			*pOffset = 0;
+			pChunk->head = total;
+			return true;
+		}
+		return false;
+	}
+	if (pChunk->tail - pChunk->head > total) {
+		*pOffset = pChunk->head;
+		pChunk->head += total;
+		return true;
+	}
+	return false;
+}
+
+uint8_t* FrameArena::Allocate(size_t size)
+{
+	size_t total = AlignUp(sizeof(SpanHeader) + size, SPAN_ALIGNMENT);
+	size_t offset = 0;
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_pCurrent == NULL || !Place(m_pCurrent, total, &offset)) {
+		size_t newSize = m_pCurrent ? m_pCurrent->size * 2 : total;
+		while (newSize < 2 * total) {
+			newSize *= 2;
+		}
+		Chunk* pChunk = NewChunk(newSize);
+		if (pChunk == NULL) {
+			return NULL;
+		}
+		if (m_pCurrent && m_pCurrent->live) {
+			m_retired.push_back(m_pCurrent);
+		}
+		else if (m_pCurrent) {
+			AlignedFree(m_pCurrent->pBase);
+			delete m_pCurrent;
+		}
+		m_pCurrent = pChunk;
+		m_stats.overflows++;
+		Place(m_pCurrent, total, &offset);
+	}
+
+	SpanHeader* pHeader = (SpanHeader*)(m_pCurrent->pBase + offset);
+	pHeader->pArena = this;
+	pHeader->pChunk = m_pCurrent;
+	pHeader->size = (uint32_t)total;
+	pHeader->freed = 0;
+	m_pCurrent->live++;
+
+	m_stats.allocations++;
+	m_stats.bytes += size;
+	m_stats.liveSpans++;
+	m_stats.liveBytes += total;
+	if (m_stats.liveBytes > m_stats.highWater) {
+		m_stats.highWater = m_stats.liveBytes;
+	}
+	return (uint8_t*)(pHeader + 1);
+}
+
+// Moves tail past the spans that have been freed.
+void FrameArena::AdvanceTail(Chunk* pChunk)
+{
+	while (pChunk->live) {
+		if (pChunk->tail == pChunk->wrap) {
+			pChunk->tail = 0;
+			pChunk->wrap = pChunk->size;
+		}
+		SpanHeader* pHeader = (SpanHeader*)(pChunk->pBase + pChunk->tail);
+		if (!pHeader->freed) {
+			return;
+		}
+		pChunk->tail += pHeader->size;
+	}
+}
+
+void FrameArena::Free(uint8_t* pData)
+{
+	SpanHeader* pHeader = (SpanHeader*)pData - 1;
+	Chunk* pChunk = pHeader->pChunk;
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	pHeader->freed = 1;
+	pChunk->live--;
+	m_stats.liveSpans--;
+	m_stats.liveBytes -= pHeader->size;
+	if (pChunk != m_pCurrent && pChunk->live == 0) {
+		for (size_t i = 0; i < m_retired.size(); ++i) {
+			if (m_retired[i] == pChunk) {
+				m_retired.erase(m_retired.begin() + i);
+				break;
+			}
+		}
+		AlignedFree(pChunk->pBase);
+		delete pChunk;
+		return;
+	}
+	AdvanceTail(pChunk);
+}
+
+void FrameArena::FreeSpan(void* pData)
+{
+	SpanHeader* pHeader = (SpanHeader*)pData - 1;
+	pHeader->pArena->Free((uint8_t*)pData);
+}
+
+FrameArenaStats FrameArena::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
@@ -0,0 +1,72 @@
+#ifndef __FRAMEARENA_H__
+#define __FRAMEARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+struct FrameArenaStats
+{
+	uint64_t allocations;	// spans handed out
+	uint64_t bytes;	// payload bytes handed out
+	uint64_t mallocs;	// chunk allocations, including the first
+	uint64_t overflows;	// allocations that didn't fit and grew the arena
+	size_t chunkSize;	// size of the current chunk
+	uint32_t liveSpans;
+	size_t liveBytes;	// span bytes in use, headers included
+	size_t highWater;	// most span bytes in use at once
+};
+
+// Ring buffer for compressed frames. Allocate() hands out a contiguous span
+// sized to the frame, Free() gives it back. Spans are normally freed in the
+// order they were allocated, but they don't have to be; memory is reused once
+// the oldest span is free. When a frame doesn't fit, the arena moves to a new
+// chunk of twice the size and frees the old one when its last span is freed,
+// so in steady state there are no heap allocations (FrameArenaStats::mallocs
+// stops growing). Thread safe.
+class FrameArena
+{
+public:
+	FrameArena(size_t initialSize);
+	~FrameArena();
+
+	// Returns size bytes, 32 byte aligned, or NULL if memory runs out.
+	uint8_t* Allocate(size_t size);
+	void Free(uint8_t* pData);
+
+	// Release hook for CompressedFrame (FrameScheduler.h): pOwner is the span.
+	static void FreeSpan(void* pData);
+
+	FrameArenaStats GetStats();
+
+private:
+	struct Chunk
+	{
+		uint8_t* pBase;
+		size_t size;
+		size_t head;	// next free byte
+		size_t tail;	// oldest live span
+		size_t wrap;	// end of the spans before head wrapped to 0
+		uint32_t live;
+	};
+	struct alignas(32) SpanHeader
+	{
+		FrameArena* pArena;
+		Chunk* pChunk;
+		uint32_t size;	// header included
+		uint32_t freed;
+	};
+
+	Chunk* NewChunk(size_t size);
+	bool Place(Chunk* pChunk, size_t total, size_t* pOffset);
+	void AdvanceTail(Chunk* pChunk);
+
+	std::mutex m_mutex;
+	Chunk* m_pCurrent;
+	std::vector<Chunk*> m_retired;	// earlier chunks with live spans
+	FrameArenaStats m_stats;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "FrameDump.h"
+#include "ColorConvert.h"
+#include "HexDump.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#define BMP_HEADER_SIZE (14 + 40)
+#define BMP_PALETTE_SIZE (256 * 4)
+#define PGM_HEADER_SIZE 32
+
+struct GrayPalette
+{
+	uint8_t bgra[BMP_PALETTE_SIZE];
+};
+
+static constexpr GrayPalette MakeGrayPalette()
+{
+	GrayPalette palette = {};
+	for (int i = 0; i < 256; ++i) {
+		palette.bgra[i * 4 + 0] = (uint8_t)i;
+		palette.bgra[i * 4 + 1] = (uint8_t)i;
+		palette.bgra[i * 4 + 2] = (uint8_t)i;
+	}
+	return palette;
+}
+
+static constexpr GrayPalette s_grayPalette = MakeGrayPalette();
+static const uint8_t s_rowPad[4] = { 0 };
+
+static void PutLE16(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void PutLE32(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+// BITMAPFILEHEADER + BITMAPINFOHEADER for a bottom-up image with rowBytes
+// (padded) bytes per row and paletteSize bytes of palette after the header.
+static void BuildBmpHeader(uint8_t* pHeader, uint32_t width, uint32_t height, uint32_t bitsPerPixel,
+	uint32_t rowBytes, uint32_t paletteSize)
+{
+	uint32_t imageSize = rowBytes * height;
+
+	memset(pHeader, 0, BMP_HEADER_SIZE);
+	pHeader[0] = 'B';
+	pHeader[1] = 'M';
+	PutLE32(pHeader + 2, BMP_HEADER_SIZE + paletteSize + imageSize);	// bfSize
+	PutLE32(pHeader + 10, BMP_HEADER_SIZE + paletteSize);				// bfOffBits
+	PutLE32(pHeader + 14, 40);							// biSize
+	PutLE32(pHeader + 18, width);
+	PutLE32(pHeader + 22, height);						// positive height: bottom-up rows
+	PutLE16(pHeader + 26, 1);							// biPlanes
+	PutLE16(pHeader + 28, bitsPerPixel);
+	PutLE32(pHeader + 34, imageSize);
+	PutLE32(pHeader + 38, 2400);
+	PutLE32(pHeader + 42, 2400);
+	PutLE32(pHeader + 46, paletteSize / 4);				// biClrUsed
+}
+
+bool WriteImageSpans(const char* fileName, const ImageSpan* pSpans, size_t count)
+{
+#if defined(_WIN32)
+	// No gather write for regular files here: copy the spans into one image.
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i) {
+		total += pSpans[i].len;
+	}
+	std::vector<uint8_t> buffer(total);
+	size_t offset = 0;
+	for (size_t i = 0; i < count; ++i) {
+		memcpy(buffer.data() + offset, pSpans[i].pData, pSpans[i].len);
+		offset += pSpans[i].len;
+	}
+	FILE* file = fopen(fileName, "wb");
+	if (file == NULL) {
+		LOG_ERROR("Failed to open %s\n", fileName);
+		return false;
+	}
+	// Unbuffered, so the CRT hands the copied image to one WriteFile.
+	setvbuf(file, NULL, _IONBF, 0);
+	bool ok = fwrite(buffer.data(), 1, total, file) == total;
+	fclose(file);
+	return ok;
+#else
+	int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		LOG_ERROR("Failed to open %s\n", fileName);
+		return false;
+	}
+	std::vector<struct iovec> iov(count);
+	for (size_t i = 0; i < count; ++i) {
+		iov[i].iov_base = (void*)pSpans[i].pData;
+		iov[i].iov_len = pSpans[i].len;
+	}
+	size_t next = 0;
+	bool ok = true;
+	while (next < count) {
+		int batch = count - next < IOV_MAX ? (int)(count - next) : IOV_MAX;
+		ssize_t written = writev(fd, &iov[next], batch);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			ok = false;
+			break;
+		}
+		// Skip what went out, resuming inside a span after a short write.
+		while (next < count && (size_t)written >= iov[next].iov_len) {
+			written -= iov[next].iov_len;
+			next++;
+		}
+		if (written > 0) {
+			iov[next].iov_base = (uint8_t*)iov[next].iov_base + written;
+			iov[next].iov_len -= written;
+		}
+	}
+	close(fd);
+	return ok;
+#endif
+}
+
+bool SaveGrayImage(const char* fileName, ImageFormat format, const uint8_t* pData, uint32_t pitch,
+	uint32_t width, uint32_t height)
+{
+	std::vector<ImageSpan> spans;
+	uint8_t header[BMP_HEADER_SIZE > PGM_HEADER_SIZE ? BMP_HEADER_SIZE : PGM_HEADER_SIZE];
+
+	spans.reserve(2 * (size_t)height + 2);
+	if (format == IMAGE_FORMAT_PGM) {
+		int len = snprintf((char*)header, sizeof(header), "P5\n%u %u\n255\n", width, height);
+		spans.push_back({ header, (size_t)len });
+		if (pitch == width) {
+			spans.push_back({ pData, (size_t)width * height });
+		}
+		else {
+			for (uint32_t y = 0; y < height; ++y) {
+				spans.push_back({ pData + (size_t)y * pitch, width });
+			}
+		}
+	}
+	else {
+		uint32_t rowBytes = (width + 3) & ~3u;
+		BuildBmpHeader(header, width, height, 8, rowBytes, BMP_PALETTE_SIZE);
+		spans.push_back({ header, BMP_HEADER_SIZE });
+		spans.push_back({ s_grayPalette.bgra, BMP_PALETTE_SIZE });
+		for (uint32_t y = height; y-- > 0; ) {
+			spans.push_back({ pData + (size_t)y * pitch, width });
+			if (rowBytes != width) {
+				spans.push_back({ s_rowPad, rowBytes - width });
+			}
+		}
+	}
+	return WriteImageSpans(fileName, spans.data(), spans.size());
+}
+
+bool SaveGrayBmp(const char* fileName, const uint8_t* pData, uint32_t pitch, uint32_t width, uint32_t height)
+{
+	return SaveGrayImage(fileName, IMAGE_FORMAT_BMP, pData, pitch, width, height);
+}
+
+bool SaveNV12Planes(const NV12Frame* pFrame, ImageFormat format, const char* yFileName, const char* uvFileName)
+{
+	uint32_t uvWidth = (pFrame->width + 1) & ~1u;
+	if (!SaveGrayImage(yFileName, format, pFrame->pY, pFrame->pitchY, pFrame->width, pFrame->height)) {
+		return false;
+	}
+	if (pFrame->pUV == NULL) {
+		return true;
+	}
+	return SaveGrayImage(uvFileName, format, pFrame->pUV, pFrame->pitchUV, uvWidth, (pFrame->height + 1) / 2);
+}
+
+bool SaveNV12PlanesBmp(const NV12Frame* pFrame, const char* yFileName, const char* uvFileName)
+{
+	return SaveNV12Planes(pFrame, IMAGE_FORMAT_BMP, yFileName, uvFileName);
+}
+
+bool SaveNV12RgbBmp(const NV12Frame* pFrame, const char* fileName)
+{
+	uint32_t width = pFrame->width;
+	uint32_t height = pFrame->height;
+	uint32_t rowBytes = (width * 3 + 3) & ~3u;
+	uint8_t header[BMP_HEADER_SIZE];
+	std::vector<uint8_t> image((size_t)rowBytes * height);
+
+	// Converted straight into bottom-up order, padding included.
+	if (height) {
+		ConvertNV12ToRgb(pFrame, YUV_MATRIX_BT601, YUV_RANGE_FULL, RGB_FORMAT_RGB24,
+			image.data() + (size_t)(height - 1) * rowBytes, -(ptrdiff_t)rowBytes);
+	}
+	BuildBmpHeader(header, width, height, 24, rowBytes, 0);
+	ImageSpan spans[2] = { { header, BMP_HEADER_SIZE }, { image.data(), image.size() } };
+	return WriteImageSpans(fileName, spans, 2);
+}
+
+static void DumpPlane(HexDumpWriter* pWriter, const char* name, const uint8_t* pBase, const uint8_t* pPlane,
+	uint32_t pitch, uint32_t rowBytes, uint32_t rows)
+{
+	char title[64];
+	int len = snprintf(title, sizeof(title), "%s plane offset=%u pitch=%u\n", name, (unsigned)(pPlane - pBase), pitch);
+	pWriter->Write(title, len);
+	for (uint32_t y = 0; y < rows; ++y) {
+		const uint8_t* p = pPlane + (size_t)y * pitch;
+		pWriter->Dump(p, rowBytes, (uint64_t)(p - pBase));
+	}
+}
+
+void DumpNV12Frame(const NV12Frame* pFrame)
+{
+	printf("NV12 frame %u x %u aligned height %u\n", pFrame->width, pFrame->height, pFrame->alignedHeight);
+	fflush(stdout);
+	HexDumpWriter writer(HEX_DUMP_STDOUT);
+	DumpPlane(&writer, "Y", pFrame->pY, pFrame->pY, pFrame->pitchY, pFrame->width, pFrame->height);
+	if (pFrame->pUV) {
+		DumpPlane(&writer, "UV", pFrame->pY, pFrame->pUV, pFrame->pitchUV, (pFrame->width + 1) & ~1u, (pFrame->height + 1) / 2);
+	}
+}
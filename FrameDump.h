@@ -0,0 +1,49 @@
+#ifndef __FRAMEDUMP_H__
+#define __FRAMEDUMP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "NV12Frame.h"
+
+// A piece of a file to write, e.g. a header or one row of a plane.
+struct ImageSpan
+{
+	const void* pData;
+	size_t len;
+};
+
+// Creates fileName and writes the spans in order with as few system calls as
+// possible: writev() in batches of IOV_MAX on POSIX. Elsewhere the spans are
+// copied into one buffer and written at once, which costs less than a
+// WriteFile per row.
+bool WriteImageSpans(const char* fileName, const ImageSpan* pSpans, size_t count);
+
+enum ImageFormat
+{
+	IMAGE_FORMAT_BMP,	// 8 bit with a gray palette, bottom-up rows padded to 4 bytes
+	IMAGE_FORMAT_PGM,	// binary P5, top-down rows
+};
+
+// Saves one 8 bit plane as a grayscale image. Rows are written straight from
+// pData, pitch bytes apart.
+bool SaveGrayImage(const char* fileName, ImageFormat format, const uint8_t* pData, uint32_t pitch,
+	uint32_t width, uint32_t height);
+
+// Saves one 8 bit plane as a grayscale BMP file.
+bool SaveGrayBmp(const char* fileName, const uint8_t* pData, uint32_t pitch, uint32_t width, uint32_t height);
+
+// Saves the Y plane and the interleaved UV plane of a frame as grayscale
+// images. Reads the frame through its pitches, so padded output is fine. Luma
+// only frames (pUV NULL) save just the Y image.
+bool SaveNV12Planes(const NV12Frame* pFrame, ImageFormat format, const char* yFileName, const char* uvFileName);
+bool SaveNV12PlanesBmp(const NV12Frame* pFrame, const char* yFileName, const char* uvFileName);
+
+// Converts the frame to RGB and saves it as a 24 bit BMP. Uses the JFIF (BT.601
+// full range) matrix, which is what MJPEG frames decode to.
+bool SaveNV12RgbBmp(const NV12Frame* pFrame, const char* fileName);
+
+// Prints the visible bytes of both planes as hex, 32 bytes per line.
+void DumpNV12Frame(const NV12Frame* pFrame);
+
+#endif
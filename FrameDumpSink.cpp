@@ -0,0 +1,114 @@
+#include "FrameDumpSink.h"
+#include "FrameDump.h"
+
+#include <stdio.h>
+
+// Upper bound on how long a missed wakeup can delay the writer or a producer.
+#define DUMP_WAKEUP_MS 10
+
+FrameDumpSink::FrameDumpSink(const char* prefix, FrameDumpFormat format, uint32_t interval, uint32_t queueSize,
+	FrameDumpPolicy policy)
+	: m_prefix(prefix), m_format(format), m_interval(interval ? interval : 1), m_policy(policy),
+	m_queue(queueSize), m_stop(false), m_submitted(0), m_written(0), m_dropped(0), m_blocked(0), m_failed(0)
+{
+	m_writer = std::thread(&FrameDumpSink::WriterMain, this);
+}
+
+FrameDumpSink::~FrameDumpSink()
+{
+	Flush();
+	m_stop = true;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_itemQueued.notify_all();
+	m_writer.join();
+}
+
+bool FrameDumpSink::Submit(const NV12Frame* pFrame, uint64_t frameNumber)
+{
+	if (frameNumber % m_interval != 0) {
+		return false;
+	}
+	Item item = { *pFrame, frameNumber };
+	RetainFrame(&item.frame);
+	m_submitted++;
+	if (!m_queue.TryPush(item)) {
+		if (m_policy == FRAME_DUMP_DROP) {
+			m_dropped++;
+			ReleaseFrame(&item.frame);
+			return false;
+		}
+		m_blocked++;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_queue.TryPush(item)) {
+			m_itemDone.wait_for(lock, std::chrono::milliseconds(DUMP_WAKEUP_MS));
+		}
+	}
+	m_itemQueued.notify_one();
+	return true;
+}
+
+void FrameDumpSink::WriterMain()
+{
+	Item item;
+	for (;;) {
+		if (m_queue.TryPop(&item)) {
+			if (Write(&item)) {
+				m_written++;
+			}
+			else {
+				m_failed++;
+			}
+			ReleaseFrame(&item.frame);
+			m_itemDone.notify_all();
+			continue;
+		}
+		if (m_stop) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_itemQueued.wait_for(lock, std::chrono::milliseconds(DUMP_WAKEUP_MS));
+	}
+}
+
+bool FrameDumpSink::Write(const Item* pItem)
+{
+	char yName[512];
+	char uvName[512];
+	unsigned long long n = (unsigned long long)pItem->frameNumber;
+
+	switch (m_format) {
+	case FRAME_DUMP_PLANES_BMP:
+	case FRAME_DUMP_PLANES_PGM: {
+		const char* ext = m_format == FRAME_DUMP_PLANES_BMP ? "bmp" : "pgm";
+		snprintf(yName, sizeof(yName), "%s%llu_y.%s", m_prefix.c_str(), n, ext);
+		snprintf(uvName, sizeof(uvName), "%s%llu_uv.%s", m_prefix.c_str(), n, ext);
+		return SaveNV12Planes(&pItem->frame, m_format == FRAME_DUMP_PLANES_BMP ? IMAGE_FORMAT_BMP : IMAGE_FORMAT_PGM,
+			yName, uvName);
+	}
+	case FRAME_DUMP_RGB_BMP:
+		snprintf(yName, sizeof(yName), "%s%llu.bmp", m_prefix.c_str(), n);
+		return SaveNV12RgbBmp(&pItem->frame, yName);
+	}
+	return false;
+}
+
+void FrameDumpSink::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_written + m_failed + m_dropped < m_submitted) {
+		m_itemDone.wait_for(lock, std::chrono::milliseconds(DUMP_WAKEUP_MS));
+	}
+}
+
+FrameDumpStats FrameDumpSink::GetStats()
+{
+	FrameDumpStats stats;
+	stats.submitted = m_submitted;
+	stats.written = m_written;
+	stats.dropped = m_dropped;
+	stats.blocked = m_blocked;
+	stats.failed = m_failed;
+	return stats;
+}
@@ -0,0 +1,89 @@
+#ifndef __FRAMEDUMPSINK_H__
+#define __FRAMEDUMPSINK_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "NV12Frame.h"
+#include "BoundedQueue.h"
+
+enum FrameDumpFormat
+{
+	FRAME_DUMP_PLANES_BMP,	// <prefix><n>_y.bmp and <prefix><n>_uv.bmp
+	FRAME_DUMP_PLANES_PGM,	// <prefix><n>_y.pgm and <prefix><n>_uv.pgm
+	FRAME_DUMP_RGB_BMP,		// <prefix><n>.bmp
+};
+
+enum FrameDumpPolicy
+{
+	FRAME_DUMP_DROP,	// a full queue drops the frame
+	FRAME_DUMP_BLOCK,	// a full queue makes Submit() wait for the writer
+};
+
+struct FrameDumpStats
+{
+	uint64_t submitted;	// frames that passed the interval filter
+	uint64_t written;
+	uint64_t dropped;	// queue full with FRAME_DUMP_DROP
+	uint64_t blocked;	// Submit() calls that waited with FRAME_DUMP_BLOCK
+	uint64_t failed;	// write errors
+};
+
+// Saves every Nth frame on a background thread so decoding never waits for
+// file I/O. Submit() takes a reference on the frame (no copy) and puts it in
+// a lock free bounded queue; the writer thread saves it with FrameDump.h and
+// releases it. Any thread may submit.
+class FrameDumpSink
+{
+public:
+	FrameDumpSink(const char* prefix, FrameDumpFormat format, uint32_t interval, uint32_t queueSize,
+		FrameDumpPolicy policy);
+	// Writes what is queued, then stops the writer.
+	~FrameDumpSink();
+
+	// Queues the frame if frameNumber is a multiple of the interval. Returns
+	// whether it was queued; the caller keeps its own reference either way.
+	bool Submit(const NV12Frame* pFrame, uint64_t frameNumber);
+
+	// Waits until every queued frame has been written.
+	void Flush();
+
+	FrameDumpStats GetStats();
+
+private:
+	struct Item
+	{
+		NV12Frame frame;
+		uint64_t frameNumber;
+	};
+
+	void WriterMain();
+	bool Write(const Item* pItem);
+
+	std::string m_prefix;
+	FrameDumpFormat m_format;
+	uint32_t m_interval;
+	FrameDumpPolicy m_policy;
+	BoundedQueue<Item> m_queue;
+
+	// Only for sleeping: the writer when the queue is empty, producers when
+	// it is full (FRAME_DUMP_BLOCK) and Flush().
+	std::mutex m_mutex;
+	std::condition_variable m_itemQueued;
+	std::condition_variable m_itemDone;
+	std::atomic<bool> m_stop;
+	std::thread m_writer;
+
+	std::atomic<uint64_t> m_submitted;
+	std::atomic<uint64_t> m_written;
+	std::atomic<uint64_t> m_dropped;
+	std::atomic<uint64_t> m_blocked;
+	std::atomic<uint64_t> m_failed;
+};
+
+#endif
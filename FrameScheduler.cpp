@@ -0,0 +1,175 @@
+#include "FrameScheduler.h"
+#include "FrameTrace.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+FrameScheduler::FrameScheduler(IMJPEGDecoder** ppDecoders, uint32_t numDecoders, uint32_t maxQueued)
+{
+	m_maxQueued = maxQueued ? maxQueued : 1;
+	m_callback = NULL;
+	m_pCallbackContext = NULL;
+	m_nextSequence = 0;
+	m_nextDeliver = 0;
+	m_delivering = false;
+	m_stop = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_totalReorderMs = 0.0;
+	for (uint32_t i = 0; i < numDecoders; ++i) {
+		m_workers.push_back(std::thread(&FrameScheduler::WorkerMain, this, ppDecoders[i]));
+	}
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	Drain();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_jobAvailable.notify_all();
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workers[i].join();
+	}
+	while (!m_ready.empty()) {
+		ReleaseFrame(&m_ready.front().second);
+		m_ready.pop_front();
+	}
+}
+
+void FrameScheduler::SetCallback(DecodedFrameCallback callback, void* pContext)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_callback = callback;
+	m_pCallbackContext = pContext;
+}
+
+bool FrameScheduler::Submit(const CompressedFrame* pFrame, bool block)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_queue.size() >= m_maxQueued) {
+		if (!block) {
+			return false;
+		}
+		m_spaceAvailable.wait(lock, [this] { return m_queue.size() < m_maxQueued; });
+	}
+	Job job = { *pFrame, m_nextSequence++ };
+	m_queue.push_back(job);
+	m_stats.submitted++;
+	if (m_queue.size() > m_stats.maxQueueDepth) {
+		m_stats.maxQueueDepth = (uint32_t)m_queue.size();
+	}
+	m_jobAvailable.notify_one();
+	return true;
+}
+
+void FrameScheduler::WorkerMain(IMJPEGDecoder* pDecoder)
+{
+	TRACE_THREAD_NAME("FrameScheduler worker");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_jobAvailable.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+		if (m_queue.empty()) {
+			return;
+		}
+		Job job = m_queue.front();
+		m_queue.pop_front();
+		m_spaceAvailable.notify_one();
+		lock.unlock();
+
+		Result result;
+		TRACE_BEGIN(TRACE_DECODE, job.input.timestamp);
+		result.ok = pDecoder->DecodeOneFrame(job.input.pData, job.input.len, &result.frame) == S_OK;
+		TRACE_END(TRACE_DECODE, job.input.timestamp);
+		if (result.ok) {
+			result.frame.timestamp = job.input.timestamp;
+		}
+		else {
+			LOG_WARN("FrameScheduler %s decode failed seq=%llu\n", pDecoder->Name(), (unsigned long long)job.sequence);
+		}
+		if (job.input.pfnRelease) {
+			job.input.pfnRelease(job.input.pOwner);
+		}
+		result.decodedAt = Clock::now();
+
+		lock.lock();
+		m_reorder[job.sequence] = result;
+		if (m_reorder.size() > m_stats.maxReorderDepth) {
+			m_stats.maxReorderDepth = (uint32_t)m_reorder.size();
+		}
+		DeliverLocked(lock);
+	}
+}
+
+// Hands out decoded frames while the next one in sequence is available. Only
+// one thread delivers at a time, so callbacks run in order; the others just
+// leave their result in m_reorder.
+void FrameScheduler::DeliverLocked(std::unique_lock<std::mutex>& lock)
+{
+	if (m_delivering) {
+		return;
+	}
+	m_delivering = true;
+	while (!m_reorder.empty() && m_reorder.begin()->first == m_nextDeliver) {
+		uint64_t sequence = m_reorder.begin()->first;
+		Result result = m_reorder.begin()->second;
+		m_reorder.erase(m_reorder.begin());
+		m_nextDeliver++;
+		if (!result.ok) {
+			m_stats.failed++;
+			m_delivered.notify_all();
+			continue;
+		}
+		double waitMs = std::chrono::duration<double, std::milli>(Clock::now() - result.decodedAt).count();
+		m_totalReorderMs += waitMs;
+		if (waitMs > m_stats.maxReorderMs) {
+			m_stats.maxReorderMs = waitMs;
+		}
+		m_stats.delivered++;
+		TRACE_INSTANT(TRACE_DELIVER, result.frame.timestamp);
+		if (m_callback == NULL) {
+			m_ready.push_back(std::make_pair(sequence, result.frame));
+			m_resultAvailable.notify_one();
+		}
+		else {
+			DecodedFrameCallback callback = m_callback;
+			void* pContext = m_pCallbackContext;
+			lock.unlock();
+			callback(pContext, sequence, &result.frame);
+			lock.lock();
+		}
+		m_delivered.notify_all();
+	}
+	m_delivering = false;
+}
+
+bool FrameScheduler::Poll(NV12Frame* pFrame, uint64_t* pSequence, uint32_t timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_resultAvailable.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !m_ready.empty(); })) {
+		return false;
+	}
+	*pFrame = m_ready.front().second;
+	if (pSequence) {
+		*pSequence = m_ready.front().first;
+	}
+	m_ready.pop_front();
+	return true;
+}
+
+void FrameScheduler::Drain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_delivered.wait(lock, [this] { return m_nextDeliver == m_nextSequence && !m_delivering; });
+}
+
+FrameSchedulerStats FrameScheduler::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	FrameSchedulerStats stats = m_stats;
+	stats.queueDepth = (uint32_t)m_queue.size();
+	stats.reorderDepth = (uint32_t)m_reorder.size();
+	stats.meanReorderMs = stats.delivered ? m_totalReorderMs / stats.delivered : 0.0;
+	return stats;
+}
@@ -0,0 +1,103 @@
+#ifndef __FRAMESCHEDULER_H__
+#define __FRAMESCHEDULER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IMJPEGDecoder.h"
+#include "DecodePipeline.h"
+
+// A compressed frame and how to give its memory back. pfnRelease(pOwner) is
+// called once the frame has been decoded or dropped; it may be NULL.
+struct CompressedFrame
+{
+	const uint8_t* pData;
+	size_t len;
+	int64_t timestamp;
+	void (*pfnRelease)(void* pOwner);
+	void* pOwner;
+};
+
+struct FrameSchedulerStats
+{
+	uint64_t submitted;
+	uint64_t delivered;
+	uint64_t failed;	// decode errors, skipped in the output
+	uint32_t queueDepth;	// frames waiting for a decoder
+	uint32_t maxQueueDepth;
+	uint32_t reorderDepth;	// decoded frames waiting for an earlier one
+	uint32_t maxReorderDepth;
+	double meanReorderMs;	// time from decoded to delivered
+	double maxReorderMs;
+};
+
+// Decodes independent MJPEG frames on several decoder instances at once (one
+// thread each) and delivers them in submit order through a reorder buffer.
+// Uses the same callback / Poll() delivery as DecodePipeline.
+class FrameScheduler
+{
+public:
+	// The decoders stay owned by the caller and must outlive the scheduler.
+	// Submit() blocks (or fails) while maxQueued frames wait for a decoder.
+	FrameScheduler(IMJPEGDecoder** ppDecoders, uint32_t numDecoders, uint32_t maxQueued);
+	~FrameScheduler();
+
+	void SetCallback(DecodedFrameCallback callback, void* pContext);
+	bool Submit(const CompressedFrame* pFrame, bool block);
+	bool Poll(NV12Frame* pFrame, uint64_t* pSequence, uint32_t timeoutMs);
+
+	// Waits until every submitted frame has been decoded and delivered
+	// (or is waiting in Poll()'s queue).
+	void Drain();
+
+	FrameSchedulerStats GetStats();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job
+	{
+		CompressedFrame input;
+		uint64_t sequence;
+	};
+	struct Result
+	{
+		NV12Frame frame;
+		bool ok;
+		Clock::time_point decodedAt;
+	};
+
+	void WorkerMain(IMJPEGDecoder* pDecoder);
+	void DeliverLocked(std::unique_lock<std::mutex>& lock);
+
+	std::vector<std::thread> m_workers;
+	uint32_t m_maxQueued;
+	DecodedFrameCallback m_callback;
+	void* m_pCallbackContext;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_spaceAvailable;
+	std::condition_variable m_resultAvailable;
+	std::condition_variable m_delivered;
+	std::deque<Job> m_queue;
+	std::map<uint64_t, Result> m_reorder;	// decoded, keyed by sequence
+	std::deque<std::pair<uint64_t, NV12Frame> > m_ready;	// in order, for Poll()
+	uint64_t m_nextSequence;
+	uint64_t m_nextDeliver;
+	bool m_delivering;	// a thread is running DeliverLocked's callbacks
+	bool m_stop;
+
+	FrameSchedulerStats m_stats;
+	double m_totalReorderMs;
+};
+
+#endif
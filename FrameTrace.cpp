@@ -0,0 +1,271 @@
+#include "FrameTrace.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+
+static_assert((FRAME_TRACE_RING_SIZE & (FRAME_TRACE_RING_SIZE - 1)) == 0, "FRAME_TRACE_RING_SIZE must be a power of two");
+
+// Written by its own thread only. Rings live until the process exits, so
+// records of threads that have exited can still be exported.
+struct TraceRing
+{
+	TraceRecord records[FRAME_TRACE_RING_SIZE];
+	std::atomic<uint64_t> written;
+	uint32_t index;
+	char name[32];
+};
+
+// Destroyed at exit, after which no traced thread may record.
+struct TraceRegistry
+{
+	~TraceRegistry()
+	{
+		for (TraceRing* pRing : rings) {
+			delete pRing;
+		}
+	}
+
+	std::mutex mutex;
+	std::vector<TraceRing*> rings;
+};
+
+static TraceRegistry& GetRegistry()
+{
+	static TraceRegistry registry;
+	return registry;
+}
+
+static thread_local TraceRing* t_pRing = NULL;
+
+static constexpr const char* s_stageNames[TRACE_STAGE_COUNT] =
+{
+	"ReadSample",
+	"Submit",
+	"ProcessInput",
+	"NeedInput",
+	"HaveOutput",
+	"ProcessOutput",
+	"Decode",
+	"Deliver",
+	"Release",
+};
+
+uint64_t TraceNowNs()
+{
+	static const std::chrono::steady_clock::time_point s_epoch = std::chrono::steady_clock::now();
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+}
+
+static TraceRing* GetThreadRing()
+{
+	if (t_pRing == NULL) {
+		TraceRing* pRing = new TraceRing();
+		pRing->written = 0;
+		TraceRegistry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		pRing->index = (uint32_t)registry.rings.size();
+		snprintf(pRing->name, sizeof(pRing->name), "thread %u", pRing->index);
+		registry.rings.push_back(pRing);
+		t_pRing = pRing;
+	}
+	return t_pRing;
+}
+
+void TraceRecordEvent(TraceStage stage, char phase, int64_t frameId)
+{
+	TraceRing* pRing = GetThreadRing();
+	uint64_t n = pRing->written.load(std::memory_order_relaxed);
+	TraceRecord& record = pRing->records[n & (FRAME_TRACE_RING_SIZE - 1)];
+	record.timeNs = TraceNowNs();
+	record.frameId = frameId;
+	record.stage = (uint8_t)stage;
+	record.phase = phase;
+	pRing->written.store(n + 1, std::memory_order_release);
+}
+
+void TraceSetThreadName(const char* name)
+{
+	TraceRing* pRing = GetThreadRing();
+	std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+	snprintf(pRing->name, sizeof(pRing->name), "%s", name);
+}
+
+const char* TraceStageName(TraceStage stage)
+{
+	return (unsigned)stage < TRACE_STAGE_COUNT ? s_stageNames[stage] : "?";
+}
+
+// Returns the number of records lost to ring wrap around.
+static uint64_t CollectRecords(std::vector<TraceRecord>* pRecords, std::vector<uint32_t>* pThreads,
+	std::vector<std::string>* pNames)
+{
+	uint64_t overwritten = 0;
+	TraceRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	pRecords->clear();
+	pThreads->clear();
+	for (size_t i = 0; i < registry.rings.size(); ++i) {
+		TraceRing* pRing = registry.rings[i];
+		uint64_t n = pRing->written.load(std::memory_order_acquire);
+		uint64_t first = n > FRAME_TRACE_RING_SIZE ? n - FRAME_TRACE_RING_SIZE : 0;
+		overwritten += first;
+		for (uint64_t j = first; j < n; ++j) {
+			pRecords->push_back(pRing->records[j & (FRAME_TRACE_RING_SIZE - 1)]);
+			pThreads->push_back(pRing->index);
+		}
+		if (pNames) {
+			pNames->push_back(pRing->name);
+		}
+	}
+	return overwritten;
+}
+
+size_t CollectTrace(std::vector<TraceRecord>* pRecords, std::vector<uint32_t>* pThreads)
+{
+	CollectRecords(pRecords, pThreads, NULL);
+	return pRecords->size();
+}
+
+bool WriteChromeTrace(const char* path)
+{
+	std::vector<TraceRecord> records;
+	std::vector<uint32_t> threads;
+	std::vector<std::string> names;
+	CollectRecords(&records, &threads, &names);
+
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		LOG_ERROR("Failed to open %s\n", path);
+		return false;
+	}
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < names.size(); ++i) {
+		// Thread names come from code, not user input, so only quotes need care.
+		std::string name = names[i];
+		std::replace(name.begin(), name.end(), '"', '\'');
+		fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}},\n",
+			i, name.c_str());
+	}
+	for (size_t i = 0; i < records.size(); ++i) {
+		const TraceRecord& r = records[i];
+		fprintf(f, "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,%s\"args\":{\"frame\":%lld}}%s\n",
+			TraceStageName((TraceStage)r.stage), r.phase, r.timeNs / 1000.0, threads[i],
+			r.phase == TRACE_PHASE_INSTANT ? "\"s\":\"t\"," : "", (long long)r.frameId,
+			i + 1 < records.size() ? "," : "");
+	}
+	fprintf(f, "]}\n");
+	bool ok = ferror(f) == 0;
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+	return ok;
+}
+
+static void AddLatency(std::vector<TraceLatency>* pLatencies, TraceStage stage, bool duration, std::vector<uint64_t>* pNs)
+{
+	if (pNs->empty()) {
+		return;
+	}
+	std::sort(pNs->begin(), pNs->end());
+	size_t n = pNs->size();
+	// Nearest rank percentiles.
+	size_t p50 = (n * 50 + 99) / 100 - 1;
+	size_t p99 = (n * 99 + 99) / 100 - 1;
+	TraceLatency latency = { stage, duration, (uint32_t)n, (*pNs)[p50] / 1e6, (*pNs)[p99] / 1e6, pNs->back() / 1e6 };
+	pLatencies->push_back(latency);
+}
+
+std::vector<TraceLatency> ComputeTraceLatencies()
+{
+	std::vector<TraceRecord> records;
+	std::vector<uint32_t> threads;
+	CollectRecords(&records, &threads, NULL);
+
+	// Time each frame first reached each stage; begin / end stages count when they end.
+	std::map<int64_t, std::vector<uint64_t>> frameTimes;
+	std::vector<uint64_t> durations[TRACE_STAGE_COUNT];
+	std::vector<std::pair<uint8_t, uint64_t>> open;	// begun stages of the current thread
+	for (size_t i = 0; i < records.size(); ++i) {
+		const TraceRecord& r = records[i];
+		if (r.stage >= TRACE_STAGE_COUNT) {
+			continue;
+		}
+		if (i == 0 || threads[i] != threads[i - 1]) {
+			open.clear();
+		}
+		if (r.phase == TRACE_PHASE_BEGIN) {
+			open.push_back(std::make_pair(r.stage, r.timeNs));
+			continue;
+		}
+		if (r.phase == TRACE_PHASE_END) {
+			for (size_t j = open.size(); j-- > 0; ) {
+				if (open[j].first == r.stage) {
+					durations[r.stage].push_back(r.timeNs - open[j].second);
+					open.erase(open.begin() + j);
+					break;
+				}
+			}
+		}
+		if (r.frameId >= 0) {
+			std::vector<uint64_t>& times = frameTimes[r.frameId];
+			if (times.empty()) {
+				times.assign(TRACE_STAGE_COUNT, UINT64_MAX);
+			}
+			times[r.stage] = std::min(times[r.stage], r.timeNs);
+		}
+	}
+
+	std::vector<uint64_t> sinceRead[TRACE_STAGE_COUNT];
+	for (std::map<int64_t, std::vector<uint64_t>>::iterator it = frameTimes.begin(); it != frameTimes.end(); ++it) {
+		const std::vector<uint64_t>& times = it->second;
+		if (times[TRACE_READ_SAMPLE] == UINT64_MAX) {
+			continue;
+		}
+		for (int s = 0; s < TRACE_STAGE_COUNT; ++s) {
+			if (s != TRACE_READ_SAMPLE && times[s] != UINT64_MAX && times[s] >= times[TRACE_READ_SAMPLE]) {
+				sinceRead[s].push_back(times[s] - times[TRACE_READ_SAMPLE]);
+			}
+		}
+	}
+
+	std::vector<TraceLatency> latencies;
+	for (int s = 0; s < TRACE_STAGE_COUNT; ++s) {
+		AddLatency(&latencies, (TraceStage)s, false, &sinceRead[s]);
+	}
+	for (int s = 0; s < TRACE_STAGE_COUNT; ++s) {
+		AddLatency(&latencies, (TraceStage)s, true, &durations[s]);
+	}
+	return latencies;
+}
+
+void PrintTraceLatencies()
+{
+	std::vector<TraceRecord> records;
+	std::vector<uint32_t> threads;
+	uint64_t overwritten = CollectRecords(&records, &threads, NULL);
+	printf("Frame trace: %zu records, %llu overwritten\n", records.size(), (unsigned long long)overwritten);
+
+	std::vector<TraceLatency> latencies = ComputeTraceLatencies();
+	printf("  %-28s %7s %9s %9s %9s\n", "stage", "count", "p50 ms", "p99 ms", "max ms");
+	for (size_t i = 0; i < latencies.size(); ++i) {
+		const TraceLatency& l = latencies[i];
+		char label[64];
+		snprintf(label, sizeof(label), "%s %s", TraceStageName(l.stage), l.duration ? "duration" : "since read");
+		printf("  %-28s %7u %9.3f %9.3f %9.3f\n", label, l.count, l.p50Ms, l.p99Ms, l.maxMs);
+	}
+}
+
+void ResetTrace()
+{
+	TraceRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (size_t i = 0; i < registry.rings.size(); ++i) {
+		registry.rings[i]->written.store(0, std::memory_order_release);
+	}
+}
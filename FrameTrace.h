@@ -0,0 +1,118 @@
+#ifndef __FRAMETRACE_H__
+#define __FRAMETRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Set to 1 (here or with /DFRAME_TRACE=1) to record the TRACE_* points below.
+// With 0 they expand to nothing and cost nothing.
+#ifndef FRAME_TRACE
+#define FRAME_TRACE 0
+#endif
+
+// Records kept per thread; older ones are overwritten.
+#define FRAME_TRACE_RING_SIZE 16384
+
+// Points in the life of a frame. Frames are identified by their sample time.
+enum TraceStage
+{
+	TRACE_READ_SAMPLE,		// IMFSourceReader::ReadSample returned the frame
+	TRACE_SUBMIT,			// handed to the decoder (may wait for space)
+	TRACE_PROCESS_INPUT,	// IMFTransform::ProcessInput
+	TRACE_NEED_INPUT,		// METransformNeedInput
+	TRACE_HAVE_OUTPUT,		// METransformHaveOutput
+	TRACE_PROCESS_OUTPUT,	// IMFTransform::ProcessOutput
+	TRACE_DECODE,			// software decode on a FrameScheduler thread
+	TRACE_DELIVER,			// decoded frame handed to the consumer
+	TRACE_RELEASE,			// consumer released the frame
+	TRACE_STAGE_COUNT
+};
+
+enum TracePhase
+{
+	TRACE_PHASE_INSTANT = 'i',
+	TRACE_PHASE_BEGIN = 'B',
+	TRACE_PHASE_END = 'E',
+};
+
+struct TraceRecord
+{
+	uint64_t timeNs;	// TraceNowNs()
+	int64_t frameId;	// -1 when not tied to a frame
+	uint8_t stage;		// TraceStage
+	char phase;			// TracePhase
+};
+
+// Monotonic nanoseconds since the first call in the process.
+uint64_t TraceNowNs();
+
+// Appends a record to the calling thread's ring. Lock free except for the
+// first record of a thread, which registers its ring.
+void TraceRecordEvent(TraceStage stage, char phase, int64_t frameId);
+
+// Names the calling thread in the exported trace.
+void TraceSetThreadName(const char* name);
+
+const char* TraceStageName(TraceStage stage);
+
+// The functions below read every ring; call them once the traced threads
+// have gone quiet, records written meanwhile may be torn.
+
+// Copies the records of all threads; pThreads receives the thread index of each.
+size_t CollectTrace(std::vector<TraceRecord>* pRecords, std::vector<uint32_t>* pThreads);
+
+// Writes the records in Chrome trace event format (chrome://tracing, Perfetto).
+bool WriteChromeTrace(const char* path);
+
+struct TraceLatency
+{
+	TraceStage stage;
+	bool duration;	// begin to end of the stage, otherwise time since the frame was read
+	uint32_t count;
+	double p50Ms;
+	double p99Ms;
+	double maxMs;
+};
+
+// Per stage latency since TRACE_READ_SAMPLE of the same frame (first
+// occurrence of each stage per frame), and begin / end durations.
+std::vector<TraceLatency> ComputeTraceLatencies();
+
+void PrintTraceLatencies();
+
+// Forgets all records; the rings stay registered.
+void ResetTrace();
+
+#if FRAME_TRACE
+class TraceScope
+{
+public:
+	TraceScope(TraceStage stage, int64_t frameId) : m_stage(stage), m_frameId(frameId)
+	{
+		TraceRecordEvent(stage, TRACE_PHASE_BEGIN, frameId);
+	}
+	~TraceScope() { TraceRecordEvent(m_stage, TRACE_PHASE_END, m_frameId); }
+
+private:
+	TraceStage m_stage;
+	int64_t m_frameId;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_INSTANT(stage, frameId) TraceRecordEvent(stage, TRACE_PHASE_INSTANT, frameId)
+#define TRACE_BEGIN(stage, frameId) TraceRecordEvent(stage, TRACE_PHASE_BEGIN, frameId)
+#define TRACE_END(stage, frameId) TraceRecordEvent(stage, TRACE_PHASE_END, frameId)
+#define TRACE_SCOPE(stage, frameId) TraceScope TRACE_CONCAT(traceScope, __LINE__)(stage, frameId)
+#define TRACE_THREAD_NAME(name) TraceSetThreadName(name)
+#else
+#define TRACE_INSTANT(stage, frameId) ((void)0)
+#define TRACE_BEGIN(stage, frameId) ((void)0)
+#define TRACE_END(stage, frameId) ((void)0)
+#define TRACE_SCOPE(stage, frameId) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif
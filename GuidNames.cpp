@@ -0,0 +1,99 @@
+#include "GuidNames.h"
+
+struct FormatName
+{
+	uint32_t code;	// FOURCC, WAVE_FORMAT tag or D3DFMT value
+	const char* name;
+};
+
+static constexpr FormatName s_formatNames[] =
+{
+	{ MakeFourcc("auds"), "MFMediaType_Audio" },
+	{ MakeFourcc("vids"), "MFMediaType_Video" },
+
+	{ MakeFourcc("AI44"), "MFVideoFormat_AI44" },
+	{ 21, "MFVideoFormat_ARGB32" },	// D3DFMT_A8R8G8B8
+	{ MakeFourcc("AYUV"), "MFVideoFormat_AYUV" },
+	{ MakeFourcc("dv25"), "MFVideoFormat_DV25" },
+	{ MakeFourcc("dv50"), "MFVideoFormat_DV50" },
+	{ MakeFourcc("dvh1"), "MFVideoFormat_DVH1" },
+	{ MakeFourcc("dvsd"), "MFVideoFormat_DVSD" },
+	{ MakeFourcc("dvsl"), "MFVideoFormat_DVSL" },
+	{ MakeFourcc("H264"), "MFVideoFormat_H264" },
+	{ MakeFourcc("I420"), "MFVideoFormat_I420" },
+	{ MakeFourcc("IYUV"), "MFVideoFormat_IYUV" },
+	{ MakeFourcc("M4S2"), "MFVideoFormat_M4S2" },
+	{ MakeFourcc("MJPG"), "MFVideoFormat_MJPG" },
+	{ MakeFourcc("MP43"), "MFVideoFormat_MP43" },
+	{ MakeFourcc("MP4S"), "MFVideoFormat_MP4S" },
+	{ MakeFourcc("MP4V"), "MFVideoFormat_MP4V" },
+	{ MakeFourcc("MPG1"), "MFVideoFormat_MPG1" },
+	{ MakeFourcc("MSS1"), "MFVideoFormat_MSS1" },
+	{ MakeFourcc("MSS2"), "MFVideoFormat_MSS2" },
+	{ MakeFourcc("NV11"), "MFVideoFormat_NV11" },
+	{ MakeFourcc("NV12"), "MFVideoFormat_NV12" },
+	{ MakeFourcc("P010"), "MFVideoFormat_P010" },
+	{ MakeFourcc("P016"), "MFVideoFormat_P016" },
+	{ MakeFourcc("P210"), "MFVideoFormat_P210" },
+	{ MakeFourcc("P216"), "MFVideoFormat_P216" },
+	{ 20, "MFVideoFormat_RGB24" },	// D3DFMT_R8G8B8
+	{ 22, "MFVideoFormat_RGB32" },	// D3DFMT_X8R8G8B8
+	{ 24, "MFVideoFormat_RGB555" },	// D3DFMT_X1R5G5B5
+	{ 23, "MFVideoFormat_RGB565" },	// D3DFMT_R5G6B5
+	{ 41, "MFVideoFormat_RGB8" },	// D3DFMT_P8
+	{ MakeFourcc("UYVY"), "MFVideoFormat_UYVY" },
+	{ MakeFourcc("v210"), "MFVideoFormat_v210" },
+	{ MakeFourcc("v410"), "MFVideoFormat_v410" },
+	{ MakeFourcc("WMV1"), "MFVideoFormat_WMV1" },
+	{ MakeFourcc("WMV2"), "MFVideoFormat_WMV2" },
+	{ MakeFourcc("WMV3"), "MFVideoFormat_WMV3" },
+	{ MakeFourcc("WVC1"), "MFVideoFormat_WVC1" },
+	{ MakeFourcc("Y210"), "MFVideoFormat_Y210" },
+	{ MakeFourcc("Y216"), "MFVideoFormat_Y216" },
+	{ MakeFourcc("Y410"), "MFVideoFormat_Y410" },
+	{ MakeFourcc("Y416"), "MFVideoFormat_Y416" },
+	{ MakeFourcc("Y41P"), "MFVideoFormat_Y41P" },
+	{ MakeFourcc("Y41T"), "MFVideoFormat_Y41T" },
+	{ MakeFourcc("YUY2"), "MFVideoFormat_YUY2" },
+	{ MakeFourcc("YV12"), "MFVideoFormat_YV12" },
+	{ MakeFourcc("YVYU"), "MFVideoFormat_YVYU" },
+
+	{ 0x0001, "MFAudioFormat_PCM" },	// WAVE_FORMAT_PCM
+	{ 0x0003, "MFAudioFormat_Float" },	// WAVE_FORMAT_IEEE_FLOAT
+	{ 0x0008, "MFAudioFormat_DTS" },	// WAVE_FORMAT_DTS
+	{ 0x0092, "MFAudioFormat_Dolby_AC3_SPDIF" },	// WAVE_FORMAT_DOLBY_AC3_SPDIF
+	{ 0x0009, "MFAudioFormat_DRM" },	// WAVE_FORMAT_DRM
+	{ 0x0161, "MFAudioFormat_WMAudioV8" },	// WAVE_FORMAT_WMAUDIO2
+	{ 0x0162, "MFAudioFormat_WMAudioV9" },	// WAVE_FORMAT_WMAUDIO3
+	{ 0x0163, "MFAudioFormat_WMAudio_Lossless" },	// WAVE_FORMAT_WMAUDIO_LOSSLESS
+	{ 0x0164, "MFAudioFormat_WMASPDIF" },	// WAVE_FORMAT_WMASPDIF
+	{ 0x000A, "MFAudioFormat_MSP1" },	// WAVE_FORMAT_WMAVOICE9
+	{ 0x0055, "MFAudioFormat_MP3" },	// WAVE_FORMAT_MPEGLAYER3
+	{ 0x0050, "MFAudioFormat_MPEG" },	// WAVE_FORMAT_MPEG
+	{ 0x1610, "MFAudioFormat_AAC" },	// WAVE_FORMAT_MPEG_HEAAC
+	{ 0x1600, "MFAudioFormat_ADTS" },	// WAVE_FORMAT_MPEG_ADTS_AAC
+};
+
+static constexpr GuidNameRegistry MakeFormatGuidNames()
+{
+	GuidNameRegistry table;
+	for (size_t i = 0; i < sizeof(s_formatNames) / sizeof(s_formatNames[0]); ++i) {
+		table.Insert(MakeFourccGuid(s_formatNames[i].code), s_formatNames[i].name);
+	}
+	return table;
+}
+
+static constexpr GuidNameRegistry s_formatGuidNames = MakeFormatGuidNames();
+
+static_assert(s_formatGuidNames.Count() == sizeof(s_formatNames) / sizeof(s_formatNames[0]),
+	"duplicate format GUID");
+
+const GuidNameRegistry& GetFormatGuidNames()
+{
+	return s_formatGuidNames;
+}
+
+const char* FindFormatGuidName(const PortableGuid& guid)
+{
+	return s_formatGuidNames.Find(guid);
+}
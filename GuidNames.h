@@ -0,0 +1,134 @@
+#ifndef __GUIDNAMES_H__
+#define __GUIDNAMES_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Same layout as the Windows GUID, usable without the Windows headers.
+struct PortableGuid
+{
+	uint32_t data1;
+	uint16_t data2;
+	uint16_t data3;
+	uint8_t data4[8];
+};
+
+constexpr bool GuidEqual(const PortableGuid& a, const PortableGuid& b)
+{
+	if (a.data1 != b.data1 || a.data2 != b.data2 || a.data3 != b.data3) {
+		return false;
+	}
+	for (int i = 0; i < 8; ++i) {
+		if (a.data4[i] != b.data4[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Mixes all 128 bits; FOURCC based GUIDs only differ in data1.
+constexpr uint32_t HashGuid(const PortableGuid& g)
+{
+	uint64_t a = ((uint64_t)g.data1 << 32) | ((uint64_t)g.data2 << 16) | g.data3;
+	uint64_t b = 0;
+	for (int i = 0; i < 8; ++i) {
+		b = (b << 8) | g.data4[i];
+	}
+	// murmur3 fmix64 finalizer
+	uint64_t h = a ^ (b * 0x9E3779B97F4A7C15ull);
+	h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDull;
+	h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53ull;
+	return (uint32_t)(h ^ (h >> 33));
+}
+
+// The {XXXXXXXX-0000-0010-8000-00AA00389B71} GUID used for FOURCC video
+// subtypes, WAVE_FORMAT audio subtypes and D3DFMT RGB formats.
+constexpr PortableGuid MakeFourccGuid(uint32_t code)
+{
+	return PortableGuid{ code, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+}
+
+constexpr uint32_t MakeFourcc(const char* s)
+{
+	return (uint32_t)(uint8_t)s[0] | ((uint32_t)(uint8_t)s[1] << 8) | ((uint32_t)(uint8_t)s[2] << 16) |
+		((uint32_t)(uint8_t)s[3] << 24);
+}
+
+struct GuidName
+{
+	PortableGuid guid = {};
+	const char* name = NULL;	// NULL marks an empty slot
+};
+
+// Open addressing hash table from GUID to name. Size is a power of two, at
+// least twice the number of entries so probes stay short. Everything is
+// constexpr, so a table of constant GUIDs is built by the compiler.
+template <uint32_t Size>
+class GuidNameTable
+{
+public:
+	constexpr GuidNameTable() : m_slots(), m_count(0), m_maxProbe(0) {}
+
+	// Returns false when the table is full. A GUID that is already there keeps its first name.
+	constexpr bool Insert(const PortableGuid& guid, const char* name)
+	{
+		if (2 * (m_count + 1) > Size) {
+			return false;
+		}
+		uint32_t i = HashGuid(guid) & (Size - 1);
+		for (uint32_t probe = 1; ; ++probe, i = (i + 1) & (Size - 1)) {
+			if (m_slots[i].name == NULL) {
+				m_slots[i].guid = guid;
+				m_slots[i].name = name;
+				m_count++;
+				if (probe > m_maxProbe) {
+					m_maxProbe = probe;
+				}
+				return true;
+			}
+			if (GuidEqual(m_slots[i].guid, guid)) {
+				return true;
+			}
+		}
+	}
+
+	// Returns the name, or NULL for an unknown GUID.
+	constexpr const char* Find(const PortableGuid& guid) const
+	{
+		uint32_t i = HashGuid(guid) & (Size - 1);
+		for (uint32_t probe = 0; probe < m_maxProbe; ++probe, i = (i + 1) & (Size - 1)) {
+			if (m_slots[i].name == NULL) {
+				return NULL;
+			}
+			if (GuidEqual(m_slots[i].guid, guid)) {
+				return m_slots[i].name;
+			}
+		}
+		return NULL;
+	}
+
+	constexpr uint32_t Count() const { return m_count; }
+	constexpr uint32_t MaxProbe() const { return m_maxProbe; }
+	constexpr const GuidName& Slot(uint32_t i) const { return m_slots[i]; }
+
+private:
+	static_assert((Size & (Size - 1)) == 0, "GuidNameTable size must be a power of two");
+
+	GuidName m_slots[Size];
+	uint32_t m_count;
+	uint32_t m_maxProbe;
+};
+
+#define GUID_NAME_TABLE_SIZE 512
+
+typedef GuidNameTable<GUID_NAME_TABLE_SIZE> GuidNameRegistry;
+
+// Names of the media subtypes whose GUIDs are FOURCC / WAVE_FORMAT / D3DFMT
+// based (MFVideoFormat_*, MFAudioFormat_*, MFMediaType_Audio / _Video), built
+// at compile time.
+const GuidNameRegistry& GetFormatGuidNames();
+
+// Looks guid up in GetFormatGuidNames(), NULL if unknown.
+const char* FindFormatGuidName(const PortableGuid& guid);
+
+#endif
@@ -0,0 +1,232 @@
+#include "HexDump.h"
+#include "CpuFeatures.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#define HEX_WRITE _write
+#else
+#include <unistd.h>
+#define HEX_WRITE write
+#endif
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+
+static const char s_hexDigits[] = "0123456789abcdef";
+
+struct HexTable
+{
+	char text[256][4];	// "xx " and a spare byte so a 4 byte copy is safe
+};
+
+static constexpr HexTable MakeHexTable()
+{
+	HexTable table = {};
+	for (int i = 0; i < 256; ++i) {
+		table.text[i][0] = "0123456789abcdef"[i >> 4];
+		table.text[i][1] = "0123456789abcdef"[i & 15];
+		table.text[i][2] = ' ';
+		table.text[i][3] = ' ';
+	}
+	return table;
+}
+
+static constexpr HexTable s_hexTable = MakeHexTable();
+
+size_t HexEncode(const uint8_t* pSrc, size_t len, char* pDst)
+{
+	for (size_t i = 0; i < len; ++i) {
+		memcpy(pDst + 2 * i, s_hexTable.text[pSrc[i]], 2);
+	}
+	return 2 * len;
+}
+
+// "xx " for each of n bytes, 3 * n chars.
+static void FormatBytes(const uint8_t* pSrc, size_t n, char* pDst)
+{
+	for (size_t i = 0; i < n; ++i) {
+		memcpy(pDst + 3 * i, s_hexTable.text[pSrc[i]], 3);
+	}
+}
+
+#if defined(CPU_X86)
+// pshufb controls that spread 16 high / low nibble digits over 48 output
+// bytes as "hl ", 0x80 where the other vector or the space goes.
+struct SpreadMasks
+{
+	int8_t high[48];
+	int8_t low[48];
+	int8_t space[48];
+};
+
+static constexpr SpreadMasks MakeSpreadMasks()
+{
+	SpreadMasks masks = {};
+	for (int j = 0; j < 48; ++j) {
+		int r = j % 3;
+		masks.high[j] = r == 0 ? (int8_t)(j / 3) : (int8_t)0x80;
+		masks.low[j] = r == 1 ? (int8_t)(j / 3) : (int8_t)0x80;
+		masks.space[j] = r == 2 ? ' ' : 0;
+	}
+	return masks;
+}
+
+static constexpr SpreadMasks s_spreadMasks = MakeSpreadMasks();
+
+TARGET_SSSE3 static void FormatBytesSSSE3(const uint8_t* pSrc, size_t n, char* pDst)
+{
+	const __m128i digits = _mm_loadu_si128((const __m128i*)s_hexDigits);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(pSrc + i));
+		__m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+		__m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, nibble));
+		for (int k = 0; k < 3; ++k) {
+			__m128i out = _mm_or_si128(
+				_mm_shuffle_epi8(hi, _mm_loadu_si128((const __m128i*)(s_spreadMasks.high + 16 * k))),
+				_mm_shuffle_epi8(lo, _mm_loadu_si128((const __m128i*)(s_spreadMasks.low + 16 * k))));
+			out = _mm_or_si128(out, _mm_loadu_si128((const __m128i*)(s_spreadMasks.space + 16 * k)));
+			_mm_storeu_si128((__m128i*)(pDst + 3 * i + 16 * k), out);
+		}
+	}
+	FormatBytes(pSrc + i, n - i, pDst + 3 * i);
+}
+#endif
+
+static HexFormatFunc SelectFormatBytes()
+{
+#if defined(CPU_X86)
+	if (GetCpuFeatures() & CPU_FEATURE_SSSE3) {
+		return FormatBytesSSSE3;
+	}
+#endif
+	return FormatBytes;
+}
+
+HexDumpWriter::HexDumpWriter(int fd)
+{
+	m_fd = fd;
+	m_formatBytes = SelectFormatBytes();
+	m_used = 0;
+	m_written = 0;
+}
+
+HexDumpWriter::~HexDumpWriter()
+{
+	Flush();
+}
+
+void HexDumpWriter::Flush()
+{
+	size_t done = 0;
+	while (done < m_used) {
+		int n = (int)HEX_WRITE(m_fd, m_buffer + done, (unsigned int)(m_used - done));
+		if (n <= 0) {
+			break;
+		}
+		done += n;
+	}
+	m_written += done;
+	m_used = 0;
+}
+
+char* HexDumpWriter::Reserve(size_t len)
+{
+	if (m_used + len > sizeof(m_buffer)) {
+		Flush();
+	}
+	char* p = m_buffer + m_used;
+	m_used += len;
+	return p;
+}
+
+void HexDumpWriter::Write(const char* pText, size_t len)
+{
+	while (len) {
+		size_t n = len < sizeof(m_buffer) ? len : sizeof(m_buffer);
+		memcpy(Reserve(n), pText, n);
+		pText += n;
+		len -= n;
+	}
+}
+
+void HexDumpWriter::Dump(const uint8_t* pData, size_t len, uint64_t offset, char marker)
+{
+	// marker, 16 offset digits, ": ", the bytes and '\n'.
+	const size_t maxLine = 1 + 16 + 2 + 3 * HEX_DUMP_LINE_BYTES + 1;
+
+	for (size_t pos = 0; pos < len; pos += HEX_DUMP_LINE_BYTES) {
+		size_t n = len - pos < HEX_DUMP_LINE_BYTES ? len - pos : HEX_DUMP_LINE_BYTES;
+		uint64_t lineOffset = offset + pos;
+		int digits = lineOffset >> 32 ? 16 : 8;
+		char* pLine = Reserve(maxLine);
+		char* p = pLine;
+		if (marker) {
+			*p++ = marker;
+		}
+		for (int d = digits / 2 - 1; d >= 0; --d) {
+			memcpy(p, s_hexTable.text[(lineOffset >> (8 * d)) & 0xFF], 2);
+			p += 2;
+		}
+		*p++ = ':';
+		*p++ = ' ';
+		m_formatBytes(pData + pos, n, p);
+		p += 3 * n;
+		*p++ = '\n';
+		m_used -= maxLine - (size_t)(p - pLine);
+	}
+}
+
+void HexDump(int fd, const uint8_t* pData, size_t len, size_t start, size_t count)
+{
+	if (start >= len) {
+		return;
+	}
+	if (count > len - start) {
+		count = len - start;
+	}
+	HexDumpWriter writer(fd);
+	writer.Dump(pData + start, count, start);
+}
+
+uint64_t HexDiff(int fd, const uint8_t* pA, size_t lenA, const uint8_t* pB, size_t lenB, size_t start, size_t count)
+{
+	size_t len = lenA > lenB ? lenA : lenB;
+	uint64_t diffBytes = 0;
+	uint64_t diffLines = 0;
+	char summary[128];
+
+	if (start > len) {
+		start = len;
+	}
+	if (count > len - start) {
+		count = len - start;
+	}
+	HexDumpWriter writer(fd);
+	for (size_t pos = start; pos < start + count; pos += HEX_DUMP_LINE_BYTES) {
+		size_t n = start + count - pos < HEX_DUMP_LINE_BYTES ? start + count - pos : HEX_DUMP_LINE_BYTES;
+		size_t nA = pos < lenA ? (lenA - pos < n ? lenA - pos : n) : 0;
+		size_t nB = pos < lenB ? (lenB - pos < n ? lenB - pos : n) : 0;
+		if (nA == nB && memcmp(pA + pos, pB + pos, n) == 0) {
+			continue;
+		}
+		size_t common = nA < nB ? nA : nB;
+		for (size_t i = 0; i < common; ++i) {
+			diffBytes += pA[pos + i] != pB[pos + i];
+		}
+		diffBytes += (nA > nB ? nA : nB) - common;
+		diffLines++;
+		writer.Dump(pA + pos, nA, pos, '-');
+		writer.Dump(pB + pos, nB, pos, '+');
+	}
+	int n = snprintf(summary, sizeof(summary), "%llu bytes differ in %llu lines\n",
+		(unsigned long long)diffBytes, (unsigned long long)diffLines);
+	writer.Write(summary, n);
+	return diffBytes;
+}
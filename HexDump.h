@@ -0,0 +1,57 @@
+#ifndef __HEXDUMP_H__
+#define __HEXDUMP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes per dump line: "%08x: " then "xx " per byte.
+#define HEX_DUMP_LINE_BYTES 32
+#define HEX_DUMP_BUFFER_SIZE (64 * 1024)
+// File descriptor of stdout with both the MSVC CRT and POSIX. fflush(stdout)
+// before dumping to it.
+#define HEX_DUMP_STDOUT 1
+
+// Writes 2 * len lowercase hex digits to pDst (no terminator). Returns 2 * len.
+size_t HexEncode(const uint8_t* pSrc, size_t len, char* pDst);
+
+typedef void (*HexFormatFunc)(const uint8_t* pSrc, size_t n, char* pDst);
+
+// Formats hex dump lines into a buffer and writes it to a file descriptor in
+// HEX_DUMP_BUFFER_SIZE chunks. Bytes are formatted with a lookup table, 16 at
+// a time with SSSE3 shuffles when available.
+class HexDumpWriter
+{
+public:
+	HexDumpWriter(int fd);
+	~HexDumpWriter();
+
+	// Dumps len bytes as lines labelled offset, offset + 32, ... A non zero
+	// marker is put in front of every line (e.g. '-' / '+' for diffs).
+	void Dump(const uint8_t* pData, size_t len, uint64_t offset, char marker = 0);
+	// Appends text as is.
+	void Write(const char* pText, size_t len);
+	void Flush();
+
+	uint64_t BytesWritten() const { return m_written; }
+
+private:
+	char* Reserve(size_t len);
+
+	int m_fd;
+	HexFormatFunc m_formatBytes;	// "xx " per byte, picked for the CPU
+	size_t m_used;
+	uint64_t m_written;
+	char m_buffer[HEX_DUMP_BUFFER_SIZE];
+};
+
+// Dumps count bytes starting at start (clipped to len). Offsets in the
+// output are relative to pData.
+void HexDump(int fd, const uint8_t* pData, size_t len, size_t start = 0, size_t count = (size_t)-1);
+
+// Dumps the lines of the window where A and B differ, A's line marked '-'
+// and B's '+', then a summary. Bytes past the end of the shorter one count
+// as different. Returns the number of differing bytes.
+uint64_t HexDiff(int fd, const uint8_t* pA, size_t lenA, const uint8_t* pB, size_t lenB,
+	size_t start = 0, size_t count = (size_t)-1);
+
+#endif
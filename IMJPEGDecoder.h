@@ -0,0 +1,77 @@
+#ifndef __IMJPEGDECODER_H__
+#define __IMJPEGDECODER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PortableDefs.h"
+#include "NV12Frame.h"
+#include "ColorConvert.h"
+#include "DecodeOptions.h"
+
+// Common interface of the MJPEG decode backends: the AMD hardware MFT
+// (MJPEGDecoder) and the software decoder (SoftMJPEGDecoder).
+class IMJPEGDecoder
+{
+public:
+	virtual ~IMJPEGDecoder() {}
+
+	virtual const char* Name() const = 0;
+	// Locates / creates the decoder. Fails if the backend isn't available.
+	virtual HRESULT Find() = 0;
+	virtual HRESULT Configure(uint32_t width, uint32_t height, uint32_t framerate) = 0;
+	// Options for the frames DecodeOneFrame produces, e.g. a 1/8 scale decode
+	// for previews or a crop for analytics. Set before Start(). Backends that
+	// can't produce them return E_NOTIMPL and keep the full frame.
+	virtual HRESULT SetDecodeOptions(const DecodeOptions& options)
+	{
+		return IsDefaultDecodeOptions(options) ? S_OK : E_NOTIMPL;
+	}
+	virtual void GetDecodeOptions(DecodeOptions* pOptions) const
+	{
+		GetDefaultDecodeOptions(pOptions);
+	}
+	// MCU counts of the last decoded frame, e.g. how many a crop skipped.
+	virtual void GetLastFrameStats(DecodeFrameStats* pStats) const
+	{
+		pStats->mcus = 0;
+		pStats->skippedMcus = 0;
+		pStats->unreadMcus = 0;
+	}
+	virtual HRESULT Start() = 0;
+	// Decodes one compressed JPEG frame to NV12. On success the caller owns
+	// pFrame and releases it with ReleaseFrame().
+	virtual HRESULT DecodeOneFrame(const uint8_t* pData, size_t len, NV12Frame* pFrame) = 0;
+	virtual HRESULT Close() = 0;
+	// Decodes one frame to BGRA or RGB24 instead of NV12. The caller releases
+	// pFrame with ReleaseFrame(). Backends without a direct path decode to NV12
+	// and convert the frame afterwards.
+	virtual HRESULT DecodeOneFrameRgb(const uint8_t* pData, size_t len, RgbFormat format, RgbFrame* pFrame)
+	{
+		NV12Frame frame;
+		YuvMatrix matrix;
+		YuvRange range;
+		HRESULT hr = DecodeOneFrame(pData, len, &frame);
+		if (hr != S_OK) {
+			return hr;
+		}
+		if (!AllocateRgbFrame(frame.width, frame.height, format, pFrame)) {
+			ReleaseFrame(&frame);
+			return E_OUTOFMEMORY;
+		}
+		GetColorSpace(&matrix, &range);
+		ConvertNV12ToRgb(&frame, matrix, range, format, pFrame->pData, pFrame->pitch);
+		pFrame->timestamp = frame.timestamp;
+		ReleaseFrame(&frame);
+		return S_OK;
+	}
+	// YCbCr encoding of the decoded frames, for ConvertNV12ToRgb. JPEG (JFIF)
+	// is BT.601 full range unless the backend negotiated something else.
+	virtual void GetColorSpace(YuvMatrix* pMatrix, YuvRange* pRange) const
+	{
+		*pMatrix = YUV_MATRIX_BT601;
+		*pRange = YUV_RANGE_FULL;
+	}
+};
+
+#endif
@@ -0,0 +1,794 @@
+#include "JpegDecoder.h"
+#include "JpegHuffman.h"
+#include "JpegIdct.h"
+#include "AlignedMemory.h"
+#include "ColorConvert.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+// Restart intervals are handed out in this many chunks per thread, so
+// uneven intervals still balance.
+#define RESTART_TASKS_PER_THREAD 4
+
+static void InitChromaMap(const JpegHeader* pHeader, const JpegComponent* pComp, ChromaMap* pMap)
+{
+	pMap->stride = pComp->h * 8;
+	pMap->direct = pComp->h * 2 == pHeader->hMax && pComp->v * 2 == pHeader->vMax;
+	for (uint32_t i = 0; i < pHeader->mcuWidth / 2; ++i) {
+		pMap->xs0[i] = (uint8_t)(2 * i * pComp->h / pHeader->hMax);
+		pMap->xs1[i] = (uint8_t)((2 * i + 1) * pComp->h / pHeader->hMax);
+	}
+	for (uint32_t j = 0; j < pHeader->mcuHeight / 2; ++j) {
+		pMap->ys0[j] = (uint8_t)(2 * j * pComp->v / pHeader->vMax);
+		pMap->ys1[j] = (uint8_t)((2 * j + 1) * pComp->v / pHeader->vMax);
+	}
+}
+
+static void WriteChromaMcu(const JpegHeader* pHeader, const ChromaMap* pMapCb, const ChromaMap* pMapCr,
+	const uint8_t* pCb, const uint8_t* pCr, uint8_t* pUV, uint32_t pitchUV)
+{
+	uint32_t w = pHeader->mcuWidth / 2;
+	uint32_t h = pHeader->mcuHeight / 2;
+
+	if (pMapCb->direct && pMapCr->direct) {
+		for (uint32_t j = 0; j < h; ++j) {
+			const uint8_t* cb = pCb + j * pMapCb->stride;
+			const uint8_t* cr = pCr + j * pMapCr->stride;
+			uint8_t* uv = pUV + (size_t)j * pitchUV;
+			for (uint32_t i = 0; i < w; ++i) {
+				uv[2 * i] = cb[i];
+				uv[2 * i + 1] = cr[i];
+			}
+		}
+		return;
+	}
+	for (uint32_t j = 0; j < h; ++j) {
+		const uint8_t* cb0 = pCb + pMapCb->ys0[j] * pMapCb->stride;
+		const uint8_t* cb1 = pCb + pMapCb->ys1[j] * pMapCb->stride;
+		const uint8_t* cr0 = pCr + pMapCr->ys0[j] * pMapCr->stride;
+		const uint8_t* cr1 = pCr + pMapCr->ys1[j] * pMapCr->stride;
+		uint8_t* uv = pUV + (size_t)j * pitchUV;
+		for (uint32_t i = 0; i < w; ++i) {
+			uint32_t a0 = pMapCb->xs0[i], a1 = pMapCb->xs1[i];
+			uint32_t b0 = pMapCr->xs0[i], b1 = pMapCr->xs1[i];
+			uv[2 * i] = (uint8_t)((cb0[a0] + cb0[a1] + cb1[a0] + cb1[a1] + 2) >> 2);
+			uv[2 * i + 1] = (uint8_t)((cr0[b0] + cr0[b1] + cr1[b0] + cr1[b1] + 2) >> 2);
+		}
+	}
+}
+
+// Decodes the Huffman coded coefficients of one block (JPEG Annex F.2.2).
+// pCoef must be zeroed; coefficients are stored in natural order. Most AC
+// coefficients are a short code plus a few magnitude bits, which fastAc
+// resolves with one lookup.
+static bool DecodeBlock(BitReader* br, const HuffmanTable* pDc, const HuffmanTable* pAc, int* pDcPred, int16_t* pCoef)
+{
+	int s = DecodeHuffman(br, pDc);
+	if (s < 0 || s > 11) {
+		return false;
+	}
+	if (s) {
+		*pDcPred += ReceiveExtend(br, s);
+	}
+	pCoef[0] = (int16_t)*pDcPred;
+
+	for (int k = 1; k < 64; ) {
+		if (br->bits < 16 + 11) {
+			FillBits(br);
+		}
+		int32_t f = pAc->fastAc[br->acc >> (64 - HUFF_LOOKAHEAD)];
+		if (f) {
+			k += (f >> 8) & 15;
+			br->acc <<= f & 0xFF;
+			br->bits -= f & 0xFF;
+			pCoef[g_jpegZigzag[k]] = (int16_t)(f >> 16);
+			k++;
+			continue;
+		}
+		int rs = DecodeHuffman(br, pAc);
+		if (rs < 0) {
+			return false;
+		}
+		int r = rs >> 4;
+		s = rs & 15;
+		if (s == 0) {
+			if (r != 15) {
+				break;	// EOB
+			}
+			k += 16;
+			continue;
+		}
+		k += r;
+		pCoef[g_jpegZigzag[k]] = (int16_t)ReceiveExtend(br, s);
+		k++;
+	}
+	return true;
+}
+
+// DecodeBlock for 1/8 scale decodes, which only use the DC coefficient: the
+// AC codes are walked to advance the reader but nothing is stored, like
+// libjpeg skipping the coefficients it doesn't need.
+static bool DecodeBlockDc(BitReader* br, const HuffmanTable* pDc, const HuffmanTable* pAc, int* pDcPred, int16_t* pCoef)
+{
+	int s = DecodeHuffman(br, pDc);
+	if (s < 0 || s > 11) {
+		return false;
+	}
+	if (s) {
+		*pDcPred += ReceiveExtend(br, s);
+	}
+	pCoef[0] = (int16_t)*pDcPred;
+
+	for (int k = 1; k < 64; ) {
+		if (br->bits < 16 + 11) {
+			FillBits(br);
+		}
+		int32_t f = pAc->fastAc[br->acc >> (64 - HUFF_LOOKAHEAD)];
+		if (f) {
+			k += ((f >> 8) & 15) + 1;
+			br->acc <<= f & 0xFF;
+			br->bits -= f & 0xFF;
+			continue;
+		}
+		int rs = DecodeHuffman(br, pAc);
+		if (rs < 0) {
+			return false;
+		}
+		int r = rs >> 4;
+		s = rs & 15;
+		if (s == 0) {
+			if (r != 15) {
+				break;	// EOB
+			}
+			k += 16;
+			continue;
+		}
+		GetBits(br, s);	// magnitude, not needed
+		k += r + 1;
+	}
+	return true;
+}
+
+// Table built from the frame's DHT segment, or the prebuilt Annex K table when
+// the frame has none (UVC MJPEG). Each table is built once per frame.
+static const HuffmanTable* SelectHuffmanTable(const JpegHuffmanSpec* pSpec, int tableClass, int id,
+	HuffmanTable* pTable, bool* pBuilt)
+{
+	if (!pSpec->defined) {
+		return GetDefaultHuffmanTable(tableClass, id);
+	}
+	if (!*pBuilt) {
+		if (!BuildHuffmanTable(pSpec, pTable)) {
+			return NULL;
+		}
+		*pBuilt = true;
+	}
+	return pTable;
+}
+
+HRESULT PrepareJpegScanTables(const JpegHeader* pHeader, JpegScanTables* pTables)
+{
+	bool dcBuilt[JPEG_MAX_TABLES] = { false };
+	bool acBuilt[JPEG_MAX_TABLES] = { false };
+
+	if (pHeader->components[0].h != pHeader->hMax || pHeader->components[0].v != pHeader->vMax) {
+		printf("JPEG luma sampling %dx%d not supported\n", pHeader->components[0].h, pHeader->components[0].v);
+		return E_NOTIMPL;
+	}
+	for (uint32_t c = 0; c < pHeader->numComponents; ++c) {
+		const JpegComponent* pComp = &pHeader->components[c];
+		pTables->pDc[c] = SelectHuffmanTable(&pHeader->dcSpec[pComp->td], 0, pComp->td,
+			&pTables->dcTables[pComp->td], &dcBuilt[pComp->td]);
+		pTables->pAc[c] = SelectHuffmanTable(&pHeader->acSpec[pComp->ta], 1, pComp->ta,
+			&pTables->acTables[pComp->ta], &acBuilt[pComp->ta]);
+		if (pTables->pDc[c] == NULL || pTables->pAc[c] == NULL) {
+			printf("JPEG missing or invalid Huffman table\n");
+			return E_FAIL;
+		}
+		if (!pHeader->quantDefined[pComp->tq]) {
+			printf("JPEG missing quantization table\n");
+			return E_FAIL;
+		}
+		if (c > 0) {
+			InitChromaMap(pHeader, pComp, &pTables->chromaMaps[c - 1]);
+		}
+	}
+	return S_OK;
+}
+
+void GetJpegFrameLayout(const JpegHeader* pHeader, uint32_t* pPitch, uint32_t* pAlignedHeight)
+{
+	*pPitch = (uint32_t)AlignUp(pHeader->mcusX * pHeader->mcuWidth, 32);
+	*pAlignedHeight = pHeader->mcusY * pHeader->mcuHeight;
+}
+
+void GetJpegFrameLayout(const JpegHeader* pHeader, const DecodeOptions& options, uint32_t* pWidth, uint32_t* pHeight,
+	uint32_t* pPitch, uint32_t* pAlignedHeight)
+{
+	GetDecodedSize(options, pHeader->width, pHeader->height, pWidth, pHeight);
+	if (HasDecodeCrop(options)) {
+		*pPitch = options.lumaOnly ? *pWidth : (uint32_t)AlignUp(*pWidth, 2);
+		*pAlignedHeight = *pHeight;
+		return;
+	}
+	*pPitch = (uint32_t)AlignUp((pHeader->mcusX * pHeader->mcuWidth) >> options.scale, 32);
+	*pAlignedHeight = (uint32_t)AlignUp((pHeader->mcusY * pHeader->mcuHeight) >> options.scale, 2);
+}
+
+HRESULT DecodeJpegScan(const JpegHeader* pHeader, NV12Frame* pFrame)
+{
+	JpegScanTables tables;
+	HRESULT hr = PrepareJpegScanTables(pHeader, &tables);
+	if (hr != S_OK) {
+		return hr;
+	}
+	return DecodeJpegScan(pHeader, &tables, pFrame);
+}
+
+// Where DecodeMcus writes: the whole frame, or a band that holds one MCU row
+// and is handed to pfnRowDone as soon as the row is complete.
+struct McuOutput
+{
+	NV12Frame* pFrame;
+	bool band;
+	void (*pfnRowDone)(void* pContext, uint32_t mcuRow);
+	void* pContext;
+	uint32_t scale;	// DecodeScale, blocks are 8 >> scale samples
+	uint8_t* pChroma[2];	// scaled: Cb and Cr at their own resolution, see ResampleChromaPlanes
+	uint32_t chromaPitch[2];
+	// MCUs written, mcuX0 / mcuY0 at the frame's origin. The others are only
+	// entropy decoded to get past them.
+	uint32_t mcuX0;
+	uint32_t mcuY0;
+	uint32_t mcusX;
+	uint32_t mcusY;
+	bool lumaOnly;	// chroma blocks only entropy decoded, pFrame has no UV plane
+};
+
+// Output of every MCU to pFrame.
+static void InitMcuOutput(const JpegHeader* pHeader, NV12Frame* pFrame, uint32_t scale, McuOutput* pOutput)
+{
+	memset(pOutput, 0, sizeof(*pOutput));
+	pOutput->pFrame = pFrame;
+	pOutput->scale = scale;
+	pOutput->mcusX = pHeader->mcusX;
+	pOutput->mcusY = pHeader->mcusY;
+}
+
+// Decodes mcuCount MCUs in raster order starting at firstMcu. With restarts,
+// an RSTn marker is expected every restartInterval MCUs counted from firstMcu.
+static HRESULT DecodeMcus(const JpegHeader* pHeader, const JpegScanTables* pTables, IdctDequantFunc idct,
+	BitReader* br, uint32_t firstMcu, uint32_t mcuCount, bool restarts, const McuOutput* pOutput)
+{
+	NV12Frame* pFrame = pOutput->pFrame;
+	const ChromaMap* chromaMaps = pTables->chromaMaps;
+	uint8_t chroma[2][JPEG_MAX_MCU_SIZE * JPEG_MAX_MCU_SIZE];
+	int16_t coef[64];
+	int dcPred[JPEG_MAX_COMPONENTS] = { 0 };
+	uint32_t numComponents = pHeader->numComponents;
+	uint32_t restartsLeft = pHeader->restartInterval;
+	uint32_t blockSize = 8 >> pOutput->scale;
+	uint32_t mcuWidth = pHeader->mcuWidth >> pOutput->scale;
+	uint32_t mcuHeight = pHeader->mcuHeight >> pOutput->scale;
+	bool dcOnly = pOutput->scale == DECODE_SCALE_1_8;
+
+	for (uint32_t mcu = firstMcu; mcu < firstMcu + mcuCount; ++mcu) {
+		uint32_t mx = mcu % pHeader->mcusX;
+		uint32_t my = mcu / pHeader->mcusX;
+		uint32_t outCol = mx - pOutput->mcuX0;
+		uint32_t outRow = pOutput->band ? 0 : my - pOutput->mcuY0;
+		bool skip = outCol >= pOutput->mcusX || my - pOutput->mcuY0 >= pOutput->mcusY;
+		if (restarts) {
+			if (restartsLeft == 0) {
+				if (!ProcessRestart(br)) {
+					printf("JPEG missing restart marker at MCU %u,%u\n", mx, my);
+					return E_FAIL;
+				}
+				memset(dcPred, 0, sizeof(dcPred));
+				restartsLeft = pHeader->restartInterval;
+			}
+			restartsLeft--;
+		}
+
+		for (uint32_t c = 0; c < numComponents; ++c) {
+			const JpegComponent* pComp = &pHeader->components[c];
+			bool skipBlocks = skip || (c > 0 && pOutput->lumaOnly);
+			for (uint32_t v = 0; v < pComp->v; ++v) {
+				for (uint32_t h = 0; h < pComp->h; ++h) {
+					uint8_t* pOut;
+					size_t outStride;
+					bool ok;
+					if (dcOnly || skipBlocks) {
+						ok = DecodeBlockDc(br, pTables->pDc[c], pTables->pAc[c], &dcPred[c], coef);
+					}
+					else {
+						memset(coef, 0, sizeof(coef));
+						ok = DecodeBlock(br, pTables->pDc[c], pTables->pAc[c], &dcPred[c], coef);
+					}
+					if (!ok) {
+						printf("JPEG corrupt data at MCU %u,%u\n", mx, my);
+						return E_FAIL;
+					}
+					if (skipBlocks) {
+						continue;
+					}
+					if (c == 0) {
+						outStride = pFrame->pitchY;
+						pOut = pFrame->pY + (size_t)(outRow * mcuHeight + v * blockSize) * outStride +
+							outCol * mcuWidth + h * blockSize;
+					}
+					else if (pOutput->pChroma[0]) {
+						outStride = pOutput->chromaPitch[c - 1];
+						pOut = pOutput->pChroma[c - 1] + (size_t)((outRow * pComp->v + v) * blockSize) * outStride +
+							(outCol * pComp->h + h) * blockSize;
+					}
+					else {
+						outStride = chromaMaps[c - 1].stride;
+						pOut = chroma[c - 1] + v * 8 * outStride + h * 8;
+					}
+					idct(coef, pHeader->quant[pComp->tq], pOut, outStride);
+				}
+			}
+		}
+
+		if (skip) {
+			continue;
+		}
+		if (numComponents == 3 && !pOutput->lumaOnly && pOutput->pChroma[0] == NULL) {
+			uint8_t* pUV = pFrame->pUV + (size_t)(outRow * pHeader->mcuHeight / 2) * pFrame->pitchUV + outCol * pHeader->mcuWidth;
+			WriteChromaMcu(pHeader, &chromaMaps[0], &chromaMaps[1], chroma[0], chroma[1], pUV, pFrame->pitchUV);
+		}
+		if (pOutput->pfnRowDone && mx == pHeader->mcusX - 1) {
+			pOutput->pfnRowDone(pOutput->pContext, my);
+		}
+	}
+	return S_OK;
+}
+
+// A scaled MCU can be a single sample wide or high, too small for a 4:2:0
+// chroma sample of its own, so scaled decodes write each chroma component at
+// its own resolution and resample the whole frame at the end.
+static bool AllocateChromaPlanes(const JpegHeader* pHeader, McuOutput* pOutput)
+{
+	uint32_t blockSize = 8 >> pOutput->scale;
+	for (uint32_t c = 0; c < 2; ++c) {
+		const JpegComponent* pComp = &pHeader->components[c + 1];
+		pOutput->chromaPitch[c] = pOutput->mcusX * pComp->h * blockSize;
+		pOutput->pChroma[c] = (uint8_t*)AlignedAlloc((size_t)pOutput->chromaPitch[c] * pOutput->mcusY * pComp->v * blockSize);
+		if (pOutput->pChroma[c] == NULL) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void FreeChromaPlanes(McuOutput* pOutput)
+{
+	for (uint32_t c = 0; c < 2; ++c) {
+		AlignedFree(pOutput->pChroma[c]);
+		pOutput->pChroma[c] = NULL;
+	}
+}
+
+// Same 2x2 averaging as ChromaMap, over the whole frame. Luma positions past
+// the last decoded row or column repeat it.
+static void ResampleChromaPlanes(const JpegHeader* pHeader, const McuOutput* pOutput, NV12Frame* pFrame)
+{
+	uint32_t lumaWidth = (pOutput->mcusX * pHeader->mcuWidth) >> pOutput->scale;
+	uint32_t lumaHeight = (pOutput->mcusY * pHeader->mcuHeight) >> pOutput->scale;
+	uint32_t width = (lumaWidth + 1) / 2;
+	const JpegComponent* pCb = &pHeader->components[1];
+	const JpegComponent* pCr = &pHeader->components[2];
+	std::vector<uint32_t> columns(4 * (size_t)width);
+
+	for (uint32_t i = 0; i < width; ++i) {
+		uint32_t x1 = 2 * i + 1 < lumaWidth ? 2 * i + 1 : lumaWidth - 1;
+		columns[4 * i] = 2 * i * pCb->h / pHeader->hMax;
+		columns[4 * i + 1] = x1 * pCb->h / pHeader->hMax;
+		columns[4 * i + 2] = 2 * i * pCr->h / pHeader->hMax;
+		columns[4 * i + 3] = x1 * pCr->h / pHeader->hMax;
+	}
+	for (uint32_t j = 0; j < pFrame->alignedHeight / 2; ++j) {
+		uint32_t y1 = 2 * j + 1 < lumaHeight ? 2 * j + 1 : lumaHeight - 1;
+		const uint8_t* cb0 = pOutput->pChroma[0] + (size_t)(2 * j * pCb->v / pHeader->vMax) * pOutput->chromaPitch[0];
+		const uint8_t* cb1 = pOutput->pChroma[0] + (size_t)(y1 * pCb->v / pHeader->vMax) * pOutput->chromaPitch[0];
+		const uint8_t* cr0 = pOutput->pChroma[1] + (size_t)(2 * j * pCr->v / pHeader->vMax) * pOutput->chromaPitch[1];
+		const uint8_t* cr1 = pOutput->pChroma[1] + (size_t)(y1 * pCr->v / pHeader->vMax) * pOutput->chromaPitch[1];
+		uint8_t* uv = pFrame->pUV + (size_t)j * pFrame->pitchUV;
+		for (uint32_t i = 0; i < width; ++i) {
+			const uint32_t* x = &columns[4 * i];
+			uv[2 * i] = (uint8_t)((cb0[x[0]] + cb0[x[1]] + cb1[x[0]] + cb1[x[1]] + 2) >> 2);
+			uv[2 * i + 1] = (uint8_t)((cr0[x[2]] + cr0[x[3]] + cr1[x[2]] + cr1[x[3]] + 2) >> 2);
+		}
+	}
+}
+
+// Fused decode to RGB: each MCU row is decoded into an NV12 band that stays
+// in cache and converted from there, so no full NV12 frame is ever written.
+struct RgbBand
+{
+	NV12Frame band;
+	RgbFrame* pFrame;
+	uint32_t mcuHeight;
+	NV12RowFunc convertRow;
+	YuvCoefficients coef;
+};
+
+static bool InitRgbBand(const JpegHeader* pHeader, RgbFrame* pFrame, RgbBand* pBand)
+{
+	uint32_t pitch, alignedHeight;
+	GetJpegFrameLayout(pHeader, &pitch, &alignedHeight);
+	if (!AllocateNV12Frame(pHeader->width, pHeader->mcuHeight, pitch, pHeader->mcuHeight, &pBand->band)) {
+		return false;
+	}
+	if (pHeader->numComponents == 1) {
+		memset(pBand->band.pUV, 128, (size_t)pitch * (pHeader->mcuHeight / 2));
+	}
+	pBand->pFrame = pFrame;
+	pBand->mcuHeight = pHeader->mcuHeight;
+	pBand->convertRow = SelectNV12RowKernel(pFrame->format);
+	// JFIF
+	GetYuvCoefficients(YUV_MATRIX_BT601, YUV_RANGE_FULL, &pBand->coef);
+	return true;
+}
+
+static void ConvertBandRow(void* pContext, uint32_t mcuRow)
+{
+	RgbBand* pBand = (RgbBand*)pContext;
+	RgbFrame* pFrame = pBand->pFrame;
+	uint32_t y0 = mcuRow * pBand->mcuHeight;
+	uint32_t rows = pFrame->height - y0 < pBand->mcuHeight ? pFrame->height - y0 : pBand->mcuHeight;
+	for (uint32_t y = 0; y < rows; ++y) {
+		pBand->convertRow(pBand->band.pY + (size_t)y * pBand->band.pitchY,
+			pBand->band.pUV + (size_t)(y / 2) * pBand->band.pitchUV,
+			pFrame->pData + (size_t)(y0 + y) * pFrame->pitch, pFrame->width, &pBand->coef);
+	}
+}
+
+// Finds where each restart interval's entropy coded data starts. Fails unless
+// there is exactly one interval per restartInterval MCUs and the RSTn markers
+// count 0..7 in order, in which case the frame is decoded sequentially.
+static bool FindRestartIntervals(const JpegHeader* pHeader, std::vector<uint32_t>* pOffsets)
+{
+	const uint8_t* p = pHeader->pScan;
+	size_t len = pHeader->scanLen;
+	uint32_t totalMcus = pHeader->mcusX * pHeader->mcusY;
+	uint32_t intervals = (totalMcus + pHeader->restartInterval - 1) / pHeader->restartInterval;
+	size_t pos = 0;
+
+	pOffsets->clear();
+	pOffsets->push_back(0);
+	while (pOffsets->size() < intervals) {
+		const uint8_t* ff = (const uint8_t*)memchr(p + pos, 0xFF, len - pos);
+		if (ff == NULL || ff + 1 >= p + len) {
+			return false;
+		}
+		pos = ff - p + 1;
+		uint8_t marker = p[pos];
+		if (marker == 0 || marker == 0xFF) {
+			continue;	// stuffed byte or fill
+		}
+		if (marker != JPEG_RST0 + ((pOffsets->size() - 1) & 7)) {
+			return false;
+		}
+		pos++;
+		pOffsets->push_back((uint32_t)pos);
+	}
+	return true;
+}
+
+struct RestartJob
+{
+	const JpegHeader* pHeader;
+	const JpegScanTables* pTables;
+	IdctDequantFunc idct;
+	McuOutput output;	// NV12 target, unused when decoding to pRgbFrame
+	RgbFrame* pRgbFrame;	// whole MCU rows per interval, each task has its own band
+	const uint32_t* pOffsets;
+	uint32_t intervals;
+	const uint32_t* pSelected;	// intervals to decode, NULL for all
+	uint32_t count;	// of them
+	uint32_t tasks;
+	std::atomic<HRESULT> hr;
+};
+
+// One task: a contiguous run of restart intervals, each with its own reader.
+static void DecodeRestartTask(void* pContext, uint32_t task)
+{
+	RestartJob* pJob = (RestartJob*)pContext;
+	const JpegHeader* pHeader = pJob->pHeader;
+	uint32_t totalMcus = pHeader->mcusX * pHeader->mcusY;
+	uint32_t first = (uint32_t)((uint64_t)task * pJob->count / pJob->tasks);
+	uint32_t last = (uint32_t)((uint64_t)(task + 1) * pJob->count / pJob->tasks);
+	McuOutput output = pJob->output;
+	RgbBand band;
+
+	if (pJob->pRgbFrame) {
+		if (!InitRgbBand(pHeader, pJob->pRgbFrame, &band)) {
+			pJob->hr = E_OUTOFMEMORY;
+			return;
+		}
+		InitMcuOutput(pHeader, &band.band, DECODE_SCALE_FULL, &output);
+		output.band = true;
+		output.pfnRowDone = ConvertBandRow;
+		output.pContext = &band;
+	}
+	for (uint32_t k = first; k < last; ++k) {
+		uint32_t i = pJob->pSelected ? pJob->pSelected[k] : k;
+		size_t start = pJob->pOffsets[i];
+		size_t end = i + 1 < pJob->intervals ? pJob->pOffsets[i + 1] - 2 : pHeader->scanLen;
+		uint32_t firstMcu = i * pHeader->restartInterval;
+		uint32_t mcuCount = totalMcus - firstMcu < pHeader->restartInterval ? totalMcus - firstMcu : pHeader->restartInterval;
+		BitReader br;
+		InitBitReader(&br, pHeader->pScan + start, end - start);
+		HRESULT hr = DecodeMcus(pHeader, pJob->pTables, pJob->idct, &br, firstMcu, mcuCount, false, &output);
+		if (hr != S_OK) {
+			pJob->hr = hr;
+			break;
+		}
+	}
+	if (pJob->pRgbFrame) {
+		ReleaseFrame(&band.band);
+	}
+}
+
+// Whether any MCU of the interval starting at firstMcu is in the output.
+static bool IntervalHasOutput(const JpegHeader* pHeader, const McuOutput* pOutput, uint32_t firstMcu, uint32_t mcuCount)
+{
+	uint32_t lastMcu = firstMcu + mcuCount - 1;
+	uint32_t rowFirst = firstMcu / pHeader->mcusX;
+	uint32_t rowLast = lastMcu / pHeader->mcusX;
+	uint32_t outFirst = pOutput->mcuY0 > rowFirst ? pOutput->mcuY0 : rowFirst;
+	uint32_t outLast = pOutput->mcuY0 + pOutput->mcusY - 1 < rowLast ? pOutput->mcuY0 + pOutput->mcusY - 1 : rowLast;
+	for (uint32_t row = outFirst; row <= outLast; ++row) {
+		uint32_t colFirst = row == rowFirst ? firstMcu % pHeader->mcusX : 0;
+		uint32_t colLast = row == rowLast ? lastMcu % pHeader->mcusX : pHeader->mcusX - 1;
+		if (colFirst < pOutput->mcuX0 + pOutput->mcusX && colLast >= pOutput->mcuX0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Decodes the restart intervals on pPool's threads, or on the calling thread
+// without a pool. With a crop only the intervals holding MCUs of it are read;
+// *pReadMcus gets the MCUs entropy decoded. Returns S_FALSE when the intervals
+// can't be located, so the caller decodes sequentially instead.
+static HRESULT DecodeRestartIntervals(const JpegHeader* pHeader, const JpegScanTables* pTables, IdctDequantFunc idct,
+	const McuOutput* pOutput, RgbFrame* pRgbFrame, WorkerPool* pPool, uint32_t* pReadMcus = NULL)
+{
+	uint32_t totalMcus = pHeader->mcusX * pHeader->mcusY;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> selected;
+	if (!FindRestartIntervals(pHeader, &offsets)) {
+		return S_FALSE;
+	}
+	RestartJob job;
+	job.pHeader = pHeader;
+	job.pTables = pTables;
+	job.idct = idct;
+	job.output = pOutput ? *pOutput : McuOutput();
+	job.pRgbFrame = pRgbFrame;
+	job.pOffsets = offsets.data();
+	job.intervals = (uint32_t)offsets.size();
+	job.pSelected = NULL;
+	job.count = job.intervals;
+	if (pReadMcus) {
+		*pReadMcus = totalMcus;
+	}
+	if (pOutput && (pOutput->mcusX < pHeader->mcusX || pOutput->mcusY < pHeader->mcusY)) {
+		uint32_t readMcus = 0;
+		for (uint32_t i = 0; i < job.intervals; ++i) {
+			uint32_t firstMcu = i * pHeader->restartInterval;
+			uint32_t mcuCount = totalMcus - firstMcu < pHeader->restartInterval ? totalMcus - firstMcu : pHeader->restartInterval;
+			if (IntervalHasOutput(pHeader, pOutput, firstMcu, mcuCount)) {
+				selected.push_back(i);
+				readMcus += mcuCount;
+			}
+		}
+		job.pSelected = selected.data();
+		job.count = (uint32_t)selected.size();
+		if (pReadMcus) {
+			*pReadMcus = readMcus;
+		}
+	}
+	job.tasks = pPool && pPool->Threads() > 1 ? pPool->Threads() * RESTART_TASKS_PER_THREAD : 1;
+	if (job.tasks > job.count) {
+		job.tasks = job.count;
+	}
+	job.hr = S_OK;
+	if (job.tasks > 1) {
+		pPool->Run(job.tasks, DecodeRestartTask, &job);
+	}
+	else if (job.tasks == 1) {
+		DecodeRestartTask(&job, 0);
+	}
+	return job.hr;
+}
+
+// Copies rect of the decoded region, which starts at pixel (x0, y0) of the
+// frame, into the packed crop frame.
+static void CopyCropRect(const NV12Frame* pRegion, uint32_t x0, uint32_t y0, const DecodeRect& rect, NV12Frame* pFrame)
+{
+	uint32_t dx = rect.x - x0;
+	uint32_t dy = rect.y - y0;
+	for (uint32_t y = 0; y < rect.height; ++y) {
+		memcpy(pFrame->pY + (size_t)y * pFrame->pitchY, pRegion->pY + (size_t)(dy + y) * pRegion->pitchY + dx, rect.width);
+	}
+	if (pFrame->pUV == NULL) {
+		return;
+	}
+	for (uint32_t y = 0; y < (rect.height + 1) / 2; ++y) {
+		memcpy(pFrame->pUV + (size_t)y * pFrame->pitchUV, pRegion->pUV + (size_t)(dy / 2 + y) * pRegion->pitchUV + dx,
+			(rect.width + 1) & ~1u);
+	}
+}
+
+HRESULT DecodeJpegScan(const JpegHeader* pHeader, const JpegScanTables* pTables, NV12Frame* pFrame, WorkerPool* pPool,
+	const DecodeOptions* pOptions, DecodeFrameStats* pStats)
+{
+	DecodeOptions options;
+	if (pOptions) {
+		options = *pOptions;
+	}
+	else {
+		GetDefaultDecodeOptions(&options);
+	}
+	uint32_t scale = options.scale;
+	bool crop = HasDecodeCrop(options);
+	IdctDequantFunc idct = SelectIdctDequantScaled(scale);
+	uint32_t totalMcus = pHeader->mcusX * pHeader->mcusY;
+	uint32_t mcuWidth = pHeader->mcuWidth >> scale;
+	uint32_t mcuHeight = pHeader->mcuHeight >> scale;
+	uint32_t endMcu = totalMcus;	// one past the last MCU needed
+	uint32_t readMcus = totalMcus;
+	NV12Frame region;
+	NV12Frame* pTarget = pFrame;
+	DecodeRect rect = { 0, 0, 0, 0 };
+	McuOutput output;
+	HRESULT hr = S_FALSE;
+	BitReader br;
+
+	InitMcuOutput(pHeader, pFrame, scale, &output);
+	output.lumaOnly = options.lumaOnly;
+	if (crop) {
+		// The MCUs under the crop decode into an MCU aligned region that is
+		// copied out packed at the end. Decoding stops after its last MCU.
+		GetDecodedRect(options, pHeader->width, pHeader->height, &rect);
+		if (rect.width == 0 || rect.height == 0) {
+			return E_INVALIDARG;
+		}
+		output.mcuX0 = rect.x / mcuWidth;
+		output.mcuY0 = rect.y / mcuHeight;
+		output.mcusX = (rect.x + rect.width - 1) / mcuWidth - output.mcuX0 + 1;
+		output.mcusY = (rect.y + rect.height - 1) / mcuHeight - output.mcuY0 + 1;
+		uint32_t regionWidth = output.mcusX * mcuWidth;
+		uint32_t regionHeight = output.mcusY * mcuHeight;
+		uint32_t regionPitch = (uint32_t)AlignUp(regionWidth, 32);
+		bool allocated = options.lumaOnly ?
+			AllocateLumaFrame(regionWidth, regionHeight, regionPitch, regionHeight, &region) :
+			AllocateNV12Frame(regionWidth, regionHeight, regionPitch, (uint32_t)AlignUp(regionHeight, 2), &region);
+		if (!allocated) {
+			return E_OUTOFMEMORY;
+		}
+		pTarget = &region;
+		output.pFrame = &region;
+		endMcu = (output.mcuY0 + output.mcusY - 1) * pHeader->mcusX + output.mcuX0 + output.mcusX;
+	}
+
+	// Luma only decodes have no UV plane, chroma blocks are only entropy decoded.
+	if (!options.lumaOnly) {
+		if (pHeader->numComponents == 1) {
+			// Grayscale: neutral chroma.
+			memset(pTarget->pUV, 128, (size_t)pTarget->pitchUV * (pTarget->alignedHeight / 2));
+		}
+		else if (scale != DECODE_SCALE_FULL && !AllocateChromaPlanes(pHeader, &output)) {
+			hr = E_OUTOFMEMORY;
+		}
+	}
+
+	// Restart intervals reset the DC predictors and start on a byte boundary,
+	// so they decode independently into disjoint MCUs of the frame, and a crop
+	// can skip the intervals outside it without reading them.
+	if (hr == S_FALSE && pHeader->restartInterval && pHeader->restartInterval < totalMcus &&
+		((pPool && pPool->Threads() > 1) || crop)) {
+		hr = DecodeRestartIntervals(pHeader, pTables, idct, &output, NULL, pPool, &readMcus);
+	}
+	if (hr == S_FALSE) {
+		readMcus = endMcu;
+		InitBitReader(&br, pHeader->pScan, pHeader->scanLen);
+		hr = DecodeMcus(pHeader, pTables, idct, &br, 0, endMcu, pHeader->restartInterval != 0, &output);
+	}
+	if (hr == S_OK && output.pChroma[0]) {
+		ResampleChromaPlanes(pHeader, &output, pTarget);
+	}
+	FreeChromaPlanes(&output);
+	if (crop) {
+		if (hr == S_OK) {
+			CopyCropRect(&region, output.mcuX0 * mcuWidth, output.mcuY0 * mcuHeight, rect, pFrame);
+		}
+		ReleaseFrame(&region);
+	}
+	if (pStats) {
+		pStats->mcus = totalMcus;
+		pStats->skippedMcus = totalMcus - output.mcusX * output.mcusY;
+		pStats->unreadMcus = totalMcus - readMcus;
+	}
+	return hr;
+}
+
+HRESULT DecodeJpegScanRgb(const JpegHeader* pHeader, const JpegScanTables* pTables, RgbFrame* pFrame, WorkerPool* pPool)
+{
+	IdctDequantFunc idct = SelectIdctDequant();
+	uint32_t totalMcus = pHeader->mcusX * pHeader->mcusY;
+	BitReader br;
+	RgbBand band;
+
+	// Threads need intervals of whole MCU rows, each converts its own rows.
+	if (pPool && pPool->Threads() > 1 && pHeader->restartInterval && pHeader->restartInterval < totalMcus &&
+		pHeader->restartInterval % pHeader->mcusX == 0) {
+		HRESULT hr = DecodeRestartIntervals(pHeader, pTables, idct, NULL, pFrame, pPool);
+		if (hr != S_FALSE) {
+			return hr;
+		}
+	}
+
+	if (!InitRgbBand(pHeader, pFrame, &band)) {
+		return E_OUTOFMEMORY;
+	}
+	McuOutput output;
+	InitMcuOutput(pHeader, &band.band, DECODE_SCALE_FULL, &output);
+	output.band = true;
+	output.pfnRowDone = ConvertBandRow;
+	output.pContext = &band;
+	InitBitReader(&br, pHeader->pScan, pHeader->scanLen);
+	HRESULT hr = DecodeMcus(pHeader, pTables, idct, &br, 0, totalMcus, pHeader->restartInterval != 0, &output);
+	ReleaseFrame(&band.band);
+	return hr;
+}
+
+HRESULT DecodeJpegCoefficients(const JpegHeader* pHeader, uint64_t* pChecksum)
+{
+	JpegScanTables tables;
+	int16_t coef[64];
+	int dcPred[JPEG_MAX_COMPONENTS] = { 0 };
+	uint32_t restartsLeft = pHeader->restartInterval;
+	uint64_t sum = 0;
+	BitReader br;
+
+	HRESULT hr = PrepareJpegScanTables(pHeader, &tables);
+	if (hr != S_OK) {
+		return hr;
+	}
+
+	InitBitReader(&br, pHeader->pScan, pHeader->scanLen);
+	for (uint32_t mcu = 0; mcu < pHeader->mcusX * pHeader->mcusY; ++mcu) {
+		if (pHeader->restartInterval) {
+			if (restartsLeft == 0) {
+				if (!ProcessRestart(&br)) {
+					return E_FAIL;
+				}
+				memset(dcPred, 0, sizeof(dcPred));
+				restartsLeft = pHeader->restartInterval;
+			}
+			restartsLeft--;
+		}
+		for (uint32_t c = 0; c < pHeader->numComponents; ++c) {
+			const JpegComponent* pComp = &pHeader->components[c];
+			for (uint32_t b = 0; b < pComp->h * pComp->v; ++b) {
+				memset(coef, 0, sizeof(coef));
+				if (!DecodeBlock(&br, tables.pDc[c], tables.pAc[c], &dcPred[c], coef)) {
+					return E_FAIL;
+				}
+				for (int i = 0; i < 64; ++i) {
+					sum += (uint16_t)coef[i];
+				}
+			}
+		}
+	}
+	*pChecksum = sum;
+	return S_OK;
+}
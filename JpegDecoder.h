@@ -0,0 +1,79 @@
+#ifndef __JPEGDECODER_H__
+#define __JPEGDECODER_H__
+
+#include <stdint.h>
+
+#include "PortableDefs.h"
+#include "JpegParser.h"
+#include "NV12Frame.h"
+#include "ColorConvert.h"
+#include "DecodeOptions.h"
+#include "JpegHuffman.h"
+#include "WorkerPool.h"
+
+#define JPEG_MAX_MCU_SIZE (4 * 8)
+
+// Maps the MCU's 4:2:0 chroma samples to the chroma component's samples.
+// Each output sample averages the component samples under its 2x2 luma
+// pixels: (xs0|xs1, ys0|ys1). Duplicates make this exact for 4:2:2 and 4:2:0.
+struct ChromaMap
+{
+	uint32_t stride;	// bytes per row of the component's MCU buffer
+	uint8_t xs0[JPEG_MAX_MCU_SIZE / 2];
+	uint8_t xs1[JPEG_MAX_MCU_SIZE / 2];
+	uint8_t ys0[JPEG_MAX_MCU_SIZE / 2];
+	uint8_t ys1[JPEG_MAX_MCU_SIZE / 2];
+	bool direct;	// component is already 4:2:0
+};
+
+// Everything derived from a header that the scan decoder needs: Huffman
+// decode tables per component and the chroma layout. Frames of a stream
+// share it (JpegHeaderCache). Holds pointers into itself, so don't copy it.
+struct JpegScanTables
+{
+	HuffmanTable dcTables[JPEG_MAX_TABLES];
+	HuffmanTable acTables[JPEG_MAX_TABLES];
+	const HuffmanTable* pDc[JPEG_MAX_COMPONENTS];	// per component, dcTables or a default table
+	const HuffmanTable* pAc[JPEG_MAX_COMPONENTS];
+	ChromaMap chromaMaps[2];
+};
+
+// NV12 layout the decoder writes: whole MCUs, so the pitch and the aligned
+// height are rounded up to the MCU size like the hardware decoder's output.
+void GetJpegFrameLayout(const JpegHeader* pHeader, uint32_t* pPitch, uint32_t* pAlignedHeight);
+
+// Layout of a decode with 'options': the frame size, the scaled MCUs rounded up
+// like above and an even aligned height for the chroma rows. Crops are packed.
+// Luma only frames have the same Y plane and are allocated with AllocateLumaFrame.
+void GetJpegFrameLayout(const JpegHeader* pHeader, const DecodeOptions& options, uint32_t* pWidth, uint32_t* pHeight,
+	uint32_t* pPitch, uint32_t* pAlignedHeight);
+
+// Builds the decode tables for a parsed header.
+HRESULT PrepareJpegScanTables(const JpegHeader* pHeader, JpegScanTables* pTables);
+
+// Decodes the scan of a parsed frame into pFrame, which must have the layout
+// from GetJpegFrameLayout() for pOptions. Chroma is resampled to 4:2:0 per
+// MCU. Frames with restart markers are split across pPool's threads when a
+// pool is given; others decode on the calling thread. Scaled decodes use the
+// reduced IDCTs (SelectIdctDequantScaled) and resample chroma per frame. A
+// crop transforms only the MCUs under it, stops reading after the last one and
+// jumps over restart intervals outside it; pStats gets the MCU counts. Luma
+// only decodes skip the chroma IDCT and output, pFrame has no UV plane.
+HRESULT DecodeJpegScan(const JpegHeader* pHeader, const JpegScanTables* pTables, NV12Frame* pFrame,
+	WorkerPool* pPool = NULL, const DecodeOptions* pOptions = NULL, DecodeFrameStats* pStats = NULL);
+
+// Decodes straight to pFrame (width x height of the header, BGRA or RGB24).
+// Every MCU row goes through a small NV12 band that is converted while it is
+// still in cache, so the full NV12 frame is never written or read back.
+// Restart intervals run on pPool's threads when they hold whole MCU rows.
+HRESULT DecodeJpegScanRgb(const JpegHeader* pHeader, const JpegScanTables* pTables, RgbFrame* pFrame,
+	WorkerPool* pPool = NULL);
+
+// Same as DecodeJpegScan, building the tables first.
+HRESULT DecodeJpegScan(const JpegHeader* pHeader, NV12Frame* pFrame);
+
+// Entropy decodes the scan without the IDCT, for measuring the Huffman
+// decoder alone. pChecksum receives the sum of all coefficients.
+HRESULT DecodeJpegCoefficients(const JpegHeader* pHeader, uint64_t* pChecksum);
+
+#endif
@@ -0,0 +1,131 @@
+#include "JpegHeaderCache.h"
+
+#include <string.h>
+
+// Appends the segments that determine how the scan is decoded to pKey and
+// returns the offset of the entropy coded data, 0 if the markers are broken.
+static size_t CollectHeaderKey(const uint8_t* pData, size_t len, std::vector<uint8_t>* pKey)
+{
+	size_t pos = 2;
+	if (len < 4 || pData[0] != 0xFF || pData[1] != JPEG_SOI) {
+		return 0;
+	}
+	while (pos + 4 <= len && pData[pos] == 0xFF) {
+		uint8_t marker = pData[pos + 1];
+		if (marker == 0xFF) {
+			pos++;
+			continue;
+		}
+		size_t segLen = ((size_t)pData[pos + 2] << 8) | pData[pos + 3];
+		if (segLen < 2 || pos + 2 + segLen > len) {
+			return 0;
+		}
+		switch (marker)
+		{
+		case JPEG_SOS:
+			pKey->insert(pKey->end(), pData + pos, pData + pos + 2 + segLen);
+			return pos + 2 + segLen;
+		case JPEG_SOF0:
+		case JPEG_SOF1:
+		case JPEG_DHT:
+		case JPEG_DQT:
+		case JPEG_DRI:
+			pKey->insert(pKey->end(), pData + pos, pData + pos + 2 + segLen);
+			break;
+		default:
+			if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC8 && marker != 0xCC) {
+				pKey->insert(pKey->end(), pData + pos, pData + pos + 2 + segLen);	// let the parser reject it
+			}
+			break;
+		}
+		pos += 2 + segLen;
+	}
+	return 0;
+}
+
+// FNV-1a
+static uint64_t HashBytes(const uint8_t* p, size_t len)
+{
+	uint64_t h = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < len; ++i) {
+		h = (h ^ p[i]) * 0x100000001B3ull;
+	}
+	return h;
+}
+
+JpegHeaderCache::JpegHeaderCache(uint32_t capacity)
+{
+	m_capacity = capacity ? capacity : 1;
+	m_useCount = 0;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+JpegHeaderCache::~JpegHeaderCache()
+{
+	Clear();
+}
+
+void JpegHeaderCache::Clear()
+{
+	for (size_t i = 0; i < m_entries.size(); ++i) {
+		delete m_entries[i];
+	}
+	m_entries.clear();
+}
+
+HRESULT JpegHeaderCache::Lookup(const uint8_t* pData, size_t len, JpegHeader* pHeader, const JpegScanTables** ppTables)
+{
+	HRESULT hr;
+	m_key.clear();
+	size_t scanOffset = CollectHeaderKey(pData, len, &m_key);
+	if (scanOffset == 0) {
+		hr = ParseJpegHeader(pData, len, pHeader);	// reports what is wrong
+		return FAILED(hr) ? hr : E_FAIL;
+	}
+	uint64_t hash = HashBytes(m_key.data(), m_key.size());
+
+	for (size_t i = 0; i < m_entries.size(); ++i) {
+		Entry* pEntry = m_entries[i];
+		if (pEntry->hash == hash && pEntry->key == m_key) {
+			m_hits++;
+			pEntry->lastUse = ++m_useCount;
+			memcpy(pHeader, &pEntry->header, sizeof(*pHeader));
+			pHeader->pScan = pData + scanOffset;
+			pHeader->scanLen = len - scanOffset;
+			*ppTables = &pEntry->tables;
+			return S_OK;
+		}
+	}
+
+	m_misses++;
+	Entry* pEntry = new Entry;
+	hr = ParseJpegHeader(pData, len, &pEntry->header);
+	if (hr == S_OK) {
+		hr = PrepareJpegScanTables(&pEntry->header, &pEntry->tables);
+	}
+	if (hr != S_OK) {
+		delete pEntry;
+		return hr;
+	}
+	pEntry->hash = hash;
+	pEntry->key = m_key;
+	pEntry->lastUse = ++m_useCount;
+
+	// Evict the least recently used format.
+	if (m_entries.size() >= m_capacity) {
+		size_t oldest = 0;
+		for (size_t i = 1; i < m_entries.size(); ++i) {
+			if (m_entries[i]->lastUse < m_entries[oldest]->lastUse) {
+				oldest = i;
+			}
+		}
+		delete m_entries[oldest];
+		m_entries.erase(m_entries.begin() + oldest);
+	}
+	m_entries.push_back(pEntry);
+
+	memcpy(pHeader, &pEntry->header, sizeof(*pHeader));
+	*ppTables = &pEntry->tables;
+	return S_OK;
+}
@@ -0,0 +1,48 @@
+#ifndef __JPEGHEADERCACHE_H__
+#define __JPEGHEADERCACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "PortableDefs.h"
+#include "JpegParser.h"
+#include "JpegDecoder.h"
+
+// Frames from one camera repeat the same DQT / DHT / SOF / DRI / SOS bytes.
+// The cache keys the parsed header and its decode tables by a hash of those
+// segments, so a hit only walks the markers. Not thread safe: use one per
+// stream (decoder).
+class JpegHeaderCache
+{
+public:
+	JpegHeaderCache(uint32_t capacity = 4);
+	~JpegHeaderCache();
+
+	// Fills *pHeader for the frame (pScan / scanLen point into pData) and
+	// returns the shared tables, valid until the next Lookup or Clear.
+	HRESULT Lookup(const uint8_t* pData, size_t len, JpegHeader* pHeader, const JpegScanTables** ppTables);
+	void Clear();
+
+	uint64_t Hits() const { return m_hits; }
+	uint64_t Misses() const { return m_misses; }
+
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		std::vector<uint8_t> key;	// the hashed segments, compared on a hash match
+		uint64_t lastUse;
+		JpegHeader header;
+		JpegScanTables tables;
+	};
+
+	uint32_t m_capacity;
+	std::vector<Entry*> m_entries;
+	std::vector<uint8_t> m_key;
+	uint64_t m_useCount;
+	uint64_t m_hits;
+	uint64_t m_misses;
+};
+
+#endif
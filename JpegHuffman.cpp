@@ -0,0 +1,190 @@
+#include "JpegHuffman.h"
+
+#include <string.h>
+
+// Builds the decode tables from the DHT counts (1..16) and symbols. constexpr
+// so the Annex K tables below are built by the compiler.
+static constexpr bool FillHuffmanTable(const uint8_t* pCounts, const uint8_t* pSymbols, HuffmanTable* pTable)
+{
+	int32_t code = 0;
+	int32_t k = 0;
+
+	for (int l = 1; l <= 16; ++l) {
+		int32_t count = pCounts[l];
+		pTable->valoffset[l] = k - code;
+		code += count;
+		k += count;
+		pTable->maxcode[l] = count ? code - 1 : -1;
+		if (code > (1 << l)) {
+			return false;	// more codes than fit in l bits
+		}
+		code <<= 1;
+	}
+	pTable->maxcode[17] = 0x7FFFFFFF;
+	for (int i = 0; i < k; ++i) {
+		pTable->values[i] = pSymbols[i];
+	}
+
+	// Every HUFF_LOOKAHEAD bit pattern that starts with a short code maps to it.
+	for (int i = 0; i < (1 << HUFF_LOOKAHEAD); ++i) {
+		pTable->lookup[i] = 0;
+		pTable->fastAc[i] = 0;
+	}
+	code = 0;
+	k = 0;
+	for (int l = 1; l <= HUFF_LOOKAHEAD; ++l) {
+		for (int32_t i = 0; i < pCounts[l]; ++i, ++code, ++k) {
+			int rs = pSymbols[k];
+			int r = rs >> 4;
+			int s = rs & 15;
+			int32_t first = code << (HUFF_LOOKAHEAD - l);
+			int32_t fill = 1 << (HUFF_LOOKAHEAD - l);
+			for (int32_t j = 0; j < fill; ++j) {
+				pTable->lookup[first + j] = (uint16_t)((l << 8) | rs);
+				if (s != 0 && l + s <= HUFF_LOOKAHEAD) {
+					int v = Extend((j >> (HUFF_LOOKAHEAD - l - s)) & ((1 << s) - 1), s);
+					pTable->fastAc[first + j] = (int32_t)((uint32_t)v << 16) | (r << 8) | (l + s);
+				}
+			}
+		}
+		code <<= 1;
+	}
+	return true;
+}
+
+bool BuildHuffmanTable(const JpegHuffmanSpec* pSpec, HuffmanTable* pTable)
+{
+	if (!pSpec->defined) {
+		return false;
+	}
+	return FillHuffmanTable(pSpec->counts, pSpec->symbols, pTable);
+}
+
+// JPEG Annex K.3 tables, which UVC cameras use without sending them.
+// Counts are indexed by code length like JpegHuffmanSpec::counts.
+static constexpr uint8_t s_dcLumaCounts[17] = { 0, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static constexpr uint8_t s_dcChromaCounts[17] = { 0, 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static constexpr uint8_t s_dcSymbols[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static constexpr uint8_t s_acLumaCounts[17] = { 0, 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static constexpr uint8_t s_acLumaSymbols[162] =
+{
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+	0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+	0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+	0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA,
+};
+
+static constexpr uint8_t s_acChromaCounts[17] = { 0, 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static constexpr uint8_t s_acChromaSymbols[162] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+	0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+	0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+	0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+	0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+	0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA,
+};
+
+static constexpr HuffmanTable MakeHuffmanTable(const uint8_t* pCounts, const uint8_t* pSymbols)
+{
+	HuffmanTable table = {};
+	FillHuffmanTable(pCounts, pSymbols, &table);
+	return table;
+}
+
+// Indexed by [class][id]: DC luma, DC chroma, AC luma, AC chroma.
+static constexpr HuffmanTable s_defaultTables[2][2] =
+{
+	{ MakeHuffmanTable(s_dcLumaCounts, s_dcSymbols), MakeHuffmanTable(s_dcChromaCounts, s_dcSymbols) },
+	{ MakeHuffmanTable(s_acLumaCounts, s_acLumaSymbols), MakeHuffmanTable(s_acChromaCounts, s_acChromaSymbols) },
+};
+
+const HuffmanTable* GetDefaultHuffmanTable(int tableClass, int id)
+{
+	if (tableClass < 0 || tableClass > 1 || id < 0 || id > 1) {
+		return NULL;
+	}
+	return &s_defaultTables[tableClass][id];
+}
+
+// The same tables as a complete DHT segment, for decoders that need them in the bitstream.
+struct DefaultDHTSegment
+{
+	uint8_t bytes[JPEG_DEFAULT_DHT_SIZE];
+};
+
+static constexpr size_t AppendDHTTable(uint8_t* pOut, size_t pos, uint8_t classAndId, const uint8_t* pCounts,
+	const uint8_t* pSymbols)
+{
+	size_t total = 0;
+	pOut[pos++] = classAndId;
+	for (int l = 1; l <= 16; ++l) {
+		pOut[pos++] = pCounts[l];
+		total += pCounts[l];
+	}
+	for (size_t i = 0; i < total; ++i) {
+		pOut[pos++] = pSymbols[i];
+	}
+	return pos;
+}
+
+static constexpr DefaultDHTSegment MakeDefaultDHTSegment()
+{
+	DefaultDHTSegment seg = {};
+	size_t pos = 0;
+	seg.bytes[pos++] = 0xFF;
+	seg.bytes[pos++] = JPEG_DHT;
+	seg.bytes[pos++] = (uint8_t)((JPEG_DEFAULT_DHT_SIZE - 2) >> 8);
+	seg.bytes[pos++] = (uint8_t)((JPEG_DEFAULT_DHT_SIZE - 2) & 0xFF);
+	pos = AppendDHTTable(seg.bytes, pos, 0x00, s_dcLumaCounts, s_dcSymbols);
+	pos = AppendDHTTable(seg.bytes, pos, 0x10, s_acLumaCounts, s_acLumaSymbols);
+	pos = AppendDHTTable(seg.bytes, pos, 0x01, s_dcChromaCounts, s_dcSymbols);
+	pos = AppendDHTTable(seg.bytes, pos, 0x11, s_acChromaCounts, s_acChromaSymbols);
+	return seg;
+}
+
+static constexpr DefaultDHTSegment s_defaultDHT = MakeDefaultDHTSegment();
+
+size_t InsertDefaultHuffmanTables(const uint8_t* pSrc, size_t len, uint8_t* pDst)
+{
+	// Right after SOI; tables only have to precede the SOS that uses them.
+	memcpy(pDst, pSrc, 2);
+	memcpy(pDst + 2, s_defaultDHT.bytes, JPEG_DEFAULT_DHT_SIZE);
+	memcpy(pDst + 2 + JPEG_DEFAULT_DHT_SIZE, pSrc + 2, len - 2);
+	return len + JPEG_DEFAULT_DHT_SIZE;
+}
+
+bool ProcessRestart(BitReader* br)
+{
+	// The rest of the current byte is padding.
+	br->acc = 0;
+	br->bits = 0;
+	if (br->marker == 0) {
+		while (br->p + 1 < br->end && !(br->p[0] == 0xFF && br->p[1] != 0 && br->p[1] != 0xFF)) {
+			br->p++;
+		}
+		if (br->p + 1 >= br->end) {
+			return false;
+		}
+		br->marker = br->p[1];
+	}
+	if (br->marker < JPEG_RST0 || br->marker > JPEG_RST7) {
+		return false;
+	}
+	br->p += 2;
+	br->marker = 0;
+	return true;
+}
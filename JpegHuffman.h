@@ -0,0 +1,160 @@
+#ifndef __JPEGHUFFMAN_H__
+#define __JPEGHUFFMAN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "JpegParser.h"
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#define JPEG_BSWAP64(x) _byteswap_uint64(x)
+#else
+#define JPEG_BSWAP64(x) __builtin_bswap64(x)
+#endif
+
+// Codes up to this many bits are resolved with a single table lookup.
+#define HUFF_LOOKAHEAD 9
+
+// Canonical Huffman decode table (JPEG Annex F.2.2.3) with lookahead tables.
+struct HuffmanTable
+{
+	int32_t maxcode[18];	// largest code of length l, -1 if there is none
+	int32_t valoffset[17];	// index into values of a code of length l, minus the first such code
+	uint8_t values[256];
+	// Indexed by the next HUFF_LOOKAHEAD bits: (code length << 8) | symbol,
+	// 0 if the code is longer.
+	uint16_t lookup[1 << HUFF_LOOKAHEAD];
+	// Indexed the same way, for AC tables: a code and its magnitude bits that
+	// fit together, as (value << 16) | (run << 8) | total length. 0 otherwise.
+	int32_t fastAc[1 << HUFF_LOOKAHEAD];
+};
+
+bool BuildHuffmanTable(const JpegHuffmanSpec* pSpec, HuffmanTable* pTable);
+
+// Prebuilt decode table for the JPEG Annex K tables (class 0 = DC, 1 = AC;
+// id 0 = luma, 1 = chroma), used when a frame has no DHT segment. NULL for
+// other ids.
+const HuffmanTable* GetDefaultHuffmanTable(int tableClass, int id);
+
+// Size of a DHT segment holding the four Annex K tables, marker included.
+#define JPEG_DEFAULT_DHT_SIZE 420
+
+// Copies a JPEG frame that has no DHT segment to pDst with the Annex K tables
+// inserted after SOI. pDst needs len + JPEG_DEFAULT_DHT_SIZE bytes; returns the new length.
+size_t InsertDefaultHuffmanTables(const uint8_t* pSrc, size_t len, uint8_t* pDst);
+
+// Reads entropy coded data MSB first, dropping the 0x00 stuffed after 0xFF.
+// A marker stops the reader; from then on zero bits are returned.
+struct BitReader
+{
+	const uint8_t* p;
+	const uint8_t* end;
+	uint64_t acc;	// next bits, MSB aligned
+	int bits;	// number of valid bits in acc
+	uint8_t marker;	// marker found in the data, 0 if none yet
+};
+
+inline void InitBitReader(BitReader* br, const uint8_t* p, size_t len)
+{
+	br->p = p;
+	br->end = p + len;
+	br->acc = 0;
+	br->bits = 0;
+	br->marker = 0;
+}
+
+// Tops the reservoir up to more than 56 bits.
+inline void FillBits(BitReader* br)
+{
+	if (br->bits > 56) {
+		return;
+	}
+	// Fast path: the next 8 bytes hold no 0xFF, so whole bytes go in without
+	// unstuffing. The load assumes a little endian host.
+	if (br->marker == 0 && br->p + 8 <= br->end) {
+		uint64_t x;
+		memcpy(&x, br->p, 8);
+		x = JPEG_BSWAP64(x);
+		if (((~x - 0x0101010101010101ull) & x & 0x8080808080808080ull) == 0) {
+			int n = (64 - br->bits) >> 3;
+			br->acc |= (x >> (64 - 8 * n)) << (64 - 8 * n - br->bits);
+			br->p += n;
+			br->bits += 8 * n;
+			return;
+		}
+	}
+	while (br->bits <= 56) {
+		uint64_t b = 0;
+		if (br->marker == 0 && br->p < br->end) {
+			b = *br->p;
+			if (b == 0xFF) {
+				uint8_t next = br->p + 1 < br->end ? br->p[1] : JPEG_EOI;
+				if (next == 0) {
+					br->p += 2;
+				}
+				else {
+					br->marker = next;	// leave p on the marker
+					b = 0;
+				}
+			}
+			else {
+				br->p++;
+			}
+		}
+		br->acc |= b << (56 - br->bits);
+		br->bits += 8;
+	}
+}
+
+inline uint32_t GetBits(BitReader* br, int n)
+{
+	if (br->bits < n) {
+		FillBits(br);
+	}
+	uint32_t v = (uint32_t)(br->acc >> (64 - n));
+	br->acc <<= n;
+	br->bits -= n;
+	return v;
+}
+
+// Sign extends s magnitude bits (JPEG Annex F.2.2.1).
+constexpr int Extend(int v, int s)
+{
+	return v < (1 << (s - 1)) ? v - ((1 << s) - 1) : v;
+}
+
+// Reads s extra bits and sign extends them.
+inline int ReceiveExtend(BitReader* br, int s)
+{
+	return Extend((int)GetBits(br, s), s);
+}
+
+// Returns the next symbol, or -1 for a code that is not in the table.
+inline int DecodeHuffman(BitReader* br, const HuffmanTable* pTable)
+{
+	if (br->bits < 16) {
+		FillBits(br);
+	}
+	uint32_t e = pTable->lookup[br->acc >> (64 - HUFF_LOOKAHEAD)];
+	if (e) {
+		br->acc <<= e >> 8;
+		br->bits -= e >> 8;
+		return e & 0xFF;
+	}
+	for (int l = HUFF_LOOKAHEAD + 1; l <= 16; ++l) {
+		int32_t code = (int32_t)(br->acc >> (64 - l));
+		if (code <= pTable->maxcode[l]) {
+			br->acc <<= l;
+			br->bits -= l;
+			return pTable->values[pTable->valoffset[l] + code];
+		}
+	}
+	return -1;
+}
+
+// Skips to the next RSTn marker at the end of a restart interval.
+bool ProcessRestart(BitReader* br);
+
+#endif
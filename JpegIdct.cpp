@@ -0,0 +1,620 @@
+#include "JpegIdct.h"
+
+#include <string.h>
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+
+#define CONST_BITS 13
+#define PASS1_BITS 2
+
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+
+#define DESCALE(x, n) (((x) + (1 << ((n) - 1))) >> (n))
+
+static inline uint8_t ClampSample(int32_t v)
+{
+	return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// Dequantized coefficient clamped to 16 bits, far beyond what 8 bit samples
+// produce, so the passes below stay within 32 bits on corrupt input.
+static inline int32_t DequantClamped(int16_t coef, uint16_t quant)
+{
+	int32_t v = coef * quant;
+	return v < -32768 ? -32768 : (v > 32767 ? 32767 : v);
+}
+
+// Pass 1 of the 8x8 IDCT can grow 16 bit input about 30 times; clamping its
+// output to 16 bits as well keeps pass 2 within 32 bits. Valid data never gets near.
+static inline int32_t ClampWorkspace(int32_t v)
+{
+	return v < -32768 ? -32768 : (v > 32767 ? 32767 : v);
+}
+
+// Block with only a DC coefficient: both passes reduce to a constant.
+static inline void FillDcBlock(int32_t dc, uint8_t* pOut, size_t outStride)
+{
+	uint8_t v = ClampSample(DESCALE(dc * (1 << PASS1_BITS), PASS1_BITS + 3) + 128);
+	for (int r = 0; r < 8; ++r) {
+		memset(pOut + r * outStride, v, 8);
+	}
+}
+
+void IdctDequant8x8(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride)
+{
+	int32_t ws[64];
+
+	// Pass 1: columns, results scaled up by 2^PASS1_BITS.
+	for (int c = 0; c < 8; ++c) {
+		const int16_t* in = pCoef + c;
+		const uint16_t* q = pQuant + c;
+		int32_t* out = ws + c;
+
+		if (in[8] == 0 && in[16] == 0 && in[24] == 0 && in[32] == 0 &&
+			in[40] == 0 && in[48] == 0 && in[56] == 0) {
+			int32_t dc = ClampWorkspace(DequantClamped(in[0], q[0]) * (1 << PASS1_BITS));
+			for (int r = 0; r < 8; ++r) {
+				out[r * 8] = dc;
+			}
+			continue;
+		}
+
+		// Even part
+		int32_t z2 = DequantClamped(in[16], q[16]);
+		int32_t z3 = DequantClamped(in[48], q[48]);
+		int32_t z1 = (z2 + z3) * FIX_0_541196100;
+		int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+		int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+
+		z2 = DequantClamped(in[0], q[0]);
+		z3 = DequantClamped(in[32], q[32]);
+		int32_t tmp0 = (z2 + z3) * (1 << CONST_BITS);
+		int32_t tmp1 = (z2 - z3) * (1 << CONST_BITS);
+
+		int32_t tmp10 = tmp0 + tmp3;
+		int32_t tmp13 = tmp0 - tmp3;
+		int32_t tmp11 = tmp1 + tmp2;
+		int32_t tmp12 = tmp1 - tmp2;
+
+		// Odd part
+		tmp0 = DequantClamped(in[56], q[56]);
+		tmp1 = DequantClamped(in[40], q[40]);
+		tmp2 = DequantClamped(in[24], q[24]);
+		tmp3 = DequantClamped(in[8], q[8]);
+
+		z1 = tmp0 + tmp3;
+		z2 = tmp1 + tmp2;
+		z3 = tmp0 + tmp2;
+		int32_t z4 = tmp1 + tmp3;
+		int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+		tmp0 *= FIX_0_298631336;
+		tmp1 *= FIX_2_053119869;
+		tmp2 *= FIX_3_072711026;
+		tmp3 *= FIX_1_501321110;
+		z1 *= -FIX_0_899976223;
+		z2 *= -FIX_2_562915447;
+		z3 *= -FIX_1_961570560;
+		z4 *= -FIX_0_390180644;
+
+		z3 += z5;
+		z4 += z5;
+
+		tmp0 += z1 + z3;
+		tmp1 += z2 + z4;
+		tmp2 += z2 + z3;
+		tmp3 += z1 + z4;
+
+		out[0] = ClampWorkspace(DESCALE(tmp10 + tmp3, CONST_BITS - PASS1_BITS));
+		out[56] = ClampWorkspace(DESCALE(tmp10 - tmp3, CONST_BITS - PASS1_BITS));
+		out[8] = ClampWorkspace(DESCALE(tmp11 + tmp2, CONST_BITS - PASS1_BITS));
+		out[48] = ClampWorkspace(DESCALE(tmp11 - tmp2, CONST_BITS - PASS1_BITS));
+		out[16] = ClampWorkspace(DESCALE(tmp12 + tmp1, CONST_BITS - PASS1_BITS));
+		out[40] = ClampWorkspace(DESCALE(tmp12 - tmp1, CONST_BITS - PASS1_BITS));
+		out[24] = ClampWorkspace(DESCALE(tmp13 + tmp0, CONST_BITS - PASS1_BITS));
+		out[32] = ClampWorkspace(DESCALE(tmp13 - tmp0, CONST_BITS - PASS1_BITS));
+	}
+
+	// Pass 2: rows, removing PASS1_BITS, the 8x scale and the level shift.
+	for (int r = 0; r < 8; ++r) {
+		const int32_t* in = ws + r * 8;
+		uint8_t* out = pOut + r * outStride;
+
+		if (in[1] == 0 && in[2] == 0 && in[3] == 0 && in[4] == 0 &&
+			in[5] == 0 && in[6] == 0 && in[7] == 0) {
+			uint8_t dc = ClampSample(DESCALE(in[0], PASS1_BITS + 3) + 128);
+			for (int c = 0; c < 8; ++c) {
+				out[c] = dc;
+			}
+			continue;
+		}
+
+		// Even part
+		int32_t z2 = in[2];
+		int32_t z3 = in[6];
+		int32_t z1 = (z2 + z3) * FIX_0_541196100;
+		int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+		int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+
+		int32_t tmp0 = (in[0] + in[4]) * (1 << CONST_BITS);
+		int32_t tmp1 = (in[0] - in[4]) * (1 << CONST_BITS);
+
+		int32_t tmp10 = tmp0 + tmp3;
+		int32_t tmp13 = tmp0 - tmp3;
+		int32_t tmp11 = tmp1 + tmp2;
+		int32_t tmp12 = tmp1 - tmp2;
+
+		// Odd part
+		tmp0 = in[7];
+		tmp1 = in[5];
+		tmp2 = in[3];
+		tmp3 = in[1];
+
+		z1 = tmp0 + tmp3;
+		z2 = tmp1 + tmp2;
+		z3 = tmp0 + tmp2;
+		int32_t z4 = tmp1 + tmp3;
+		int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+		tmp0 *= FIX_0_298631336;
+		tmp1 *= FIX_2_053119869;
+		tmp2 *= FIX_3_072711026;
+		tmp3 *= FIX_1_501321110;
+		z1 *= -FIX_0_899976223;
+		z2 *= -FIX_2_562915447;
+		z3 *= -FIX_1_961570560;
+		z4 *= -FIX_0_390180644;
+
+		z3 += z5;
+		z4 += z5;
+
+		tmp0 += z1 + z3;
+		tmp1 += z2 + z4;
+		tmp2 += z2 + z3;
+		tmp3 += z1 + z4;
+
+		const int shift = CONST_BITS + PASS1_BITS + 3;
+		out[0] = ClampSample(DESCALE(tmp10 + tmp3, shift) + 128);
+		out[7] = ClampSample(DESCALE(tmp10 - tmp3, shift) + 128);
+		out[1] = ClampSample(DESCALE(tmp11 + tmp2, shift) + 128);
+		out[6] = ClampSample(DESCALE(tmp11 - tmp2, shift) + 128);
+		out[2] = ClampSample(DESCALE(tmp12 + tmp1, shift) + 128);
+		out[5] = ClampSample(DESCALE(tmp12 - tmp1, shift) + 128);
+		out[3] = ClampSample(DESCALE(tmp13 + tmp0, shift) + 128);
+		out[4] = ClampSample(DESCALE(tmp13 - tmp0, shift) + 128);
+	}
+}
+
+// Reduced IDCTs: the N-point IDCT of the lowest N coefficients of the 8-point
+// one. Each output is a sum of C(u)/2 * cos((2x+1)u pi/2N) * F(u); the
+// constants below are those weights in CONST_BITS.
+#define FIX_0_353553391 2896	// C(0)/2, and cos(pi/4)/2
+#define FIX_0_461939766 3784	// cos(pi/8)/2
+#define FIX_0_191341716 1567	// cos(3pi/8)/2
+
+void IdctDequant4x4(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride)
+{
+	int32_t ws[4 * 4];
+
+	// Pass 1: columns, results scaled up by 2^PASS1_BITS.
+	for (int c = 0; c < 4; ++c) {
+		const int16_t* in = pCoef + c;
+		const uint16_t* q = pQuant + c;
+		int32_t* out = ws + c;
+
+		if (in[8] == 0 && in[16] == 0 && in[24] == 0) {
+			int32_t dc = DESCALE(DequantClamped(in[0], q[0]) * FIX_0_353553391, CONST_BITS - PASS1_BITS);
+			out[0] = out[4] = out[8] = out[12] = dc;
+			continue;
+		}
+		int32_t z0 = DequantClamped(in[0], q[0]);
+		int32_t z1 = DequantClamped(in[8], q[8]);
+		int32_t z2 = DequantClamped(in[16], q[16]);
+		int32_t z3 = DequantClamped(in[24], q[24]);
+		int32_t tmp0 = (z0 + z2) * FIX_0_353553391;
+		int32_t tmp2 = (z0 - z2) * FIX_0_353553391;
+		int32_t tmp1 = z1 * FIX_0_461939766 + z3 * FIX_0_191341716;
+		int32_t tmp3 = z1 * FIX_0_191341716 - z3 * FIX_0_461939766;
+		out[0] = DESCALE(tmp0 + tmp1, CONST_BITS - PASS1_BITS);
+		out[12] = DESCALE(tmp0 - tmp1, CONST_BITS - PASS1_BITS);
+		out[4] = DESCALE(tmp2 + tmp3, CONST_BITS - PASS1_BITS);
+		out[8] = DESCALE(tmp2 - tmp3, CONST_BITS - PASS1_BITS);
+	}
+
+	// Pass 2: rows, removing PASS1_BITS and the level shift. The weights
+	// already hold the 2D scale.
+	for (int r = 0; r < 4; ++r) {
+		const int32_t* in = ws + r * 4;
+		uint8_t* out = pOut + r * outStride;
+		int32_t tmp0 = (in[0] + in[2]) * FIX_0_353553391;
+		int32_t tmp2 = (in[0] - in[2]) * FIX_0_353553391;
+		int32_t tmp1 = in[1] * FIX_0_461939766 + in[3] * FIX_0_191341716;
+		int32_t tmp3 = in[1] * FIX_0_191341716 - in[3] * FIX_0_461939766;
+		out[0] = ClampSample(DESCALE(tmp0 + tmp1, CONST_BITS + PASS1_BITS) + 128);
+		out[3] = ClampSample(DESCALE(tmp0 - tmp1, CONST_BITS + PASS1_BITS) + 128);
+		out[1] = ClampSample(DESCALE(tmp2 + tmp3, CONST_BITS + PASS1_BITS) + 128);
+		out[2] = ClampSample(DESCALE(tmp2 - tmp3, CONST_BITS + PASS1_BITS) + 128);
+	}
+}
+
+void IdctDequant2x2(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride)
+{
+	int32_t z00 = DequantClamped(pCoef[0], pQuant[0]);
+	int32_t z01 = DequantClamped(pCoef[1], pQuant[1]);
+	int32_t z10 = DequantClamped(pCoef[8], pQuant[8]);
+	int32_t z11 = DequantClamped(pCoef[9], pQuant[9]);
+
+	// Pass 1: columns.
+	int32_t c00 = DESCALE((z00 + z10) * FIX_0_353553391, CONST_BITS - PASS1_BITS);
+	int32_t c10 = DESCALE((z00 - z10) * FIX_0_353553391, CONST_BITS - PASS1_BITS);
+	int32_t c01 = DESCALE((z01 + z11) * FIX_0_353553391, CONST_BITS - PASS1_BITS);
+	int32_t c11 = DESCALE((z01 - z11) * FIX_0_353553391, CONST_BITS - PASS1_BITS);
+
+	// Pass 2: rows.
+	pOut[0] = ClampSample(DESCALE((c00 + c01) * FIX_0_353553391, CONST_BITS + PASS1_BITS) + 128);
+	pOut[1] = ClampSample(DESCALE((c00 - c01) * FIX_0_353553391, CONST_BITS + PASS1_BITS) + 128);
+	pOut[outStride] = ClampSample(DESCALE((c10 + c11) * FIX_0_353553391, CONST_BITS + PASS1_BITS) + 128);
+	pOut[outStride + 1] = ClampSample(DESCALE((c10 - c11) * FIX_0_353553391, CONST_BITS + PASS1_BITS) + 128);
+}
+
+void IdctDequant1x1(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t)
+{
+	pOut[0] = ClampSample(DESCALE(DequantClamped(pCoef[0], pQuant[0]), 3) + 128);
+}
+
+#if defined(CPU_X86)
+// SSE2 has no 32 bit low multiply; two 32x32->64 multiplies give the same low halves.
+TARGET_SSE2 static inline __m128i MulLo32SSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+#define MULC_SSE2(x, c) MulLo32SSE2(x, _mm_set1_epi32(c))
+
+// One 1-D IDCT over four columns at once; v[k] holds frequency k. The results
+// replace v[] descaled by 'shift' bits.
+TARGET_SSE2 static inline void Idct1DSSE2(__m128i* v, int shift)
+{
+	// Even part
+	__m128i z2 = v[2];
+	__m128i z3 = v[6];
+	__m128i z1 = MULC_SSE2(_mm_add_epi32(z2, z3), FIX_0_541196100);
+	__m128i tmp2 = _mm_sub_epi32(z1, MULC_SSE2(z3, FIX_1_847759065));
+	__m128i tmp3 = _mm_add_epi32(z1, MULC_SSE2(z2, FIX_0_765366865));
+
+	__m128i tmp0 = _mm_slli_epi32(_mm_add_epi32(v[0], v[4]), CONST_BITS);
+	__m128i tmp1 = _mm_slli_epi32(_mm_sub_epi32(v[0], v[4]), CONST_BITS);
+
+	__m128i tmp10 = _mm_add_epi32(tmp0, tmp3);
+	__m128i tmp13 = _mm_sub_epi32(tmp0, tmp3);
+	__m128i tmp11 = _mm_add_epi32(tmp1, tmp2);
+	__m128i tmp12 = _mm_sub_epi32(tmp1, tmp2);
+
+	// Odd part
+	tmp0 = v[7];
+	tmp1 = v[5];
+	tmp2 = v[3];
+	tmp3 = v[1];
+
+	z1 = _mm_add_epi32(tmp0, tmp3);
+	z2 = _mm_add_epi32(tmp1, tmp2);
+	z3 = _mm_add_epi32(tmp0, tmp2);
+	__m128i z4 = _mm_add_epi32(tmp1, tmp3);
+	__m128i z5 = MULC_SSE2(_mm_add_epi32(z3, z4), FIX_1_175875602);
+
+	tmp0 = MULC_SSE2(tmp0, FIX_0_298631336);
+	tmp1 = MULC_SSE2(tmp1, FIX_2_053119869);
+	tmp2 = MULC_SSE2(tmp2, FIX_3_072711026);
+	tmp3 = MULC_SSE2(tmp3, FIX_1_501321110);
+	z1 = MULC_SSE2(z1, -FIX_0_899976223);
+	z2 = MULC_SSE2(z2, -FIX_2_562915447);
+	z3 = _mm_add_epi32(MULC_SSE2(z3, -FIX_1_961570560), z5);
+	z4 = _mm_add_epi32(MULC_SSE2(z4, -FIX_0_390180644), z5);
+
+	tmp0 = _mm_add_epi32(tmp0, _mm_add_epi32(z1, z3));
+	tmp1 = _mm_add_epi32(tmp1, _mm_add_epi32(z2, z4));
+	tmp2 = _mm_add_epi32(tmp2, _mm_add_epi32(z2, z3));
+	tmp3 = _mm_add_epi32(tmp3, _mm_add_epi32(z1, z4));
+
+	__m128i round = _mm_set1_epi32(1 << (shift - 1));
+	__m128i sh = _mm_cvtsi32_si128(shift);
+	v[0] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(tmp10, tmp3), round), sh);
+	v[7] = _mm_sra_epi32(_mm_add_epi32(_mm_sub_epi32(tmp10, tmp3), round), sh);
+	v[1] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(tmp11, tmp2), round), sh);
+	v[6] = _mm_sra_epi32(_mm_add_epi32(_mm_sub_epi32(tmp11, tmp2), round), sh);
+	v[2] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(tmp12, tmp1), round), sh);
+	v[5] = _mm_sra_epi32(_mm_add_epi32(_mm_sub_epi32(tmp12, tmp1), round), sh);
+	v[3] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(tmp13, tmp0), round), sh);
+	v[4] = _mm_sra_epi32(_mm_add_epi32(_mm_sub_epi32(tmp13, tmp0), round), sh);
+}
+
+TARGET_SSE2 static inline void Transpose4x4SSE2(__m128i* a, __m128i* b, __m128i* c, __m128i* d)
+{
+	__m128i t0 = _mm_unpacklo_epi32(*a, *b);
+	__m128i t1 = _mm_unpacklo_epi32(*c, *d);
+	__m128i t2 = _mm_unpackhi_epi32(*a, *b);
+	__m128i t3 = _mm_unpackhi_epi32(*c, *d);
+	*a = _mm_unpacklo_epi64(t0, t1);
+	*b = _mm_unpackhi_epi64(t0, t1);
+	*c = _mm_unpacklo_epi64(t2, t3);
+	*d = _mm_unpackhi_epi64(t2, t3);
+}
+
+// Transposes the 8x8 block held as left (columns 0-3) and right (columns 4-7)
+// halves of each row: afterwards left[k] / right[k] are rows 0-3 / 4-7 of column k.
+TARGET_SSE2 static inline void Transpose8x8SSE2(__m128i* left, __m128i* right)
+{
+	Transpose4x4SSE2(&left[0], &left[1], &left[2], &left[3]);
+	Transpose4x4SSE2(&left[4], &left[5], &left[6], &left[7]);
+	Transpose4x4SSE2(&right[0], &right[1], &right[2], &right[3]);
+	Transpose4x4SSE2(&right[4], &right[5], &right[6], &right[7]);
+	for (int k = 0; k < 4; ++k) {
+		__m128i t = left[4 + k];
+		left[4 + k] = right[k];
+		right[k] = t;
+	}
+}
+
+TARGET_SSE2 void IdctDequant8x8SSE2(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride)
+{
+	__m128i left[8], right[8];
+	__m128i coef[8];
+	__m128i ac = _mm_setzero_si128();
+
+	for (int r = 0; r < 8; ++r) {
+		coef[r] = _mm_loadu_si128((const __m128i*)(pCoef + r * 8));
+		ac = _mm_or_si128(ac, r == 0 ? _mm_srli_si128(coef[0], 2) : coef[r]);
+	}
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(ac, _mm_setzero_si128())) == 0xFFFF) {
+		FillDcBlock(DequantClamped(pCoef[0], pQuant[0]), pOut, outStride);
+		return;
+	}
+
+	// Dequantize in 32 bits: sign extend the coefficients, zero extend the quantizers.
+	const __m128i zero = _mm_setzero_si128();
+	for (int r = 0; r < 8; ++r) {
+		__m128i sign = _mm_srai_epi16(coef[r], 15);
+		__m128i q = _mm_loadu_si128((const __m128i*)(pQuant + r * 8));
+		left[r] = MulLo32SSE2(_mm_unpacklo_epi16(coef[r], sign), _mm_unpacklo_epi16(q, zero));
+		right[r] = MulLo32SSE2(_mm_unpackhi_epi16(coef[r], sign), _mm_unpackhi_epi16(q, zero));
+	}
+
+	// Pass 1: columns, each lane is a column.
+	Idct1DSSE2(left, CONST_BITS - PASS1_BITS);
+	Idct1DSSE2(right, CONST_BITS - PASS1_BITS);
+
+	// Pass 2: rows, after transposing each lane is a row.
+	Transpose8x8SSE2(left, right);
+	Idct1DSSE2(left, CONST_BITS + PASS1_BITS + 3);
+	Idct1DSSE2(right, CONST_BITS + PASS1_BITS + 3);
+	Transpose8x8SSE2(left, right);
+
+	// Level shift and saturate to 8 bits, two rows per store pair.
+	const __m128i center = _mm_set1_epi16(128);
+	for (int r = 0; r < 8; r += 2) {
+		__m128i row0 = _mm_add_epi16(_mm_packs_epi32(left[r], right[r]), center);
+		__m128i row1 = _mm_add_epi16(_mm_packs_epi32(left[r + 1], right[r + 1]), center);
+		__m128i pix = _mm_packus_epi16(row0, row1);
+		_mm_storel_epi64((__m128i*)(pOut + r * outStride), pix);
+		_mm_storel_epi64((__m128i*)(pOut + (r + 1) * outStride), _mm_srli_si128(pix, 8));
+	}
+}
+
+#define MULC_AVX2(x, c) _mm256_mullo_epi32(x, _mm256_set1_epi32(c))
+
+// One 1-D IDCT over eight columns at once, see Idct1DSSE2().
+TARGET_AVX2 static inline void Idct1DAVX2(__m256i* v, int shift)
+{
+	// Even part
+	__m256i z2 = v[2];
+	__m256i z3 = v[6];
+	__m256i z1 = MULC_AVX2(_mm256_add_epi32(z2, z3), FIX_0_541196100);
+	__m256i tmp2 = _mm256_sub_epi32(z1, MULC_AVX2(z3, FIX_1_847759065));
+	__m256i tmp3 = _mm256_add_epi32(z1, MULC_AVX2(z2, FIX_0_765366865));
+
+	__m256i tmp0 = _mm256_slli_epi32(_mm256_add_epi32(v[0], v[4]), CONST_BITS);
+	__m256i tmp1 = _mm256_slli_epi32(_mm256_sub_epi32(v[0], v[4]), CONST_BITS);
+
+	__m256i tmp10 = _mm256_add_epi32(tmp0, tmp3);
+	__m256i tmp13 = _mm256_sub_epi32(tmp0, tmp3);
+	__m256i tmp11 = _mm256_add_epi32(tmp1, tmp2);
+	__m256i tmp12 = _mm256_sub_epi32(tmp1, tmp2);
+
+	// Odd part
+	tmp0 = v[7];
+	tmp1 = v[5];
+	tmp2 = v[3];
+	tmp3 = v[1];
+
+	z1 = _mm256_add_epi32(tmp0, tmp3);
+	z2 = _mm256_add_epi32(tmp1, tmp2);
+	z3 = _mm256_add_epi32(tmp0, tmp2);
+	__m256i z4 = _mm256_add_epi32(tmp1, tmp3);
+	__m256i z5 = MULC_AVX2(_mm256_add_epi32(z3, z4), FIX_1_175875602);
+
+	tmp0 = MULC_AVX2(tmp0, FIX_0_298631336);
+	tmp1 = MULC_AVX2(tmp1, FIX_2_053119869);
+	tmp2 = MULC_AVX2(tmp2, FIX_3_072711026);
+	tmp3 = MULC_AVX2(tmp3, FIX_1_501321110);
+	z1 = MULC_AVX2(z1, -FIX_0_899976223);
+	z2 = MULC_AVX2(z2, -FIX_2_562915447);
+	z3 = _mm256_add_epi32(MULC_AVX2(z3, -FIX_1_961570560), z5);
+	z4 = _mm256_add_epi32(MULC_AVX2(z4, -FIX_0_390180644), z5);
+
+	tmp0 = _mm256_add_epi32(tmp0, _mm256_add_epi32(z1, z3));
+	tmp1 = _mm256_add_epi32(tmp1, _mm256_add_epi32(z2, z4));
+	tmp2 = _mm256_add_epi32(tmp2, _mm256_add_epi32(z2, z3));
+	tmp3 = _mm256_add_epi32(tmp3, _mm256_add_epi32(z1, z4));
+
+	__m256i round = _mm256_set1_epi32(1 << (shift - 1));
+	__m128i sh = _mm_cvtsi32_si128(shift);
+	v[0] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(tmp10, tmp3), round), sh);
+	v[7] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_sub_epi32(tmp10, tmp3), round), sh);
+	v[1] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(tmp11, tmp2), round), sh);
+	v[6] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_sub_epi32(tmp11, tmp2), round), sh);
+	v[2] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(tmp12, tmp1), round), sh);
+	v[5] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_sub_epi32(tmp12, tmp1), round), sh);
+	v[3] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(tmp13, tmp0), round), sh);
+	v[4] = _mm256_sra_epi32(_mm256_add_epi32(_mm256_sub_epi32(tmp13, tmp0), round), sh);
+}
+
+TARGET_AVX2 static inline void Transpose8x8AVX2(__m256i* v)
+{
+	__m256i t[8], u[8];
+	for (int k = 0; k < 8; k += 2) {
+		t[k] = _mm256_unpacklo_epi32(v[k], v[k + 1]);
+		t[k + 1] = _mm256_unpackhi_epi32(v[k], v[k + 1]);
+	}
+	for (int k = 0; k < 8; k += 4) {
+		u[k] = _mm256_unpacklo_epi64(t[k], t[k + 2]);
+		u[k + 1] = _mm256_unpackhi_epi64(t[k], t[k + 2]);
+		u[k + 2] = _mm256_unpacklo_epi64(t[k + 1], t[k + 3]);
+		u[k + 3] = _mm256_unpackhi_epi64(t[k + 1], t[k + 3]);
+	}
+	for (int k = 0; k < 4; ++k) {
+		v[k] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x20);
+		v[k + 4] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x31);
+	}
+}
+
+TARGET_AVX2 void IdctDequant8x8AVX2(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride)
+{
+	__m256i v[8];
+
+	__m256i c01 = _mm256_loadu_si256((const __m256i*)(pCoef + 0));
+	__m256i c23 = _mm256_loadu_si256((const __m256i*)(pCoef + 16));
+	__m256i c45 = _mm256_loadu_si256((const __m256i*)(pCoef + 32));
+	__m256i c67 = _mm256_loadu_si256((const __m256i*)(pCoef + 48));
+	__m256i ac = _mm256_or_si256(_mm256_or_si256(c23, c45), c67);
+	ac = _mm256_or_si256(ac, _mm256_andnot_si256(_mm256_setr_epi16(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0), c01));
+	if (_mm256_testz_si256(ac, ac)) {
+		FillDcBlock(DequantClamped(pCoef[0], pQuant[0]), pOut, outStride);
+		return;
+	}
+
+	// Dequantize in 32 bits, one row per register.
+	for (int r = 0; r < 8; ++r) {
+		__m256i c = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(pCoef + r * 8)));
+		__m256i q = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pQuant + r * 8)));
+		v[r] = _mm256_mullo_epi32(c, q);
+	}
+
+	// Pass 1: columns, each lane is a column.
+	Idct1DAVX2(v, CONST_BITS - PASS1_BITS);
+
+	// Pass 2: rows, after transposing each lane is a row.
+	Transpose8x8AVX2(v);
+	Idct1DAVX2(v, CONST_BITS + PASS1_BITS + 3);
+	Transpose8x8AVX2(v);
+
+	// Level shift and saturate to 8 bits. Packing works within 128 bit lanes,
+	// the permute puts each row's 8 bytes back together.
+	const __m256i center = _mm256_set1_epi16(128);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	for (int r = 0; r < 8; r += 4) {
+		__m256i rows01 = _mm256_add_epi16(_mm256_packs_epi32(v[r], v[r + 1]), center);
+		__m256i rows23 = _mm256_add_epi16(_mm256_packs_epi32(v[r + 2], v[r + 3]), center);
+		__m256i pix = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(rows01, rows23), order);
+		__m128i lo = _mm256_castsi256_si128(pix);
+		__m128i hi = _mm256_extracti128_si256(pix, 1);
+		_mm_storel_epi64((__m128i*)(pOut + r * outStride), lo);
+		_mm_storel_epi64((__m128i*)(pOut + (r + 1) * outStride), _mm_srli_si128(lo, 8));
+		_mm_storel_epi64((__m128i*)(pOut + (r + 2) * outStride), hi);
+		_mm_storel_epi64((__m128i*)(pOut + (r + 3) * outStride), _mm_srli_si128(hi, 8));
+	}
+}
+#endif
+
+IdctDequantFunc SelectIdctDequant()
+{
+#if defined(CPU_X86)
+	unsigned int features = GetCpuFeatures();
+	if (features & CPU_FEATURE_AVX2) {
+		return IdctDequant8x8AVX2;
+	}
+	if (features & CPU_FEATURE_SSE2) {
+		return IdctDequant8x8SSE2;
+	}
+#endif
+	return IdctDequant8x8;
+}
+
+IdctDequantFunc SelectIdctDequantScaled(uint32_t scale)
+{
+	switch (scale) {
+	case 1:
+		return IdctDequant4x4;
+	case 2:
+		return IdctDequant2x2;
+	case 3:
+		return IdctDequant1x1;
+	default:
+		return SelectIdctDequant();
+	}
+}
+
+// Blocks shaped like real data: sparse AC, dequantized values within the
+// range an 8 bit DCT can produce.
+static void RandomBlock(uint32_t* pState, int16_t* pCoef, uint16_t* pQuant)
+{
+	uint32_t kind = (*pState = *pState * 1664525u + 1013904223u) >> 28;
+	for (int i = 0; i < 64; ++i) {
+		*pState = *pState * 1664525u + 1013904223u;
+		uint32_t q = 1 + ((*pState >> 8) % (kind < 8 ? 16 : 255));
+		int32_t range = 1024 / (int32_t)q;
+		*pState = *pState * 1664525u + 1013904223u;
+		int32_t c = (int32_t)((*pState >> 8) % (2 * range + 1)) - range;
+		bool keep = i == 0 || (kind >= 4 && ((*pState >> 4) & 7) < (kind >> 1));
+		pQuant[i] = (uint16_t)q;
+		pCoef[i] = (int16_t)(keep ? c : 0);
+	}
+}
+
+uint32_t VerifyIdctKernels(uint32_t blocks, uint32_t seed)
+{
+	IdctDequantFunc kernels[2];
+	int numKernels = 0;
+#if defined(CPU_X86)
+	unsigned int features = GetCpuFeatures();
+	if (features & CPU_FEATURE_SSE2) {
+		kernels[numKernels++] = IdctDequant8x8SSE2;
+	}
+	if (features & CPU_FEATURE_AVX2) {
+		kernels[numKernels++] = IdctDequant8x8AVX2;
+	}
+#endif
+	int16_t coef[64];
+	uint16_t quant[64];
+	uint8_t expected[64];
+	uint8_t actual[64];
+	uint32_t state = seed;
+	uint32_t mismatches = 0;
+
+	for (uint32_t b = 0; b < blocks; ++b) {
+		RandomBlock(&state, coef, quant);
+		IdctDequant8x8(coef, quant, expected, 8);
+		for (int k = 0; k < numKernels; ++k) {
+			kernels[k](coef, quant, actual, 8);
+			if (memcmp(expected, actual, sizeof(actual)) != 0) {
+				mismatches++;
+			}
+		}
+	}
+	return mismatches;
+}
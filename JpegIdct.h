@@ -0,0 +1,41 @@
+#ifndef __JPEGIDCT_H__
+#define __JPEGIDCT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CpuFeatures.h"
+
+// Dequantizes an 8x8 block of coefficients (natural order) and writes the
+// inverse DCT as 8 bit samples. Accurate integer LLM algorithm, bit exact with
+// libjpeg's JDCT_ISLOW.
+typedef void (*IdctDequantFunc)(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride);
+
+// Scalar reference kernel.
+void IdctDequant8x8(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride);
+
+#if defined(CPU_X86)
+// Same arithmetic in 32 bit lanes, bit exact with IdctDequant8x8.
+void IdctDequant8x8SSE2(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride);
+void IdctDequant8x8AVX2(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride);
+#endif
+
+// Returns the fastest kernel for this CPU (GetCpuFeatures()).
+IdctDequantFunc SelectIdctDequant();
+
+// Reduced kernels for scaled decoding, like libjpeg's jidctred: the N-point
+// IDCT of the lowest NxN coefficients gives the block averaged down to 4x4,
+// 2x2 or 1x1 samples. Only those coefficients are read.
+void IdctDequant4x4(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride);
+void IdctDequant2x2(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride);
+void IdctDequant1x1(const int16_t* pCoef, const uint16_t* pQuant, uint8_t* pOut, size_t outStride);
+
+// Kernel writing blocks of 8 >> scale samples (DecodeScale); scale 0 is
+// SelectIdctDequant().
+IdctDequantFunc SelectIdctDequantScaled(uint32_t scale);
+
+// Runs every available kernel on 'blocks' pseudo random blocks and compares
+// them with the scalar reference. Returns the number of mismatching blocks.
+uint32_t VerifyIdctKernels(uint32_t blocks, uint32_t seed);
+
+#endif
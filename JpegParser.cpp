@@ -0,0 +1,296 @@
+#include "JpegParser.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// The extra entries let a corrupt run length past 63 land harmlessly on 63.
+const uint8_t g_jpegZigzag[64 + 16] =
+{
+	0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63,
+	63, 63, 63, 63, 63, 63, 63, 63,
+	63, 63, 63, 63, 63, 63, 63, 63,
+};
+
+static uint32_t ReadBE16(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 8) | p[1];
+}
+
+static HRESULT ParseDQT(const uint8_t* p, size_t len, JpegHeader* pHeader)
+{
+	while (len > 0) {
+		uint32_t precision = p[0] >> 4;
+		uint32_t id = p[0] & 15;
+		size_t tableLen = precision ? 129 : 65;
+		if (id >= JPEG_MAX_TABLES || len < tableLen) {
+			return E_FAIL;
+		}
+		for (int i = 0; i < 64; ++i) {
+			uint16_t q = precision ? (uint16_t)ReadBE16(p + 1 + i * 2) : p[1 + i];
+			pHeader->quant[id][g_jpegZigzag[i]] = q;
+		}
+		pHeader->quantDefined[id] = true;
+		p += tableLen;
+		len -= tableLen;
+	}
+	return S_OK;
+}
+
+static HRESULT ParseDHT(const uint8_t* p, size_t len, JpegHeader* pHeader)
+{
+	while (len > 0) {
+		if (len < 17) {
+			return E_FAIL;
+		}
+		uint32_t tableClass = p[0] >> 4;
+		uint32_t id = p[0] & 15;
+		if (tableClass > 1 || id >= JPEG_MAX_TABLES) {
+			return E_FAIL;
+		}
+		JpegHuffmanSpec* pSpec = tableClass ? &pHeader->acSpec[id] : &pHeader->dcSpec[id];
+		uint32_t total = 0;
+		pSpec->counts[0] = 0;
+		for (int l = 1; l <= 16; ++l) {
+			pSpec->counts[l] = p[l];
+			total += p[l];
+		}
+		if (total > 256 || len < 17 + total) {
+			return E_FAIL;
+		}
+		memcpy(pSpec->symbols, p + 17, total);
+		pSpec->defined = true;
+		p += 17 + total;
+		len -= 17 + total;
+	}
+	return S_OK;
+}
+
+static HRESULT ParseSOF(const uint8_t* p, size_t len, JpegHeader* pHeader)
+{
+	if (len < 6) {
+		return E_FAIL;
+	}
+	if (p[0] != 8) {
+		printf("JPEG %d bit precision not supported\n", p[0]);
+		return E_NOTIMPL;
+	}
+	pHeader->height = ReadBE16(p + 1);
+	pHeader->width = ReadBE16(p + 3);
+	pHeader->numComponents = p[5];
+	if (pHeader->width == 0 || pHeader->height == 0 ||
+		(pHeader->numComponents != 1 && pHeader->numComponents != 3) || len < 6 + 3 * pHeader->numComponents) {
+		return E_FAIL;
+	}
+	pHeader->hMax = 1;
+	pHeader->vMax = 1;
+	for (uint32_t i = 0; i < pHeader->numComponents; ++i) {
+		JpegComponent* pComp = &pHeader->components[i];
+		pComp->id = p[6 + i * 3];
+		pComp->h = p[7 + i * 3] >> 4;
+		pComp->v = p[7 + i * 3] & 15;
+		pComp->tq = p[8 + i * 3];
+		if (pComp->h < 1 || pComp->h > 4 || pComp->v < 1 || pComp->v > 4 || pComp->tq >= JPEG_MAX_TABLES) {
+			return E_FAIL;
+		}
+		if (pComp->h > pHeader->hMax) pHeader->hMax = pComp->h;
+		if (pComp->v > pHeader->vMax) pHeader->vMax = pComp->v;
+	}
+	if (pHeader->numComponents == 1) {
+		// A single component scan is not interleaved: one block per MCU.
+		pHeader->components[0].h = 1;
+		pHeader->components[0].v = 1;
+		pHeader->hMax = 1;
+		pHeader->vMax = 1;
+	}
+	pHeader->mcuWidth = pHeader->hMax * 8;
+	pHeader->mcuHeight = pHeader->vMax * 8;
+	pHeader->mcusX = (pHeader->width + pHeader->mcuWidth - 1) / pHeader->mcuWidth;
+	pHeader->mcusY = (pHeader->height + pHeader->mcuHeight - 1) / pHeader->mcuHeight;
+	return S_OK;
+}
+
+static HRESULT ParseSOS(const uint8_t* p, size_t len, JpegHeader* pHeader)
+{
+	if (len < 1 || pHeader->numComponents == 0) {
+		return E_FAIL;
+	}
+	uint32_t count = p[0];
+	if (len < 1 + count * 2 + 3) {
+		return E_FAIL;
+	}
+	if (count != pHeader->numComponents) {
+		printf("JPEG multi scan frames not supported\n");
+		return E_NOTIMPL;
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		uint8_t id = p[1 + i * 2];
+		uint8_t tables = p[2 + i * 2];
+		JpegComponent* pComp = NULL;
+		for (uint32_t c = 0; c < pHeader->numComponents; ++c) {
+			if (pHeader->components[c].id == id) {
+				pComp = &pHeader->components[c];
+			}
+		}
+		if (pComp == NULL || (tables >> 4) >= JPEG_MAX_TABLES || (tables & 15) >= JPEG_MAX_TABLES) {
+			return E_FAIL;
+		}
+		pComp->td = tables >> 4;
+		pComp->ta = tables & 15;
+	}
+	return S_OK;
+}
+
+HRESULT ParseJpegHeader(const uint8_t* pData, size_t len, JpegHeader* pHeader)
+{
+	HRESULT hr = S_OK;
+	size_t pos = 2;
+	bool haveFrame = false;
+
+	memset(pHeader, 0, sizeof(*pHeader));
+	if (len < 4 || pData[0] != 0xFF || pData[1] != JPEG_SOI) {
+		printf("Not a JPEG frame\n");
+		return E_FAIL;
+	}
+
+	while (pos + 4 <= len) {
+		if (pData[pos] != 0xFF) {
+			return E_FAIL;
+		}
+		uint8_t marker = pData[pos + 1];
+		if (marker == 0xFF) {
+			pos++;	// fill byte
+			continue;
+		}
+		if (marker == JPEG_EOI) {
+			break;
+		}
+		size_t segLen = ReadBE16(pData + pos + 2);
+		if (segLen < 2 || pos + 2 + segLen > len) {
+			return E_FAIL;
+		}
+		const uint8_t* p = pData + pos + 4;
+		size_t n = segLen - 2;
+
+		switch (marker)
+		{
+		case JPEG_SOF0:
+		case JPEG_SOF1:
+			hr = ParseSOF(p, n, pHeader);
+			haveFrame = true;
+			break;
+		case JPEG_DHT:
+			hr = ParseDHT(p, n, pHeader);
+			break;
+		case JPEG_DQT:
+			hr = ParseDQT(p, n, pHeader);
+			break;
+		case JPEG_DRI:
+			hr = n >= 2 ? S_OK : E_FAIL;
+			if (hr == S_OK) {
+				pHeader->restartInterval = ReadBE16(p);
+			}
+			break;
+		case JPEG_SOS:
+			if (!haveFrame) {
+				return E_FAIL;
+			}
+			hr = ParseSOS(p, n, pHeader);
+			if (hr == S_OK) {
+				pHeader->pScan = p + n;
+				pHeader->scanLen = len - (pos + 2 + segLen);
+			}
+			return hr;
+		default:
+			if (marker >= 0xC2 && marker <= 0xCF && marker != JPEG_DHT && marker != 0xC8 && marker != 0xCC) {
+				printf("JPEG SOF%d not supported\n", marker - JPEG_SOF0);
+				return E_NOTIMPL;
+			}
+			break;	// APPn, COM, ...
+		}
+		if (hr != S_OK) {
+			return hr;
+		}
+		pos += 2 + segLen;
+	}
+	printf("JPEG frame without scan\n");
+	return E_FAIL;
+}
+
+bool JpegHasHuffmanTables(const uint8_t* pData, size_t len)
+{
+	size_t pos = 2;
+	while (pos + 4 <= len && pData[pos] == 0xFF) {
+		uint8_t marker = pData[pos + 1];
+		if (marker == 0xFF) {
+			pos++;
+			continue;
+		}
+		if (marker == JPEG_DHT) {
+			return true;
+		}
+		if (marker == JPEG_SOS || marker == JPEG_EOI) {
+			break;
+		}
+		pos += 2 + ReadBE16(pData + pos + 2);
+	}
+	return false;
+}
+
+size_t FindJpegFrameEnd(const uint8_t* pData, size_t len)
+{
+	if (len < 4 || pData[0] != 0xFF || pData[1] != JPEG_SOI) {
+		return 0;
+	}
+	size_t pos = 2;
+	while (pos + 2 <= len) {
+		if (pData[pos] != 0xFF) {
+			return 0;
+		}
+		uint8_t marker = pData[pos + 1];
+		if (marker == 0xFF) {
+			pos++;	// fill byte
+			continue;
+		}
+		if (marker == JPEG_EOI) {
+			return pos + 2;
+		}
+		if (marker >= JPEG_RST0 && marker <= JPEG_RST7) {
+			pos += 2;
+			continue;
+		}
+		if (marker == JPEG_SOI || pos + 4 > len) {
+			return 0;
+		}
+		pos += 2 + ReadBE16(pData + pos + 2);
+		if (marker != JPEG_SOS) {
+			continue;
+		}
+		// Entropy coded data runs to the first marker other than a stuffed
+		// 0xFF00 or RSTn. Progressive frames have several scans.
+		for (;;) {
+			const uint8_t* p = pos < len ? (const uint8_t*)memchr(pData + pos, 0xFF, len - pos) : NULL;
+			if (p == NULL || p + 1 >= pData + len) {
+				return 0;
+			}
+			pos = p - pData;
+			uint8_t next = p[1];
+			if (next == 0xFF) {
+				pos++;
+			}
+			else if (next == 0 || (next >= JPEG_RST0 && next <= JPEG_RST7)) {
+				pos += 2;
+			}
+			else {
+				break;
+			}
+		}
+	}
+	return 0;
+}
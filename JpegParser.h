@@ -0,0 +1,83 @@
+#ifndef __JPEGPARSER_H__
+#define __JPEGPARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PortableDefs.h"
+
+#define JPEG_MAX_COMPONENTS 4
+#define JPEG_MAX_TABLES 4
+
+// JPEG markers (second byte after 0xFF).
+#define JPEG_SOI 0xD8
+#define JPEG_EOI 0xD9
+#define JPEG_SOF0 0xC0
+#define JPEG_SOF1 0xC1
+#define JPEG_SOF2 0xC2
+#define JPEG_DHT 0xC4
+#define JPEG_SOS 0xDA
+#define JPEG_DQT 0xDB
+#define JPEG_DRI 0xDD
+#define JPEG_RST0 0xD0
+#define JPEG_RST7 0xD7
+
+// Huffman table as stored in a DHT segment.
+struct JpegHuffmanSpec
+{
+	uint8_t counts[17];	// counts[l]: number of codes of length l (1..16)
+	uint8_t symbols[256];
+	bool defined;
+};
+
+struct JpegComponent
+{
+	uint8_t id;
+	uint8_t h;	// horizontal sampling factor
+	uint8_t v;	// vertical sampling factor
+	uint8_t tq;	// quantization table
+	uint8_t td;	// DC Huffman table
+	uint8_t ta;	// AC Huffman table
+};
+
+// Everything needed to decode a baseline, single scan JPEG frame.
+struct JpegHeader
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t numComponents;
+	JpegComponent components[JPEG_MAX_COMPONENTS];
+	uint16_t quant[JPEG_MAX_TABLES][64];	// natural (row major) order
+	bool quantDefined[JPEG_MAX_TABLES];
+	JpegHuffmanSpec dcSpec[JPEG_MAX_TABLES];
+	JpegHuffmanSpec acSpec[JPEG_MAX_TABLES];
+	uint32_t restartInterval;	// MCUs per restart interval, 0 if none
+
+	uint32_t hMax;
+	uint32_t vMax;
+	uint32_t mcuWidth;	// pixels
+	uint32_t mcuHeight;
+	uint32_t mcusX;
+	uint32_t mcusY;
+
+	const uint8_t* pScan;	// entropy coded data following the SOS header
+	size_t scanLen;	// bytes from pScan to the end of the input
+};
+
+// Maps zigzag position to natural (row major) block position.
+extern const uint8_t g_jpegZigzag[64 + 16];
+
+// Parses the markers up to and including SOS. Returns E_NOTIMPL for
+// progressive, 12 bit or multi scan frames.
+HRESULT ParseJpegHeader(const uint8_t* pData, size_t len, JpegHeader* pHeader);
+
+// Walks the markers before SOS looking for a DHT segment. UVC cameras leave
+// it out and rely on the JPEG Annex K tables.
+bool JpegHasHuffmanTables(const uint8_t* pData, size_t len);
+
+// Returns the length of the JPEG frame that starts (with SOI) at pData, up to
+// and including its EOI, or 0 if there is no complete frame. Marker segments
+// are skipped by their length, so an EXIF thumbnail doesn't end the frame.
+size_t FindJpegFrameEnd(const uint8_t* pData, size_t len);
+
+#endif
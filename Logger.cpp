@@ -0,0 +1,374 @@
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+std::atomic<int> g_logLevel(LOG_LEVEL_INFO);
+
+// Single producer (its thread), single consumer (whoever holds
+// Logger::drainMutex). Rings live as long as the process.
+struct LogRing
+{
+	LogRecord records[LOG_RING_SIZE];
+	std::atomic<uint64_t> head;	// next record the producer writes
+	std::atomic<uint64_t> tail;	// next record the consumer reads
+	std::atomic<uint64_t> dropped;
+};
+
+class Logger
+{
+public:
+	Logger() : m_pOutput(stdout), m_totalDropped(0), m_stop(false), m_wake(false)
+	{
+		m_thread = std::thread(&Logger::WriterMain, this);
+	}
+
+	~Logger()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_wakeMutex);
+			m_stop = true;
+		}
+		m_wakeup.notify_one();
+		m_thread.join();
+		Drain();
+	}
+
+	LogRing* RegisterRing()
+	{
+		LogRing* pRing = new LogRing();
+		pRing->head = 0;
+		pRing->tail = 0;
+		pRing->dropped = 0;
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		m_rings.push_back(pRing);
+		return pRing;
+	}
+
+	void Wake()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_wakeMutex);
+			m_wake = true;
+		}
+		m_wakeup.notify_one();
+	}
+
+	// Moves every published record out of the rings, then formats and writes
+	// them in time order.
+	void Drain()
+	{
+		std::lock_guard<std::mutex> drainLock(m_drainMutex);
+		std::vector<LogRing*> rings;
+		{
+			std::lock_guard<std::mutex> lock(m_ringsMutex);
+			rings = m_rings;
+		}
+		m_batch.clear();
+		uint64_t dropped = 0;
+		for (size_t i = 0; i < rings.size(); ++i) {
+			LogRing* pRing = rings[i];
+			uint64_t tail = pRing->tail.load(std::memory_order_relaxed);
+			uint64_t head = pRing->head.load(std::memory_order_acquire);
+			for (; tail != head; ++tail) {
+				m_batch.push_back(pRing->records[tail & (LOG_RING_SIZE - 1)]);
+			}
+			pRing->tail.store(tail, std::memory_order_release);
+			dropped += pRing->dropped.exchange(0, std::memory_order_relaxed);
+		}
+		if (m_batch.empty() && dropped == 0) {
+			return;
+		}
+		std::stable_sort(m_batch.begin(), m_batch.end(),
+			[](const LogRecord& a, const LogRecord& b) { return a.timeNs < b.timeNs; });
+		m_text.clear();
+		for (size_t i = 0; i < m_batch.size(); ++i) {
+			FormatRecord(m_batch[i], &m_text);
+		}
+		if (dropped) {
+			char line[64];
+			snprintf(line, sizeof(line), "[log] %llu messages dropped\n", (unsigned long long)dropped);
+			m_text += line;
+			m_totalDropped += dropped;
+		}
+		FILE* f = m_pOutput.load();
+		fwrite(m_text.data(), 1, m_text.size(), f);
+		fflush(f);
+	}
+
+	void SetOutput(FILE* f) { m_pOutput.store(f); }
+	uint64_t Dropped() const { return m_totalDropped.load(); }
+
+private:
+	void WriterMain()
+	{
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		while (!m_stop) {
+			m_wakeup.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_MS), [this] { return m_stop || m_wake; });
+			m_wake = false;
+			lock.unlock();
+			Drain();
+			lock.lock();
+		}
+	}
+
+	static void FormatRecord(const LogRecord& record, std::string* pOut);
+
+	std::atomic<FILE*> m_pOutput;
+	std::atomic<uint64_t> m_totalDropped;
+	std::mutex m_ringsMutex;
+	std::vector<LogRing*> m_rings;
+	std::mutex m_drainMutex;
+	std::vector<LogRecord> m_batch;
+	std::string m_text;
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeup;
+	bool m_stop;
+	bool m_wake;
+	std::thread m_thread;
+};
+
+static Logger& GetLogger()
+{
+	static Logger logger;
+	return logger;
+}
+
+static thread_local LogRing* t_pLogRing = NULL;
+
+static uint64_t LogNowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LogRecord* LogBegin(int level, const char* format)
+{
+	LogRing* pRing = t_pLogRing;
+	if (pRing == NULL) {
+		pRing = t_pLogRing = GetLogger().RegisterRing();
+	}
+	uint64_t head = pRing->head.load(std::memory_order_relaxed);
+	if (head - pRing->tail.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+		pRing->dropped.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+	LogRecord* pRecord = &pRing->records[head & (LOG_RING_SIZE - 1)];
+	pRecord->timeNs = LogNowNs();
+	pRecord->format = format;
+	pRecord->level = (uint8_t)level;
+	pRecord->argCount = 0;
+	pRecord->stringBytes = 0;
+	return pRecord;
+}
+
+void LogCommit(int level)
+{
+	LogRing* pRing = t_pLogRing;
+	pRing->head.store(pRing->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	// Errors show up right away, everything else within LOG_FLUSH_MS.
+	if (level >= LOG_LEVEL_ERROR) {
+		GetLogger().Wake();
+	}
+}
+
+static char* LogAddString(LogRecord* pRecord, LogArg* pArg, size_t* pRoom)
+{
+	pArg->type = LOG_ARG_STRING;
+	pArg->size = 0;
+	pArg->offset = pRecord->stringBytes;
+	*pRoom = LOG_STRING_BYTES - pRecord->stringBytes;
+	return pRecord->strings + pRecord->stringBytes;
+}
+
+void LogPack(LogRecord* pRecord, const char* s)
+{
+	LogArg& arg = pRecord->args[pRecord->argCount++];
+	size_t room;
+	char* pDst = LogAddString(pRecord, &arg, &room);
+	if (room == 0) {
+		arg.type = LOG_ARG_POINTER;
+		arg.p = NULL;
+		return;
+	}
+	if (s == NULL) {
+		s = "(null)";
+	}
+	size_t n = strlen(s);
+	if (n > room - 1) {
+		n = room - 1;
+	}
+	memcpy(pDst, s, n);
+	pDst[n] = 0;
+	pRecord->stringBytes += (uint16_t)(n + 1);
+}
+
+void LogPack(LogRecord* pRecord, const wchar_t* s)
+{
+	LogArg& arg = pRecord->args[pRecord->argCount++];
+	size_t room;
+	char* pDst = LogAddString(pRecord, &arg, &room);
+	if (room == 0) {
+		arg.type = LOG_ARG_POINTER;
+		arg.p = NULL;
+		return;
+	}
+	size_t n = 0;
+	for (; s && s[n] && n < room - 1; ++n) {
+		pDst[n] = s[n] < 0x80 ? (char)s[n] : '?';
+	}
+	pDst[n] = 0;
+	pRecord->stringBytes += (uint16_t)(n + 1);
+}
+
+static int64_t ArgAsInt(const LogArg& arg)
+{
+	switch (arg.type) {
+	case LOG_ARG_DOUBLE: return (int64_t)arg.d;
+	case LOG_ARG_POINTER: return (int64_t)(uintptr_t)arg.p;
+	case LOG_ARG_STRING: return 0;
+	default: return arg.i;
+	}
+}
+
+// Unsigned view with the width of the original type, as printf would see it.
+static uint64_t ArgAsUnsigned(const LogArg& arg)
+{
+	uint64_t v = (uint64_t)ArgAsInt(arg);
+	if ((arg.type == LOG_ARG_INT || arg.type == LOG_ARG_UINT) && arg.size < 8) {
+		v &= (1ull << (8 * arg.size)) - 1;
+	}
+	return v;
+}
+
+// Writes "%<flags><width><precision><length><conversion>" to pFormat.
+static void BuildConversion(char* pFormat, const char* spec, size_t prefix, const char* length, char conversion)
+{
+	memcpy(pFormat, spec, prefix);
+	size_t n = strlen(length);
+	memcpy(pFormat + prefix, length, n);
+	pFormat[prefix + n] = conversion;
+	pFormat[prefix + n + 1] = 0;
+}
+
+// Re-runs each conversion of the format through snprintf with the type the
+// argument was captured as; length modifiers in the format are replaced.
+void Logger::FormatRecord(const LogRecord& record, std::string* pOut)
+{
+	const char* f = record.format;
+	int next = 0;
+	while (*f) {
+		if (*f != '%') {
+			const char* end = strchr(f, '%');
+			if (end == NULL) {
+				end = f + strlen(f);
+			}
+			pOut->append(f, end - f);
+			f = end;
+			continue;
+		}
+		if (f[1] == '%') {
+			pOut->push_back('%');
+			f += 2;
+			continue;
+		}
+		const char* spec = f++;
+		while (*f && strchr("-+ #0", *f)) {
+			f++;
+		}
+		while (*f >= '0' && *f <= '9') {
+			f++;
+		}
+		if (*f == '.') {
+			f++;
+			while (*f >= '0' && *f <= '9') {
+				f++;
+			}
+		}
+		size_t prefix = f - spec;	// "%", flags, width and precision
+		while (*f && strchr("hlLqjzt", *f)) {
+			f++;
+		}
+		char conversion = *f;
+		if (conversion == 0 || prefix > 16) {
+			pOut->append(spec);
+			break;
+		}
+		f++;
+		if (next >= record.argCount) {
+			pOut->append("(missing)");
+			continue;
+		}
+		const LogArg& arg = record.args[next++];
+		char format[24];
+		char text[256];
+		int n = 0;
+		switch (conversion) {
+		case 'd':
+		case 'i':
+			BuildConversion(format, spec, prefix, "ll", 'd');
+			n = snprintf(text, sizeof(text), format, (long long)ArgAsInt(arg));
+			break;
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+			BuildConversion(format, spec, prefix, "ll", conversion);
+			n = snprintf(text, sizeof(text), format, (unsigned long long)ArgAsUnsigned(arg));
+			break;
+		case 'c':
+			BuildConversion(format, spec, prefix, "", 'c');
+			n = snprintf(text, sizeof(text), format, (int)ArgAsInt(arg));
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			BuildConversion(format, spec, prefix, "", conversion);
+			n = snprintf(text, sizeof(text), format, arg.type == LOG_ARG_DOUBLE ? arg.d : (double)ArgAsInt(arg));
+			break;
+		case 's':
+		case 'S':
+			BuildConversion(format, spec, prefix, "", 's');
+			n = snprintf(text, sizeof(text), format, arg.type == LOG_ARG_STRING ? record.strings + arg.offset : "(?)");
+			break;
+		case 'p':
+			BuildConversion(format, spec, prefix, "", 'p');
+			n = snprintf(text, sizeof(text), format, arg.type == LOG_ARG_POINTER ? arg.p : NULL);
+			break;
+		default:
+			pOut->append(spec, f - spec);
+			continue;
+		}
+		if (n > 0) {
+			pOut->append(text, std::min((size_t)n, sizeof(text) - 1));
+		}
+	}
+}
+
+void LogSetOutput(FILE* f)
+{
+	GetLogger().SetOutput(f ? f : stdout);
+}
+
+void LogFlush()
+{
+	GetLogger().Drain();
+}
+
+uint64_t LogDropped()
+{
+	return GetLogger().Dropped();
+}
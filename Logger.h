@@ -0,0 +1,175 @@
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <type_traits>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// Calls below this level are removed by the preprocessor, arguments included.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE 1024		// records per thread, power of two; a full ring drops new records
+#define LOG_MAX_ARGS 8
+#define LOG_STRING_BYTES 128	// room for copies of string arguments in one record
+#define LOG_FLUSH_MS 20			// the writer thread wakes at least this often
+
+enum LogArgType
+{
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STRING,
+	LOG_ARG_POINTER,
+};
+
+struct LogArg
+{
+	uint8_t type;	// LogArgType
+	uint8_t size;	// sizeof the integer, so %x of a negative HRESULT prints 8 digits
+	union
+	{
+		int64_t i;
+		uint64_t u;
+		double d;
+		const void* p;
+		uint32_t offset;	// into LogRecord::strings
+	};
+};
+
+// A log call as captured on the calling thread. Formatting happens later on
+// the writer thread, so the format must be a string literal; string
+// arguments are copied.
+struct LogRecord
+{
+	uint64_t timeNs;
+	const char* format;
+	uint8_t level;
+	uint8_t argCount;
+	uint16_t stringBytes;
+	LogArg args[LOG_MAX_ARGS];
+	char strings[LOG_STRING_BYTES];
+};
+
+extern std::atomic<int> g_logLevel;
+
+// Runtime filter on top of LOG_MIN_LEVEL, LOG_LEVEL_INFO by default.
+inline void LogSetLevel(int level) { g_logLevel.store(level, std::memory_order_relaxed); }
+inline bool LogEnabled(int level) { return level >= g_logLevel.load(std::memory_order_relaxed); }
+
+// Where the writer thread prints, stdout by default.
+void LogSetOutput(FILE* f);
+
+// Formats and writes everything logged so far, on the calling thread.
+void LogFlush();
+
+// Records dropped because a thread's ring was full.
+uint64_t LogDropped();
+
+// Returns a free record in the calling thread's ring, NULL if it is full.
+LogRecord* LogBegin(int level, const char* format);
+// Publishes the record from LogBegin to the writer thread.
+void LogCommit(int level);
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type LogPack(LogRecord* pRecord, T value)
+{
+	LogArg& arg = pRecord->args[pRecord->argCount++];
+	arg.size = (uint8_t)sizeof(T);
+	if (std::is_signed<T>::value) {
+		arg.type = LOG_ARG_INT;
+		arg.i = (int64_t)value;
+	}
+	else {
+		arg.type = LOG_ARG_UINT;
+		arg.u = (uint64_t)value;
+	}
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_enum<T>::value>::type LogPack(LogRecord* pRecord, T value)
+{
+	LogArg& arg = pRecord->args[pRecord->argCount++];
+	arg.size = (uint8_t)sizeof(T);
+	arg.type = LOG_ARG_INT;
+	arg.i = (int64_t)value;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type LogPack(LogRecord* pRecord, T value)
+{
+	LogArg& arg = pRecord->args[pRecord->argCount++];
+	arg.size = (uint8_t)sizeof(T);
+	arg.type = LOG_ARG_DOUBLE;
+	arg.d = (double)value;
+}
+
+template <typename T>
+inline void LogPack(LogRecord* pRecord, const T* p)
+{
+	LogArg& arg = pRecord->args[pRecord->argCount++];
+	arg.size = (uint8_t)sizeof(p);
+	arg.type = LOG_ARG_POINTER;
+	arg.p = p;
+}
+
+// Strings are copied (truncated to the room left in the record). Wide
+// strings are narrowed, non ASCII characters become '?'.
+void LogPack(LogRecord* pRecord, const char* s);
+void LogPack(LogRecord* pRecord, const wchar_t* s);
+
+template <typename... Args>
+inline void LogWrite(int level, const char* format, const Args&... args)
+{
+	static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+	if (!LogEnabled(level)) {
+		return;
+	}
+	LogRecord* pRecord = LogBegin(level, format);
+	if (pRecord == NULL) {
+		return;
+	}
+	int unpack[] = { 0, (LogPack(pRecord, args), 0)... };
+	(void)unpack;
+	LogCommit(level);
+}
+
+// printf style, with the usual conversions; '*' widths are not supported.
+#if LOG_MIN_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) LogWrite(LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LogWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LogWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) LogWrite(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LogWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif
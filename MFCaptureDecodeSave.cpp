@@ -22,8 +22,22 @@
 #include <mferror.h>
 #include <wmcodecdsp.h>
 #include <fstream>
+#include <vector>
 
 #include "MJPEGDecoder.h"
+#include "SoftMJPEGDecoder.h"
+#include "JpegParser.h"
+#include "JpegIdct.h"
+#include "DecodeBenchmark.h"
+#include "DecodeSuite.h"
+#include "FrameScheduler.h"
+#include "FrameArena.h"
+#include "FrameDumpSink.h"
+#include "HexDump.h"
+#include "FrameTrace.h"
+#include "Logger.h"
+#include "ReplaySource.h"
+#include "SamplePool.h"
 
 #pragma comment(lib, "mf.lib")
 #pragma comment(lib, "mfplat.lib")
@@ -34,13 +48,27 @@
 
 #define WEBCAM_DEVICE_INDEX 0	// Adjust according to desired video capture device.
 #define SAMPLE_COUNT 100			// Adjust depending on number of samples to capture.
-#define PLANE_Y_FILENAME L"planeY.bmp"
-#define PLANE_UV_FILENAME L"planeUV.bmp"
 #define FRAME_WIDTH 1280
 #define FRAME_HEIGHT 720
 #define FRAME_RATE 30
-
-#define CHECK_HR(hr, msg) if (hr != S_OK) { printf(msg); printf(" Error: %.2X.\n", hr); goto done; }
+#define DECODE_IN_FLIGHT 0		// Frames kept inside the decoder at once (e.g. 4), 0 for synchronous DecodeOneFrame.
+#define COMPARE_SOFTWARE_DECODER 0	// With DECODE_IN_FLIGHT 0, also decode each frame on the CPU and compare.
+#define VERIFY_SIMD_KERNELS 0		// Check the SIMD IDCT and color conversion kernels against the scalar ones at startup.
+#define BENCHMARK_CAPTURED_FRAMES 0	// Keep the compressed frames and benchmark the software decoder on them.
+#define SOFTWARE_DECODE_THREADS 4	// Threads for software decoding of frames with restart markers.
+#define SOFTWARE_DECODE_WORKERS 0	// Also decode every frame on this many SoftMJPEGDecoders through a FrameScheduler.
+#define SOFTWARE_DECODE_SCALE DECODE_SCALE_FULL	// Output size of those workers, e.g. DECODE_SCALE_1_8 for preview tiles.
+#define SOFTWARE_DECODE_CROP { 0, 0, 0, 0 }	// x, y, width, height of the region those workers decode, width 0 for all.
+#define SOFTWARE_DECODE_LUMA_ONLY 0	// Those workers output only the Y plane, e.g. for motion detection.
+#define INPUT_ARENA_SIZE (4 * 1024 * 1024)	// Initial size of the ring buffer for compressed frames.
+#define DUMP_EVERY_N_FRAMES 0		// Save every Nth decoded frame on a background thread, 0 for only frame 10 inline.
+#define DUMP_QUEUE_SIZE 4			// Frames waiting for the dump thread before new ones are dropped.
+#define REPLAY_FILENAME NULL		// MJPEG file (JPEG stream, AVI or indexed) to decode instead of the webcam.
+#define REPLAY_FPS REPLAY_FILE_RATE	// Replay pacing: frames per second, REPLAY_FILE_RATE or REPLAY_AS_FAST_AS_POSSIBLE.
+#define DECODE_SUITE_FILENAME "decode_suite.json"	// With BENCHMARK_CAPTURED_FRAMES and REPLAY_FILENAME, decode suite results.
+#define TRACE_FILENAME "trace.json"	// Chrome trace written at the end when FRAME_TRACE (FrameTrace.h) is 1.
+
+#define CHECK_HR(expr, msg) do { hr = (expr); if (FAILED(hr)) { LOG_ERROR("%s Error: %.2X.\n", msg, hr); goto done; } } while (0)
 LPCSTR GetGUIDNameConst(const GUID & guid);
 #define CHECKHR_GOTO(x, y) if(FAILED(x)) goto y
 
@@ -80,11 +108,25 @@ enum class DeviceType { Audio, Video };
 // Util functions
 void print_guid(GUID guid);
 void dump_sample(IMFSample* pSample);
-void save_bmp(IMFSample* pSample, int width, int height);
+void dump_sample(IMFSample* pSample, size_t start, size_t count);
+void diff_samples(IMFSample* pSampleA, IMFSample* pSampleB);
 void print_attr(IMFAttributes* pAttr);
+HRESULT decode_sample(IMJPEGDecoder* pDecoder, IMFSample* pSample, NV12Frame* pFrame);
+HRESULT copy_sample(IMFSample* pSample, std::vector<uint8_t>* pBytes);
+HRESULT copy_sample(IMFSample* pSample, FrameArena* pArena, CompressedFrame* pFrame);
+HRESULT read_sample(IMFSourceReader* pReader, ReplaySource* pReplay, DWORD* pFlags, LONGLONG* pTimestamp,
+	IMFSample** ppSample);
+
+// Called on a Media Foundation work queue thread (or a FrameScheduler thread) for each decoded frame, in capture order.
+static void OnDecodedFrame(void* pContext, uint64_t sequence, NV12Frame* pFrame)
+{
+	TRACE_INSTANT(TRACE_RELEASE, pFrame->timestamp);
+	ReleaseFrame(pFrame);
+}
 
 int main()
 {
+	HRESULT hr = S_OK;
 	IMFMediaSource* videoSource = NULL;
 	UINT32 videoDeviceCount = 0;
 	IMFAttributes* videoConfig = NULL;
@@ -95,86 +137,246 @@ int main()
 	IMFMediaType* pSrcOutMediaType = NULL;
 	UINT webcamNameLength = 0;
 	MJPEGDecoder* pDecoder = NULL;
+	SoftMJPEGDecoder* pSoftDecoder = NULL;
+	std::vector<std::vector<uint8_t>> capturedFrames;
+	std::vector<IMJPEGDecoder*> schedulerDecoders;
+	FrameScheduler* pScheduler = NULL;
+	FrameArena* pInputArena = NULL;
+	FrameDumpSink* pDumpSink = NULL;
+	ReplaySource* pReplay = NULL;
+	UINT32 frameWidth = FRAME_WIDTH;
+	UINT32 frameHeight = FRAME_HEIGHT;
+
+	if (VERIFY_SIMD_KERNELS) {
+		printf("IDCT kernel mismatches: %u\n", VerifyIdctKernels(1000000, 1));
+		int maxError;
+		uint32_t colorMismatches = VerifyColorKernels(10000, 1, &maxError);
+		printf("Color conversion mismatches: %u, max error %d\n", colorMismatches, maxError);
+	}
 
 	CHECK_HR(CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE),
 		"COM initialisation failed.");
 	CHECK_HR(MFStartup(MF_VERSION),
 		"Media Foundation initialisation failed.");
 
-	// Get the first available webcam.
-	CHECK_HR(MFCreateAttributes(&videoConfig, 1), 
-		"Error creating video configuation.");
-
-	// Request video capture devices.
-	CHECK_HR(videoConfig->SetGUID(
-		MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-		MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID), 
-		"Error initialising video configuration object.");
-	CHECK_HR(MFEnumDeviceSources(videoConfig, &videoDevices, &videoDeviceCount), 
-		"Error enumerating video devices.");
-	CHECK_HR(videoDevices[WEBCAM_DEVICE_INDEX]->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME, &webcamFriendlyName, &webcamNameLength),
-		"Error retrieving video device friendly name.");
-	wprintf(L"First available webcam: %s\n", webcamFriendlyName);
-
-	CHECK_HR(videoDevices[WEBCAM_DEVICE_INDEX]->ActivateObject(IID_PPV_ARGS(&videoSource)), 
-		"Error activating video device.");
-
-	// Create a source reader.
-	CHECK_HR(MFCreateSourceReaderFromMediaSource(
-		videoSource,
-		videoConfig,
-		&videoReader), 
-		"Error creating video source reader.");
-
-	// The list of media types supported by the webcam.
-	//ListModes(videoReader);
-
-	// Note the webcam needs to support this media type.
-	CHECK_HR(MFCreateMediaType(&pSrcOutMediaType), "Failed to create media type.");
-	CHECK_HR(pSrcOutMediaType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video), "Failed to set video media type.");
-	CHECK_HR(pSrcOutMediaType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_MJPG /*WMMEDIASUBTYPE_I420*/), "Failed to set video media sub type to MJPG.");
-	CHECK_HR(MFSetAttributeSize(pSrcOutMediaType, MF_MT_FRAME_SIZE, FRAME_WIDTH, FRAME_HEIGHT), "Failed to set frame size.");
-	//CHECK_HR(CopyAttribute(videoSourceOutputType, pSrcOutMediaType, MF_MT_DEFAULT_STRIDE), "Failed to copy default stride attribute.");
-	CHECK_HR(videoReader->SetCurrentMediaType(0, NULL, pSrcOutMediaType),
-		"Failed to set media type on source reader.");
+	if (REPLAY_FILENAME) {
+		// Frames come from a file instead of the webcam, at the size they were recorded.
+		JpegHeader header;
+		CompressedFrame first;
+		pReplay = new ReplaySource();
+		CHECK_HR(pReplay->Open(REPLAY_FILENAME), "Error opening replay file.");
+		pReplay->SetPacing(REPLAY_FPS);
+		pReplay->GetFrame(0, &first);
+		if (ParseJpegHeader(first.pData, first.len, &header) == S_OK) {
+			frameWidth = header.width;
+			frameHeight = header.height;
+		}
+	}
+	else {
+		// Get the first available webcam.
+		CHECK_HR(MFCreateAttributes(&videoConfig, 1), 
+			"Error creating video configuation.");
+
+		// Request video capture devices.
+		CHECK_HR(videoConfig->SetGUID(
+			MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
+			MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID), 
+			"Error initialising video configuration object.");
+		CHECK_HR(MFEnumDeviceSources(videoConfig, &videoDevices, &videoDeviceCount), 
+			"Error enumerating video devices.");
+		CHECK_HR(videoDevices[WEBCAM_DEVICE_INDEX]->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME, &webcamFriendlyName, &webcamNameLength),
+			"Error retrieving video device friendly name.");
+		wprintf(L"First available webcam: %s\n", webcamFriendlyName);
+
+		CHECK_HR(videoDevices[WEBCAM_DEVICE_INDEX]->ActivateObject(IID_PPV_ARGS(&videoSource)), 
+			"Error activating video device.");
+
+		// Create a source reader.
+		CHECK_HR(MFCreateSourceReaderFromMediaSource(
+			videoSource,
+			videoConfig,
+			&videoReader), 
+			"Error creating video source reader.");
+
+		// The list of media types supported by the webcam.
+		//ListModes(videoReader);
+
+		// Note the webcam needs to support this media type.
+		CHECK_HR(MFCreateMediaType(&pSrcOutMediaType), "Failed to create media type.");
+		CHECK_HR(pSrcOutMediaType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video), "Failed to set video media type.");
+		CHECK_HR(pSrcOutMediaType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_MJPG /*WMMEDIASUBTYPE_I420*/), "Failed to set video media sub type to MJPG.");
+		CHECK_HR(MFSetAttributeSize(pSrcOutMediaType, MF_MT_FRAME_SIZE, FRAME_WIDTH, FRAME_HEIGHT), "Failed to set frame size.");
+		//CHECK_HR(CopyAttribute(videoSourceOutputType, pSrcOutMediaType, MF_MT_DEFAULT_STRIDE), "Failed to copy default stride attribute.");
+		CHECK_HR(videoReader->SetCurrentMediaType(0, NULL, pSrcOutMediaType),
+			"Failed to set media type on source reader.");
+	}
 
 	pDecoder = new MJPEGDecoder();
+	if (DUMP_EVERY_N_FRAMES > 0) {
+		pDumpSink = new FrameDumpSink("frame", FRAME_DUMP_PLANES_BMP, DUMP_EVERY_N_FRAMES, DUMP_QUEUE_SIZE, FRAME_DUMP_DROP);
+		pDecoder->SetDumpSink(pDumpSink);
+	}
 	pDecoder->Find();
-	pDecoder->Configure(FRAME_WIDTH, FRAME_HEIGHT, FRAME_RATE);
+	pDecoder->Configure(frameWidth, frameHeight, FRAME_RATE);
 	pDecoder->Start();
+	if (DECODE_IN_FLIGHT > 0) {
+		pDecoder->StartAsync(DECODE_IN_FLIGHT, OnDecodedFrame, NULL);
+	}
+	else if (COMPARE_SOFTWARE_DECODER) {
+		pSoftDecoder = new SoftMJPEGDecoder();
+		pSoftDecoder->Configure(frameWidth, frameHeight, FRAME_RATE);
+		pSoftDecoder->SetThreadCount(SOFTWARE_DECODE_THREADS);
+		pSoftDecoder->Start();
+	}
+	if (SOFTWARE_DECODE_WORKERS > 0) {
+		for (int i = 0; i < SOFTWARE_DECODE_WORKERS; ++i) {
+			DecodeOptions decodeOptions;
+			DecodeRect crop = SOFTWARE_DECODE_CROP;
+			GetDefaultDecodeOptions(&decodeOptions);
+			decodeOptions.scale = SOFTWARE_DECODE_SCALE;
+			decodeOptions.crop = crop;
+			decodeOptions.lumaOnly = SOFTWARE_DECODE_LUMA_ONLY != 0;
+			schedulerDecoders.push_back(new SoftMJPEGDecoder());
+			schedulerDecoders.back()->Configure(frameWidth, frameHeight, FRAME_RATE);
+			schedulerDecoders.back()->SetDecodeOptions(decodeOptions);
+			schedulerDecoders.back()->Start();
+		}
+		pInputArena = new FrameArena(INPUT_ARENA_SIZE);
+		pScheduler = new FrameScheduler(schedulerDecoders.data(), SOFTWARE_DECODE_WORKERS, 2 * SOFTWARE_DECODE_WORKERS);
+		pScheduler->SetCallback(OnDecodedFrame, NULL);
+	}
 
 	IMFSample* videoSample = NULL;
-	IMFSample* decodedSample = NULL;
-	DWORD streamIndex, flags;
+	NV12Frame decodedFrame;
+	NV12Frame softFrame;
+	NV12FrameDiff diff;
+	DWORD flags;
 	LONGLONG llVideoTimeStamp, llSampleDuration;
 	int sampleCount = 0;
 
+	TRACE_THREAD_NAME("capture");
 	while (sampleCount <= SAMPLE_COUNT)
 	{
-		CHECK_HR(videoReader->ReadSample(
-			MF_SOURCE_READER_FIRST_VIDEO_STREAM,
-			0,                              // Flags.
-			&streamIndex,                   // Receives the actual stream index. 
-			&flags,                         // Receives status flags.
-			&llVideoTimeStamp,              // Receives the time stamp.
-			&videoSample                    // Receives the sample or NULL.
-		), "Error reading video sample.");
+		CHECK_HR(read_sample(videoReader, pReplay, &flags, &llVideoTimeStamp, &videoSample),
+			"Error reading video sample.");
+
+		if (flags & MF_SOURCE_READERF_ENDOFSTREAM)
+		{
+			break;
+		}
 
 		if (flags & MF_SOURCE_READERF_STREAMTICK)
 		{
-			printf("Stream tick.\n");
+			LOG_DEBUG("Stream tick.\n");
 		}
 
 		if (videoSample == NULL) {
 			continue;
 		}
+		TRACE_INSTANT(TRACE_READ_SAMPLE, llVideoTimeStamp);
 
-		decodedSample = pDecoder->DecodeOneFrame(videoSample);
-		decodedSample->Release();
+		if (BENCHMARK_CAPTURED_FRAMES) {
+			capturedFrames.push_back(std::vector<uint8_t>());
+			copy_sample(videoSample, &capturedFrames.back());
+		}
+
+		if (pScheduler) {
+			CompressedFrame input;
+			if (copy_sample(videoSample, pInputArena, &input) == S_OK) {
+				input.timestamp = llVideoTimeStamp;
+				pScheduler->Submit(&input, true);
+			}
+		}
+
+		if (DECODE_IN_FLIGHT > 0) {
+			// Returns as soon as the frame is queued, so the next ReadSample overlaps decoding.
+			TRACE_BEGIN(TRACE_SUBMIT, llVideoTimeStamp);
+			pDecoder->SubmitFrame(videoSample, llVideoTimeStamp, true);
+			TRACE_END(TRACE_SUBMIT, llVideoTimeStamp);
+		}
+		else {
+			// The hardware decoder releases the input sample, so decode on the CPU first.
+			bool compare = pSoftDecoder && decode_sample(pSoftDecoder, videoSample, &softFrame) == S_OK;
+			if (pDecoder->DecodeOneFrame(videoSample, &decodedFrame) == S_OK) {
+				// Zero copy: the frame points into the decoder's padded output buffer.
+				if (compare && CompareNV12Frames(&decodedFrame, &softFrame, &diff)) {
+					LOG_INFO("frame %d hw/sw diff Y max=%u mean=%.3f UV max=%u mean=%.3f\n", sampleCount,
+						diff.maxDiffY, diff.meanDiffY, diff.maxDiffUV, diff.meanDiffUV);
+				}
+				TRACE_INSTANT(TRACE_RELEASE, llVideoTimeStamp);
+				ReleaseFrame(&decodedFrame);
+			}
+			if (compare) {
+				ReleaseFrame(&softFrame);
+			}
+		}
 
 		sampleCount++;
 	}
 
+	pDecoder->StopAsync();
+	// Decoder messages are written asynchronously; get them out before the summary.
+	LogFlush();
+	if (pDumpSink) {
+		pDumpSink->Flush();
+		FrameDumpStats dumpStats = pDumpSink->GetStats();
+		printf("Frame dump: %llu written, %llu dropped, %llu failed\n", (unsigned long long)dumpStats.written,
+			(unsigned long long)dumpStats.dropped, (unsigned long long)dumpStats.failed);
+	}
+	if (pScheduler) {
+		pScheduler->Drain();
+		FrameSchedulerStats stats = pScheduler->GetStats();
+		printf("Frame scheduler: %llu delivered, %llu failed, max queue %u, max reorder %u, reorder wait mean %.2f ms max %.2f ms\n",
+			(unsigned long long)stats.delivered, (unsigned long long)stats.failed, stats.maxQueueDepth,
+			stats.maxReorderDepth, stats.meanReorderMs, stats.maxReorderMs);
+		FrameArenaStats arenaStats = pInputArena->GetStats();
+		printf("Input arena: %llu frames, %llu heap allocations, %zu byte chunk, high water %zu bytes\n",
+			(unsigned long long)arenaStats.allocations, (unsigned long long)arenaStats.mallocs,
+			arenaStats.chunkSize, arenaStats.highWater);
+	}
+	if (pDecoder->m_pOutputPool) {
+		BufferPoolStats poolStats = pDecoder->m_pOutputPool->GetStats();
+		printf("Output sample pool: %u of %u buffers allocated, high water %u, %llu acquired, %llu exhausted\n",
+			poolStats.allocated, poolStats.capacity, poolStats.highWater, (unsigned long long)poolStats.acquired,
+			(unsigned long long)poolStats.exhausted);
+	}
+	if (pSoftDecoder) {
+		printf("Software decoder header cache: %llu hits, %llu misses\n",
+			(unsigned long long)pSoftDecoder->m_headerCache.Hits(), (unsigned long long)pSoftDecoder->m_headerCache.Misses());
+	}
+
+	if (FRAME_TRACE) {
+		PrintTraceLatencies();
+		if (WriteChromeTrace(TRACE_FILENAME)) {
+			printf("Trace written to %s\n", TRACE_FILENAME);
+		}
+	}
+
+	if (BENCHMARK_CAPTURED_FRAMES && !capturedFrames.empty()) {
+		std::vector<const uint8_t*> frames;
+		std::vector<size_t> lengths;
+		for (size_t i = 0; i < capturedFrames.size(); ++i) {
+			frames.push_back(capturedFrames[i].data());
+			lengths.push_back(capturedFrames[i].size());
+		}
+		RunHuffmanBenchmark(frames.data(), lengths.data(), (uint32_t)frames.size(), 10);
+		RunRestartScalingBenchmark(frames.data(), lengths.data(), (uint32_t)frames.size(), 5, 16);
+		RunFrameSchedulerBenchmark(frames.data(), lengths.data(), (uint32_t)frames.size(), 5, 8);
+		RunGuidNameBenchmark(100000);
+		RunLoggerBenchmark(1000000);
+		RunColorConvertBenchmark(FRAME_WIDTH, FRAME_HEIGHT, 100);
+		if (REPLAY_FILENAME) {
+			// The replayed file through a second hardware decoder and the software decoder.
+			const char* corpus[1] = { REPLAY_FILENAME };
+			MJPEGDecoder benchHardware;
+			SoftMJPEGDecoder benchSoftware;
+			DecodeSuiteBackend backends[2] = { { "software", &benchSoftware }, { "AMD MFT", &benchHardware } };
+			DecodeSuiteOptions options = { 5, 0, DECODE_STEP_ALL & ~DECODE_STEP_DUMP, NULL };
+			uint32_t backendCount = benchHardware.Find() == S_OK ? 2 : 1;
+			WriteDecodeSuiteJson(DECODE_SUITE_FILENAME, options, RunDecodeSuite(corpus, 1, backends, backendCount, options));
+		}
+	}
+
 done:
 	//pDecoder->Close();
 	printf("finished.\n");
@@ -186,10 +388,58 @@ done:
 	SAFE_RELEASE(videoReader);
 	SAFE_RELEASE(videoSourceOutputType);
 	SAFE_RELEASE(pSrcOutMediaType);
+	delete pSoftDecoder;
+	delete pScheduler;
+	delete pInputArena;
+	if (pDecoder) {
+		pDecoder->SetDumpSink(NULL);
+	}
+	delete pDumpSink;
+	for (size_t i = 0; i < schedulerDecoders.size(); ++i) {
+		delete schedulerDecoders[i];
+	}
+	// Replayed samples point into the file mapping, so it goes last.
+	delete pReplay;
 
 	return 0;
 }
 
+// Feeds the compressed bytes of a captured sample to a decoder backend.
+HRESULT decode_sample(IMJPEGDecoder* pDecoder, IMFSample* pSample, NV12Frame* pFrame)
+{
+	HRESULT hr = S_OK;
+	IMFMediaBuffer* mediaBuffer = NULL;
+	BYTE* pData = NULL;
+	DWORD len = 0;
+
+	CHECK_HR(pSample->ConvertToContiguousBuffer(&mediaBuffer), "ConvertToContiguousBuffer failed");
+	CHECK_HR(mediaBuffer->Lock(&pData, NULL, &len), "Lock failed");
+	hr = pDecoder->DecodeOneFrame(pData, len, pFrame);
+	mediaBuffer->Unlock();
+
+done:
+	SAFE_RELEASE(mediaBuffer);
+	return hr;
+}
+
+// Copies the compressed bytes of a captured sample.
+HRESULT copy_sample(IMFSample* pSample, std::vector<uint8_t>* pBytes)
+{
+	HRESULT hr = S_OK;
+	IMFMediaBuffer* mediaBuffer = NULL;
+	BYTE* pData = NULL;
+	DWORD len = 0;
+
+	CHECK_HR(pSample->ConvertToContiguousBuffer(&mediaBuffer), "ConvertToContiguousBuffer failed");
+	CHECK_HR(mediaBuffer->Lock(&pData, NULL, &len), "Lock failed");
+	pBytes->assign(pData, pData + len);
+	mediaBuffer->Unlock();
+
+done:
+	SAFE_RELEASE(mediaBuffer);
+	return hr;
+}
+
 
 void print_guid(GUID guid) {
 	printf("Guid = {%08lX-%04hX-%04hX-%02hhX%02hhX-%02hhX%02hhX%02hhX%02hhX%02hhX%02hhX}\n",
@@ -199,101 +449,58 @@ void print_guid(GUID guid) {
 }
 
 void dump_sample(IMFSample* pSample)
+{
+	dump_sample(pSample, 0, (size_t)-1);
+}
+
+// Hex dumps count bytes of the sample from start on.
+void dump_sample(IMFSample* pSample, size_t start, size_t count)
 {
 	HRESULT hr;
-	HANDLE file;
-	BITMAPFILEHEADER fileHeader;
-	BITMAPINFOHEADER fileInfo;
-	DWORD len;
-	DWORD bufferCount;
+	DWORD len = 0;
+	DWORD bufferCount = 0;
 	IMFMediaBuffer* mediaBuffer = NULL;
 	BYTE* pData = NULL;
-	int cnt = 0;
 
 	hr = pSample->GetBufferCount(&bufferCount);
 	printf("dump_sample bufferCount=%d\n", bufferCount);
-	pSample->ConvertToContiguousBuffer(&mediaBuffer);
-	hr = mediaBuffer->Lock(&pData, NULL, NULL);
-	hr = mediaBuffer->GetCurrentLength(&len);
+	CHECK_HR(pSample->ConvertToContiguousBuffer(&mediaBuffer), "ConvertToContiguousBuffer failed");
+	CHECK_HR(mediaBuffer->Lock(&pData, NULL, &len), "Lock failed");
 	printf("dump_sample len=%d\n", len);
-	char buf[32 * 4 + 32];
-	char tmp[8];
-	snprintf(buf, sizeof(buf), "%08x: ", cnt);
-	for (int i = 0; i < len; ++i) {
-		++cnt;
-		snprintf(tmp, sizeof(tmp), "%02x ", pData[i]);
-		strncat(buf, tmp, sizeof(buf));
-		if (i % 32 == 31) {
-			printf(buf);
-			printf("\n");
-			snprintf(buf, sizeof(buf), "%08x: ", cnt);
-		}
-	}
+	fflush(stdout);
+	HexDump(HEX_DUMP_STDOUT, pData, len, start, count);
 	mediaBuffer->Unlock();
+
+done:
+	SAFE_RELEASE(mediaBuffer);
 }
-void save_bmp(IMFSample* pSample, int width, int height)
+
+// Hex dumps the lines where two samples differ, e.g. the same frame before and
+// after a repack.
+void diff_samples(IMFSample* pSampleA, IMFSample* pSampleB)
 {
 	HRESULT hr;
-	HANDLE file;
-	BITMAPFILEHEADER fileHeader;
-	BITMAPINFOHEADER fileInfo;
-	DWORD write = 0;
-	IMFMediaBuffer* mediaBuffer = NULL;
-	BYTE* pData = NULL;
-
-	OutputDebugStringA("save_bmp start\n");
-	file = CreateFile(PLANE_Y_FILENAME, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);  //Sets up the new bmp to be written to
-
-	fileHeader.bfType = 19778;                                                  //Sets our type to BM or bmp
-	fileHeader.bfSize = sizeof(fileHeader.bfOffBits) + sizeof(RGBTRIPLE);       //Sets the size equal to the size of the header struct
-	fileHeader.bfReserved1 = 0;                                                 //sets the reserves to 0
-	fileHeader.bfReserved2 = 0;
-	fileHeader.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER); //Sets offbits equal to the size of file and info header
-
-	fileInfo.biSize = sizeof(BITMAPINFOHEADER);
-	fileInfo.biWidth = width;
-	fileInfo.biHeight = height;
-	fileInfo.biPlanes = 1;
-	fileInfo.biBitCount = 8;
-	fileInfo.biCompression = BI_RGB;
-	fileInfo.biSizeImage = width * height;
-	fileInfo.biXPelsPerMeter = 2400;
-	fileInfo.biYPelsPerMeter = 2400;
-	fileInfo.biClrImportant = 0;
-	fileInfo.biClrUsed = 256;
-
-	WriteFile(file, &fileHeader, sizeof(fileHeader), &write, NULL);
-	WriteFile(file, &fileInfo, sizeof(fileInfo), &write, NULL);
-	// color table
-	for (int i = 0; i < 256; ++i) {
-		unsigned char col[4];
-		col[0] = col[1] = col[2] = i;
-		col[3] = 0;
-		WriteFile(file, col, 4, &write, NULL);
+	IMFMediaBuffer* bufferA = NULL;
+	IMFMediaBuffer* bufferB = NULL;
+	BYTE* pA = NULL;
+	BYTE* pB = NULL;
+	DWORD lenA = 0;
+	DWORD lenB = 0;
+
+	CHECK_HR(pSampleA->ConvertToContiguousBuffer(&bufferA), "ConvertToContiguousBuffer failed");
+	CHECK_HR(pSampleB->ConvertToContiguousBuffer(&bufferB), "ConvertToContiguousBuffer failed");
+	CHECK_HR(bufferA->Lock(&pA, NULL, &lenA), "Lock failed");
+	hr = bufferB->Lock(&pB, NULL, &lenB);
+	if (hr == S_OK) {
+		fflush(stdout);
+		HexDiff(HEX_DUMP_STDOUT, pA, lenA, pB, lenB);
+		bufferB->Unlock();
 	}
-	pSample->ConvertToContiguousBuffer(&mediaBuffer);
-	hr = mediaBuffer->Lock(&pData, NULL, NULL);
-	WriteFile(file, pData, fileInfo.biSizeImage, &write, NULL);
-	CloseHandle(file);
-
-	write = 0;
-	file = CreateFile(PLANE_UV_FILENAME, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);  // UV plane
-	fileInfo.biWidth = width;
-	fileInfo.biHeight = height / 2;
-	fileInfo.biSizeImage = width * height / 2;
-	WriteFile(file, &fileHeader, sizeof(fileHeader), &write, NULL);
-	WriteFile(file, &fileInfo, sizeof(fileInfo), &write, NULL);
-	// color table
-	for (int i = 0; i < 256; ++i) {
-		unsigned char col[4];
-		col[0] = col[1] = col[2] = i;
-		col[3] = 0;
-		WriteFile(file, col, 4, &write, NULL);
-	}
-	WriteFile(file, pData + width * height, width * height / 2, &write, NULL);
-	CloseHandle(file);
-	mediaBuffer->Unlock();
-	OutputDebugStringA("save_bmp end\n");
+	bufferA->Unlock();
+
+done:
+	SAFE_RELEASE(bufferA);
+	SAFE_RELEASE(bufferB);
 }
 void print_attr(IMFAttributes* pAttr)
 {
@@ -304,7 +511,7 @@ void print_attr(IMFAttributes* pAttr)
 	hr = pAttr->GetCount(&cnt);
 	for (int i = 0; i < cnt; ++i) {
 		hr = pAttr->GetItemByIndex(i, &guid, &pv);
-		printf("attr i=%d %s\n", i, GetGUIDNameConst(guid));
+		LOG_DEBUG("attr i=%d %s\n", i, GetGUIDNameConst(guid));
 		//print_guid(guid);
 		if (guid == MF_MT_MINIMUM_DISPLAY_APERTURE) {
 			MFVideoArea aperture;
@@ -321,152 +528,68 @@ void print_attr(IMFAttributes* pAttr)
 
 	}
 }
-LPCSTR GetGUIDNameConst(const GUID& guid)
+
+// Copies the compressed bytes of a captured sample into a span of the arena
+// that is freed when the FrameScheduler is done with it.
+HRESULT copy_sample(IMFSample* pSample, FrameArena* pArena, CompressedFrame* pFrame)
 {
-	IF_EQUAL_RETURN(guid, MF_MT_MAJOR_TYPE);
-	IF_EQUAL_RETURN(guid, MF_MT_MAJOR_TYPE);
-	IF_EQUAL_RETURN(guid, MF_MT_SUBTYPE);
-	IF_EQUAL_RETURN(guid, MF_MT_ALL_SAMPLES_INDEPENDENT);
-	IF_EQUAL_RETURN(guid, MF_MT_FIXED_SIZE_SAMPLES);
-	IF_EQUAL_RETURN(guid, MF_MT_COMPRESSED);
-	IF_EQUAL_RETURN(guid, MF_MT_SAMPLE_SIZE);
-	IF_EQUAL_RETURN(guid, MF_MT_WRAPPED_TYPE);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_NUM_CHANNELS);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_SAMPLES_PER_SECOND);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_AVG_BYTES_PER_SECOND);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_BLOCK_ALIGNMENT);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_BITS_PER_SAMPLE);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_VALID_BITS_PER_SAMPLE);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_SAMPLES_PER_BLOCK);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_CHANNEL_MASK);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_FOLDDOWN_MATRIX);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_PEAKREF);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_PEAKTARGET);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_AVGREF);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_AVGTARGET);
-	IF_EQUAL_RETURN(guid, MF_MT_AUDIO_PREFER_WAVEFORMATEX);
-	IF_EQUAL_RETURN(guid, MF_MT_AAC_PAYLOAD_TYPE);
-	IF_EQUAL_RETURN(guid, MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION);
-	IF_EQUAL_RETURN(guid, MF_MT_FRAME_SIZE);
-	IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE);
-	IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE_RANGE_MAX);
-	IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE_RANGE_MIN);
-	IF_EQUAL_RETURN(guid, MF_MT_PIXEL_ASPECT_RATIO);
-	IF_EQUAL_RETURN(guid, MF_MT_DRM_FLAGS);
-	IF_EQUAL_RETURN(guid, MF_MT_PAD_CONTROL_FLAGS);
-	IF_EQUAL_RETURN(guid, MF_MT_SOURCE_CONTENT_HINT);
-	IF_EQUAL_RETURN(guid, MF_MT_VIDEO_CHROMA_SITING);
-	IF_EQUAL_RETURN(guid, MF_MT_INTERLACE_MODE);
-	IF_EQUAL_RETURN(guid, MF_MT_TRANSFER_FUNCTION);
-	IF_EQUAL_RETURN(guid, MF_MT_VIDEO_PRIMARIES);
-	IF_EQUAL_RETURN(guid, MF_MT_CUSTOM_VIDEO_PRIMARIES);
-	IF_EQUAL_RETURN(guid, MF_MT_YUV_MATRIX);
-	IF_EQUAL_RETURN(guid, MF_MT_VIDEO_LIGHTING);
-	IF_EQUAL_RETURN(guid, MF_MT_VIDEO_NOMINAL_RANGE);
-	IF_EQUAL_RETURN(guid, MF_MT_GEOMETRIC_APERTURE);
-	IF_EQUAL_RETURN(guid, MF_MT_MINIMUM_DISPLAY_APERTURE);
-	IF_EQUAL_RETURN(guid, MF_MT_PAN_SCAN_APERTURE);
-	IF_EQUAL_RETURN(guid, MF_MT_PAN_SCAN_ENABLED);
-	IF_EQUAL_RETURN(guid, MF_MT_AVG_BITRATE);
-	IF_EQUAL_RETURN(guid, MF_MT_AVG_BIT_ERROR_RATE);
-	IF_EQUAL_RETURN(guid, MF_MT_MAX_KEYFRAME_SPACING);
-	IF_EQUAL_RETURN(guid, MF_MT_DEFAULT_STRIDE);
-	IF_EQUAL_RETURN(guid, MF_MT_PALETTE);
-	IF_EQUAL_RETURN(guid, MF_MT_USER_DATA);
-	IF_EQUAL_RETURN(guid, MF_MT_AM_FORMAT_TYPE);
-	IF_EQUAL_RETURN(guid, MF_MT_MPEG_START_TIME_CODE);
-	IF_EQUAL_RETURN(guid, MF_MT_MPEG2_PROFILE);
-	IF_EQUAL_RETURN(guid, MF_MT_MPEG2_LEVEL);
-	IF_EQUAL_RETURN(guid, MF_MT_MPEG2_FLAGS);
-	IF_EQUAL_RETURN(guid, MF_MT_MPEG_SEQUENCE_HEADER);
-	IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_SRC_PACK_0);
-	IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_CTRL_PACK_0);
-	IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_SRC_PACK_1);
-	IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_CTRL_PACK_1);
-	IF_EQUAL_RETURN(guid, MF_MT_DV_VAUX_SRC_PACK);
-	IF_EQUAL_RETURN(guid, MF_MT_DV_VAUX_CTRL_PACK);
-	IF_EQUAL_RETURN(guid, MF_MT_ARBITRARY_HEADER);
-	IF_EQUAL_RETURN(guid, MF_MT_ARBITRARY_FORMAT);
-	IF_EQUAL_RETURN(guid, MF_MT_IMAGE_LOSS_TOLERANT);
-	IF_EQUAL_RETURN(guid, MF_MT_MPEG4_SAMPLE_DESCRIPTION);
-	IF_EQUAL_RETURN(guid, MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY);
-	IF_EQUAL_RETURN(guid, MF_MT_ORIGINAL_4CC);
-	IF_EQUAL_RETURN(guid, MF_MT_ORIGINAL_WAVE_FORMAT_TAG);
-
-	// Media types
-
-	IF_EQUAL_RETURN(guid, MFMediaType_Audio);
-	IF_EQUAL_RETURN(guid, MFMediaType_Video);
-	IF_EQUAL_RETURN(guid, MFMediaType_Protected);
-	IF_EQUAL_RETURN(guid, MFMediaType_SAMI);
-	IF_EQUAL_RETURN(guid, MFMediaType_Script);
-	IF_EQUAL_RETURN(guid, MFMediaType_Image);
-	IF_EQUAL_RETURN(guid, MFMediaType_HTML);
-	IF_EQUAL_RETURN(guid, MFMediaType_Binary);
-	IF_EQUAL_RETURN(guid, MFMediaType_FileTransfer);
-
-	IF_EQUAL_RETURN(guid, MFVideoFormat_AI44); //     FCC('AI44')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_ARGB32); //   D3DFMT_A8R8G8B8 
-	IF_EQUAL_RETURN(guid, MFVideoFormat_AYUV); //     FCC('AYUV')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_DV25); //     FCC('dv25')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_DV50); //     FCC('dv50')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_DVH1); //     FCC('dvh1')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_DVSD); //     FCC('dvsd')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_DVSL); //     FCC('dvsl')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_H264); //     FCC('H264')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_I420); //     FCC('I420')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_IYUV); //     FCC('IYUV')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_M4S2); //     FCC('M4S2')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_MJPG);
-	IF_EQUAL_RETURN(guid, MFVideoFormat_MP43); //     FCC('MP43')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_MP4S); //     FCC('MP4S')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_MP4V); //     FCC('MP4V')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_MPG1); //     FCC('MPG1')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_MSS1); //     FCC('MSS1')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_MSS2); //     FCC('MSS2')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_NV11); //     FCC('NV11')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_NV12); //     FCC('NV12')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_P010); //     FCC('P010')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_P016); //     FCC('P016')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_P210); //     FCC('P210')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_P216); //     FCC('P216')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_RGB24); //    D3DFMT_R8G8B8 
-	IF_EQUAL_RETURN(guid, MFVideoFormat_RGB32); //    D3DFMT_X8R8G8B8 
-	IF_EQUAL_RETURN(guid, MFVideoFormat_RGB555); //   D3DFMT_X1R5G5B5 
-	IF_EQUAL_RETURN(guid, MFVideoFormat_RGB565); //   D3DFMT_R5G6B5 
-	IF_EQUAL_RETURN(guid, MFVideoFormat_RGB8);
-	IF_EQUAL_RETURN(guid, MFVideoFormat_UYVY); //     FCC('UYVY')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_v210); //     FCC('v210')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_v410); //     FCC('v410')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_WMV1); //     FCC('WMV1')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_WMV2); //     FCC('WMV2')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_WMV3); //     FCC('WMV3')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_WVC1); //     FCC('WVC1')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_Y210); //     FCC('Y210')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_Y216); //     FCC('Y216')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_Y410); //     FCC('Y410')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_Y416); //     FCC('Y416')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_Y41P);
-	IF_EQUAL_RETURN(guid, MFVideoFormat_Y41T);
-	IF_EQUAL_RETURN(guid, MFVideoFormat_YUY2); //     FCC('YUY2')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_YV12); //     FCC('YV12')
-	IF_EQUAL_RETURN(guid, MFVideoFormat_YVYU);
-
-	IF_EQUAL_RETURN(guid, MFAudioFormat_PCM); //              WAVE_FORMAT_PCM 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_Float); //            WAVE_FORMAT_IEEE_FLOAT 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_DTS); //              WAVE_FORMAT_DTS 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_Dolby_AC3_SPDIF); //  WAVE_FORMAT_DOLBY_AC3_SPDIF 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_DRM); //              WAVE_FORMAT_DRM 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudioV8); //        WAVE_FORMAT_WMAUDIO2 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudioV9); //        WAVE_FORMAT_WMAUDIO3 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudio_Lossless); // WAVE_FORMAT_WMAUDIO_LOSSLESS 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_WMASPDIF); //         WAVE_FORMAT_WMASPDIF 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_MSP1); //             WAVE_FORMAT_WMAVOICE9 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_MP3); //              WAVE_FORMAT_MPEGLAYER3 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_MPEG); //             WAVE_FORMAT_MPEG 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_AAC); //              WAVE_FORMAT_MPEG_HEAAC 
-	IF_EQUAL_RETURN(guid, MFAudioFormat_ADTS); //             WAVE_FORMAT_MPEG_ADTS_AAC 
-
-	return NULL;
-}
\ No newline at end of file
+	HRESULT hr = S_OK;
+	IMFMediaBuffer* mediaBuffer = NULL;
+	BYTE* pData = NULL;
+	DWORD len = 0;
+	uint8_t* pSpan = NULL;
+
+	CHECK_HR(pSample->ConvertToContiguousBuffer(&mediaBuffer), "ConvertToContiguousBuffer failed");
+	CHECK_HR(mediaBuffer->Lock(&pData, NULL, &len), "Lock failed");
+	pSpan = pArena->Allocate(len);
+	if (pSpan) {
+		memcpy(pSpan, pData, len);
+		pFrame->pData = pSpan;
+		pFrame->len = len;
+		pFrame->timestamp = 0;
+		pFrame->pfnRelease = FrameArena::FreeSpan;
+		pFrame->pOwner = pSpan;
+	}
+	else {
+		hr = E_OUTOFMEMORY;
+	}
+	mediaBuffer->Unlock();
+
+done:
+	SAFE_RELEASE(mediaBuffer);
+	return hr;
+}
+
+// Reads the next frame from the webcam or, with a replay source, from the
+// file. The replayed sample wraps the mapped frame without a copy. At the
+// end of the file *pFlags gets MF_SOURCE_READERF_ENDOFSTREAM.
+HRESULT read_sample(IMFSourceReader* pReader, ReplaySource* pReplay, DWORD* pFlags, LONGLONG* pTimestamp,
+	IMFSample** ppSample)
+{
+	HRESULT hr;
+	DWORD streamIndex;
+	CompressedFrame frame;
+
+	if (pReplay == NULL) {
+		return pReader->ReadSample(
+			MF_SOURCE_READER_FIRST_VIDEO_STREAM,
+			0,                              // Flags.
+			&streamIndex,                   // Receives the actual stream index.
+			pFlags,                         // Receives status flags.
+			pTimestamp,                     // Receives the time stamp.
+			ppSample                        // Receives the sample or NULL.
+		);
+	}
+	*pFlags = 0;
+	*ppSample = NULL;
+	hr = pReplay->ReadFrame(&frame);
+	if (hr == S_FALSE) {
+		*pFlags = MF_SOURCE_READERF_ENDOFSTREAM;
+		return S_OK;
+	}
+	if (hr != S_OK) {
+		return hr;
+	}
+	*pTimestamp = frame.timestamp;
+	return CreateSampleFromMemory(frame.pData, (DWORD)frame.len, frame.timestamp, ppSample);
+}
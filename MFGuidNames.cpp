@@ -0,0 +1,124 @@
+#include <mfapi.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "GuidNames.h"
+
+static_assert(sizeof(GUID) == sizeof(PortableGuid), "GUID layout");
+
+// Attribute and major type GUIDs are extern symbols in mfuuid.lib, not
+// constants, so these are hashed at first use instead of at compile time.
+#define GUID_NAME(val) { &val, #val }
+
+struct SdkGuidName
+{
+	const GUID* pGuid;
+	const char* name;
+};
+
+static const SdkGuidName s_sdkGuidNames[] =
+{
+	GUID_NAME(MF_MT_MAJOR_TYPE),
+	GUID_NAME(MF_MT_SUBTYPE),
+	GUID_NAME(MF_MT_ALL_SAMPLES_INDEPENDENT),
+	GUID_NAME(MF_MT_FIXED_SIZE_SAMPLES),
+	GUID_NAME(MF_MT_COMPRESSED),
+	GUID_NAME(MF_MT_SAMPLE_SIZE),
+	GUID_NAME(MF_MT_WRAPPED_TYPE),
+	GUID_NAME(MF_MT_AUDIO_NUM_CHANNELS),
+	GUID_NAME(MF_MT_AUDIO_SAMPLES_PER_SECOND),
+	GUID_NAME(MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND),
+	GUID_NAME(MF_MT_AUDIO_AVG_BYTES_PER_SECOND),
+	GUID_NAME(MF_MT_AUDIO_BLOCK_ALIGNMENT),
+	GUID_NAME(MF_MT_AUDIO_BITS_PER_SAMPLE),
+	GUID_NAME(MF_MT_AUDIO_VALID_BITS_PER_SAMPLE),
+	GUID_NAME(MF_MT_AUDIO_SAMPLES_PER_BLOCK),
+	GUID_NAME(MF_MT_AUDIO_CHANNEL_MASK),
+	GUID_NAME(MF_MT_AUDIO_FOLDDOWN_MATRIX),
+	GUID_NAME(MF_MT_AUDIO_WMADRC_PEAKREF),
+	GUID_NAME(MF_MT_AUDIO_WMADRC_PEAKTARGET),
+	GUID_NAME(MF_MT_AUDIO_WMADRC_AVGREF),
+	GUID_NAME(MF_MT_AUDIO_WMADRC_AVGTARGET),
+	GUID_NAME(MF_MT_AUDIO_PREFER_WAVEFORMATEX),
+	GUID_NAME(MF_MT_AAC_PAYLOAD_TYPE),
+	GUID_NAME(MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION),
+	GUID_NAME(MF_MT_FRAME_SIZE),
+	GUID_NAME(MF_MT_FRAME_RATE),
+	GUID_NAME(MF_MT_FRAME_RATE_RANGE_MAX),
+	GUID_NAME(MF_MT_FRAME_RATE_RANGE_MIN),
+	GUID_NAME(MF_MT_PIXEL_ASPECT_RATIO),
+	GUID_NAME(MF_MT_DRM_FLAGS),
+	GUID_NAME(MF_MT_PAD_CONTROL_FLAGS),
+	GUID_NAME(MF_MT_SOURCE_CONTENT_HINT),
+	GUID_NAME(MF_MT_VIDEO_CHROMA_SITING),
+	GUID_NAME(MF_MT_INTERLACE_MODE),
+	GUID_NAME(MF_MT_TRANSFER_FUNCTION),
+	GUID_NAME(MF_MT_VIDEO_PRIMARIES),
+	GUID_NAME(MF_MT_CUSTOM_VIDEO_PRIMARIES),
+	GUID_NAME(MF_MT_YUV_MATRIX),
+	GUID_NAME(MF_MT_VIDEO_LIGHTING),
+	GUID_NAME(MF_MT_VIDEO_NOMINAL_RANGE),
+	GUID_NAME(MF_MT_GEOMETRIC_APERTURE),
+	GUID_NAME(MF_MT_MINIMUM_DISPLAY_APERTURE),
+	GUID_NAME(MF_MT_PAN_SCAN_APERTURE),
+	GUID_NAME(MF_MT_PAN_SCAN_ENABLED),
+	GUID_NAME(MF_MT_AVG_BITRATE),
+	GUID_NAME(MF_MT_AVG_BIT_ERROR_RATE),
+	GUID_NAME(MF_MT_MAX_KEYFRAME_SPACING),
+	GUID_NAME(MF_MT_DEFAULT_STRIDE),
+	GUID_NAME(MF_MT_PALETTE),
+	GUID_NAME(MF_MT_USER_DATA),
+	GUID_NAME(MF_MT_AM_FORMAT_TYPE),
+	GUID_NAME(MF_MT_MPEG_START_TIME_CODE),
+	GUID_NAME(MF_MT_MPEG2_PROFILE),
+	GUID_NAME(MF_MT_MPEG2_LEVEL),
+	GUID_NAME(MF_MT_MPEG2_FLAGS),
+	GUID_NAME(MF_MT_MPEG_SEQUENCE_HEADER),
+	GUID_NAME(MF_MT_DV_AAUX_SRC_PACK_0),
+	GUID_NAME(MF_MT_DV_AAUX_CTRL_PACK_0),
+	GUID_NAME(MF_MT_DV_AAUX_SRC_PACK_1),
+	GUID_NAME(MF_MT_DV_AAUX_CTRL_PACK_1),
+	GUID_NAME(MF_MT_DV_VAUX_SRC_PACK),
+	GUID_NAME(MF_MT_DV_VAUX_CTRL_PACK),
+	GUID_NAME(MF_MT_ARBITRARY_HEADER),
+	GUID_NAME(MF_MT_ARBITRARY_FORMAT),
+	GUID_NAME(MF_MT_IMAGE_LOSS_TOLERANT),
+	GUID_NAME(MF_MT_MPEG4_SAMPLE_DESCRIPTION),
+	GUID_NAME(MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY),
+	GUID_NAME(MF_MT_ORIGINAL_4CC),
+	GUID_NAME(MF_MT_ORIGINAL_WAVE_FORMAT_TAG),
+
+	GUID_NAME(MFMediaType_Protected),
+	GUID_NAME(MFMediaType_SAMI),
+	GUID_NAME(MFMediaType_Script),
+	GUID_NAME(MFMediaType_Image),
+	GUID_NAME(MFMediaType_HTML),
+	GUID_NAME(MFMediaType_Binary),
+	GUID_NAME(MFMediaType_FileTransfer),
+};
+
+static PortableGuid ToPortableGuid(const GUID& guid)
+{
+	PortableGuid g;
+	memcpy(&g, &guid, sizeof(g));
+	return g;
+}
+
+static GuidNameRegistry BuildGuidNames()
+{
+	// Start from the compile time table of format GUIDs.
+	GuidNameRegistry table = GetFormatGuidNames();
+	for (size_t i = 0; i < sizeof(s_sdkGuidNames) / sizeof(s_sdkGuidNames[0]); ++i) {
+		if (!table.Insert(ToPortableGuid(*s_sdkGuidNames[i].pGuid), s_sdkGuidNames[i].name)) {
+			printf("GUID name table full, increase GUID_NAME_TABLE_SIZE\n");
+			break;
+		}
+	}
+	return table;
+}
+
+LPCSTR GetGUIDNameConst(const GUID& guid)
+{
+	static const GuidNameRegistry s_guidNames = BuildGuidNames();
+	return s_guidNames.Find(ToPortableGuid(guid));
+}
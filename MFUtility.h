@@ -34,7 +34,12 @@
 #include <locale>
 #include <string>
 
-#define CHECK_HR(hr, msg) if (hr != S_OK) { printf(msg); printf(" Error: %.2X.\n", hr); goto done; }
+#include "SamplePool.h"
+#include "HexDump.h"
+#include "Logger.h"
+
+// Stores the result of expr in the caller's hr, so the code after done: sees the failure.
+#define CHECK_HR(expr, msg) do { hr = (expr); if (FAILED(hr)) { LOG_ERROR("%s Error: %.2X.\n", msg, hr); goto done; } } while (0)
 
 #define CHECKHR_GOTO(x, y) if(FAILED(x)) goto y
 
@@ -71,155 +76,13 @@ enum class DeviceType { Audio, Video };
 #define IF_EQUAL_RETURN(param, val) if(val == param) return #val
 #endif
 
-LPCSTR GetGUIDNameConst(const GUID& guid)
-{
-  IF_EQUAL_RETURN(guid, MF_MT_MAJOR_TYPE);
-  IF_EQUAL_RETURN(guid, MF_MT_MAJOR_TYPE);
-  IF_EQUAL_RETURN(guid, MF_MT_SUBTYPE);
-  IF_EQUAL_RETURN(guid, MF_MT_ALL_SAMPLES_INDEPENDENT);
-  IF_EQUAL_RETURN(guid, MF_MT_FIXED_SIZE_SAMPLES);
-  IF_EQUAL_RETURN(guid, MF_MT_COMPRESSED);
-  IF_EQUAL_RETURN(guid, MF_MT_SAMPLE_SIZE);
-  IF_EQUAL_RETURN(guid, MF_MT_WRAPPED_TYPE);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_NUM_CHANNELS);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_SAMPLES_PER_SECOND);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_AVG_BYTES_PER_SECOND);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_BLOCK_ALIGNMENT);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_BITS_PER_SAMPLE);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_VALID_BITS_PER_SAMPLE);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_SAMPLES_PER_BLOCK);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_CHANNEL_MASK);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_FOLDDOWN_MATRIX);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_PEAKREF);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_PEAKTARGET);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_AVGREF);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_AVGTARGET);
-  IF_EQUAL_RETURN(guid, MF_MT_AUDIO_PREFER_WAVEFORMATEX);
-  IF_EQUAL_RETURN(guid, MF_MT_AAC_PAYLOAD_TYPE);
-  IF_EQUAL_RETURN(guid, MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION);
-  IF_EQUAL_RETURN(guid, MF_MT_FRAME_SIZE);
-  IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE);
-  IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE_RANGE_MAX);
-  IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE_RANGE_MIN);
-  IF_EQUAL_RETURN(guid, MF_MT_PIXEL_ASPECT_RATIO);
-  IF_EQUAL_RETURN(guid, MF_MT_DRM_FLAGS);
-  IF_EQUAL_RETURN(guid, MF_MT_PAD_CONTROL_FLAGS);
-  IF_EQUAL_RETURN(guid, MF_MT_SOURCE_CONTENT_HINT);
-  IF_EQUAL_RETURN(guid, MF_MT_VIDEO_CHROMA_SITING);
-  IF_EQUAL_RETURN(guid, MF_MT_INTERLACE_MODE);
-  IF_EQUAL_RETURN(guid, MF_MT_TRANSFER_FUNCTION);
-  IF_EQUAL_RETURN(guid, MF_MT_VIDEO_PRIMARIES);
-  IF_EQUAL_RETURN(guid, MF_MT_CUSTOM_VIDEO_PRIMARIES);
-  IF_EQUAL_RETURN(guid, MF_MT_YUV_MATRIX);
-  IF_EQUAL_RETURN(guid, MF_MT_VIDEO_LIGHTING);
-  IF_EQUAL_RETURN(guid, MF_MT_VIDEO_NOMINAL_RANGE);
-  IF_EQUAL_RETURN(guid, MF_MT_GEOMETRIC_APERTURE);
-  IF_EQUAL_RETURN(guid, MF_MT_MINIMUM_DISPLAY_APERTURE);
-  IF_EQUAL_RETURN(guid, MF_MT_PAN_SCAN_APERTURE);
-  IF_EQUAL_RETURN(guid, MF_MT_PAN_SCAN_ENABLED);
-  IF_EQUAL_RETURN(guid, MF_MT_AVG_BITRATE);
-  IF_EQUAL_RETURN(guid, MF_MT_AVG_BIT_ERROR_RATE);
-  IF_EQUAL_RETURN(guid, MF_MT_MAX_KEYFRAME_SPACING);
-  IF_EQUAL_RETURN(guid, MF_MT_DEFAULT_STRIDE);
-  IF_EQUAL_RETURN(guid, MF_MT_PALETTE);
-  IF_EQUAL_RETURN(guid, MF_MT_USER_DATA);
-  IF_EQUAL_RETURN(guid, MF_MT_AM_FORMAT_TYPE);
-  IF_EQUAL_RETURN(guid, MF_MT_MPEG_START_TIME_CODE);
-  IF_EQUAL_RETURN(guid, MF_MT_MPEG2_PROFILE);
-  IF_EQUAL_RETURN(guid, MF_MT_MPEG2_LEVEL);
-  IF_EQUAL_RETURN(guid, MF_MT_MPEG2_FLAGS);
-  IF_EQUAL_RETURN(guid, MF_MT_MPEG_SEQUENCE_HEADER);
-  IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_SRC_PACK_0);
-  IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_CTRL_PACK_0);
-  IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_SRC_PACK_1);
-  IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_CTRL_PACK_1);
-  IF_EQUAL_RETURN(guid, MF_MT_DV_VAUX_SRC_PACK);
-  IF_EQUAL_RETURN(guid, MF_MT_DV_VAUX_CTRL_PACK);
-  IF_EQUAL_RETURN(guid, MF_MT_ARBITRARY_HEADER);
-  IF_EQUAL_RETURN(guid, MF_MT_ARBITRARY_FORMAT);
-  IF_EQUAL_RETURN(guid, MF_MT_IMAGE_LOSS_TOLERANT);
-  IF_EQUAL_RETURN(guid, MF_MT_MPEG4_SAMPLE_DESCRIPTION);
-  IF_EQUAL_RETURN(guid, MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY);
-  IF_EQUAL_RETURN(guid, MF_MT_ORIGINAL_4CC);
-  IF_EQUAL_RETURN(guid, MF_MT_ORIGINAL_WAVE_FORMAT_TAG);
-
-  // Media types
-
-  IF_EQUAL_RETURN(guid, MFMediaType_Audio);
-  IF_EQUAL_RETURN(guid, MFMediaType_Video);
-  IF_EQUAL_RETURN(guid, MFMediaType_Protected);
-  IF_EQUAL_RETURN(guid, MFMediaType_SAMI);
-  IF_EQUAL_RETURN(guid, MFMediaType_Script);
-  IF_EQUAL_RETURN(guid, MFMediaType_Image);
-  IF_EQUAL_RETURN(guid, MFMediaType_HTML);
-  IF_EQUAL_RETURN(guid, MFMediaType_Binary);
-  IF_EQUAL_RETURN(guid, MFMediaType_FileTransfer);
-
-  IF_EQUAL_RETURN(guid, MFVideoFormat_AI44); //     FCC('AI44')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_ARGB32); //   D3DFMT_A8R8G8B8 
-  IF_EQUAL_RETURN(guid, MFVideoFormat_AYUV); //     FCC('AYUV')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_DV25); //     FCC('dv25')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_DV50); //     FCC('dv50')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_DVH1); //     FCC('dvh1')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_DVSD); //     FCC('dvsd')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_DVSL); //     FCC('dvsl')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_H264); //     FCC('H264')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_I420); //     FCC('I420')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_IYUV); //     FCC('IYUV')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_M4S2); //     FCC('M4S2')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_MJPG);
-  IF_EQUAL_RETURN(guid, MFVideoFormat_MP43); //     FCC('MP43')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_MP4S); //     FCC('MP4S')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_MP4V); //     FCC('MP4V')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_MPG1); //     FCC('MPG1')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_MSS1); //     FCC('MSS1')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_MSS2); //     FCC('MSS2')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_NV11); //     FCC('NV11')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_NV12); //     FCC('NV12')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_P010); //     FCC('P010')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_P016); //     FCC('P016')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_P210); //     FCC('P210')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_P216); //     FCC('P216')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_RGB24); //    D3DFMT_R8G8B8 
-  IF_EQUAL_RETURN(guid, MFVideoFormat_RGB32); //    D3DFMT_X8R8G8B8 
-  IF_EQUAL_RETURN(guid, MFVideoFormat_RGB555); //   D3DFMT_X1R5G5B5 
-  IF_EQUAL_RETURN(guid, MFVideoFormat_RGB565); //   D3DFMT_R5G6B5 
-  IF_EQUAL_RETURN(guid, MFVideoFormat_RGB8);
-  IF_EQUAL_RETURN(guid, MFVideoFormat_UYVY); //     FCC('UYVY')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_v210); //     FCC('v210')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_v410); //     FCC('v410')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_WMV1); //     FCC('WMV1')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_WMV2); //     FCC('WMV2')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_WMV3); //     FCC('WMV3')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_WVC1); //     FCC('WVC1')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_Y210); //     FCC('Y210')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_Y216); //     FCC('Y216')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_Y410); //     FCC('Y410')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_Y416); //     FCC('Y416')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_Y41P);
-  IF_EQUAL_RETURN(guid, MFVideoFormat_Y41T);
-  IF_EQUAL_RETURN(guid, MFVideoFormat_YUY2); //     FCC('YUY2')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_YV12); //     FCC('YV12')
-  IF_EQUAL_RETURN(guid, MFVideoFormat_YVYU);
-
-  IF_EQUAL_RETURN(guid, MFAudioFormat_PCM); //              WAVE_FORMAT_PCM 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_Float); //            WAVE_FORMAT_IEEE_FLOAT 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_DTS); //              WAVE_FORMAT_DTS 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_Dolby_AC3_SPDIF); //  WAVE_FORMAT_DOLBY_AC3_SPDIF 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_DRM); //              WAVE_FORMAT_DRM 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudioV8); //        WAVE_FORMAT_WMAUDIO2 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudioV9); //        WAVE_FORMAT_WMAUDIO3 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudio_Lossless); // WAVE_FORMAT_WMAUDIO_LOSSLESS 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_WMASPDIF); //         WAVE_FORMAT_WMASPDIF 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_MSP1); //             WAVE_FORMAT_WMAVOICE9 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_MP3); //              WAVE_FORMAT_MPEGLAYER3 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_MPEG); //             WAVE_FORMAT_MPEG 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_AAC); //              WAVE_FORMAT_MPEG_HEAAC 
-  IF_EQUAL_RETURN(guid, MFAudioFormat_ADTS); //             WAVE_FORMAT_MPEG_ADTS_AAC 
-
-  return NULL;
-}
+/**
+* Gets the symbolic name of a media type attribute or format GUID.
+* Implemented with a hash table in MFGuidNames.cpp.
+* @param[in] guid: the GUID to look up.
+* @@Returns the name, or NULL if the GUID is not known.
+*/
+LPCSTR GetGUIDNameConst(const GUID& guid);
 
 /**
 * Helper function to get a user friendly description for a media type.
@@ -412,6 +275,7 @@ done:
 */
 std::string GetVideoTypeDescriptionBrief(IMFMediaType* pMediaType)
 {
+  HRESULT hr = S_OK;
   std::string description = " ";
   GUID subType;
   UINT32 width = 0, height = 0, fpsNum = 0, fpsDen = 0;
@@ -455,12 +319,13 @@ HRESULT FindMatchingVideoType(IMFMediaTypeHandler* pMediaTypeHandler, const GUID
       CHECK_HR(pMediaType->CopyAllItems(pOutMediaType), "Error copying media type attributes.");
       SAFE_RELEASE(pMediaType);
       hr = S_OK;
-      break;
+      goto done;
     }
     else {
       SAFE_RELEASE(pMediaType);
     }
   }
+  hr = S_FALSE;
 
 done:
   return hr;
@@ -766,7 +631,7 @@ HRESULT GetAudioOutputDevice(UINT deviceIndex, IMFMediaSink** ppAudioSink)
   CHECK_HR(hr, "Failed to get audio end points count.");
 
   if (deviceIndex >= deviceCount) {
-    printf("The audio output device index was invalid.\n");
+    LOG_ERROR("The audio output device index was invalid.\n");
     hr = E_INVALIDARG;
   }
   else {
@@ -834,7 +699,7 @@ HRESULT GetVideoSourceFromDevice(UINT nDevice, IMFMediaSource** ppVideoSource, I
   CHECK_HR(hr, "Error enumerating video devices.");
 
   if (nDevice >= videoDeviceCount) {
-    printf("The device index of %d was invalid for available device count of %d.\n", nDevice, videoDeviceCount);
+    LOG_ERROR("The device index of %d was invalid for available device count of %d.\n", nDevice, videoDeviceCount);
     hr = E_INVALIDARG;
   }
   else {
@@ -910,7 +775,7 @@ HRESULT GetSourceFromCaptureDevice(DeviceType deviceType, UINT nDevice, IMFMedia
   CHECK_HR(hr, "Error enumerating capture devices.");
 
   if (nDevice >= captureDeviceCount) {
-    printf("The device index of %d was invalid for available device count of %d.\n", nDevice, captureDeviceCount);
+    LOG_ERROR("The device index of %d was invalid for available device count of %d.\n", nDevice, captureDeviceCount);
     hr = E_INVALIDARG;
   }
   else {
@@ -982,38 +847,44 @@ HRESULT CopyAttribute(IMFAttributes* pSrc, IMFAttributes* pDest, const GUID& key
 * @param[in] width: the width of the bitmap.
 * @param[in] height: the height of the bitmap.
 * @param[in] bitsPerPixel: colour depth of the bitmap pixels (typically 24 or 32).
-* @param[in] bitmapData: a pointer to the bytes containing the bitmap data.
-* @param[in] bitmapDataLength: the number of pixels in the bitmap.
+* @param[in] bitmapData: a pointer to the bytes containing the bitmap data, bottom-up rows
+*  padded to a multiple of 4 bytes.
+* @param[in] bitmapDataLength: the number of bytes in the bitmap data.
 */
 void CreateBitmapFile(LPCWSTR fileName, long width, long height, WORD bitsPerPixel, BYTE* bitmapData, DWORD bitmapDataLength)
 {
   HANDLE file;
-  BITMAPFILEHEADER fileHeader;
-  BITMAPINFOHEADER fileInfo;
+  BITMAPFILEHEADER fileHeader = { 0 };
+  BITMAPINFOHEADER fileInfo = { 0 };
+  BYTE headerBytes[sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)];
   DWORD writePosn = 0;
 
   file = CreateFile(fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);  //Sets up the new bmp to be written to
+  if (file == INVALID_HANDLE_VALUE) {
+    LOG_ERROR("Failed to create bitmap file.\n");
+    return;
+  }
 
   fileHeader.bfType = 19778;                                                                    //Sets our type to BM or bmp
-  fileHeader.bfSize = sizeof(fileHeader.bfOffBits) + sizeof(RGBTRIPLE);                         //Sets the size equal to the size of the header struct
-  fileHeader.bfReserved1 = 0;                                                                   //sets the reserves to 0
-  fileHeader.bfReserved2 = 0;
-  fileHeader.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);											//Sets offbits equal to the size of file and info header
+  fileHeader.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);                   //Sets offbits equal to the size of file and info header
+  fileHeader.bfSize = fileHeader.bfOffBits + bitmapDataLength;                                  //Sets the size equal to the whole file
   fileInfo.biSize = sizeof(BITMAPINFOHEADER);
   fileInfo.biWidth = width;
   fileInfo.biHeight = height;
   fileInfo.biPlanes = 1;
   fileInfo.biBitCount = bitsPerPixel;
   fileInfo.biCompression = BI_RGB;
-  fileInfo.biSizeImage = width * height * (bitsPerPixel / 8);
+  fileInfo.biSizeImage = ((width * bitsPerPixel / 8 + 3) & ~3) * height;                       //Rows are padded to 4 bytes
   fileInfo.biXPelsPerMeter = 2400;
   fileInfo.biYPelsPerMeter = 2400;
   fileInfo.biClrImportant = 0;
   fileInfo.biClrUsed = 0;
 
-  WriteFile(file, &fileHeader, sizeof(fileHeader), &writePosn, NULL);
+  // Both headers go out with one WriteFile.
+  memcpy(headerBytes, &fileHeader, sizeof(fileHeader));
+  memcpy(headerBytes + sizeof(fileHeader), &fileInfo, sizeof(fileInfo));
 
-  WriteFile(file, &fileInfo, sizeof(fileInfo), &writePosn, NULL);
+  WriteFile(file, headerBytes, sizeof(headerBytes), &writePosn, NULL);
 
   WriteFile(file, bitmapData, bitmapDataLength, &writePosn, NULL);
 
@@ -1022,6 +893,7 @@ void CreateBitmapFile(LPCWSTR fileName, long width, long height, WORD bitsPerPix
 
 void CreateBitmapFromSample(LPCWSTR fileName, long width, long height, WORD bitsPerPixel, IMFSample* pSample)
 {
+  HRESULT hr = S_OK;
   IMFMediaBuffer* pMediaBuffer = NULL;
   DWORD bmpLength = 0;
   BYTE* bmpBuffer = NULL;
@@ -1108,7 +980,7 @@ HRESULT WriteSampleToFile(IMFSample* pSample, std::ofstream* pFileStream)
   hr = buf->GetCurrentLength(&bufLength);
   CHECK_HR(hr, "Get buffer length failed.");
 
-  printf("Writing sample to capture file sample size %i.\n", bufLength);
+  LOG_DEBUG("Writing sample to capture file sample size %i.\n", bufLength);
 
   byte* byteBuffer = NULL;
   DWORD buffMaxLen = 0, buffCurrLen = 0;
@@ -1157,15 +1029,21 @@ done:
 * Creates a new media sample and copies the first media buffer from the source to it.
 * @param[in] pSrcSample: size of the media buffer to set on the create media sample.
 * @param[out] pDstSample: pointer to the media sample created.
+* @param[in] pSamplePool: optional pool to take the destination buffer from instead of
+*  allocating a new one. Blocks while all of its buffers are in use.
 * @@Returns S_OK if successful or an error code if not.
 */
-HRESULT CreateAndCopySingleBufferIMFSample(IMFSample* pSrcSample, IMFSample** pDstSample)
+HRESULT CreateAndCopySingleBufferIMFSample(IMFSample* pSrcSample, IMFSample** pDstSample, SamplePool* pSamplePool = NULL)
 {
   IMFMediaBuffer* pDstBuffer = NULL;
   DWORD srcBufLength;
 
   HRESULT hr = S_OK;
 
+  if (pSamplePool != NULL) {
+    return pSamplePool->CreateCopy(pSrcSample, true, pDstSample);
+  }
+
   // Gets total length of ALL media buffer samples. We can use here because it's only a
   // single buffer sample copy.
   hr = pSrcSample->GetTotalLength(&srcBufLength);
@@ -1195,9 +1073,13 @@ done:
 *  if the transform did not produce one.
 * @param[out] transformFlushed: if set to true means the transform format changed and the
 *  contents were flushed. Output format of sample most likely changed.
+* @param[in] pSamplePool: optional pool of recycled output samples, used when the transform
+*  doesn't provide samples and the pool's buffers are large enough. Blocks while all of
+*  its buffers are in use.
 * @@Returns S_OK if successful or an error code if not.
 */
-HRESULT GetTransformOutput(IMFTransform* pTransform, IMFSample** pOutSample, BOOL* transformFlushed)
+HRESULT GetTransformOutput(IMFTransform* pTransform, IMFSample** pOutSample, BOOL* transformFlushed,
+  SamplePool* pSamplePool = NULL)
 {
   MFT_OUTPUT_STREAM_INFO StreamInfo = { 0 };
   MFT_OUTPUT_DATA_BUFFER outputDataBuffer = { 0 };
@@ -1215,14 +1097,19 @@ HRESULT GetTransformOutput(IMFTransform* pTransform, IMFSample** pOutSample, BOO
   outputDataBuffer.pEvents = NULL;
 
   if ((StreamInfo.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES) == 0) {
-    hr = CreateSingleBufferIMFSample(StreamInfo.cbSize, pOutSample);
+    if (pSamplePool != NULL && pSamplePool->BufferSize() >= StreamInfo.cbSize) {
+      hr = pSamplePool->CreateSample(true, pOutSample);
+    }
+    else {
+      hr = CreateSingleBufferIMFSample(StreamInfo.cbSize, pOutSample);
+    }
     CHECK_HR(hr, "Failed to create new single buffer IMF sample.");
     outputDataBuffer.pSample = *pOutSample;
   }
 
   auto mftProcessOutput = pTransform->ProcessOutput(0, 1, &outputDataBuffer, &processOutputStatus);
 
-  //printf("Process output result %.2X, MFT status %.2X.\n", mftProcessOutput, processOutputStatus);
+  LOG_TRACE("Process output result %.2X, MFT status %.2X.\n", mftProcessOutput, processOutputStatus);
 
   if (mftProcessOutput == S_OK) {
     // Sample is ready and allocated on the transform output buffer.
@@ -1231,7 +1118,7 @@ HRESULT GetTransformOutput(IMFTransform* pTransform, IMFSample** pOutSample, BOO
   else if (mftProcessOutput == MF_E_TRANSFORM_STREAM_CHANGE) {
     // Format of the input stream has changed. https://docs.microsoft.com/en-us/windows/win32/medfound/handling-stream-changes
     if (outputDataBuffer.dwStatus == MFT_OUTPUT_DATA_BUFFER_FORMAT_CHANGE) {
-      printf("MFT stream changed.\n");
+      LOG_INFO("MFT stream changed.\n");
 
       hr = pTransform->GetOutputAvailableType(0, 0, &pChangedOutMediaType);
       CHECK_HR(hr, "Failed to get the MFT output media type after a stream change.");
@@ -1250,7 +1137,7 @@ HRESULT GetTransformOutput(IMFTransform* pTransform, IMFSample** pOutSample, BOO
       *transformFlushed = TRUE;
     }
     else {
-      printf("MFT stream changed but didn't have the data format change flag set. Don't know what to do.\n");
+      LOG_ERROR("MFT stream changed but didn't have the data format change flag set. Don't know what to do.\n");
       hr = E_NOTIMPL;
     }
 
@@ -1264,7 +1151,7 @@ HRESULT GetTransformOutput(IMFTransform* pTransform, IMFSample** pOutSample, BOO
     hr = MF_E_TRANSFORM_NEED_MORE_INPUT;
   }
   else {
-    printf("MFT ProcessOutput error result %.2X, MFT status %.2X.\n", mftProcessOutput, processOutputStatus);
+    LOG_ERROR("MFT ProcessOutput error result %.2X, MFT status %.2X.\n", mftProcessOutput, processOutputStatus);
     hr = mftProcessOutput;
     SAFE_RELEASE(pOutSample);
     *pOutSample = NULL;
@@ -1278,28 +1165,21 @@ done:
 }
 
 /**
-* Gets the hex string representation of a byte array.
+* Gets the hex string representation of a byte array. To print large buffers use
+* HexDump / HexDumpWriter (HexDump.h), which stream without allocating.
 * @param[in] start: pointer to the start of the byte array.
 * @param[in] length: length of the byte array.
-* @@Returns a null terminated char array.
+* @@Returns a null terminated char array, to be freed with free().
 */
 unsigned char* HexStr(const uint8_t* start, size_t length)
 {
   // Each byte requires 2 characters. Add one additional byte to hold the null termination char.
-  unsigned char* hexStr = (unsigned char*)calloc((size_t)(length * 2 + 1), 1);
-
-  static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
-    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-
-  int posn = 0;
-  for (int i = 0; i < length; i++)
-  {
-    unsigned char val = (unsigned char)(*(start + i));
-    hexStr[posn] = (hexmap[val >> 4]);
-    hexStr[posn + 1] = (hexmap[val & 15]);
-    posn += 2;
+  unsigned char* hexStr = (unsigned char*)malloc((size_t)(length * 2 + 1));
+  if (hexStr == NULL) {
+    return NULL;
   }
 
+  hexStr[HexEncode(start, length, (char*)hexStr)] = '\0';
   return hexStr;
 }
 
@@ -1319,7 +1199,7 @@ public:
     hr = pAsyncResult->GetState((IUnknown**)&pEventGenerator);
     if (!SUCCEEDED(hr))
     {
-      printf("Failed to get media event generator from async state.\n");
+      LOG_ERROR("Failed to get media event generator from async state.\n");
     }
 
     // Get the event from the event queue.
@@ -1331,7 +1211,7 @@ public:
     if (SUCCEEDED(hr))
     {
       hr = pEvent->GetType(&meType);
-      //printf("Media event type %d.\n", meType);
+      LOG_TRACE("Media event type %d.\n", meType);
     }
 
     // Get the event status. If the operation that triggered the event 
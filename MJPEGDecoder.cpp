@@ -1,12 +1,20 @@
 #include "MJPEGDecoder.h"
+#include "NV12Repack.h"
+#include "FrameDump.h"
+#include "JpegParser.h"
+#include "JpegHuffman.h"
+#include "FrameTrace.h"
+#include "Logger.h"
+
+#define PLANE_Y_FILENAME "planeY.bmp"
+#define PLANE_UV_FILENAME "planeUV.bmp"
 
 // Util functions
-#define CHECK_HR(hr, msg) if (hr != S_OK) { printf(msg); printf(" Error: %.2X.\n", hr); goto done; }
+#define CHECK_HR(expr, msg) do { hr = (expr); if (FAILED(hr)) { LOG_ERROR("%s Error: %.2X.\n", msg, hr); goto done; } } while (0)
 LPCSTR GetGUIDNameConst(const GUID& guid);
 
 void print_guid(GUID guid);
 void dump_sample(IMFSample* pSample);
-void save_bmp(IMFSample* pSample, int width, int height);
 void print_attr(IMFAttributes* pAttr);
 
 struct __declspec(uuid("687CBC51-25DA-4FFC-A678-1E64943285A7")) AMD_MJPEG_DECODER_Cls; // AMD Hardware MJPEG decoder
@@ -23,11 +31,23 @@ MJPEGDecoder::MJPEGDecoder()
 	m_framerate = 0;
 	m_outWidth = 0;
 	m_outHeight = 0;
+	m_outStride = 0;
+	m_yuvMatrix = YUV_MATRIX_BT601;
+	m_yuvRange = YUV_RANGE_FULL;
+	m_packOutput = false;
 	m_sampleCount = 0;
+
+	m_pOutputPool = NULL;
+	m_pDumpSink = NULL;
+	m_pPipeline = NULL;
+	m_pEventCallback = NULL;
 }
 
 MJPEGDecoder::~MJPEGDecoder()
-{}
+{
+	StopAsync();
+	delete m_pOutputPool;
+}
 
 
 HRESULT MJPEGDecoder::Find()
@@ -53,13 +73,13 @@ HRESULT MJPEGDecoder::Find()
 		m_inputStreamID = 0;
 		m_outputStreamID = 0;
 	}
-	else {
-		printf("Failed GetStreamID hr=%x\n", hr);
+	else if (hr != S_OK) {
+		LOG_WARN("Failed GetStreamID hr=%x\n", hr);
 	}
 
 	return S_OK;
 done:
-	printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
 	return -1;
 }
 
@@ -95,11 +115,22 @@ HRESULT MJPEGDecoder::Configure(UINT32 width, UINT32 height, UINT32 framerate)
 			break;
 		}
 		CHECK_HR(pType->GetGUID(MF_MT_SUBTYPE, &subtype), "Get subtype failed");
-		printf("GetOutputAvailableType i=%d %s\n", i, GetGUIDNameConst(subtype));
+		LOG_DEBUG("GetOutputAvailableType i=%d %s\n", i, GetGUIDNameConst(subtype));
 		if (subtype == MFVideoFormat_NV12) {
 			print_attr(pType);
 			CHECK_HR(MFGetAttributeSize(pType, MF_MT_FRAME_SIZE, &m_outWidth, &m_outHeight), "Get MF_MT_FRAME_SIZE failed");
-			printf("MJPEG decoder out %d x %d\n", m_outWidth, m_outHeight);
+			LOG_INFO("MJPEG decoder out %d x %d\n", m_outWidth, m_outHeight);
+			if (pType->GetUINT32(MF_MT_DEFAULT_STRIDE, &val32) != S_OK || (INT32)val32 <= 0) {
+				val32 = m_outWidth;
+			}
+			m_outStride = val32;
+			// Unset attributes keep the JFIF defaults.
+			if (pType->GetUINT32(MF_MT_YUV_MATRIX, &val32) == S_OK && val32 == MFVideoTransferMatrix_BT709) {
+				m_yuvMatrix = YUV_MATRIX_BT709;
+			}
+			if (pType->GetUINT32(MF_MT_VIDEO_NOMINAL_RANGE, &val32) == S_OK && val32 == MFNominalRange_16_235) {
+				m_yuvRange = YUV_RANGE_LIMITED;
+			}
 			CHECK_HR(m_pDecoderTransform->SetOutputType(m_outputStreamID, pType, 0), "SetOutputType failed");
 			pType->Release();
 			found = 1;
@@ -109,102 +140,588 @@ HRESULT MJPEGDecoder::Configure(UINT32 width, UINT32 height, UINT32 framerate)
 		++i;
 	}
 	if (found == 0) {
-		printf("Failed to set output media type on AMD_MJPEG decoder MFT.");
+		LOG_ERROR("Failed to set output media type on AMD_MJPEG decoder MFT.\n");
 	}
 	return S_OK;
 done:
-	printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
 	return -1;
 }
 
+void MJPEGDecoder::GetColorSpace(YuvMatrix* pMatrix, YuvRange* pRange) const
+{
+	*pMatrix = m_yuvMatrix;
+	*pRange = m_yuvRange;
+}
+
 HRESULT MJPEGDecoder::Start()
 {
 	HRESULT hr;
+	MFT_OUTPUT_STREAM_INFO streamInfo = { 0 };
+
+	CHECK_HR(m_pDecoderTransform->GetOutputStreamInfo(m_outputStreamID, &streamInfo), "GetOutputStreamInfo failed");
+	if ((streamInfo.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES) == 0 && m_pOutputPool == NULL) {
+		m_pOutputPool = new SamplePool(streamInfo.cbSize, OUTPUT_SAMPLE_POOL_SIZE);
+	}
 	CHECK_HR(m_pDecoderTransform->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, NULL), "Failed ProcessMessage");
 	CHECK_HR(m_pDecoderTransform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL), "Failed ProcessMessage");
 	CHECK_HR(m_pDecoderTransform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL), "FailedProcessMessage");
 	return S_OK;
 done:
-	printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
 	return -1;
 }
 
+// Keeps a decoded sample's buffer locked while an NV12Frame points into it.
+class MFFrameOwner : public IFrameOwner
+{
+public:
+	MFFrameOwner(IMFSample* pSample, IMFMediaBuffer* pBuffer, IMF2DBuffer* p2DBuffer)
+		: m_refCount(1), m_pSample(pSample), m_pBuffer(pBuffer), m_p2DBuffer(p2DBuffer)
+	{
+		m_pSample->AddRef();
+	}
+
+	void AddRef() { InterlockedIncrement(&m_refCount); }
+	void Release()
+	{
+		if (InterlockedDecrement(&m_refCount) == 0) {
+			if (m_p2DBuffer) {
+				m_p2DBuffer->Unlock2D();
+				m_p2DBuffer->Release();
+			}
+			else {
+				m_pBuffer->Unlock();
+			}
+			m_pBuffer->Release();
+			m_pSample->Release();
+			delete this;
+		}
+	}
+
+private:
+	LONG m_refCount;
+	IMFSample* m_pSample;
+	IMFMediaBuffer* m_pBuffer;
+	IMF2DBuffer* m_p2DBuffer;
+};
+
 IMFSample * MJPEGDecoder::DecodeOneFrame(IMFSample* pInSample)
+{
+	IMFSample* pOutSample = DecodeSample(pInSample);
+	// The dump sink may still be reading the sample; packing would move UV under it.
+	if (pOutSample && m_packOutput && m_pDumpSink == NULL) {
+		PackOutputSample(pOutSample);
+	}
+	return pOutSample;
+}
+
+HRESULT MJPEGDecoder::DecodeOneFrame(IMFSample* pInSample, NV12Frame* pFrame)
+{
+	HRESULT hr;
+	IMFSample* pOutSample = DecodeSample(pInSample);
+	if (pOutSample == NULL) {
+		return E_FAIL;
+	}
+	hr = GetFrame(pOutSample, pFrame);
+	pOutSample->Release();
+	return hr;
+}
+
+// IMJPEGDecoder entry point: wraps the compressed frame in a sample for the MFT.
+HRESULT MJPEGDecoder::DecodeOneFrame(const uint8_t* pData, size_t len, NV12Frame* pFrame)
 {
 	HRESULT hr = S_OK;
-	IMFSample* pOutSample;
+	IMFSample* pInSample = NULL;
+	IMFMediaBuffer* mediaBuffer = NULL;
+	BYTE* pDst = NULL;
+
+	CHECK_HR(MFCreateSample(&pInSample), "MFCreateSample failed");
+	CHECK_HR(MFCreateMemoryBuffer((DWORD)len, &mediaBuffer), "MFCreateMemoryBuffer failed");
+	CHECK_HR(mediaBuffer->Lock(&pDst, NULL, NULL), "Lock failed");
+	memcpy(pDst, pData, len);
+	mediaBuffer->Unlock();
+	CHECK_HR(mediaBuffer->SetCurrentLength((DWORD)len), "SetCurrentLength failed");
+	CHECK_HR(pInSample->AddBuffer(mediaBuffer), "AddBuffer failed");
+	mediaBuffer->Release();
+	// DecodeOneFrame releases the input sample.
+	return DecodeOneFrame(pInSample, pFrame);
+done:
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
+	if (mediaBuffer) {
+		mediaBuffer->Release();
+	}
+	if (pInSample) {
+		pInSample->Release();
+	}
+	return hr;
+}
+
+// Describes a decoded sample without copying it. The pitch comes from
+// IMF2DBuffer::Lock2D (or MF_MT_DEFAULT_STRIDE) and the aligned height from
+// the buffer length. The frame holds the buffer locked until ReleaseFrame().
+// On failure pFrame is cleared, so ReleaseFrame() on it does nothing.
+HRESULT MJPEGDecoder::GetFrame(IMFSample* pSample, NV12Frame* pFrame)
+{
+	HRESULT hr = S_OK;
+	IMFMediaBuffer* mediaBuffer = NULL;
+	IMF2DBuffer* buffer2D = NULL;
+	MFFrameOwner* pOwner = NULL;
+	BYTE* pData = NULL;
+	LONG pitch = 0;
+	DWORD len = 0;
+	LONGLONG sampleTime = 0;
+	UINT32 alignedHeight;
+
+	CHECK_HR(pSample->GetBufferByIndex(0, &mediaBuffer), "GetBufferByIndex failed");
+	if (mediaBuffer->QueryInterface(IID_PPV_ARGS(&buffer2D)) == S_OK) {
+		CHECK_HR(buffer2D->Lock2D(&pData, &pitch), "Lock2D failed");
+		if (buffer2D->GetContiguousLength(&len) != S_OK) {
+			mediaBuffer->GetCurrentLength(&len);
+		}
+	}
+	else {
+		CHECK_HR(mediaBuffer->Lock(&pData, NULL, &len), "Lock failed");
+		pitch = m_outStride ? m_outStride : m_outWidth;
+	}
+	alignedHeight = m_outHeight;
+	if (pitch > 0 && len >= (DWORD)pitch * m_outHeight * 3 / 2) {
+		alignedHeight = len * 2 / 3 / pitch;
+	}
+
+	pOwner = new MFFrameOwner(pSample, mediaBuffer, buffer2D);
+	DescribeNV12Frame(pData, m_outWidth, m_outHeight, (uint32_t)pitch, alignedHeight, pOwner, pFrame);
+	pOwner->Release();
+	if (pSample->GetSampleTime(&sampleTime) == S_OK) {
+		pFrame->timestamp = sampleTime;
+	}
+	return S_OK;
+done:
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
+	memset(pFrame, 0, sizeof(*pFrame));
+	if (buffer2D) {
+		buffer2D->Release();
+	}
+	if (mediaBuffer) {
+		mediaBuffer->Release();
+	}
+	return hr;
+}
+
+#if FRAME_TRACE
+// Frames are traced by sample time, -1 if the sample has none.
+static int64_t TraceFrameId(IMFSample* pSample)
+{
+	LONGLONG sampleTime = 0;
+	return pSample->GetSampleTime(&sampleTime) == S_OK ? sampleTime : -1;
+}
+#endif
+
+IMFSample * MJPEGDecoder::DecodeSample(IMFSample* pInSample)
+{
+	HRESULT hr = S_OK;
+	IMFSample* pOutSample = NULL;
 	MediaEventType eventType = 0;
-	IMFMediaEvent* event;
+	IMFMediaEvent* event = NULL;
 	bool inputProcessed = false;
 	bool hasOutput = false;
 
-	OutputDebugStringA("DecodeOneFrame start\n");
 	while (hasOutput == false) {
-		hr = m_pEventGen->GetEvent(0, &event);
-		if (hr != S_OK) { printf("Error %s %d hr=%x\n", __FILE__, __LINE__, hr); }
-		hr = event->GetType(&eventType);
-		if (hr != S_OK) { printf("Error %s %d hr=%x\n", __FILE__, __LINE__, hr); }
-		printf("GetEvent eventType=%d\n", eventType);
+		CHECK_HR(m_pEventGen->GetEvent(0, &event), "GetEvent failed");
+		CHECK_HR(event->GetType(&eventType), "GetType failed");
+		event->Release();
+		event = NULL;
 		switch (eventType)
 		{
 		case METransformNeedInput:
+			TRACE_INSTANT(TRACE_NEED_INPUT, -1);
 			if (inputProcessed) {
-				printf("Error Input processed 2nd time\n");
+				LOG_WARN("Error Input processed 2nd time\n");
 				CHECK_HR(m_pDecoderTransform->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, NULL), "Failed ProcessMessage");
 				break;
 			}
 			if (m_sampleCount == 10) {
-				printf("dump pInSample ");
+				LOG_DEBUG("dump pInSample\n");
 				//dump_sample(pInSample);
 			}
+			pInSample = AddDefaultHuffmanTables(pInSample);
+			TRACE_BEGIN(TRACE_PROCESS_INPUT, TraceFrameId(pInSample));
 			hr = m_pDecoderTransform->ProcessInput(m_inputStreamID, pInSample, 0);
-			if (hr != S_OK) { printf("Error %s %d hr=%x\n", __FILE__, __LINE__, hr); }
+			TRACE_END(TRACE_PROCESS_INPUT, TraceFrameId(pInSample));
+			if (hr != S_OK) { LOG_ERROR("Error %s %d hr=%x\n", __FILE__, __LINE__, hr); }
 			pInSample->Release();
 			inputProcessed = true;
 			break;
 		case METransformHaveOutput:
-			MFT_OUTPUT_STREAM_INFO StreamInfo = { 0 };
-			MFT_OUTPUT_DATA_BUFFER outputDataBuffer = { 0 };
-			DWORD processOutputStatus = 0;
-
-			hr = m_pDecoderTransform->GetOutputStreamInfo(m_outputStreamID, &StreamInfo);
-			outputDataBuffer.dwStreamID = m_outputStreamID;
-			outputDataBuffer.dwStatus = 0;
-			outputDataBuffer.pEvents = NULL;
-
-			HRESULT hr2 = m_pDecoderTransform->ProcessOutput(0, 1, &outputDataBuffer, &processOutputStatus);
-			// Sample is ready and allocated on the encoderTransform output buffer.
-			if (hr2 == S_OK) {
-				pOutSample = outputDataBuffer.pSample;
-				hasOutput = true;
-				if (m_sampleCount == 10) {
-					MFT_OUTPUT_STREAM_INFO stream_info;
-					hr = m_pDecoderTransform->GetOutputStreamInfo(m_outputStreamID, &stream_info);
-					printf("dump decodedSample ");
-					//dump_sample(pOutSample);
-					save_bmp(pOutSample, m_outWidth, m_outHeight);
-				}
-				break;
-			}
-			else {
-				printf("PorcessOutput failed hr=%x\n", hr2);
-				break;
-			}
+			TRACE_INSTANT(TRACE_HAVE_OUTPUT, -1);
+			TRACE_BEGIN(TRACE_PROCESS_OUTPUT, -1);
+			pOutSample = GetOutputSample();
+			TRACE_END(TRACE_PROCESS_OUTPUT, pOutSample ? TraceFrameId(pOutSample) : -1);
+			hasOutput = pOutSample != NULL;
+			break;
 		}
 	}
-	m_sampleCount++;
-	OutputDebugStringA("DecodeOneFrame end\n");
 	return pOutSample;
 done:
-	printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
+	if (event) {
+		event->Release();
+	}
+	if (!inputProcessed) {
+		pInSample->Release();
+	}
 	return NULL;
 }
 
+// UVC cameras send MJPEG frames without DHT segments. Returns a copy of the
+// sample with the prebuilt Annex K segment inserted, or the sample itself when
+// it has its own tables. Takes over the caller's reference either way.
+IMFSample* MJPEGDecoder::AddDefaultHuffmanTables(IMFSample* pInSample)
+{
+	HRESULT hr;
+	IMFMediaBuffer* srcBuffer = NULL;
+	IMFMediaBuffer* dstBuffer = NULL;
+	IMFSample* pNewSample = NULL;
+	BYTE* pSrc = NULL;
+	BYTE* pDst = NULL;
+	DWORD len = 0;
+	LONGLONG value = 0;
+	bool needTables;
+
+	CHECK_HR(pInSample->ConvertToContiguousBuffer(&srcBuffer), "ConvertToContiguousBuffer failed");
+	CHECK_HR(srcBuffer->Lock(&pSrc, NULL, &len), "Lock failed");
+	needTables = len >= 4 && pSrc[0] == 0xFF && pSrc[1] == JPEG_SOI && !JpegHasHuffmanTables(pSrc, len);
+	if (needTables) {
+		hr = MFCreateMemoryBuffer(len + JPEG_DEFAULT_DHT_SIZE, &dstBuffer);
+		if (hr == S_OK) {
+			hr = dstBuffer->Lock(&pDst, NULL, NULL);
+		}
+		if (hr == S_OK) {
+			len = (DWORD)InsertDefaultHuffmanTables(pSrc, len, pDst);
+			dstBuffer->Unlock();
+		}
+	}
+	srcBuffer->Unlock();
+	if (!needTables) {
+		srcBuffer->Release();
+		return pInSample;
+	}
+	CHECK_HR(hr, "Failed to copy frame");
+	CHECK_HR(dstBuffer->SetCurrentLength(len), "SetCurrentLength failed");
+	CHECK_HR(MFCreateSample(&pNewSample), "MFCreateSample failed");
+	CHECK_HR(pNewSample->AddBuffer(dstBuffer), "AddBuffer failed");
+	if (pInSample->GetSampleTime(&value) == S_OK) {
+		pNewSample->SetSampleTime(value);
+	}
+	if (pInSample->GetSampleDuration(&value) == S_OK) {
+		pNewSample->SetSampleDuration(value);
+	}
+	dstBuffer->Release();
+	srcBuffer->Release();
+	pInSample->Release();
+	return pNewSample;
+done:
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
+	if (pNewSample) {
+		pNewSample->Release();
+	}
+	if (dstBuffer) {
+		dstBuffer->Release();
+	}
+	if (srcBuffer) {
+		srcBuffer->Release();
+	}
+	return pInSample;
+}
+
+// Takes an output sample from the pool, or allocates one when the pool is
+// empty. Never waits: the consumer may hold every pooled frame.
+static HRESULT CreateOutputSample(SamplePool* pPool, IMFSample** ppSample)
+{
+	HRESULT hr = S_OK;
+	IMFMediaBuffer* pBuffer = NULL;
+
+	if (pPool->CreateSample(false, ppSample) == S_OK) {
+		return S_OK;
+	}
+	*ppSample = NULL;
+	CHECK_HR(MFCreateSample(ppSample), "MFCreateSample failed");
+	CHECK_HR(MFCreateAlignedMemoryBuffer(pPool->BufferSize(), MF_64_BYTE_ALIGNMENT, &pBuffer), "MFCreateAlignedMemoryBuffer failed");
+	CHECK_HR((*ppSample)->AddBuffer(pBuffer), "AddBuffer failed");
+	pBuffer->Release();
+	return S_OK;
+done:
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
+	if (pBuffer) {
+		pBuffer->Release();
+	}
+	if (*ppSample) {
+		(*ppSample)->Release();
+		*ppSample = NULL;
+	}
+	return hr;
+}
+
+// Collects a decoded sample after METransformHaveOutput.
+IMFSample* MJPEGDecoder::GetOutputSample()
+{
+	IMFSample* pOutSample;
+	MFT_OUTPUT_DATA_BUFFER outputDataBuffer = { 0 };
+	DWORD processOutputStatus = 0;
+
+	outputDataBuffer.dwStreamID = m_outputStreamID;
+	outputDataBuffer.dwStatus = 0;
+	outputDataBuffer.pEvents = NULL;
+	if (m_pOutputPool && CreateOutputSample(m_pOutputPool, &outputDataBuffer.pSample) != S_OK) {
+		return NULL;
+	}
+
+	HRESULT hr = m_pDecoderTransform->ProcessOutput(0, 1, &outputDataBuffer, &processOutputStatus);
+	if (outputDataBuffer.pEvents) {
+		outputDataBuffer.pEvents->Release();
+	}
+	if (hr != S_OK) {
+		LOG_ERROR("ProcessOutput failed hr=%x\n", hr);
+		if (outputDataBuffer.pSample) {
+			outputDataBuffer.pSample->Release();
+		}
+		return NULL;
+	}
+	// Sample is ready and allocated on the decoder output buffer.
+	pOutSample = outputDataBuffer.pSample;
+	if (m_pDumpSink) {
+		// Only takes a reference; the sink's thread writes the files.
+		NV12Frame frame;
+		if (GetFrame(pOutSample, &frame) == S_OK) {
+			m_pDumpSink->Submit(&frame, m_sampleCount);
+			ReleaseFrame(&frame);
+		}
+	}
+	else if (m_sampleCount == 10) {
+		NV12Frame frame;
+		if (GetFrame(pOutSample, &frame) == S_OK) {
+			LOG_DEBUG("dump decodedSample\n");
+			//DumpNV12Frame(&frame);
+			SaveNV12PlanesBmp(&frame, PLANE_Y_FILENAME, PLANE_UV_FILENAME);
+			ReleaseFrame(&frame);
+		}
+	}
+	m_sampleCount++;
+	return pOutSample;
+}
+
+// The decoder aligns the Y plane height (e.g. 240 -> 256), leaving a zeros gap
+// before the UV plane. Move UV down so the sample is packed NV12. The pitch and
+// aligned height are those GetFrame() derives.
+HRESULT MJPEGDecoder::PackOutputSample(IMFSample* pSample)
+{
+	HRESULT hr = S_OK;
+	DWORD bufferCount = 0;
+	IMFMediaBuffer* mediaBuffer = NULL;
+	NV12Frame frame;
+	DWORD len = 0;
+	DWORD packedLen = (DWORD)NV12PackedSize(m_outWidth, m_outHeight);
+
+	CHECK_HR(pSample->GetBufferCount(&bufferCount), "GetBufferCount failed");
+	if (bufferCount != 1) {
+		return S_OK;
+	}
+	CHECK_HR(pSample->GetBufferByIndex(0, &mediaBuffer), "GetBufferByIndex failed");
+	CHECK_HR(mediaBuffer->GetCurrentLength(&len), "GetCurrentLength failed");
+	CHECK_HR(GetFrame(pSample, &frame), "GetFrame failed");
+	if (len <= packedLen || frame.pitchY < m_outWidth || NV12FrameSize(&frame) > len) {
+		// Already packed, or a layout that doesn't fit the buffer.
+		ReleaseFrame(&frame);
+		mediaBuffer->Release();
+		return S_OK;
+	}
+	NV12RepackInPlace(frame.pY, m_outWidth, m_outHeight, frame.pitchY, (size_t)frame.pitchY * frame.alignedHeight);
+	ReleaseFrame(&frame);
+	CHECK_HR(mediaBuffer->SetCurrentLength(packedLen), "SetCurrentLength failed");
+	mediaBuffer->Release();
+	return S_OK;
+done:
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
+	if (mediaBuffer) {
+		mediaBuffer->Release();
+	}
+	return hr;
+}
+
+// Receives MFT events on a Media Foundation work queue thread, following the
+// BeginGetEvent / MediaEventHandler pattern in MFUtility.h. It holds its own
+// reference on the event generator because the last pending request may
+// complete after StopAsync() has returned.
+class DecoderEventCallback : public IMFAsyncCallback
+{
+public:
+	DecoderEventCallback(MJPEGDecoder* pDecoder, IMFMediaEventGenerator* pEventGen)
+		: m_refCount(1), m_pDecoder(pDecoder), m_pEventGen(pEventGen)
+	{
+		m_pEventGen->AddRef();
+	}
+	~DecoderEventCallback() { m_pEventGen->Release(); }
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppv)
+	{
+		if (riid == IID_IUnknown || riid == __uuidof(IMFAsyncCallback)) {
+			*ppv = static_cast<IMFAsyncCallback*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+	STDMETHODIMP_(ULONG) AddRef() { return InterlockedIncrement(&m_refCount); }
+	STDMETHODIMP_(ULONG) Release()
+	{
+		ULONG count = InterlockedDecrement(&m_refCount);
+		if (count == 0) {
+			delete this;
+		}
+		return count;
+	}
+	STDMETHODIMP GetParameters(DWORD* pdwFlags, DWORD* pdwQueue) { return E_NOTIMPL; }
+
+	STDMETHODIMP Invoke(IMFAsyncResult* pAsyncResult)
+	{
+		IMFMediaEvent* pEvent = NULL;
+		MediaEventType eventType = MEUnknown;
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		HRESULT hr = m_pEventGen->EndGetEvent(pAsyncResult, &pEvent);
+		if (hr == S_OK) {
+			hr = pEvent->GetType(&eventType);
+		}
+		if (hr == S_OK && m_pDecoder) {
+			m_pDecoder->OnTransformEvent(eventType);
+		}
+		if (pEvent) {
+			pEvent->Release();
+		}
+		// Request the next event unless Stop() was called.
+		if (m_pDecoder) {
+			hr = m_pEventGen->BeginGetEvent(this, NULL);
+			if (hr != S_OK) { LOG_ERROR("Error BeginGetEvent hr=%x\n", hr); }
+		}
+		return S_OK;
+	}
+
+	// After Stop() returns no event reaches the decoder any more.
+	void Stop()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_pDecoder = NULL;
+	}
+
+private:
+	LONG m_refCount;
+	std::mutex m_lock;
+	MJPEGDecoder* m_pDecoder;
+	IMFMediaEventGenerator* m_pEventGen;
+};
+
+HRESULT MJPEGDecoder::StartAsync(UINT32 maxInFlight, DecodedFrameCallback callback, void* pContext)
+{
+	HRESULT hr;
+	if (m_pPipeline) {
+		return S_OK;
+	}
+	m_pPipeline = new DecodePipeline(this, maxInFlight);
+	m_pPipeline->SetCallback(callback, pContext);
+	m_pEventCallback = new DecoderEventCallback(this, m_pEventGen);
+	CHECK_HR(m_pEventGen->BeginGetEvent(m_pEventCallback, NULL), "BeginGetEvent failed");
+	return S_OK;
+done:
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
+	m_pEventCallback->Stop();
+	m_pEventCallback->Release();
+	m_pEventCallback = NULL;
+	delete m_pPipeline;
+	m_pPipeline = NULL;
+	return hr;
+}
+
+HRESULT MJPEGDecoder::SubmitFrame(IMFSample* pInSample, LONGLONG timestamp, bool block)
+{
+	if (m_pPipeline == NULL) {
+		return E_UNEXPECTED;
+	}
+	return m_pPipeline->Submit(pInSample, timestamp, block) ? S_OK : S_FALSE;
+}
+
+HRESULT MJPEGDecoder::PollFrame(NV12Frame* pFrame, DWORD timeoutMs)
+{
+	if (m_pPipeline == NULL) {
+		return E_UNEXPECTED;
+	}
+	return m_pPipeline->Poll(pFrame, NULL, timeoutMs) ? S_OK : S_FALSE;
+}
+
+// Waits for the frames in flight, then stops requesting events.
+HRESULT MJPEGDecoder::StopAsync()
+{
+	if (m_pPipeline == NULL) {
+		return S_OK;
+	}
+	m_pPipeline->Drain();
+	m_pEventCallback->Stop();
+	m_pPipeline->Flush();
+	delete m_pPipeline;
+	m_pPipeline = NULL;
+	m_pEventCallback->Release();
+	m_pEventCallback = NULL;
+	return S_OK;
+}
+
+void MJPEGDecoder::OnTransformEvent(MediaEventType eventType)
+{
+	if (m_pPipeline == NULL) {
+		return;
+	}
+	switch (eventType)
+	{
+	case METransformNeedInput:
+		TRACE_INSTANT(TRACE_NEED_INPUT, -1);
+		m_pPipeline->OnNeedInput();
+		break;
+	case METransformHaveOutput:
+		TRACE_INSTANT(TRACE_HAVE_OUTPUT, -1);
+		m_pPipeline->OnHaveOutput();
+		break;
+	}
+}
+
+bool MJPEGDecoder::ProcessInput(void* pInput)
+{
+	IMFSample* pInSample = AddDefaultHuffmanTables((IMFSample*)pInput);
+	HRESULT hr = m_pDecoderTransform->ProcessInput(m_inputStreamID, pInSample, 0);
+	if (hr != S_OK) { LOG_ERROR("Error %s %d hr=%x\n", __FILE__, __LINE__, hr); }
+	pInSample->Release();
+	return hr == S_OK;
+}
+
+bool MJPEGDecoder::ProcessOutput(NV12Frame* pFrame)
+{
+	IMFSample* pOutSample = GetOutputSample();
+	if (pOutSample == NULL) {
+		return false;
+	}
+	HRESULT hr = GetFrame(pOutSample, pFrame);
+	pOutSample->Release();
+	return hr == S_OK;
+}
+
+void MJPEGDecoder::ReleaseInput(void* pInput)
+{
+	((IMFSample*)pInput)->Release();
+}
+
 HRESULT MJPEGDecoder::Close()
 {
 	HRESULT hr;
 	return S_OK;
 done:
-	printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+	LOG_ERROR("Failed %s hr=%x\n", __FUNCTION__, hr);
 	return -1;
 }
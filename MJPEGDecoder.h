@@ -7,17 +7,57 @@
 #include <mferror.h>
 #include <wmcodecdsp.h>
 #include <fstream>
+#include <mutex>
 
-class MJPEGDecoder
+#include "IMJPEGDecoder.h"
+#include "NV12Frame.h"
+#include "DecodePipeline.h"
+#include "SamplePool.h"
+#include "FrameDumpSink.h"
+
+class DecoderEventCallback;
+
+// Output samples kept for MFTs that don't provide their own. Decoded frames
+// beyond this (e.g. all held by the consumer) get a freshly allocated sample.
+#define OUTPUT_SAMPLE_POOL_SIZE 8
+
+class MJPEGDecoder : public IMJPEGDecoder, public ITransformBackend
 {
 public :
 	MJPEGDecoder();
 	~MJPEGDecoder();
+	const char* Name() const { return "AMD MFT"; }
 	HRESULT Find();
 	HRESULT Configure(UINT32 width, UINT32 height, UINT32 framerate);
 	HRESULT Start();
 	IMFSample * DecodeOneFrame(IMFSample* pInSample);
+	HRESULT DecodeOneFrame(IMFSample* pInSample, NV12Frame* pFrame);
+	HRESULT DecodeOneFrame(const uint8_t* pData, size_t len, NV12Frame* pFrame);
 	HRESULT Close();
+	void GetColorSpace(YuvMatrix* pMatrix, YuvRange* pRange) const;
+	IMFSample* DecodeSample(IMFSample* pInSample);
+	IMFSample* AddDefaultHuffmanTables(IMFSample* pInSample);
+	IMFSample* GetOutputSample();
+	HRESULT GetFrame(IMFSample* pSample, NV12Frame* pFrame);
+	HRESULT PackOutputSample(IMFSample* pSample);
+
+	// Asynchronous decode: keeps up to maxInFlight frames in the MFT. Frames come
+	// back in submit order through the callback (on an MF work queue thread) or,
+	// without a callback, through PollFrame. Don't mix with DecodeOneFrame.
+	HRESULT StartAsync(UINT32 maxInFlight, DecodedFrameCallback callback, void* pContext);
+	HRESULT SubmitFrame(IMFSample* pInSample, LONGLONG timestamp, bool block);
+	HRESULT PollFrame(NV12Frame* pFrame, DWORD timeoutMs);
+	HRESULT StopAsync();
+	void OnTransformEvent(MediaEventType eventType);
+
+	// Decoded frames go to pSink (which picks every Nth) instead of the
+	// inline dump of frame 10. The sink must outlive the decoder's output.
+	void SetDumpSink(FrameDumpSink* pSink) { m_pDumpSink = pSink; }
+
+	// ITransformBackend
+	bool ProcessInput(void* pInput);
+	bool ProcessOutput(NV12Frame* pFrame);
+	void ReleaseInput(void* pInput);
 
 	// AMF MJPEG Decoder setup
 	IMFTransform* m_pDecoderTransform;
@@ -30,6 +70,16 @@ public :
 	UINT32 m_framerate;
 	UINT32 m_outWidth;
 	UINT32 m_outHeight;
+	UINT32 m_outStride;
+	YuvMatrix m_yuvMatrix;	// from MF_MT_YUV_MATRIX of the output type
+	YuvRange m_yuvRange;	// from MF_MT_VIDEO_NOMINAL_RANGE
+	bool m_packOutput;	// Remove the zeros gap between Y and UV in decoded samples, not while dumping
 	int m_sampleCount;
+
+	SamplePool* m_pOutputPool;	// NULL when the MFT provides output samples
+	FrameDumpSink* m_pDumpSink;	// NULL when dumping is disabled
+
+	DecodePipeline* m_pPipeline;
+	DecoderEventCallback* m_pEventCallback;
 };
 
@@ -0,0 +1,103 @@
+#include "MappedFile.h"
+
+#include <stdio.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+#if defined(_WIN32)
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#else
+	m_fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+HRESULT MappedFile::Open(const char* path)
+{
+	Close();
+#if defined(_WIN32)
+	LARGE_INTEGER size;
+	m_hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE) {
+		printf("Failed to open %s\n", path);
+		return E_FAIL;
+	}
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0) {
+		Close();
+		return E_FAIL;
+	}
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping == NULL) {
+		Close();
+		return E_FAIL;
+	}
+	m_pData = (const uint8_t*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_pData == NULL) {
+		Close();
+		return E_FAIL;
+	}
+	m_size = (size_t)size.QuadPart;
+#else
+	struct stat st;
+	m_fd = open(path, O_RDONLY);
+	if (m_fd < 0) {
+		printf("Failed to open %s\n", path);
+		return E_FAIL;
+	}
+	if (fstat(m_fd, &st) != 0 || st.st_size == 0) {
+		Close();
+		return E_FAIL;
+	}
+	void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (p == MAP_FAILED) {
+		Close();
+		return E_FAIL;
+	}
+	// Frames are read front to back.
+	madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+	m_pData = (const uint8_t*)p;
+	m_size = (size_t)st.st_size;
+#endif
+	return S_OK;
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if (m_pData) {
+		UnmapViewOfFile(m_pData);
+	}
+	if (m_hMapping) {
+		CloseHandle(m_hMapping);
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_hFile);
+	}
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#else
+	if (m_pData) {
+		munmap((void*)m_pData, m_size);
+	}
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+	m_fd = -1;
+#endif
+	m_pData = NULL;
+	m_size = 0;
+}
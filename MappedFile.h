@@ -0,0 +1,36 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PortableDefs.h"
+
+// Read only memory mapping of a whole file.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	HRESULT Open(const char* path);
+	void Close();
+
+	const uint8_t* Data() const { return m_pData; }
+	size_t Size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const uint8_t* m_pData;
+	size_t m_size;
+#if defined(_WIN32)
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#else
+	int m_fd;
+#endif
+};
+
+#endif
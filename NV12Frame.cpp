@@ -0,0 +1,160 @@
+#include "NV12Frame.h"
+#include "AlignedMemory.h"
+
+#include <atomic>
+#include <string.h>
+
+// Frame memory allocated from the heap, used by the software paths and tests.
+class MemoryFrameOwner : public IFrameOwner
+{
+public:
+	MemoryFrameOwner(void* pData) : m_refCount(1), m_pData(pData) {}
+	~MemoryFrameOwner() { AlignedFree(m_pData); }
+
+	void AddRef() { ++m_refCount; }
+	void Release()
+	{
+		if (--m_refCount == 0) {
+			delete this;
+		}
+	}
+
+private:
+	std::atomic<long> m_refCount;
+	void* m_pData;
+};
+
+IFrameOwner* CreateHeapFrameOwner(void* pData)
+{
+	return new MemoryFrameOwner(pData);
+}
+
+void DescribeNV12Frame(uint8_t* pBase, uint32_t width, uint32_t height, uint32_t pitch, uint32_t alignedHeight,
+	IFrameOwner* pOwner, NV12Frame* pFrame)
+{
+	pFrame->pY = pBase;
+	pFrame->pUV = pBase + (size_t)pitch * alignedHeight;
+	pFrame->pitchY = pitch;
+	pFrame->pitchUV = pitch;
+	pFrame->width = width;
+	pFrame->height = height;
+	pFrame->alignedHeight = alignedHeight;
+	pFrame->timestamp = 0;
+	pFrame->pOwner = pOwner;
+	if (pOwner) {
+		pOwner->AddRef();
+	}
+}
+
+bool AllocateNV12Frame(uint32_t width, uint32_t height, uint32_t pitch, uint32_t alignedHeight, NV12Frame* pFrame)
+{
+	if (pitch < width || alignedHeight < height) {
+		return false;
+	}
+	size_t size = (size_t)pitch * alignedHeight + (size_t)pitch * ((alignedHeight + 1) / 2);
+	uint8_t* pData = (uint8_t*)AlignedAlloc(size);
+	if (pData == NULL) {
+		return false;
+	}
+	// Zero only the padding, the image area is about to be written anyway.
+	if (pitch != width) {
+		for (uint32_t y = 0; y < height; ++y) {
+			memset(pData + (size_t)y * pitch + width, 0, pitch - width);
+		}
+		for (uint32_t y = 0; y < (height + 1) / 2; ++y) {
+			memset(pData + (size_t)pitch * alignedHeight + (size_t)y * pitch + width, 0, pitch - width);
+		}
+	}
+	if (alignedHeight != height) {
+		memset(pData + (size_t)pitch * height, 0, (size_t)pitch * (alignedHeight - height));
+	}
+	memset(pData + (size_t)pitch * alignedHeight + (size_t)pitch * ((height + 1) / 2), 0,
+		(size_t)pitch * ((alignedHeight + 1) / 2 - (height + 1) / 2));
+	IFrameOwner* pOwner = CreateHeapFrameOwner(pData);
+	DescribeNV12Frame(pData, width, height, pitch, alignedHeight, pOwner, pFrame);
+	pOwner->Release();
+	return true;
+}
+
+bool AllocateLumaFrame(uint32_t width, uint32_t height, uint32_t pitch, uint32_t alignedHeight, NV12Frame* pFrame)
+{
+	if (pitch < width || alignedHeight < height) {
+		return false;
+	}
+	uint8_t* pData = (uint8_t*)AlignedAlloc((size_t)pitch * alignedHeight);
+	if (pData == NULL) {
+		return false;
+	}
+	if (pitch != width) {
+		for (uint32_t y = 0; y < height; ++y) {
+			memset(pData + (size_t)y * pitch + width, 0, pitch - width);
+		}
+	}
+	if (alignedHeight != height) {
+		memset(pData + (size_t)pitch * height, 0, (size_t)pitch * (alignedHeight - height));
+	}
+	IFrameOwner* pOwner = CreateHeapFrameOwner(pData);
+	DescribeNV12Frame(pData, width, height, pitch, alignedHeight, pOwner, pFrame);
+	pFrame->pUV = NULL;
+	pFrame->pitchUV = 0;
+	pOwner->Release();
+	return true;
+}
+
+void RetainFrame(const NV12Frame* pFrame)
+{
+	if (pFrame->pOwner) {
+		pFrame->pOwner->AddRef();
+	}
+}
+
+void ReleaseFrame(NV12Frame* pFrame)
+{
+	if (pFrame->pOwner) {
+		pFrame->pOwner->Release();
+	}
+	memset(pFrame, 0, sizeof(*pFrame));
+}
+
+size_t NV12FrameSize(const NV12Frame* pFrame)
+{
+	if (pFrame->pUV == NULL) {
+		return (size_t)pFrame->pitchY * pFrame->alignedHeight;
+	}
+	return (size_t)(pFrame->pUV - pFrame->pY) + (size_t)pFrame->pitchUV * ((pFrame->height + 1) / 2);
+}
+
+static void ComparePlane(const uint8_t* pA, uint32_t pitchA, const uint8_t* pB, uint32_t pitchB,
+	uint32_t rowBytes, uint32_t rows, uint32_t* pMax, double* pMean)
+{
+	uint64_t sum = 0;
+	uint32_t maxDiff = 0;
+	for (uint32_t y = 0; y < rows; ++y) {
+		const uint8_t* a = pA + (size_t)y * pitchA;
+		const uint8_t* b = pB + (size_t)y * pitchB;
+		for (uint32_t x = 0; x < rowBytes; ++x) {
+			uint32_t d = a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+			sum += d;
+			if (d > maxDiff) {
+				maxDiff = d;
+			}
+		}
+	}
+	*pMax = maxDiff;
+	*pMean = rows && rowBytes ? (double)sum / ((double)rows * rowBytes) : 0.0;
+}
+
+bool CompareNV12Frames(const NV12Frame* pA, const NV12Frame* pB, NV12FrameDiff* pDiff)
+{
+	if (pA->width != pB->width || pA->height != pB->height) {
+		return false;
+	}
+	ComparePlane(pA->pY, pA->pitchY, pB->pY, pB->pitchY, pA->width, pA->height, &pDiff->maxDiffY, &pDiff->meanDiffY);
+	pDiff->maxDiffUV = 0;
+	pDiff->meanDiffUV = 0.0;
+	if (pA->pUV && pB->pUV) {
+		ComparePlane(pA->pUV, pA->pitchUV, pB->pUV, pB->pitchUV, (pA->width + 1) & ~1u, (pA->height + 1) / 2,
+			&pDiff->maxDiffUV, &pDiff->meanDiffUV);
+	}
+	return true;
+}
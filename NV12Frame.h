@@ -0,0 +1,70 @@
+#ifndef __NV12FRAME_H__
+#define __NV12FRAME_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keeps the memory behind a frame alive (locked media buffer, heap block, ...).
+// Reference counted like a COM object; the last Release() frees the memory.
+class IFrameOwner
+{
+public:
+	virtual ~IFrameOwner() {}
+	virtual void AddRef() = 0;
+	virtual void Release() = 0;
+};
+
+// A decoded NV12 frame in the decoder's own layout. Rows are pitchY / pitchUV
+// bytes apart and the UV plane may start after a padded Y plane of
+// alignedHeight rows, so consumers must not assume UV at width * height.
+// Luma only decodes (DecodeOptions::lumaOnly) leave pUV NULL and pitchUV 0.
+struct NV12Frame
+{
+	uint8_t* pY;
+	uint8_t* pUV;
+	uint32_t pitchY;
+	uint32_t pitchUV;
+	uint32_t width;
+	uint32_t height;
+	uint32_t alignedHeight;
+	int64_t timestamp;	// 100ns units like MF sample times
+	IFrameOwner* pOwner;
+};
+
+// Owner of an AlignedAlloc'ed block, holding one reference. The last
+// Release() frees the block.
+IFrameOwner* CreateHeapFrameOwner(void* pData);
+
+// Fills pFrame for an NV12 image that starts at pBase and takes a reference on pOwner.
+void DescribeNV12Frame(uint8_t* pBase, uint32_t width, uint32_t height, uint32_t pitch, uint32_t alignedHeight,
+	IFrameOwner* pOwner, NV12Frame* pFrame);
+
+// Allocates a heap backed frame with the given layout. Only the padding is zero filled.
+bool AllocateNV12Frame(uint32_t width, uint32_t height, uint32_t pitch, uint32_t alignedHeight, NV12Frame* pFrame);
+
+// Same for a frame with only the Y plane, pUV NULL.
+bool AllocateLumaFrame(uint32_t width, uint32_t height, uint32_t pitch, uint32_t alignedHeight, NV12Frame* pFrame);
+
+// Adds a reference for a second holder of the same frame.
+void RetainFrame(const NV12Frame* pFrame);
+
+// Drops the frame's reference and clears the descriptor.
+void ReleaseFrame(NV12Frame* pFrame);
+
+// Size in bytes of the frame's memory from pY to the end of the UV plane, or
+// of the Y plane without one.
+size_t NV12FrameSize(const NV12Frame* pFrame);
+
+struct NV12FrameDiff
+{
+	uint32_t maxDiffY;
+	uint32_t maxDiffUV;
+	double meanDiffY;
+	double meanDiffUV;
+};
+
+// Compares the visible pixels of two frames of the same size, whatever their
+// layout. UV is only compared when both frames have it.
+bool CompareNV12Frames(const NV12Frame* pA, const NV12Frame* pB, NV12FrameDiff* pDiff);
+
+#endif
@@ -0,0 +1,227 @@
+#include "NV12Repack.h"
+#include "CpuFeatures.h"
+
+#include <string.h>
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+
+// Copies 'rows' rows of 'rowBytes' each. Rows are processed front to back and
+// every block is loaded before it is stored, so dst may overlap src as long as
+// dst <= src (which is always the case when packing in place).
+typedef void (*CopyRowsFunc)(uint8_t* dst, size_t dstPitch, const uint8_t* src, size_t srcPitch,
+	size_t rowBytes, size_t rows, bool stream);
+
+static void CopyRowsScalar(uint8_t* dst, size_t dstPitch, const uint8_t* src, size_t srcPitch,
+	size_t rowBytes, size_t rows, bool stream)
+{
+	(void)stream;	// memmove has no streaming form
+	for (size_t r = 0; r < rows; ++r) {
+		if (dst != src) {
+			memmove(dst, src, rowBytes);
+		}
+		dst += dstPitch;
+		src += srcPitch;
+	}
+}
+
+#if defined(CPU_X86)
+// MOVNTDQA only helps (and is only legal) on aligned addresses; it is what makes
+// reads from write-combined decoder output fast compared to plain memcpy.
+TARGET_SSE41 static void CopyRowsSSE41(uint8_t* dst, size_t dstPitch, const uint8_t* src, size_t srcPitch,
+	size_t rowBytes, size_t rows, bool stream)
+{
+	for (size_t r = 0; r < rows; ++r) {
+		uint8_t* d = dst + r * dstPitch;
+		const uint8_t* s = src + r * srcPitch;
+		size_t n = rowBytes;
+		if (d == s) {
+			continue;
+		}
+		size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+		if (head > n) {
+			head = n;
+		}
+		memmove(d, s, head);
+		d += head;
+		s += head;
+		n -= head;
+
+		bool alignedLoad = ((uintptr_t)s & 15) == 0;
+		while (n >= 64) {
+			__m128i x0, x1, x2, x3;
+			if (alignedLoad) {
+				x0 = _mm_stream_load_si128((__m128i*)(s + 0));
+				x1 = _mm_stream_load_si128((__m128i*)(s + 16));
+				x2 = _mm_stream_load_si128((__m128i*)(s + 32));
+				x3 = _mm_stream_load_si128((__m128i*)(s + 48));
+			}
+			else {
+				x0 = _mm_loadu_si128((const __m128i*)(s + 0));
+				x1 = _mm_loadu_si128((const __m128i*)(s + 16));
+				x2 = _mm_loadu_si128((const __m128i*)(s + 32));
+				x3 = _mm_loadu_si128((const __m128i*)(s + 48));
+			}
+			if (stream) {
+				_mm_stream_si128((__m128i*)(d + 0), x0);
+				_mm_stream_si128((__m128i*)(d + 16), x1);
+				_mm_stream_si128((__m128i*)(d + 32), x2);
+				_mm_stream_si128((__m128i*)(d + 48), x3);
+			}
+			else {
+				_mm_store_si128((__m128i*)(d + 0), x0);
+				_mm_store_si128((__m128i*)(d + 16), x1);
+				_mm_store_si128((__m128i*)(d + 32), x2);
+				_mm_store_si128((__m128i*)(d + 48), x3);
+			}
+			d += 64;
+			s += 64;
+			n -= 64;
+		}
+		while (n >= 16) {
+			__m128i x = alignedLoad ? _mm_stream_load_si128((__m128i*)s) : _mm_loadu_si128((const __m128i*)s);
+			if (stream) {
+				_mm_stream_si128((__m128i*)d, x);
+			}
+			else {
+				_mm_store_si128((__m128i*)d, x);
+			}
+			d += 16;
+			s += 16;
+			n -= 16;
+		}
+		memmove(d, s, n);
+	}
+	if (stream) {
+		_mm_sfence();
+	}
+}
+
+TARGET_AVX2 static void CopyRowsAVX2(uint8_t* dst, size_t dstPitch, const uint8_t* src, size_t srcPitch,
+	size_t rowBytes, size_t rows, bool stream)
+{
+	for (size_t r = 0; r < rows; ++r) {
+		uint8_t* d = dst + r * dstPitch;
+		const uint8_t* s = src + r * srcPitch;
+		size_t n = rowBytes;
+		if (d == s) {
+			continue;
+		}
+		size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+		if (head > n) {
+			head = n;
+		}
+		memmove(d, s, head);
+		d += head;
+		s += head;
+		n -= head;
+
+		bool alignedLoad = ((uintptr_t)s & 31) == 0;
+		while (n >= 128) {
+			__m256i y0, y1, y2, y3;
+			if (alignedLoad) {
+				y0 = _mm256_stream_load_si256((__m256i*)(s + 0));
+				y1 = _mm256_stream_load_si256((__m256i*)(s + 32));
+				y2 = _mm256_stream_load_si256((__m256i*)(s + 64));
+				y3 = _mm256_stream_load_si256((__m256i*)(s + 96));
+			}
+			else {
+				y0 = _mm256_loadu_si256((const __m256i*)(s + 0));
+				y1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+				y2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+				y3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+			}
+			if (stream) {
+				_mm256_stream_si256((__m256i*)(d + 0), y0);
+				_mm256_stream_si256((__m256i*)(d + 32), y1);
+				_mm256_stream_si256((__m256i*)(d + 64), y2);
+				_mm256_stream_si256((__m256i*)(d + 96), y3);
+			}
+			else {
+				_mm256_store_si256((__m256i*)(d + 0), y0);
+				_mm256_store_si256((__m256i*)(d + 32), y1);
+				_mm256_store_si256((__m256i*)(d + 64), y2);
+				_mm256_store_si256((__m256i*)(d + 96), y3);
+			}
+			d += 128;
+			s += 128;
+			n -= 128;
+		}
+		while (n >= 32) {
+			__m256i y = alignedLoad ? _mm256_stream_load_si256((__m256i*)s) : _mm256_loadu_si256((const __m256i*)s);
+			if (stream) {
+				_mm256_stream_si256((__m256i*)d, y);
+			}
+			else {
+				_mm256_store_si256((__m256i*)d, y);
+			}
+			d += 32;
+			s += 32;
+			n -= 32;
+		}
+		memmove(d, s, n);
+	}
+	if (stream) {
+		_mm_sfence();
+	}
+	_mm256_zeroupper();
+}
+#endif
+
+static CopyRowsFunc SelectCopyRows()
+{
+#if defined(CPU_X86)
+	unsigned int features = GetCpuFeatures();
+	if (features & CPU_FEATURE_AVX2) {
+		return CopyRowsAVX2;
+	}
+	if (features & CPU_FEATURE_SSE41) {
+		return CopyRowsSSE41;
+	}
+#endif
+	return CopyRowsScalar;
+}
+
+// Copies one plane, collapsing it into a single run when both sides are packed.
+static void CopyPlane(CopyRowsFunc copyRows, uint8_t* dst, size_t dstPitch, const uint8_t* src, size_t srcPitch,
+	size_t rowBytes, size_t rows, bool stream)
+{
+	if (dstPitch == rowBytes && srcPitch == rowBytes) {
+		copyRows(dst, 0, src, 0, rowBytes * rows, 1, stream);
+	}
+	else {
+		copyRows(dst, dstPitch, src, srcPitch, rowBytes, rows, stream);
+	}
+}
+
+size_t NV12PackedSize(uint32_t width, uint32_t height)
+{
+	size_t uvRowBytes = (width + 1) & ~1u;
+	return (size_t)width * height + uvRowBytes * ((height + 1) / 2);
+}
+
+void NV12Repack(const uint8_t* srcY, uint32_t pitchY, const uint8_t* srcUV, uint32_t pitchUV,
+	uint32_t width, uint32_t height, uint8_t* dst)
+{
+	CopyRowsFunc copyRows = SelectCopyRows();
+	size_t uvRowBytes = (width + 1) & ~1u;
+	bool stream = NV12PackedSize(width, height) >= NV12_STREAM_THRESHOLD;
+
+	CopyPlane(copyRows, dst, width, srcY, pitchY, width, height, stream);
+	CopyPlane(copyRows, dst + (size_t)width * height, uvRowBytes, srcUV, pitchUV, uvRowBytes, (height + 1) / 2, stream);
+}
+
+void NV12RepackInPlace(uint8_t* buf, uint32_t width, uint32_t height, uint32_t pitch, size_t uvOffset)
+{
+	CopyRowsFunc copyRows = SelectCopyRows();
+	size_t uvRowBytes = (width + 1) & ~1u;
+	bool stream = NV12PackedSize(width, height) >= NV12_STREAM_THRESHOLD;
+
+	// Row r moves from r * pitch down to r * width, so rows never overtake
+	// their source. With pitch == width the Y plane is already in place.
+	if (pitch != width) {
+		copyRows(buf, width, buf, pitch, width, height, stream);
+	}
+	CopyPlane(copyRows, buf + (size_t)width * height, uvRowBytes, buf + uvOffset, pitch, uvRowBytes, (height + 1) / 2, stream);
+}
@@ -0,0 +1,24 @@
+#ifndef __NV12REPACK_H__
+#define __NV12REPACK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frames at least this large are written with non-temporal stores so the
+// copy does not evict the decoder's working set from the cache.
+#define NV12_STREAM_THRESHOLD (1024 * 1024)
+
+// Size of a packed NV12 image: pitch == width and UV directly after Y.
+size_t NV12PackedSize(uint32_t width, uint32_t height);
+
+// Copies an NV12 image with padded rows and/or a padded Y plane into dst as
+// packed NV12. The source may live in write-combined (GPU) memory.
+void NV12Repack(const uint8_t* srcY, uint32_t pitchY, const uint8_t* srcUV, uint32_t pitchUV,
+	uint32_t width, uint32_t height, uint8_t* dst);
+
+// Packs an NV12 image within its own buffer. buf holds Y rows of 'pitch' bytes
+// and the UV plane at uvOffset (e.g. after the zeros gap of an aligned height).
+// When pitch == width only the UV plane is moved.
+void NV12RepackInPlace(uint8_t* buf, uint32_t width, uint32_t height, uint32_t pitch, size_t uvOffset);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef __PORTABLEDEFS_H__
+#define __PORTABLEDEFS_H__
+
+#include <stdint.h>
+
+// HRESULT and friends for code that also builds without the Windows SDK.
+#if defined(_WIN32)
+#include <windows.h>
+#else
+typedef int32_t HRESULT;
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_UNEXPECTED ((HRESULT)0x8000FFFFL)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#endif
+
+#endif
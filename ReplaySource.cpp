@@ -0,0 +1,279 @@
+#include "ReplaySource.h"
+#include "JpegParser.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <thread>
+
+static_assert(sizeof(ReplayIndexHeader) == 24 && sizeof(ReplayIndexEntry) == 24, "index layout");
+
+static uint32_t ReadLE32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static constexpr uint32_t ChunkId(const char* s)
+{
+	return (uint32_t)(uint8_t)s[0] | ((uint32_t)(uint8_t)s[1] << 8) | ((uint32_t)(uint8_t)s[2] << 16) |
+		((uint32_t)(uint8_t)s[3] << 24);
+}
+
+// "##dc" (compressed video) or "##db" (uncompressed, some MJPEG writers use it).
+static bool IsVideoChunk(const uint8_t* id)
+{
+	return id[0] >= '0' && id[0] <= '9' && id[1] >= '0' && id[1] <= '9' && id[2] == 'd' && (id[3] == 'c' || id[3] == 'b');
+}
+
+ReplaySource::ReplaySource()
+{
+	m_container = REPLAY_CONTAINER_NONE;
+	m_fileFps = 0.0;
+	m_pacingFps = REPLAY_AS_FAST_AS_POSSIBLE;
+	m_loop = false;
+	m_aviFrames = 0;
+	m_next = 0;
+	m_loopOffset = 0;
+	m_paced = 0;
+	m_firstTimestamp = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+HRESULT ReplaySource::Open(const char* path)
+{
+	HRESULT hr;
+	Close();
+	hr = m_file.Open(path);
+	if (hr != S_OK) {
+		return hr;
+	}
+	const uint8_t* pData = m_file.Data();
+	size_t len = m_file.Size();
+	if (len >= 12 && ReadLE32(pData) == ChunkId("RIFF") && ReadLE32(pData + 8) == ChunkId("AVI ")) {
+		m_container = REPLAY_CONTAINER_AVI;
+		IndexAvi(pData, len);
+	}
+	else if (len >= sizeof(ReplayIndexHeader) && memcmp(pData, REPLAY_INDEX_MAGIC, 8) == 0) {
+		m_container = REPLAY_CONTAINER_INDEXED;
+		if (!IndexIndexed(pData, len)) {
+			m_frames.clear();
+		}
+	}
+	else if (len >= 2 && pData[0] == 0xFF && pData[1] == JPEG_SOI) {
+		m_container = REPLAY_CONTAINER_JPEG;
+		IndexJpegStream(pData, len);
+	}
+	if (m_frames.empty()) {
+		LOG_ERROR("No MJPEG frames found in %s\n", path);
+		Close();
+		return E_FAIL;
+	}
+	LOG_INFO("Replaying %s: %u frames, %.2f fps\n", path, FrameCount(), m_fileFps);
+	return S_OK;
+}
+
+void ReplaySource::Close()
+{
+	m_file.Close();
+	m_frames.clear();
+	m_container = REPLAY_CONTAINER_NONE;
+	m_fileFps = 0.0;
+	Rewind();
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void ReplaySource::AddFrame(const uint8_t* pData, size_t len, int64_t timestamp)
+{
+	Frame frame = { pData, len, timestamp };
+	m_frames.push_back(frame);
+}
+
+// Splits back to back JPEG frames at their EOI. Bytes between frames are
+// skipped up to the next SOI, and so is a frame that doesn't parse.
+void ReplaySource::IndexJpegStream(const uint8_t* pData, size_t len)
+{
+	m_fileFps = REPLAY_DEFAULT_FPS;
+	size_t pos = 0;
+	while (pos + 4 <= len) {
+		const uint8_t* p = (const uint8_t*)memchr(pData + pos, 0xFF, len - pos - 1);
+		if (p == NULL) {
+			break;
+		}
+		pos = p - pData;
+		if (p[1] != JPEG_SOI) {
+			pos++;
+			continue;
+		}
+		size_t frameLen = FindJpegFrameEnd(p, len - pos);
+		if (frameLen == 0) {
+			pos += 2;
+			continue;
+		}
+		AddFrame(p, frameLen, (int64_t)(m_frames.size() * 10000000.0 / m_fileFps));
+		pos += frameLen;
+	}
+}
+
+// Walks RIFF / LIST chunks. The OpenDML extension continues the movi data in
+// further RIFF 'AVIX' chunks, which are covered by walking the whole file.
+void ReplaySource::ParseAviChunks(const uint8_t* p, const uint8_t* end, int depth)
+{
+	while (end - p >= 8) {
+		uint32_t id = ReadLE32(p);
+		size_t size = ReadLE32(p + 4);
+		const uint8_t* pBody = p + 8;
+		if (size > (size_t)(end - pBody)) {
+			size = end - pBody;	// truncated file
+		}
+		if ((id == ChunkId("RIFF") || id == ChunkId("LIST")) && size >= 4) {
+			if (depth < 4) {
+				ParseAviChunks(pBody + 4, pBody + size, depth + 1);
+			}
+		}
+		else if (id == ChunkId("avih") && size >= 4) {
+			uint32_t usPerFrame = ReadLE32(pBody);
+			if (usPerFrame && m_fileFps == 0.0) {
+				m_fileFps = 1000000.0 / usPerFrame;
+			}
+		}
+		else if (IsVideoChunk(p)) {
+			// An empty chunk repeats the previous frame; it still takes a frame period.
+			int64_t timestamp = (int64_t)(m_aviFrames++ * 10000000.0 / (m_fileFps > 0.0 ? m_fileFps : REPLAY_DEFAULT_FPS));
+			if (size >= 4 && pBody[0] == 0xFF && pBody[1] == JPEG_SOI) {
+				// Chunks may carry padding after the EOI.
+				size_t frameLen = FindJpegFrameEnd(pBody, size);
+				AddFrame(pBody, frameLen ? frameLen : size, timestamp);
+			}
+		}
+		p = pBody + size + (size & 1);
+	}
+}
+
+bool ReplaySource::IndexAvi(const uint8_t* pData, size_t len)
+{
+	m_aviFrames = 0;
+	ParseAviChunks(pData, pData + len, 0);
+	if (m_fileFps == 0.0) {
+		m_fileFps = REPLAY_DEFAULT_FPS;
+	}
+	return !m_frames.empty();
+}
+
+bool ReplaySource::IndexIndexed(const uint8_t* pData, size_t len)
+{
+	ReplayIndexHeader header;
+	memcpy(&header, pData, sizeof(header));
+	if ((uint64_t)header.frameCount * sizeof(ReplayIndexEntry) > len - sizeof(header)) {
+		return false;
+	}
+	m_fileFps = header.fpsNum && header.fpsDen ? (double)header.fpsNum / header.fpsDen : REPLAY_DEFAULT_FPS;
+	for (uint32_t i = 0; i < header.frameCount; ++i) {
+		ReplayIndexEntry entry;
+		memcpy(&entry, pData + sizeof(header) + (size_t)i * sizeof(entry), sizeof(entry));
+		if (entry.offset > len || entry.length > len - entry.offset) {
+			return false;
+		}
+		AddFrame(pData + entry.offset, entry.length, entry.timestamp);
+	}
+	return true;
+}
+
+void ReplaySource::SetPacing(double fps)
+{
+	m_pacingFps = fps;
+	m_paced = 0;
+}
+
+void ReplaySource::Rewind()
+{
+	m_next = 0;
+	m_loopOffset = 0;
+	m_paced = 0;
+}
+
+void ReplaySource::GetFrame(uint32_t i, CompressedFrame* pFrame) const
+{
+	pFrame->pData = m_frames[i].pData;
+	pFrame->len = m_frames[i].len;
+	pFrame->timestamp = m_frames[i].timestamp;
+	pFrame->pfnRelease = NULL;
+	pFrame->pOwner = NULL;
+}
+
+HRESULT ReplaySource::ReadFrame(CompressedFrame* pFrame)
+{
+	if (m_next >= m_frames.size()) {
+		if (!m_loop || m_frames.empty()) {
+			return S_FALSE;
+		}
+		// Keep timestamps increasing: the next loop starts one frame period after the last frame.
+		m_loopOffset += m_frames.back().timestamp - m_frames.front().timestamp + (int64_t)(10000000.0 / m_fileFps);
+		m_next = 0;
+		m_stats.loops++;
+	}
+	GetFrame(m_next++, pFrame);
+	pFrame->timestamp += m_loopOffset;
+
+	if (m_pacingFps != REPLAY_AS_FAST_AS_POSSIBLE) {
+		Clock::time_point now = Clock::now();
+		if (m_paced == 0) {
+			m_start = now;
+			m_firstTimestamp = pFrame->timestamp;
+		}
+		// At the file rate frames are due at their timestamps, so variable frame rates replay as recorded.
+		double dueSeconds = m_pacingFps > 0.0 ? m_paced / m_pacingFps : (pFrame->timestamp - m_firstTimestamp) / 10000000.0;
+		double periodMs = 1000.0 / (m_pacingFps > 0.0 ? m_pacingFps : m_fileFps);
+		Clock::time_point due = m_start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(dueSeconds));
+		if (now < due) {
+			std::this_thread::sleep_until(due);
+		}
+		else {
+			double lateMs = std::chrono::duration<double, std::milli>(now - due).count();
+			if (lateMs > periodMs) {
+				m_stats.lateFrames++;
+			}
+			if (lateMs > m_stats.maxLateMs) {
+				m_stats.maxLateMs = lateMs;
+			}
+		}
+		m_paced++;
+	}
+	m_stats.framesRead++;
+	return S_OK;
+}
+
+bool WriteIndexedMJPEG(const char* path, const uint8_t* const* ppFrames, const size_t* pLengths,
+	const int64_t* pTimestamps, uint32_t count, double fps)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		LOG_ERROR("Failed to open %s\n", path);
+		return false;
+	}
+	ReplayIndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, REPLAY_INDEX_MAGIC, 8);
+	header.frameCount = count;
+	header.fpsNum = (uint32_t)(fps * 1000.0 + 0.5);
+	header.fpsDen = 1000;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	uint64_t offset = sizeof(header) + (uint64_t)count * sizeof(ReplayIndexEntry);
+	for (uint32_t i = 0; i < count && ok; ++i) {
+		ReplayIndexEntry entry;
+		entry.offset = offset;
+		entry.length = (uint32_t)pLengths[i];
+		entry.reserved = 0;
+		entry.timestamp = pTimestamps ? pTimestamps[i] : (int64_t)(i * 10000000.0 / fps);
+		ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+		offset += pLengths[i];
+	}
+	for (uint32_t i = 0; i < count && ok; ++i) {
+		ok = fwrite(ppFrames[i], 1, pLengths[i], file) == pLengths[i];
+	}
+	if (fclose(file) != 0) {
+		ok = false;
+	}
+	return ok;
+}
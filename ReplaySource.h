@@ -0,0 +1,125 @@
+#ifndef __REPLAYSOURCE_H__
+#define __REPLAYSOURCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+#include "FrameScheduler.h"
+#include "MappedFile.h"
+
+enum ReplayContainer
+{
+	REPLAY_CONTAINER_NONE,
+	REPLAY_CONTAINER_JPEG,		// JPEG frames back to back (e.g. a raw MJPEG dump)
+	REPLAY_CONTAINER_AVI,		// RIFF AVI / OpenDML with MJPG video
+	REPLAY_CONTAINER_INDEXED,	// WriteIndexedMJPEG
+};
+
+// Pacing value for ReplaySource::SetPacing.
+#define REPLAY_AS_FAST_AS_POSSIBLE 0.0
+#define REPLAY_FILE_RATE -1.0
+
+// Rate used when a raw JPEG stream is paced with REPLAY_FILE_RATE.
+#define REPLAY_DEFAULT_FPS 30.0
+
+// Indexed container: this header, frameCount entries, then the JPEG data.
+// All fields little endian.
+#define REPLAY_INDEX_MAGIC "MJPGIDX1"
+
+struct ReplayIndexHeader
+{
+	char magic[8];
+	uint32_t frameCount;
+	uint32_t fpsNum;
+	uint32_t fpsDen;
+	uint32_t reserved;
+};
+
+struct ReplayIndexEntry
+{
+	uint64_t offset;	// from the start of the file
+	uint32_t length;
+	uint32_t reserved;
+	int64_t timestamp;	// 100ns units
+};
+
+struct ReplayStats
+{
+	uint64_t framesRead;
+	uint32_t loops;
+	uint64_t lateFrames;	// read more than one frame period after they were due
+	double maxLateMs;
+};
+
+// Plays MJPEG frames from a file in place of the webcam's IMFSourceReader.
+// The file is memory mapped and split into frames once; ReadFrame hands out
+// pointers into the mapping, so nothing is copied. Not thread safe.
+class ReplaySource
+{
+public:
+	ReplaySource();
+
+	// Maps the file and finds its frames. The container is detected from the
+	// first bytes.
+	HRESULT Open(const char* path);
+	void Close();
+
+	// fps > 0 releases frames at that rate, REPLAY_AS_FAST_AS_POSSIBLE doesn't
+	// wait, REPLAY_FILE_RATE uses the rate stored in the file.
+	void SetPacing(double fps);
+	// Start over at the end of the file instead of reporting the end.
+	void SetLoop(bool loop) { m_loop = loop; }
+
+	// Waits until the next frame is due and describes it. pFrame->pData stays
+	// valid until Close(); pfnRelease is NULL. Returns S_FALSE at the end.
+	HRESULT ReadFrame(CompressedFrame* pFrame);
+	void Rewind();
+
+	uint32_t FrameCount() const { return (uint32_t)m_frames.size(); }
+	// Frame i without pacing, e.g. for benchmarks.
+	void GetFrame(uint32_t i, CompressedFrame* pFrame) const;
+	double FileFps() const { return m_fileFps; }
+	ReplayContainer Container() const { return m_container; }
+	ReplayStats GetStats() const { return m_stats; }
+
+private:
+	struct Frame
+	{
+		const uint8_t* pData;
+		size_t len;
+		int64_t timestamp;
+	};
+	typedef std::chrono::steady_clock Clock;
+
+	void IndexJpegStream(const uint8_t* pData, size_t len);
+	bool IndexAvi(const uint8_t* pData, size_t len);
+	bool IndexIndexed(const uint8_t* pData, size_t len);
+	void ParseAviChunks(const uint8_t* p, const uint8_t* end, int depth);
+	void AddFrame(const uint8_t* pData, size_t len, int64_t timestamp);
+
+	MappedFile m_file;
+	std::vector<Frame> m_frames;
+	ReplayContainer m_container;
+	double m_fileFps;
+	double m_pacingFps;
+	bool m_loop;
+
+	uint32_t m_aviFrames;	// video chunks seen while indexing, empty ones included
+
+	uint32_t m_next;
+	int64_t m_loopOffset;	// added to the timestamps after each loop
+	uint64_t m_paced;	// frames read since the pacing clock started
+	Clock::time_point m_start;
+	int64_t m_firstTimestamp;	// of the first paced frame
+	ReplayStats m_stats;
+};
+
+// Writes frames to an indexed container that ReplaySource plays back with
+// their timestamps (100ns units; NULL for frame number / fps).
+bool WriteIndexedMJPEG(const char* path, const uint8_t* const* ppFrames, const size_t* pLengths,
+	const int64_t* pTimestamps, uint32_t count, double fps);
+
+#endif
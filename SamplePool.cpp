@@ -0,0 +1,261 @@
+#include "SamplePool.h"
+
+#include <stdio.h>
+
+// IMFMediaBuffer over a BufferPool buffer. The final Release() recycles it.
+class PooledMediaBuffer : public IMFMediaBuffer
+{
+public:
+	PooledMediaBuffer(BufferPool* pPool, BYTE* pData)
+		: m_refCount(1), m_pPool(pPool), m_pData(pData), m_length(0)
+	{
+	}
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppv)
+	{
+		if (ppv == NULL) {
+			return E_POINTER;
+		}
+		if (riid == IID_IUnknown || riid == IID_IMFMediaBuffer) {
+			*ppv = static_cast<IMFMediaBuffer*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+	STDMETHODIMP_(ULONG) AddRef() { return InterlockedIncrement(&m_refCount); }
+	STDMETHODIMP_(ULONG) Release()
+	{
+		LONG count = InterlockedDecrement(&m_refCount);
+		if (count == 0) {
+			m_pPool->Recycle(m_pData);
+			delete this;
+		}
+		return count;
+	}
+
+	STDMETHODIMP Lock(BYTE** ppbBuffer, DWORD* pcbMaxLength, DWORD* pcbCurrentLength)
+	{
+		if (ppbBuffer == NULL) {
+			return E_POINTER;
+		}
+		*ppbBuffer = m_pData;
+		if (pcbMaxLength) {
+			*pcbMaxLength = (DWORD)m_pPool->BufferSize();
+		}
+		if (pcbCurrentLength) {
+			*pcbCurrentLength = m_length;
+		}
+		return S_OK;
+	}
+	STDMETHODIMP Unlock() { return S_OK; }
+	STDMETHODIMP GetCurrentLength(DWORD* pcbCurrentLength)
+	{
+		if (pcbCurrentLength == NULL) {
+			return E_POINTER;
+		}
+		*pcbCurrentLength = m_length;
+		return S_OK;
+	}
+	STDMETHODIMP SetCurrentLength(DWORD cbCurrentLength)
+	{
+		if (cbCurrentLength > m_pPool->BufferSize()) {
+			return E_INVALIDARG;
+		}
+		m_length = cbCurrentLength;
+		return S_OK;
+	}
+	STDMETHODIMP GetMaxLength(DWORD* pcbMaxLength)
+	{
+		if (pcbMaxLength == NULL) {
+			return E_POINTER;
+		}
+		*pcbMaxLength = (DWORD)m_pPool->BufferSize();
+		return S_OK;
+	}
+
+private:
+	LONG m_refCount;
+	BufferPool* m_pPool;
+	BYTE* m_pData;
+	DWORD m_length;
+};
+
+// IMFMediaBuffer over memory it doesn't own; nothing happens on the final Release().
+class ExternalMediaBuffer : public IMFMediaBuffer
+{
+public:
+	ExternalMediaBuffer(const BYTE* pData, DWORD len) : m_refCount(1), m_pData(pData), m_length(len) {}
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppv)
+	{
+		if (ppv == NULL) {
+			return E_POINTER;
+		}
+		if (riid == IID_IUnknown || riid == IID_IMFMediaBuffer) {
+			*ppv = static_cast<IMFMediaBuffer*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+	STDMETHODIMP_(ULONG) AddRef() { return InterlockedIncrement(&m_refCount); }
+	STDMETHODIMP_(ULONG) Release()
+	{
+		LONG count = InterlockedDecrement(&m_refCount);
+		if (count == 0) {
+			delete this;
+		}
+		return count;
+	}
+
+	STDMETHODIMP Lock(BYTE** ppbBuffer, DWORD* pcbMaxLength, DWORD* pcbCurrentLength)
+	{
+		if (ppbBuffer == NULL) {
+			return E_POINTER;
+		}
+		*ppbBuffer = const_cast<BYTE*>(m_pData);
+		if (pcbMaxLength) {
+			*pcbMaxLength = m_length;
+		}
+		if (pcbCurrentLength) {
+			*pcbCurrentLength = m_length;
+		}
+		return S_OK;
+	}
+	STDMETHODIMP Unlock() { return S_OK; }
+	STDMETHODIMP GetCurrentLength(DWORD* pcbCurrentLength)
+	{
+		if (pcbCurrentLength == NULL) {
+			return E_POINTER;
+		}
+		*pcbCurrentLength = m_length;
+		return S_OK;
+	}
+	STDMETHODIMP SetCurrentLength(DWORD cbCurrentLength)
+	{
+		return cbCurrentLength == m_length ? S_OK : E_INVALIDARG;
+	}
+	STDMETHODIMP GetMaxLength(DWORD* pcbMaxLength)
+	{
+		if (pcbMaxLength == NULL) {
+			return E_POINTER;
+		}
+		*pcbMaxLength = m_length;
+		return S_OK;
+	}
+
+private:
+	LONG m_refCount;
+	const BYTE* m_pData;
+	DWORD m_length;
+};
+
+SamplePool::SamplePool(DWORD bufferSize, UINT32 capacity)
+{
+	m_pBuffers = new BufferPool(bufferSize, capacity);
+}
+
+SamplePool::~SamplePool()
+{
+	// Buffers still held by samples keep the BufferPool alive.
+	m_pBuffers->Release();
+}
+
+HRESULT SamplePool::CreateSample(bool block, IMFSample** ppSample)
+{
+	HRESULT hr;
+	IMFSample* pSample = NULL;
+	IMFMediaBuffer* pBuffer = NULL;
+	BYTE* pData = (BYTE*)m_pBuffers->Acquire(block);
+
+	if (pData == NULL) {
+		return MF_E_SAMPLEALLOCATOR_EMPTY;
+	}
+	pBuffer = new PooledMediaBuffer(m_pBuffers, pData);
+	hr = MFCreateSample(&pSample);
+	if (hr == S_OK) {
+		hr = pSample->AddBuffer(pBuffer);
+	}
+	pBuffer->Release();
+	if (hr != S_OK) {
+		printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+		if (pSample) {
+			pSample->Release();
+		}
+		return hr;
+	}
+	*ppSample = pSample;
+	return S_OK;
+}
+
+HRESULT SamplePool::CreateCopy(IMFSample* pSrcSample, bool block, IMFSample** ppDstSample)
+{
+	HRESULT hr;
+	IMFSample* pDstSample = NULL;
+	IMFMediaBuffer* pDstBuffer = NULL;
+	DWORD srcLength = 0;
+	LONGLONG value = 0;
+
+	hr = pSrcSample->GetTotalLength(&srcLength);
+	if (hr == S_OK && srcLength > BufferSize()) {
+		hr = MF_E_BUFFERTOOSMALL;
+	}
+	if (hr == S_OK) {
+		hr = CreateSample(block, &pDstSample);
+	}
+	if (hr == S_OK) {
+		hr = pSrcSample->CopyAllItems(pDstSample);
+	}
+	if (hr == S_OK) {
+		hr = pDstSample->GetBufferByIndex(0, &pDstBuffer);
+	}
+	if (hr == S_OK) {
+		hr = pSrcSample->CopyToBuffer(pDstBuffer);
+	}
+	if (hr == S_OK && pSrcSample->GetSampleTime(&value) == S_OK) {
+		pDstSample->SetSampleTime(value);
+	}
+	if (hr == S_OK && pSrcSample->GetSampleDuration(&value) == S_OK) {
+		pDstSample->SetSampleDuration(value);
+	}
+	if (pDstBuffer) {
+		pDstBuffer->Release();
+	}
+	if (hr != S_OK) {
+		printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+		if (pDstSample) {
+			pDstSample->Release();
+		}
+		return hr;
+	}
+	*ppDstSample = pDstSample;
+	return S_OK;
+}
+
+HRESULT CreateSampleFromMemory(const BYTE* pData, DWORD len, LONGLONG sampleTime, IMFSample** ppSample)
+{
+	HRESULT hr;
+	IMFSample* pSample = NULL;
+	IMFMediaBuffer* pBuffer = new ExternalMediaBuffer(pData, len);
+
+	hr = MFCreateSample(&pSample);
+	if (hr == S_OK) {
+		hr = pSample->AddBuffer(pBuffer);
+	}
+	if (hr == S_OK) {
+		hr = pSample->SetSampleTime(sampleTime);
+	}
+	pBuffer->Release();
+	if (hr != S_OK) {
+		printf("Failed %s hr=%x\n", __FUNCTION__, hr);
+		if (pSample) {
+			pSample->Release();
+		}
+		return hr;
+	}
+	*ppSample = pSample;
+	return S_OK;
+}
@@ -0,0 +1,41 @@
+#ifndef __SAMPLEPOOL_H__
+#define __SAMPLEPOOL_H__
+
+#include <mfapi.h>
+#include <mferror.h>
+
+#include "BufferPool.h"
+
+// Single buffer IMFSamples whose memory comes from a BufferPool. The buffer
+// goes back to the pool when the last reference to it (usually through the
+// sample) is released, so MFTs that don't provide their own output samples
+// don't cost a fresh multi megabyte allocation per frame.
+class SamplePool
+{
+public:
+	SamplePool(DWORD bufferSize, UINT32 capacity);
+	~SamplePool();
+
+	DWORD BufferSize() const { return (DWORD)m_pBuffers->BufferSize(); }
+
+	// Returns a sample with one empty buffer of BufferSize() bytes. When all
+	// buffers are in use, waits if block is set, otherwise fails with
+	// MF_E_SAMPLEALLOCATOR_EMPTY.
+	HRESULT CreateSample(bool block, IMFSample** ppSample);
+	// Like CreateAndCopySingleBufferIMFSample (MFUtility.h): copies the
+	// attributes and the data of pSrcSample into a pooled sample.
+	HRESULT CreateCopy(IMFSample* pSrcSample, bool block, IMFSample** ppDstSample);
+
+	BufferPoolStats GetStats() { return m_pBuffers->GetStats(); }
+
+private:
+	BufferPool* m_pBuffers;
+};
+
+// Wraps memory owned elsewhere (e.g. a replayed file mapping, ReplaySource.h)
+// in a single buffer sample without copying it. The memory must outlive the
+// sample and is treated as read only, so only hand the sample to consumers
+// that don't write to their input.
+HRESULT CreateSampleFromMemory(const BYTE* pData, DWORD len, LONGLONG sampleTime, IMFSample** ppSample);
+
+#endif
@@ -0,0 +1,124 @@
+#include "SoftMJPEGDecoder.h"
+#include "JpegDecoder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+SoftMJPEGDecoder::SoftMJPEGDecoder()
+{
+	m_width = 0;
+	m_height = 0;
+	m_framerate = 0;
+	m_sampleCount = 0;
+	m_pPool = NULL;
+	GetDefaultDecodeOptions(&m_options);
+	memset(&m_lastStats, 0, sizeof(m_lastStats));
+}
+
+SoftMJPEGDecoder::~SoftMJPEGDecoder()
+{
+	delete m_pPool;
+}
+
+HRESULT SoftMJPEGDecoder::SetThreadCount(uint32_t threads)
+{
+	delete m_pPool;
+	m_pPool = threads > 1 ? new WorkerPool(threads) : NULL;
+	return S_OK;
+}
+
+HRESULT SoftMJPEGDecoder::Find()
+{
+	return S_OK;
+}
+
+HRESULT SoftMJPEGDecoder::Configure(uint32_t width, uint32_t height, uint32_t framerate)
+{
+	m_width = width;
+	m_height = height;
+	m_framerate = framerate;
+	return S_OK;
+}
+
+HRESULT SoftMJPEGDecoder::SetDecodeOptions(const DecodeOptions& options)
+{
+	if (options.scale > DECODE_SCALE_1_8) {
+		return E_INVALIDARG;
+	}
+	m_options = options;
+	return S_OK;
+}
+
+HRESULT SoftMJPEGDecoder::Start()
+{
+	m_sampleCount = 0;
+	return S_OK;
+}
+
+HRESULT SoftMJPEGDecoder::DecodeOneFrame(const uint8_t* pData, size_t len, NV12Frame* pFrame)
+{
+	HRESULT hr;
+	JpegHeader header;
+	const JpegScanTables* pTables;
+	uint32_t width, height, pitch, alignedHeight;
+
+	hr = m_headerCache.Lookup(pData, len, &header, &pTables);
+	if (hr != S_OK) {
+		printf("Failed %s header hr=%x\n", __FUNCTION__, hr);
+		return hr;
+	}
+	if (m_width && (header.width != m_width || header.height != m_height)) {
+		printf("%s frame %u x %u, configured %u x %u\n", __FUNCTION__, header.width, header.height, m_width, m_height);
+	}
+
+	GetJpegFrameLayout(&header, m_options, &width, &height, &pitch, &alignedHeight);
+	if (width == 0 || height == 0) {
+		printf("%s crop %u,%u %u x %u is outside the %u x %u frame\n", __FUNCTION__, m_options.crop.x, m_options.crop.y,
+			m_options.crop.width, m_options.crop.height, header.width, header.height);
+		return E_INVALIDARG;
+	}
+	if (m_options.lumaOnly ? !AllocateLumaFrame(width, height, pitch, alignedHeight, pFrame) :
+		!AllocateNV12Frame(width, height, pitch, alignedHeight, pFrame)) {
+		return E_OUTOFMEMORY;
+	}
+	hr = DecodeJpegScan(&header, pTables, pFrame, m_pPool, &m_options, &m_lastStats);
+	if (hr != S_OK) {
+		printf("Failed %s DecodeJpegScan hr=%x\n", __FUNCTION__, hr);
+		ReleaseFrame(pFrame);
+		return hr;
+	}
+	m_sampleCount++;
+	return S_OK;
+}
+
+HRESULT SoftMJPEGDecoder::DecodeOneFrameRgb(const uint8_t* pData, size_t len, RgbFormat format, RgbFrame* pFrame)
+{
+	HRESULT hr;
+	JpegHeader header;
+	const JpegScanTables* pTables;
+
+	if (!IsDefaultDecodeOptions(m_options)) {
+		return IMJPEGDecoder::DecodeOneFrameRgb(pData, len, format, pFrame);
+	}
+	hr = m_headerCache.Lookup(pData, len, &header, &pTables);
+	if (hr != S_OK) {
+		printf("Failed %s header hr=%x\n", __FUNCTION__, hr);
+		return hr;
+	}
+	if (!AllocateRgbFrame(header.width, header.height, format, pFrame)) {
+		return E_OUTOFMEMORY;
+	}
+	hr = DecodeJpegScanRgb(&header, pTables, pFrame, m_pPool);
+	if (hr != S_OK) {
+		printf("Failed %s DecodeJpegScanRgb hr=%x\n", __FUNCTION__, hr);
+		ReleaseFrame(pFrame);
+		return hr;
+	}
+	m_sampleCount++;
+	return S_OK;
+}
+
+HRESULT SoftMJPEGDecoder::Close()
+{
+	return S_OK;
+}
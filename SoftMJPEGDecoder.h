@@ -0,0 +1,43 @@
+#ifndef __SOFTMJPEGDECODER_H__
+#define __SOFTMJPEGDECODER_H__
+
+#include "IMJPEGDecoder.h"
+#include "JpegHeaderCache.h"
+#include "WorkerPool.h"
+
+// Baseline JPEG decoder on the CPU, producing the same NV12 output as the
+// hardware path. Builds without Media Foundation.
+class SoftMJPEGDecoder : public IMJPEGDecoder
+{
+public:
+	SoftMJPEGDecoder();
+	~SoftMJPEGDecoder();
+
+	const char* Name() const { return "software"; }
+	HRESULT Find();
+	HRESULT Configure(uint32_t width, uint32_t height, uint32_t framerate);
+	HRESULT SetDecodeOptions(const DecodeOptions& options);
+	void GetDecodeOptions(DecodeOptions* pOptions) const { *pOptions = m_options; }
+	void GetLastFrameStats(DecodeFrameStats* pStats) const { *pStats = m_lastStats; }
+	HRESULT Start();
+	HRESULT DecodeOneFrame(const uint8_t* pData, size_t len, NV12Frame* pFrame);
+	HRESULT Close();
+	// Fused path: MCU rows are converted while they are in cache, see
+	// DecodeJpegScanRgb. Scaled decodes convert the scaled NV12 frame instead.
+	HRESULT DecodeOneFrameRgb(const uint8_t* pData, size_t len, RgbFormat format, RgbFrame* pFrame);
+
+	// Threads used for frames with restart markers, 1 (the default) decodes on
+	// the calling thread only.
+	HRESULT SetThreadCount(uint32_t threads);
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_framerate;
+	DecodeOptions m_options;
+	DecodeFrameStats m_lastStats;
+	int m_sampleCount;
+	JpegHeaderCache m_headerCache;
+	WorkerPool* m_pPool;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(uint32_t threads)
+{
+	m_fn = NULL;
+	m_pContext = NULL;
+	m_count = 0;
+	m_next = 0;
+	m_done = 0;
+	m_active = 0;
+	m_generation = 0;
+	m_stop = false;
+	for (uint32_t i = 1; i < threads; ++i) {
+		m_workers.push_back(std::thread(&WorkerPool::WorkerMain, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_start.notify_all();
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workers[i].join();
+	}
+}
+
+uint32_t WorkerPool::RunItems()
+{
+	uint32_t finished = 0;
+	for (;;) {
+		uint32_t i = m_next.fetch_add(1);
+		if (i >= m_count) {
+			break;
+		}
+		m_fn(m_pContext, i);
+		finished++;
+	}
+	return finished;
+}
+
+void WorkerPool::WorkerMain()
+{
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_start.wait(lock, [&] { return m_stop || m_generation != seen; });
+		if (m_stop) {
+			return;
+		}
+		seen = m_generation;
+		m_active++;
+		lock.unlock();
+		uint32_t finished = RunItems();
+		lock.lock();
+		m_active--;
+		m_done += finished;
+		if (m_active == 0) {
+			m_finished.notify_all();
+		}
+	}
+}
+
+void WorkerPool::Run(uint32_t count, WorkerFunc fn, void* pContext)
+{
+	if (m_workers.empty() || count <= 1) {
+		for (uint32_t i = 0; i < count; ++i) {
+			fn(pContext, i);
+		}
+		return;
+	}
+	{
+		// A worker that woke late for the previous job may still be leaving it;
+		// the job is only replaced once none is inside.
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [&] { return m_active == 0; });
+		m_fn = fn;
+		m_pContext = pContext;
+		m_count = count;
+		m_next = 0;
+		m_done = 0;
+		m_generation++;
+	}
+	m_start.notify_all();
+
+	uint32_t finished = RunItems();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done += finished;
+	m_finished.wait(lock, [&] { return m_done == m_count && m_active == 0; });
+}
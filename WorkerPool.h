@@ -0,0 +1,47 @@
+#ifndef __WORKERPOOL_H__
+#define __WORKERPOOL_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*WorkerFunc)(void* pContext, uint32_t index);
+
+// Fixed set of threads for splitting one job (e.g. one frame) into items.
+// The calling thread works on the items too, so a pool of N threads starts
+// N - 1 workers.
+class WorkerPool
+{
+public:
+	WorkerPool(uint32_t threads);
+	~WorkerPool();
+
+	uint32_t Threads() const { return (uint32_t)m_workers.size() + 1; }
+
+	// Calls fn(pContext, i) for every i in [0, count) and returns when all
+	// calls have returned. One Run at a time.
+	void Run(uint32_t count, WorkerFunc fn, void* pContext);
+
+private:
+	void WorkerMain();
+	uint32_t RunItems();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_finished;
+	WorkerFunc m_fn;
+	void* m_pContext;
+	uint32_t m_count;
+	std::atomic<uint32_t> m_next;
+	uint32_t m_done;	// items finished, under m_mutex
+	uint32_t m_active;	// workers inside RunItems, under m_mutex
+	uint64_t m_generation;
+	bool m_stop;
+};
+
+#endif
@@ -0,0 +1,142 @@
+// BufferPool under concurrent Acquire / Recycle from several threads, with
+// blocking and non blocking acquires: no buffer is handed out twice, at most
+// capacity are in use, and the statistics add up afterwards.
+
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include "TestUtil.h"
+#include "AlignedMemory.h"
+#include "BufferPool.h"
+
+static const uint32_t THREADS = 8;
+static const uint32_t ITERATIONS = 3000;
+static const uint32_t CAPACITY = 5;
+static const size_t BUFFER_SIZE = 4000;
+
+struct ThreadCounts
+{
+	uint64_t acquired;
+	uint64_t refused;
+	uint32_t corrupted;
+};
+
+// Each holder stamps the whole buffer with its own byte and checks it is
+// still there before giving it back, so a buffer given to two threads at
+// once shows up as a corrupted stamp.
+static void Worker(BufferPool* pPool, uint32_t index, std::atomic<uint32_t>* pHeld, std::atomic<uint32_t>* pMaxHeld,
+	ThreadCounts* pCounts)
+{
+	TestRandom random(index + 1);
+	uint8_t stamp = (uint8_t)(index + 1);
+	for (uint32_t i = 0; i < ITERATIONS; ++i) {
+		bool block = (index & 1) == 0 || random.Below(4) == 0;
+		uint8_t* pBuffer = (uint8_t*)pPool->Acquire(block);
+		if (pBuffer == NULL) {
+			pCounts->refused++;
+			std::this_thread::yield();
+			continue;
+		}
+		pCounts->acquired++;
+		uint32_t held = ++*pHeld;
+		uint32_t maxHeld = pMaxHeld->load();
+		while (held > maxHeld && !pMaxHeld->compare_exchange_weak(maxHeld, held)) {
+		}
+		if ((uintptr_t)pBuffer % FRAME_ALIGNMENT) {
+			pCounts->corrupted++;
+		}
+		memset(pBuffer, stamp, BUFFER_SIZE);
+		if (random.Below(8) == 0) {
+			std::this_thread::yield();
+		}
+		for (size_t k = 0; k < BUFFER_SIZE; k += 97) {
+			if (pBuffer[k] != stamp) {
+				pCounts->corrupted++;
+				break;
+			}
+		}
+		--*pHeld;
+		pPool->Recycle(pBuffer);
+	}
+}
+
+static void TestConcurrent()
+{
+	BufferPool* pPool = new BufferPool(BUFFER_SIZE, CAPACITY);
+	TEST_CHECK(pPool->BufferSize() >= BUFFER_SIZE && pPool->BufferSize() % FRAME_ALIGNMENT == 0);
+
+	std::atomic<uint32_t> held(0);
+	std::atomic<uint32_t> maxHeld(0);
+	ThreadCounts counts[THREADS] = {};
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < THREADS; ++i) {
+		threads.push_back(std::thread(Worker, pPool, i, &held, &maxHeld, &counts[i]));
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	uint64_t acquired = 0;
+	uint64_t refused = 0;
+	uint32_t corrupted = 0;
+	for (const ThreadCounts& c : counts) {
+		acquired += c.acquired;
+		refused += c.refused;
+		corrupted += c.corrupted;
+	}
+	BufferPoolStats stats = pPool->GetStats();
+	TEST_CHECK(corrupted == 0);
+	TEST_CHECK(maxHeld.load() <= CAPACITY);
+	TEST_CHECK(stats.capacity == CAPACITY);
+	TEST_CHECK(stats.allocated <= CAPACITY && stats.allocated > 0);
+	TEST_CHECK(stats.inUse == 0);
+	TEST_CHECK(stats.highWater <= CAPACITY && stats.highWater >= maxHeld.load());
+	TEST_CHECK(stats.acquired == acquired);
+	TEST_CHECK(stats.exhausted == refused);
+	TEST_CHECK(acquired + refused == (uint64_t)THREADS * ITERATIONS);
+	printf("acquired %llu, waited %llu, exhausted %llu, high water %u\n", (unsigned long long)stats.acquired,
+		(unsigned long long)stats.waited, (unsigned long long)stats.exhausted, stats.highWater);
+	pPool->Release();
+}
+
+// A full pool refuses non blocking acquires and wakes a blocked one on Recycle().
+static void TestExhaustion()
+{
+	BufferPool* pPool = new BufferPool(64, 2);
+	void* pA = pPool->Acquire(false);
+	void* pB = pPool->Acquire(false);
+	TEST_CHECK(pA && pB && pA != pB);
+	TEST_CHECK(pPool->Acquire(false) == NULL);
+
+	std::atomic<bool> got(false);
+	void* pC = NULL;
+	std::thread waiter([&] {
+		pC = pPool->Acquire(true);
+		got = true;
+	});
+	while (pPool->GetStats().waited == 0) {
+		std::this_thread::yield();
+	}
+	TEST_CHECK(!got.load());
+	pPool->Recycle(pA);
+	waiter.join();
+	TEST_CHECK(pC == pA);
+
+	BufferPoolStats stats = pPool->GetStats();
+	TEST_CHECK(stats.allocated == 2 && stats.inUse == 2 && stats.highWater == 2);
+	TEST_CHECK(stats.exhausted == 1 && stats.waited == 1 && stats.acquired == 3);
+
+	// The creator lets go first; the last Recycle() frees the pool.
+	pPool->Release();
+	pPool->Recycle(pB);
+	pPool->Recycle(pC);
+}
+
+int main()
+{
+	TestConcurrent();
+	TestExhaustion();
+	return TestResult("BufferPoolTest");
+}
@@ -0,0 +1,315 @@
+// DecodePipeline driven by a mock transform that raises "need input" / "have
+// output" on its own event thread after a configurable latency, like the
+// asynchronous MFT: ordering, both delivery modes, back pressure, Flush()
+// and frames that fail in ProcessInput or ProcessOutput.
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "TestUtil.h"
+#include "DecodePipeline.h"
+
+// Inputs are heap allocated frame numbers; outputs are 16x16 frames with the
+// number in their first byte.
+class MockTransform : public ITransformBackend
+{
+public:
+	MockTransform(uint32_t slots, uint32_t latencyUs)
+		: m_pPipeline(NULL), m_slots(slots), m_latency(latencyUs), m_stop(false), m_inputs(0), m_released(0),
+		m_inTransform(0), m_maxInTransform(0)
+	{
+	}
+	~MockTransform() { Stop(); }
+
+	void FailInput(uint32_t id) { m_failInput.insert(id); }
+	void FailOutput(uint32_t id) { m_failOutput.insert(id); }
+
+	void Start(DecodePipeline* pPipeline)
+	{
+		m_pPipeline = pPipeline;
+		m_thread = std::thread(&MockTransform::EventLoop, this);
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+	}
+
+	bool ProcessInput(void* pInput)
+	{
+		uint32_t* pId = (uint32_t*)pInput;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_inputs++;
+		if (m_failInput.count(*pId)) {
+			delete pId;
+			return false;
+		}
+		Pending pending = { *pId, std::chrono::steady_clock::now() + std::chrono::microseconds(m_latency) };
+		delete pId;
+		m_pending.push_back(pending);
+		m_inTransform++;
+		m_maxInTransform = m_inTransform > m_maxInTransform ? m_inTransform : m_maxInTransform;
+		m_wake.notify_all();
+		return true;
+	}
+
+	bool ProcessOutput(NV12Frame* pFrame)
+	{
+		uint32_t id;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_ready.empty()) {
+				return false;
+			}
+			id = m_ready.front();
+			m_ready.pop_front();
+			m_inTransform--;
+			if (m_failOutput.count(id)) {
+				return false;
+			}
+		}
+		if (!AllocateNV12Frame(16, 16, 16, 16, pFrame)) {
+			return false;
+		}
+		pFrame->pY[0] = (uint8_t)id;
+		return true;
+	}
+
+	void ReleaseInput(void* pInput)
+	{
+		delete (uint32_t*)pInput;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_released++;
+	}
+
+	uint32_t Inputs()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_inputs;
+	}
+	uint32_t Released()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_released;
+	}
+	uint32_t MaxInTransform()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_maxInTransform;
+	}
+
+private:
+	struct Pending
+	{
+		uint32_t id;
+		std::chrono::steady_clock::time_point ready;
+	};
+
+	// The pipeline's lock is taken around ProcessInput, so events are raised
+	// without holding m_mutex.
+	void EventLoop()
+	{
+		for (uint32_t i = 0; i < m_slots; ++i) {
+			m_pPipeline->OnNeedInput();
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stop) {
+			if (m_pending.empty()) {
+				m_wake.wait(lock);
+				continue;
+			}
+			if (std::chrono::steady_clock::now() < m_pending.front().ready) {
+				m_wake.wait_until(lock, m_pending.front().ready);
+				continue;
+			}
+			m_ready.push_back(m_pending.front().id);
+			m_pending.pop_front();
+			lock.unlock();
+			m_pPipeline->OnHaveOutput();
+			m_pPipeline->OnNeedInput();
+			lock.lock();
+		}
+	}
+
+	DecodePipeline* m_pPipeline;
+	uint32_t m_slots;
+	uint32_t m_latency;
+	std::set<uint32_t> m_failInput;
+	std::set<uint32_t> m_failOutput;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stop;
+	std::deque<Pending> m_pending;
+	std::deque<uint32_t> m_ready;
+	uint32_t m_inputs;
+	uint32_t m_released;
+	uint32_t m_inTransform;
+	uint32_t m_maxInTransform;
+};
+
+static const uint32_t FRAME_COUNT = 60;
+
+static void Submit(DecodePipeline* pPipeline, uint32_t id)
+{
+	TEST_CHECK(pPipeline->Submit(new uint32_t(id), (int64_t)id * 333333, true));
+}
+
+struct Delivered
+{
+	std::mutex mutex;
+	std::vector<uint64_t> sequences;
+	bool ordered = true;
+};
+
+static void OnFrame(void* pContext, uint64_t sequence, NV12Frame* pFrame)
+{
+	Delivered* pDelivered = (Delivered*)pContext;
+	std::lock_guard<std::mutex> lock(pDelivered->mutex);
+	pDelivered->ordered &= pFrame->pY[0] == (uint8_t)sequence && pFrame->timestamp == (int64_t)sequence * 333333;
+	pDelivered->sequences.push_back(sequence);
+	ReleaseFrame(pFrame);
+}
+
+// Poll() returns every frame in submit order while Submit() blocks at maxInFlight.
+static void TestPoll()
+{
+	MockTransform transform(2, 500);
+	DecodePipeline pipeline(&transform, 3);
+	transform.Start(&pipeline);
+
+	std::vector<uint64_t> sequences;
+	bool ordered = true;
+	std::thread consumer([&] {
+		while (sequences.size() < FRAME_COUNT) {
+			NV12Frame frame;
+			uint64_t sequence;
+			if (pipeline.Poll(&frame, &sequence, 5000)) {
+				ordered &= frame.pY[0] == (uint8_t)sequence && frame.timestamp == (int64_t)sequence * 333333;
+				sequences.push_back(sequence);
+				ReleaseFrame(&frame);
+			}
+			else {
+				break;
+			}
+		}
+	});
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		Submit(&pipeline, i);
+		TEST_CHECK(pipeline.InFlight() <= pipeline.MaxInFlight());
+	}
+	consumer.join();
+	pipeline.Drain();
+
+	TEST_CHECK(sequences.size() == FRAME_COUNT);
+	for (size_t i = 0; i < sequences.size(); ++i) {
+		TEST_CHECK(sequences[i] == i);
+	}
+	TEST_CHECK(ordered);
+	TEST_CHECK(transform.MaxInTransform() <= 2);
+	TEST_CHECK(pipeline.InFlight() == 0 && pipeline.Failed() == 0);
+	transform.Stop();
+}
+
+static void TestCallback()
+{
+	MockTransform transform(3, 300);
+	DecodePipeline pipeline(&transform, 4);
+	Delivered delivered;
+	pipeline.SetCallback(OnFrame, &delivered);
+	transform.Start(&pipeline);
+
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		Submit(&pipeline, i);
+	}
+	pipeline.Drain();
+
+	TEST_CHECK(delivered.sequences.size() == FRAME_COUNT);
+	for (size_t i = 0; i < delivered.sequences.size(); ++i) {
+		TEST_CHECK(delivered.sequences[i] == i);
+	}
+	TEST_CHECK(delivered.ordered);
+	TEST_CHECK(pipeline.InFlight() == 0 && pipeline.Failed() == 0);
+	transform.Stop();
+}
+
+// Failed frames are counted and skipped; Drain() must not wait for them.
+static void TestFailures()
+{
+	MockTransform transform(2, 200);
+	transform.FailOutput(5);
+	transform.FailOutput(17);
+	transform.FailOutput(FRAME_COUNT - 1);
+	transform.FailInput(30);
+	DecodePipeline pipeline(&transform, 3);
+	Delivered delivered;
+	pipeline.SetCallback(OnFrame, &delivered);
+	transform.Start(&pipeline);
+
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		Submit(&pipeline, i);
+	}
+	pipeline.Drain();
+
+	TEST_CHECK(pipeline.Failed() == 4);
+	TEST_CHECK(pipeline.InFlight() == 0);
+	TEST_CHECK(delivered.sequences.size() == FRAME_COUNT - 4);
+	bool increasing = true;
+	for (size_t i = 0; i < delivered.sequences.size(); ++i) {
+		uint64_t s = delivered.sequences[i];
+		increasing &= (i == 0 || s > delivered.sequences[i - 1]) && s != 5 && s != 17 && s != 30 && s != FRAME_COUNT - 1;
+	}
+	TEST_CHECK(increasing);
+	TEST_CHECK(delivered.ordered);
+	transform.Stop();
+}
+
+// Non blocking Submit() refuses input at maxInFlight, and Flush() returns
+// input that never reached the transform.
+static void TestBackPressureAndFlush()
+{
+	MockTransform transform(1, 100000);
+	DecodePipeline pipeline(&transform, 3);
+	Delivered delivered;
+	pipeline.SetCallback(OnFrame, &delivered);
+	transform.Start(&pipeline);
+
+	for (uint32_t i = 0; i < 3; ++i) {
+		TEST_CHECK(pipeline.Submit(new uint32_t(i), (int64_t)i * 333333, false));
+	}
+	uint32_t* pRefused = new uint32_t(3);
+	TEST_CHECK(!pipeline.Submit(pRefused, 3 * 333333, false));
+	delete pRefused;
+
+	// One input is in the transform, the other two wait for "need input".
+	while (transform.Inputs() == 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	pipeline.Flush();
+	TEST_CHECK(transform.Released() == 2);
+	pipeline.Drain();
+	TEST_CHECK(transform.Inputs() == 1);
+	TEST_CHECK(delivered.sequences.size() == 1);
+	TEST_CHECK(pipeline.InFlight() == 0);
+	transform.Stop();
+}
+
+int main()
+{
+	TestPoll();
+	TestCallback();
+	TestFailures();
+	TestBackPressureAndFlush();
+	return TestResult("DecodePipelineTest");
+}
@@ -0,0 +1,241 @@
+// FrameArena with variable size spans freed in order, nearly in order and from
+// another thread: spans never overlap, memory wraps around within a chunk,
+// oversized frames move the arena to a new chunk, and once warmed up the
+// arena stops allocating.
+
+#include <string.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "TestUtil.h"
+#include "FrameArena.h"
+
+struct Span
+{
+	uint8_t* pData;
+	size_t size;
+	uint8_t stamp;
+};
+
+static Span AllocateSpan(FrameArena* pArena, size_t size, uint8_t stamp)
+{
+	Span span = { pArena->Allocate(size), size, stamp };
+	if (span.pData) {
+		memset(span.pData, stamp, size);
+	}
+	return span;
+}
+
+// Checks the stamp is intact, so spans that overlap show up, then frees it.
+static bool FreeSpan(FrameArena* pArena, const Span& span)
+{
+	bool intact = span.pData != NULL && (uintptr_t)span.pData % 32 == 0;
+	for (size_t i = 0; intact && i < span.size; i += 61) {
+		intact = span.pData[i] == span.stamp;
+	}
+	intact = intact && span.pData[span.size - 1] == span.stamp;
+	pArena->Free(span.pData);
+	return intact;
+}
+
+static const uint32_t ITERATIONS = 20000;
+static const uint32_t WARM_UP = 1000;
+
+// Frames of 1-20 KB with 'depth' or more live. Each time 'window' more have
+// been allocated, the oldest 'window' are freed in random order; window 1 is
+// allocation order.
+static void TestSteadyState(uint32_t depth, uint32_t window, uint32_t seed)
+{
+	FrameArena arena(16 * 1024);
+	TestRandom random(seed);
+	std::deque<Span> live;
+	uint32_t corrupted = 0;
+	uint32_t wraps = 0;
+	uint64_t bytes = 0;
+	uint64_t warmMallocs = 0;
+	uint8_t* pLast = NULL;
+
+	for (uint32_t i = 0; i < ITERATIONS; ++i) {
+		// The largest frames come first, so the warm up sees the peak demand.
+		size_t size = i < 100 ? 20 * 1024 : 1 + random.Below(20 * 1024);
+		Span span = AllocateSpan(&arena, size, (uint8_t)(i + 1));
+		bytes += size;
+		// A lower address within the same chunk size means head wrapped to 0.
+		wraps += pLast && span.pData < pLast && arena.GetStats().mallocs == warmMallocs;
+		pLast = span.pData;
+		live.push_back(span);
+		if (live.size() == depth + window) {
+			for (uint32_t n = window; n > 0; --n) {
+				size_t k = random.Below(n);
+				corrupted += !FreeSpan(&arena, live[k]);
+				live.erase(live.begin() + k);
+			}
+		}
+		if (i == WARM_UP) {
+			warmMallocs = arena.GetStats().mallocs;
+		}
+	}
+	FrameArenaStats stats = arena.GetStats();
+	TEST_CHECK(stats.mallocs == warmMallocs);
+	TEST_CHECK(stats.liveSpans >= depth && stats.liveSpans < depth + window);
+	TEST_CHECK(wraps > 100);
+
+	while (!live.empty()) {
+		corrupted += !FreeSpan(&arena, live.front());
+		live.pop_front();
+	}
+	stats = arena.GetStats();
+	TEST_CHECK(corrupted == 0);
+	TEST_CHECK(stats.allocations == ITERATIONS && stats.bytes == bytes);
+	TEST_CHECK(stats.liveSpans == 0 && stats.liveBytes == 0);
+	TEST_CHECK(stats.highWater >= (depth + window) * 64);
+	printf("depth %u window %u: %llu mallocs, %llu overflows, chunk %zu, high water %zu\n", depth, window,
+		(unsigned long long)stats.mallocs, (unsigned long long)stats.overflows, stats.chunkSize, stats.highWater);
+}
+
+// Spans of 1 KB with their headers in a 4 KB chunk: head wraps to the start
+// once the oldest spans are free, even when they were freed out of order, and
+// stops short of tail.
+static void TestWrapAround()
+{
+	const size_t size = 1024 - 32;
+	FrameArena arena(4096);
+	Span a = AllocateSpan(&arena, size, 1);
+	Span b = AllocateSpan(&arena, size, 2);
+	Span c = AllocateSpan(&arena, size, 3);
+	Span d = AllocateSpan(&arena, size, 4);
+	TEST_CHECK(b.pData == a.pData + 1024 && c.pData == b.pData + 1024 && d.pData == c.pData + 1024);
+
+	// b is free but a is not, so there is no room yet; a frees both.
+	TEST_CHECK(FreeSpan(&arena, b));
+	TEST_CHECK(arena.GetStats().liveSpans == 3);
+	TEST_CHECK(FreeSpan(&arena, a));
+	Span e = AllocateSpan(&arena, size, 5);
+	TEST_CHECK(e.pData == a.pData);
+
+	// Between head and tail there are 1024 bytes; a span that fills them
+	// exactly would make head == tail, so only a smaller one fits.
+	Span f = AllocateSpan(&arena, size - 32, 6);
+	TEST_CHECK(f.pData == b.pData);
+	FrameArenaStats stats = arena.GetStats();
+	TEST_CHECK(stats.mallocs == 1 && stats.overflows == 0 && stats.liveBytes == 4096 - 32);
+
+	Span g = AllocateSpan(&arena, 1, 7);
+	stats = arena.GetStats();
+	TEST_CHECK(stats.mallocs == 2 && stats.overflows == 1);
+	TEST_CHECK(g.pData != NULL && (g.pData < a.pData || g.pData >= a.pData + 4096));
+	TEST_CHECK(FreeSpan(&arena, c) && FreeSpan(&arena, d) && FreeSpan(&arena, e));
+	TEST_CHECK(FreeSpan(&arena, f) && FreeSpan(&arena, g));
+	stats = arena.GetStats();
+	TEST_CHECK(stats.liveSpans == 0 && stats.liveBytes == 0 && stats.highWater == 4096 - 32 + 64);
+
+	// The same at the wrap: only the first span is free, exactly the size of
+	// the new one, so it goes to a new chunk.
+	FrameArena full(4096);
+	Span spans[4];
+	for (int i = 0; i < 4; ++i) {
+		spans[i] = AllocateSpan(&full, size, (uint8_t)(i + 1));
+	}
+	TEST_CHECK(FreeSpan(&full, spans[0]));
+	Span h = AllocateSpan(&full, size, 5);
+	TEST_CHECK(h.pData != spans[0].pData && full.GetStats().mallocs == 2);
+	for (int i = 1; i < 4; ++i) {
+		TEST_CHECK(FreeSpan(&full, spans[i]));
+	}
+	TEST_CHECK(FreeSpan(&full, h));
+	TEST_CHECK(full.GetStats().liveSpans == 0);
+}
+
+// A frame larger than the chunk moves the arena to a bigger one while the old
+// chunk's spans stay valid; the old chunk goes when its last span is freed.
+static void TestOverflow()
+{
+	FrameArena arena(4096);
+	FrameArenaStats stats = arena.GetStats();
+	TEST_CHECK(stats.mallocs == 1 && stats.overflows == 0 && stats.chunkSize == 4096);
+
+	Span a = AllocateSpan(&arena, 1000, 1);
+	Span b = AllocateSpan(&arena, 1000, 2);
+	Span big = AllocateSpan(&arena, 10000, 3);
+	stats = arena.GetStats();
+	TEST_CHECK(stats.mallocs == 2 && stats.overflows == 1);
+	TEST_CHECK(stats.chunkSize >= 2 * 10000 && stats.chunkSize % 4096 == 0);
+	uintptr_t oldChunk = (uintptr_t)a.pData - 32;
+	TEST_CHECK(big.pData != NULL && ((uintptr_t)big.pData < oldChunk || (uintptr_t)big.pData >= oldChunk + 4096));
+
+	// The old chunk is retired, not reused.
+	Span c = AllocateSpan(&arena, 1000, 4);
+	TEST_CHECK(arena.GetStats().mallocs == 2);
+	TEST_CHECK(FreeSpan(&arena, b));
+	TEST_CHECK(FreeSpan(&arena, a));
+	TEST_CHECK(FreeSpan(&arena, big));
+	TEST_CHECK(FreeSpan(&arena, c));
+
+	// Empty again: the same frames fit without growing.
+	a = AllocateSpan(&arena, 10000, 5);
+	FrameArena::FreeSpan(a.pData);
+	stats = arena.GetStats();
+	TEST_CHECK(stats.mallocs == 2 && stats.overflows == 1);
+	TEST_CHECK(stats.liveSpans == 0 && stats.liveBytes == 0);
+	TEST_CHECK(stats.allocations == 5 && stats.bytes == 23000);
+}
+
+// The capture loop allocates, FrameScheduler threads free.
+static void TestThreads()
+{
+	FrameArena arena(64 * 1024);
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<Span> queue;
+	bool done = false;
+	uint32_t corrupted = 0;
+
+	std::thread consumer([&] {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!done || !queue.empty()) {
+			if (queue.empty()) {
+				changed.wait(lock);
+				continue;
+			}
+			Span span = queue.front();
+			queue.pop_front();
+			changed.notify_all();
+			lock.unlock();
+			corrupted += !FreeSpan(&arena, span);
+			lock.lock();
+		}
+	});
+	TestRandom random(9);
+	for (uint32_t i = 0; i < ITERATIONS; ++i) {
+		Span span = AllocateSpan(&arena, 1 + random.Below(8000), (uint8_t)(i + 1));
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return queue.size() < 8; });
+		queue.push_back(span);
+		changed.notify_all();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+	}
+	changed.notify_all();
+	consumer.join();
+
+	FrameArenaStats stats = arena.GetStats();
+	TEST_CHECK(corrupted == 0);
+	TEST_CHECK(stats.allocations == ITERATIONS);
+	TEST_CHECK(stats.liveSpans == 0 && stats.liveBytes == 0);
+}
+
+int main()
+{
+	TestSteadyState(6, 1, 1);
+	TestSteadyState(4, 5, 2);
+	TestSteadyState(1, 1, 3);
+	TestWrapAround();
+	TestOverflow();
+	TestThreads();
+	return TestResult("FrameArenaTest");
+}
@@ -0,0 +1,237 @@
+// FrameScheduler over mock decoders of different speeds, some frames failing:
+// delivery in submit order through the callback and through Poll(), failed
+// frames counted and skipped, every input released once, and Drain() and the
+// destructor returning with work still queued.
+
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TestUtil.h"
+#include "FrameScheduler.h"
+#include "Logger.h"
+
+// Frames are 8 bytes: the frame number, then 1 if the decode should fail.
+// Each decoder sleeps its base latency plus a jitter taken from the frame
+// number, so later frames often finish first.
+class MockDecoder : public IMJPEGDecoder
+{
+public:
+	MockDecoder(uint32_t latencyUs) : m_latency(latencyUs) {}
+
+	const char* Name() const { return "mock"; }
+	HRESULT Find() { return S_OK; }
+	HRESULT Configure(uint32_t, uint32_t, uint32_t) { return S_OK; }
+	HRESULT Start() { return S_OK; }
+	HRESULT Close() { return S_OK; }
+
+	HRESULT DecodeOneFrame(const uint8_t* pData, size_t len, NV12Frame* pFrame)
+	{
+		uint32_t id;
+		uint32_t fail;
+		if (len != 8) {
+			return E_FAIL;
+		}
+		memcpy(&id, pData, 4);
+		memcpy(&fail, pData + 4, 4);
+		std::this_thread::sleep_for(std::chrono::microseconds(m_latency + (id * 7919) % 2000));
+		if (fail) {
+			return E_FAIL;
+		}
+		if (!AllocateNV12Frame(16, 16, 16, 16, pFrame)) {
+			return E_OUTOFMEMORY;
+		}
+		pFrame->pY[0] = (uint8_t)id;
+		return S_OK;
+	}
+
+private:
+	uint32_t m_latency;
+};
+
+static const uint32_t FRAME_COUNT = 120;
+
+// Every 9th frame fails, and so does the last, which Drain() must not wait for.
+static bool ShouldFail(uint32_t id)
+{
+	return id % 9 == 4 || id == FRAME_COUNT - 1;
+}
+
+static uint32_t FailCount()
+{
+	uint32_t count = 0;
+	for (uint32_t id = 0; id < FRAME_COUNT; ++id) {
+		count += ShouldFail(id);
+	}
+	return count;
+}
+
+struct Input
+{
+	uint8_t data[8];
+	std::atomic<uint32_t> released;
+};
+
+static void ReleaseInput(void* pOwner)
+{
+	((Input*)pOwner)->released++;
+}
+
+static std::vector<Input> MakeInputs()
+{
+	std::vector<Input> inputs(FRAME_COUNT);
+	for (uint32_t id = 0; id < FRAME_COUNT; ++id) {
+		uint32_t fail = ShouldFail(id);
+		memcpy(inputs[id].data, &id, 4);
+		memcpy(inputs[id].data + 4, &fail, 4);
+		inputs[id].released = 0;
+	}
+	return inputs;
+}
+
+static bool Submit(FrameScheduler* pScheduler, Input* pInput, uint32_t id)
+{
+	CompressedFrame frame = { pInput->data, sizeof(pInput->data), (int64_t)id * 333333, ReleaseInput, pInput };
+	return pScheduler->Submit(&frame, true);
+}
+
+static bool AllReleasedOnce(const std::vector<Input>& inputs)
+{
+	for (const Input& input : inputs) {
+		if (input.released != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+struct Delivered
+{
+	std::mutex mutex;
+	std::vector<uint64_t> sequences;
+	std::atomic<int> inCallback{ 0 };
+	bool overlapped = false;
+	bool matches = true;
+};
+
+static void OnFrame(void* pContext, uint64_t sequence, NV12Frame* pFrame)
+{
+	Delivered* pDelivered = (Delivered*)pContext;
+	bool overlapped = pDelivered->inCallback++ != 0;
+	std::this_thread::sleep_for(std::chrono::microseconds(100));
+	std::lock_guard<std::mutex> lock(pDelivered->mutex);
+	pDelivered->overlapped |= overlapped;
+	pDelivered->matches &= pFrame->pY[0] == (uint8_t)sequence && pFrame->timestamp == (int64_t)sequence * 333333;
+	pDelivered->sequences.push_back(sequence);
+	ReleaseFrame(pFrame);
+	pDelivered->inCallback--;
+}
+
+// Submit order, with exactly the failed frames skipped.
+static bool InSubmitOrder(const std::vector<uint64_t>& sequences)
+{
+	if (sequences.size() != FRAME_COUNT - FailCount()) {
+		return false;
+	}
+	for (size_t i = 0; i < sequences.size(); ++i) {
+		if (ShouldFail((uint32_t)sequences[i]) || (i > 0 && sequences[i] <= sequences[i - 1])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void TestCallback()
+{
+	MockDecoder fast(0), medium(1000), slow(4000), slower(9000);
+	IMJPEGDecoder* decoders[] = { &fast, &medium, &slow, &slower };
+	std::vector<Input> inputs = MakeInputs();
+	Delivered delivered;
+	{
+		FrameScheduler scheduler(decoders, 4, 3);
+		scheduler.SetCallback(OnFrame, &delivered);
+		for (uint32_t id = 0; id < FRAME_COUNT; ++id) {
+			TEST_CHECK(Submit(&scheduler, &inputs[id], id));
+		}
+		scheduler.Drain();
+
+		FrameSchedulerStats stats = scheduler.GetStats();
+		TEST_CHECK(stats.submitted == FRAME_COUNT);
+		TEST_CHECK(stats.failed == FailCount());
+		TEST_CHECK(stats.delivered == FRAME_COUNT - FailCount());
+		TEST_CHECK(stats.queueDepth == 0 && stats.reorderDepth == 0);
+		TEST_CHECK(stats.maxQueueDepth <= 3);
+		// The slow decoders hold back the fast one's frames.
+		TEST_CHECK(stats.maxReorderDepth > 1 && stats.maxReorderMs > 0.0);
+		printf("max reorder depth %u, mean %.2f ms, max %.2f ms\n", stats.maxReorderDepth, stats.meanReorderMs,
+			stats.maxReorderMs);
+	}
+	TEST_CHECK(InSubmitOrder(delivered.sequences));
+	TEST_CHECK(delivered.matches);
+	TEST_CHECK(!delivered.overlapped);
+	TEST_CHECK(AllReleasedOnce(inputs));
+}
+
+static void TestPoll()
+{
+	MockDecoder fast(0), slow(3000), slower(6000);
+	IMJPEGDecoder* decoders[] = { &fast, &slow, &slower };
+	std::vector<Input> inputs = MakeInputs();
+	FrameScheduler scheduler(decoders, 3, 2);
+
+	std::vector<uint64_t> sequences;
+	bool matches = true;
+	std::thread consumer([&] {
+		while (sequences.size() < FRAME_COUNT - FailCount()) {
+			NV12Frame frame;
+			uint64_t sequence;
+			if (!scheduler.Poll(&frame, &sequence, 5000)) {
+				break;
+			}
+			matches &= frame.pY[0] == (uint8_t)sequence && frame.timestamp == (int64_t)sequence * 333333;
+			sequences.push_back(sequence);
+			ReleaseFrame(&frame);
+		}
+	});
+	for (uint32_t id = 0; id < FRAME_COUNT; ++id) {
+		TEST_CHECK(Submit(&scheduler, &inputs[id], id));
+	}
+	consumer.join();
+	scheduler.Drain();
+
+	NV12Frame frame;
+	TEST_CHECK(!scheduler.Poll(&frame, NULL, 10));
+	TEST_CHECK(InSubmitOrder(sequences));
+	TEST_CHECK(matches);
+	TEST_CHECK(scheduler.GetStats().failed == FailCount());
+	TEST_CHECK(AllReleasedOnce(inputs));
+}
+
+// The destructor waits for queued frames and frees those nobody polled.
+static void TestDestroyBusy()
+{
+	MockDecoder slow(2000), slower(5000);
+	IMJPEGDecoder* decoders[] = { &slow, &slower };
+	std::vector<Input> inputs = MakeInputs();
+	{
+		FrameScheduler scheduler(decoders, 2, 8);
+		for (uint32_t id = 0; id < FRAME_COUNT; ++id) {
+			TEST_CHECK(Submit(&scheduler, &inputs[id], id));
+		}
+	}
+	TEST_CHECK(AllReleasedOnce(inputs));
+}
+
+int main()
+{
+	// The failing frames are expected; don't log each one.
+	LogSetLevel(LOG_LEVEL_ERROR);
+	TestCallback();
+	TestPoll();
+	TestDestroyBusy();
+	return TestResult("FrameSchedulerTest");
+}
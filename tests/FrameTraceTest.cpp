@@ -0,0 +1,133 @@
+// Frame tracing from several threads: collection per thread, the latency
+// summary, ring wrap around, the Chrome trace export and ResetTrace().
+// Built with FRAME_TRACE=1 so the TRACE_* macros record.
+
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "TestUtil.h"
+#include "FrameTrace.h"
+
+static const uint32_t THREADS = 4;
+static const int64_t FRAMES_PER_THREAD = 20;
+
+static void SleepMs(int ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Every frame is read, decoded for about 2 ms and delivered.
+static void TraceFrames(uint32_t index)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "worker \"%u\"", index);
+	TRACE_THREAD_NAME(name);
+	for (int64_t i = 0; i < FRAMES_PER_THREAD; ++i) {
+		int64_t frameId = index * 1000 + i;
+		TRACE_INSTANT(TRACE_READ_SAMPLE, frameId);
+		{
+			TRACE_SCOPE(TRACE_DECODE, frameId);
+			SleepMs(2);
+		}
+		TRACE_INSTANT(TRACE_DELIVER, frameId);
+	}
+}
+
+static const TraceLatency* FindLatency(const std::vector<TraceLatency>& latencies, TraceStage stage, bool duration)
+{
+	for (const TraceLatency& l : latencies) {
+		if (l.stage == stage && l.duration == duration) {
+			return &l;
+		}
+	}
+	return NULL;
+}
+
+static void TestThreads()
+{
+	ResetTrace();
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < THREADS; ++i) {
+		threads.push_back(std::thread(TraceFrames, i));
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// Rings outlive their threads; each thread's records stay in order.
+	std::vector<TraceRecord> records;
+	std::vector<uint32_t> threadIndex;
+	TEST_CHECK(CollectTrace(&records, &threadIndex) == THREADS * FRAMES_PER_THREAD * 4);
+	TEST_CHECK(threadIndex.size() == records.size());
+	bool ordered = true;
+	for (size_t i = 1; i < records.size(); ++i) {
+		if (threadIndex[i] == threadIndex[i - 1]) {
+			ordered &= records[i].timeNs >= records[i - 1].timeNs;
+			ordered &= records[i].frameId / 1000 == records[i - 1].frameId / 1000;
+		}
+	}
+	TEST_CHECK(ordered);
+
+	std::vector<TraceLatency> latencies = ComputeTraceLatencies();
+	const TraceLatency* pDecode = FindLatency(latencies, TRACE_DECODE, true);
+	const TraceLatency* pDeliver = FindLatency(latencies, TRACE_DELIVER, false);
+	TEST_CHECK(pDecode && pDecode->count == THREADS * FRAMES_PER_THREAD);
+	TEST_CHECK(pDecode && pDecode->p50Ms >= 1.9 && pDecode->p50Ms <= pDecode->p99Ms && pDecode->p99Ms <= pDecode->maxMs);
+	TEST_CHECK(pDeliver && pDeliver->count == THREADS * FRAMES_PER_THREAD);
+	TEST_CHECK(pDeliver && pDecode && pDeliver->p50Ms >= pDecode->p50Ms);
+	TEST_CHECK(FindLatency(latencies, TRACE_READ_SAMPLE, false) == NULL);
+
+	// Quotes in thread names must not break the JSON.
+	const char* path = "FrameTraceTest.json";
+	TEST_CHECK(WriteChromeTrace(path));
+	FILE* f = fopen(path, "rb");
+	std::string json;
+	if (f) {
+		char buffer[4096];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+			json.append(buffer, n);
+		}
+		fclose(f);
+	}
+	remove(path);
+	TEST_CHECK(json.compare(0, 16, "{\"traceEvents\":[") == 0);
+	TEST_CHECK(json.find("\"name\":\"worker '0'\"") != std::string::npos);
+	size_t begins = 0;
+	for (size_t pos = 0; (pos = json.find("\"ph\":\"B\"", pos)) != std::string::npos; ++pos) {
+		begins++;
+	}
+	TEST_CHECK(begins == THREADS * FRAMES_PER_THREAD);
+	// No comma after the last event.
+	TEST_CHECK(json.size() > 5 && json.compare(json.size() - 5, 5, "}\n]}\n") == 0);
+
+	ResetTrace();
+	TEST_CHECK(CollectTrace(&records, &threadIndex) == 0);
+}
+
+// A thread keeps its last FRAME_TRACE_RING_SIZE records.
+static void TestWrapAround()
+{
+	ResetTrace();
+	for (int64_t i = 0; i < FRAME_TRACE_RING_SIZE + 100; ++i) {
+		TRACE_INSTANT(TRACE_SUBMIT, i);
+	}
+	std::vector<TraceRecord> records;
+	std::vector<uint32_t> threadIndex;
+	TEST_CHECK(CollectTrace(&records, &threadIndex) == FRAME_TRACE_RING_SIZE);
+	TEST_CHECK(!records.empty() && records.front().frameId == 100);
+	TEST_CHECK(!records.empty() && records.back().frameId == FRAME_TRACE_RING_SIZE + 99);
+	ResetTrace();
+}
+
+int main()
+{
+	TestThreads();
+	TestWrapAround();
+	TEST_CHECK(strcmp(TraceStageName(TRACE_DECODE), "Decode") == 0);
+	TEST_CHECK(strcmp(TraceStageName(TRACE_STAGE_COUNT), "?") == 0);
+	return TestResult("FrameTraceTest");
+}
@@ -0,0 +1,93 @@
+// The compile time GUID name registry: known subtypes by their real GUID
+// values, unknown GUIDs, probe lengths, and GuidNameTable on its own.
+
+#include <string.h>
+
+#include "TestUtil.h"
+#include "GuidNames.h"
+
+// MFVideoFormat_NV12 and MFVideoFormat_MJPG as the Windows SDK defines them.
+static constexpr PortableGuid s_nv12 = { 0x3231564E, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+static constexpr PortableGuid s_mjpg = { 0x47504A4D, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+
+// The table is built by the compiler.
+static_assert(GuidEqual(MakeFourccGuid(MakeFourcc("NV12")), s_nv12), "FOURCC GUID layout");
+static_assert(!GuidEqual(s_nv12, s_mjpg), "GuidEqual");
+
+static constexpr GuidNameTable<8> MakeSmallTable()
+{
+	GuidNameTable<8> table;
+	table.Insert(s_nv12, "nv12");
+	table.Insert(s_mjpg, "mjpg");
+	table.Insert(s_nv12, "duplicate");
+	return table;
+}
+
+static constexpr GuidNameTable<8> s_small = MakeSmallTable();
+static_assert(s_small.Count() == 2, "duplicates are not inserted");
+
+static bool NameIs(const char* pName, const char* pExpected)
+{
+	return pName != NULL && strcmp(pName, pExpected) == 0;
+}
+
+static void TestRegistry()
+{
+	const GuidNameRegistry& names = GetFormatGuidNames();
+	TEST_CHECK(names.Count() > 60);
+	TEST_CHECK(names.MaxProbe() >= 1 && names.MaxProbe() <= 4);
+
+	TEST_CHECK(NameIs(FindFormatGuidName(s_nv12), "MFVideoFormat_NV12"));
+	TEST_CHECK(NameIs(FindFormatGuidName(s_mjpg), "MFVideoFormat_MJPG"));
+	TEST_CHECK(NameIs(FindFormatGuidName(MakeFourccGuid(MakeFourcc("YUY2"))), "MFVideoFormat_YUY2"));
+	TEST_CHECK(NameIs(FindFormatGuidName(MakeFourccGuid(22)), "MFVideoFormat_RGB32"));
+	TEST_CHECK(NameIs(FindFormatGuidName(MakeFourccGuid(0x0001)), "MFAudioFormat_PCM"));
+	TEST_CHECK(NameIs(FindFormatGuidName(MakeFourccGuid(MakeFourcc("vids"))), "MFMediaType_Video"));
+
+	// Unknown FOURCCs and GUIDs that only differ outside data1.
+	TEST_CHECK(FindFormatGuidName(MakeFourccGuid(MakeFourcc("ZZZZ"))) == NULL);
+	PortableGuid other = s_nv12;
+	other.data4[7] ^= 1;
+	TEST_CHECK(FindFormatGuidName(other) == NULL);
+	other = s_nv12;
+	other.data2 = 1;
+	TEST_CHECK(FindFormatGuidName(other) == NULL);
+	PortableGuid zero = {};
+	TEST_CHECK(FindFormatGuidName(zero) == NULL);
+
+	// Every entry is found through its own slot.
+	uint32_t found = 0;
+	for (uint32_t i = 0; i < GUID_NAME_TABLE_SIZE; ++i) {
+		const GuidName& slot = names.Slot(i);
+		if (slot.name) {
+			found += names.Find(slot.guid) == slot.name;
+		}
+	}
+	TEST_CHECK(found == names.Count());
+}
+
+static void TestTable()
+{
+	TEST_CHECK(NameIs(s_small.Find(s_nv12), "nv12"));
+	TEST_CHECK(NameIs(s_small.Find(s_mjpg), "mjpg"));
+	TEST_CHECK(s_small.Find(MakeFourccGuid(1)) == NULL);
+
+	// At most half full: the fifth insert into 8 slots fails.
+	GuidNameTable<8> table;
+	for (uint32_t i = 0; i < 4; ++i) {
+		TEST_CHECK(table.Insert(MakeFourccGuid(i + 100), "entry"));
+	}
+	TEST_CHECK(!table.Insert(MakeFourccGuid(200), "full"));
+	TEST_CHECK(table.Count() == 4);
+	for (uint32_t i = 0; i < 4; ++i) {
+		TEST_CHECK(table.Find(MakeFourccGuid(i + 100)) != NULL);
+	}
+	TEST_CHECK(table.Find(MakeFourccGuid(200)) == NULL);
+}
+
+int main()
+{
+	TestRegistry();
+	TestTable();
+	return TestResult("GuidNamesTest");
+}
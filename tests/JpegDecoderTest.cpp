@@ -0,0 +1,362 @@
+// Round trips through the test encoder: the decoder against the source
+// picture, the threaded, cropped, scaled, luma only and RGB paths against the
+// plain decode, and corrupt input.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "TestUtil.h"
+#include "TestJpegEncoder.h"
+#include "SoftMJPEGDecoder.h"
+#include "ColorConvert.h"
+#include "JpegIdct.h"
+
+struct TestCase
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t h;
+	uint32_t v;
+	uint32_t restartInterval;
+	bool gray;
+};
+
+static std::vector<TestCase> MakeTestCases()
+{
+	static const uint32_t sizes[][2] = { { 64, 48 }, { 67, 41 }, { 333, 187 }, { 640, 480 } };
+	std::vector<TestCase> cases;
+	for (const auto& size : sizes) {
+		for (uint32_t h = 1; h <= 2; ++h) {
+			for (uint32_t v = 1; v <= 2; ++v) {
+				for (uint32_t restart : { 0u, 1u, 5u }) {
+					TestCase c = { size[0], size[1], h, v, restart, false };
+					cases.push_back(c);
+				}
+			}
+		}
+		TestCase gray = { size[0], size[1], 1, 1, 3, true };
+		cases.push_back(gray);
+	}
+	return cases;
+}
+
+static std::vector<uint8_t> EncodeCase(const TestCase& c, int quality)
+{
+	std::vector<uint8_t> rgb = MakeTestImage(c.width, c.height, c.width + c.height, 0);
+	return EncodeTestJpeg(rgb.data(), c.width, c.height, MakeTestJpegParams(quality, c.h, c.v, c.restartInterval, c.gray));
+}
+
+static bool Decode(const std::vector<uint8_t>& jpeg, uint32_t threads, const DecodeOptions* pOptions, NV12Frame* pFrame)
+{
+	SoftMJPEGDecoder decoder;
+	decoder.SetThreadCount(threads);
+	if (pOptions) {
+		decoder.SetDecodeOptions(*pOptions);
+	}
+	return decoder.DecodeOneFrame(jpeg.data(), jpeg.size(), pFrame) == S_OK;
+}
+
+// Decoded Y against the source picture's luma, at high quality.
+static void TestRoundTrip()
+{
+	for (const TestCase& c : MakeTestCases()) {
+		std::vector<uint8_t> rgb = MakeTestImage(c.width, c.height, c.width + c.height, 0);
+		std::vector<uint8_t> jpeg = EncodeTestJpeg(rgb.data(), c.width, c.height,
+			MakeTestJpegParams(95, c.h, c.v, c.restartInterval, c.gray));
+		NV12Frame frame;
+		if (!Decode(jpeg, 1, NULL, &frame)) {
+			TEST_CHECK(!"decode failed");
+			continue;
+		}
+		TEST_CHECK(frame.width == c.width && frame.height == c.height);
+		double sum = 0.0;
+		int maxError = 0;
+		for (uint32_t y = 0; y < c.height; ++y) {
+			for (uint32_t x = 0; x < c.width; ++x) {
+				uint8_t ycc[3];
+				RgbToYCbCr(&rgb[((size_t)y * c.width + x) * 3], ycc);
+				int e = abs((int)frame.pY[(size_t)y * frame.pitchY + x] - ycc[0]);
+				sum += e;
+				maxError = e > maxError ? e : maxError;
+			}
+		}
+		TEST_CHECK(sum / ((double)c.width * c.height) < 1.5);
+		TEST_CHECK(maxError <= 12);
+		if (c.gray) {
+			bool neutral = true;
+			for (uint32_t y = 0; y < (c.height + 1) / 2; ++y) {
+				for (uint32_t x = 0; x < (c.width + 1) / 2 * 2; ++x) {
+					neutral &= frame.pUV[(size_t)y * frame.pitchUV + x] == 128;
+				}
+			}
+			TEST_CHECK(neutral);
+		}
+		ReleaseFrame(&frame);
+	}
+
+	// Without a DHT segment the decoder falls back to the Annex K tables.
+	std::vector<uint8_t> rgb = MakeTestImage(64, 48, 1, 0);
+	TestJpegParams params = MakeTestJpegParams(90, 2, 1, 0, false);
+	params.huffmanTables = false;
+	std::vector<uint8_t> jpeg = EncodeTestJpeg(rgb.data(), 64, 48, params);
+	NV12Frame frame;
+	TEST_CHECK(Decode(jpeg, 1, NULL, &frame));
+	ReleaseFrame(&frame);
+}
+
+// Restart intervals on worker threads give the same frame as one thread.
+static void TestThreaded()
+{
+	for (const TestCase& c : MakeTestCases()) {
+		std::vector<uint8_t> jpeg = EncodeCase(c, 85);
+		NV12Frame single, threaded;
+		if (!Decode(jpeg, 1, NULL, &single) || !Decode(jpeg, 4, NULL, &threaded)) {
+			TEST_CHECK(!"decode failed");
+			continue;
+		}
+		NV12FrameDiff diff;
+		TEST_CHECK(CompareNV12Frames(&single, &threaded, &diff));
+		TEST_CHECK(diff.maxDiffY == 0 && diff.maxDiffUV == 0);
+		ReleaseFrame(&single);
+		ReleaseFrame(&threaded);
+	}
+}
+
+// A crop is the same pixels as the matching part of the whole frame, at
+// every scale.
+static void TestCrop()
+{
+	TestRandom random(7);
+	for (const TestCase& c : MakeTestCases()) {
+		std::vector<uint8_t> jpeg = EncodeCase(c, 85);
+		for (uint32_t scale = DECODE_SCALE_FULL; scale <= DECODE_SCALE_1_8; ++scale) {
+			DecodeOptions options;
+			GetDefaultDecodeOptions(&options);
+			options.scale = (DecodeScale)scale;
+			NV12Frame full;
+			if (!Decode(jpeg, 1, &options, &full)) {
+				TEST_CHECK(!"decode failed");
+				continue;
+			}
+			for (int i = 0; i < 3; ++i) {
+				options.crop.x = random.Below(c.width);
+				options.crop.y = random.Below(c.height);
+				options.crop.width = 1 + random.Below(c.width - options.crop.x);
+				options.crop.height = 1 + random.Below(c.height - options.crop.y);
+				DecodeRect rect;
+				GetDecodedRect(options, c.width, c.height, &rect);
+				NV12Frame crop;
+				if (!Decode(jpeg, 2, &options, &crop)) {
+					TEST_CHECK(rect.width == 0 || rect.height == 0);
+					continue;
+				}
+				TEST_CHECK(crop.width == rect.width && crop.height == rect.height);
+				bool same = true;
+				for (uint32_t y = 0; y < rect.height; ++y) {
+					same &= memcmp(crop.pY + (size_t)y * crop.pitchY, full.pY + (size_t)(rect.y + y) * full.pitchY + rect.x,
+						rect.width) == 0;
+				}
+				for (uint32_t y = 0; y < (rect.height + 1) / 2; ++y) {
+					same &= memcmp(crop.pUV + (size_t)y * crop.pitchUV,
+						full.pUV + (size_t)(rect.y / 2 + y) * full.pitchUV + rect.x, (rect.width + 1) & ~1u) == 0;
+				}
+				TEST_CHECK(same);
+				ReleaseFrame(&crop);
+			}
+			ReleaseFrame(&full);
+		}
+	}
+}
+
+// Scaled decodes have the rounded up size and stay close to the averaged
+// full frame; luma only decodes have the same Y plane and no UV.
+static void TestScaledAndLumaOnly()
+{
+	for (const TestCase& c : MakeTestCases()) {
+		std::vector<uint8_t> jpeg = EncodeCase(c, 85);
+		NV12Frame full;
+		if (!Decode(jpeg, 1, NULL, &full)) {
+			TEST_CHECK(!"decode failed");
+			continue;
+		}
+		for (uint32_t scale = DECODE_SCALE_FULL; scale <= DECODE_SCALE_1_8; ++scale) {
+			DecodeOptions options;
+			GetDefaultDecodeOptions(&options);
+			options.scale = (DecodeScale)scale;
+			NV12Frame scaled;
+			if (!Decode(jpeg, 1, &options, &scaled)) {
+				TEST_CHECK(!"scaled decode failed");
+				continue;
+			}
+			uint32_t n = 1u << scale;
+			TEST_CHECK(scaled.width == (c.width + n - 1) / n && scaled.height == (c.height + n - 1) / n);
+			double sum = 0.0;
+			uint32_t count = 0;
+			for (uint32_t y = 0; y < c.height / n; ++y) {
+				for (uint32_t x = 0; x < c.width / n; ++x) {
+					uint32_t a = 0;
+					for (uint32_t dy = 0; dy < n; ++dy) {
+						for (uint32_t dx = 0; dx < n; ++dx) {
+							a += full.pY[(size_t)(y * n + dy) * full.pitchY + x * n + dx];
+						}
+					}
+					a = (a + n * n / 2) / (n * n);
+					sum += abs((int)a - scaled.pY[(size_t)y * scaled.pitchY + x]);
+					count++;
+				}
+			}
+			TEST_CHECK(count == 0 || sum / count < 3.0);
+
+			options.lumaOnly = true;
+			NV12Frame luma;
+			if (!Decode(jpeg, 1, &options, &luma)) {
+				TEST_CHECK(!"luma only decode failed");
+				ReleaseFrame(&scaled);
+				continue;
+			}
+			NV12FrameDiff diff;
+			TEST_CHECK(luma.pUV == NULL);
+			TEST_CHECK(CompareNV12Frames(&luma, &scaled, &diff) && diff.maxDiffY == 0);
+			ReleaseFrame(&luma);
+			ReleaseFrame(&scaled);
+		}
+		ReleaseFrame(&full);
+	}
+}
+
+// The fused RGB decode is the NV12 decode converted afterwards.
+static void TestFusedRgb()
+{
+	for (const TestCase& c : MakeTestCases()) {
+		std::vector<uint8_t> jpeg = EncodeCase(c, 85);
+		for (int format = RGB_FORMAT_BGRA; format <= RGB_FORMAT_RGB24; ++format) {
+			SoftMJPEGDecoder decoder;
+			decoder.SetThreadCount(2);
+			NV12Frame nv12;
+			RgbFrame converted, fused;
+			if (decoder.DecodeOneFrame(jpeg.data(), jpeg.size(), &nv12) != S_OK) {
+				TEST_CHECK(!"decode failed");
+				continue;
+			}
+			TEST_CHECK(AllocateRgbFrame(nv12.width, nv12.height, (RgbFormat)format, &converted));
+			ConvertNV12ToRgb(&nv12, YUV_MATRIX_BT601, YUV_RANGE_FULL, (RgbFormat)format, converted.pData, converted.pitch);
+			if (decoder.DecodeOneFrameRgb(jpeg.data(), jpeg.size(), (RgbFormat)format, &fused) != S_OK) {
+				TEST_CHECK(!"fused decode failed");
+			} else {
+				bool same = fused.width == nv12.width && fused.height == nv12.height;
+				for (uint32_t y = 0; same && y < nv12.height; ++y) {
+					same = memcmp(converted.pData + (size_t)y * converted.pitch, fused.pData + (size_t)y * fused.pitch,
+						nv12.width * RgbBytesPerPixel((RgbFormat)format)) == 0;
+				}
+				TEST_CHECK(same);
+				ReleaseFrame(&fused);
+			}
+			ReleaseFrame(&converted);
+			ReleaseFrame(&nv12);
+		}
+	}
+}
+
+// Truncated and corrupted frames fail or decode garbage, but never crash.
+static void TestCorrupt()
+{
+	TestRandom random(11);
+	TestCase c = { 333, 187, 2, 2, 4, false };
+	std::vector<uint8_t> jpeg = EncodeCase(c, 85);
+	for (int i = 0; i < 300; ++i) {
+		std::vector<uint8_t> bad = jpeg;
+		if (i % 3 == 0) {
+			bad.resize(random.Below((uint32_t)bad.size()));
+		} else {
+			for (uint32_t n = 1 + random.Below(8); n > 0; --n) {
+				bad[random.Below((uint32_t)bad.size())] = (uint8_t)random.Next();
+			}
+		}
+		DecodeOptions options;
+		GetDefaultDecodeOptions(&options);
+		options.scale = (DecodeScale)(i % 4);
+		NV12Frame frame;
+		if (Decode(bad, 1 + i % 3, &options, &frame)) {
+			ReleaseFrame(&frame);
+		}
+	}
+	NV12Frame frame;
+	TEST_CHECK(!Decode(std::vector<uint8_t>(), 1, NULL, &frame));
+}
+
+// Sets every quantizer to 255: coefficients coded for a quality 100 table
+// then dequantize far outside what an 8 bit DCT gives.
+static void CorruptQuantTables(std::vector<uint8_t>* pJpeg)
+{
+	std::vector<uint8_t>& jpeg = *pJpeg;
+	for (size_t i = 2; i + 4 <= jpeg.size() && jpeg[i] == 0xFF && jpeg[i + 1] != 0xDA;) {
+		size_t length = (jpeg[i + 2] << 8) | jpeg[i + 3];
+		if (jpeg[i + 1] == 0xDB) {
+			for (size_t t = i + 4; t + 65 <= i + 2 + length; t += 65) {
+				memset(&jpeg[t + 1], 255, 64);
+			}
+		}
+		i += 2 + length;
+	}
+}
+
+// Huge dequantized coefficients through every IDCT, threaded and scaled.
+// Only checks that decoding completes; run under UBSan it checks the math.
+static void TestCorruptCoefficients()
+{
+	std::vector<uint8_t> rgb = MakeTestImage(160, 96, 7, 96);
+	std::vector<uint8_t> jpeg = EncodeTestJpeg(rgb.data(), 160, 96, MakeTestJpegParams(100, 2, 2, 0, false));
+	CorruptQuantTables(&jpeg);
+	for (int i = 0; i < 8; ++i) {
+		DecodeOptions options;
+		GetDefaultDecodeOptions(&options);
+		options.scale = (DecodeScale)(i % 4);
+		NV12Frame frame;
+		TEST_CHECK(Decode(jpeg, 1 + i / 4, &options, &frame));
+		ReleaseFrame(&frame);
+	}
+}
+
+// The SIMD kernels against their scalar versions, and the scalar IDCTs with
+// the largest coefficients a corrupt stream can give.
+static void TestKernels()
+{
+	int maxError = 0;
+	TEST_CHECK(VerifyIdctKernels(20000, 1) == 0);
+	TEST_CHECK(VerifyColorKernels(64, 1, &maxError) == 0);
+
+	TestRandom random(3);
+	int16_t coef[64];
+	uint16_t quant[64];
+	uint8_t out[64];
+	for (int i = 0; i < 20000; ++i) {
+		for (int k = 0; k < 64; ++k) {
+			coef[k] = (int16_t)(random.Below(2) ? (random.Below(2) ? 32767 : -32768) : random.Next());
+			quant[k] = (uint16_t)(random.Below(2) ? 65535 : random.Next());
+		}
+		// Also DC only blocks and blocks with only a first row, for the shortcuts.
+		if (i % 4 == 1) {
+			memset(coef + 1, 0, 63 * sizeof(coef[0]));
+		} else if (i % 4 == 2) {
+			memset(coef + 8, 0, 56 * sizeof(coef[0]));
+		}
+		IdctDequant8x8(coef, quant, out, 8);
+		SelectIdctDequant()(coef, quant, out, 8);
+		IdctDequant4x4(coef, quant, out, 8);
+		IdctDequant2x2(coef, quant, out, 8);
+		IdctDequant1x1(coef, quant, out, 8);
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestThreaded();
+	TestCrop();
+	TestScaledAndLumaOnly();
+	TestFusedRgb();
+	TestCorrupt();
+	TestCorruptCoefficients();
+	TestKernels();
+	return TestResult("JpegDecoderTest");
+}
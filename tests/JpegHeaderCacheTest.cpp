@@ -0,0 +1,142 @@
+// JpegHeaderCache: frames with the same tables hit and decode bit identically
+// to an uncached decode, while a changed DQT, DHT, SOF or DRI misses, and the
+// least recently used format is evicted.
+
+#include <string.h>
+
+#include "TestUtil.h"
+#include "TestJpegEncoder.h"
+#include "JpegHeaderCache.h"
+
+static const uint32_t WIDTH = 96;
+static const uint32_t HEIGHT = 64;
+
+static std::vector<uint8_t> Encode(uint32_t seed, uint32_t width, int quality, uint32_t restartInterval, bool huffmanTables)
+{
+	std::vector<uint8_t> rgb = MakeTestImage(width, HEIGHT, seed, 24);
+	TestJpegParams params = MakeTestJpegParams(quality, 2, 2, restartInterval, false);
+	params.huffmanTables = huffmanTables;
+	return EncodeTestJpeg(rgb.data(), width, HEIGHT, params);
+}
+
+static bool AllocateFor(const JpegHeader* pHeader, NV12Frame* pFrame)
+{
+	uint32_t pitch;
+	uint32_t alignedHeight;
+	GetJpegFrameLayout(pHeader, &pitch, &alignedHeight);
+	return AllocateNV12Frame(pHeader->width, pHeader->height, pitch, alignedHeight, pFrame);
+}
+
+// Decodes through the cache and without it; true when both succeed and match.
+static bool DecodeMatches(JpegHeaderCache* pCache, const std::vector<uint8_t>& jpeg)
+{
+	JpegHeader cachedHeader;
+	JpegHeader header;
+	const JpegScanTables* pTables = NULL;
+	NV12Frame cached;
+	NV12Frame plain;
+	if (pCache->Lookup(jpeg.data(), jpeg.size(), &cachedHeader, &pTables) != S_OK ||
+		ParseJpegHeader(jpeg.data(), jpeg.size(), &header) != S_OK) {
+		return false;
+	}
+	bool ok = cachedHeader.pScan == header.pScan && cachedHeader.scanLen == header.scanLen;
+	ok = ok && AllocateFor(&cachedHeader, &cached);
+	if (ok && !AllocateFor(&header, &plain)) {
+		ReleaseFrame(&cached);
+		ok = false;
+	}
+	if (ok) {
+		NV12FrameDiff diff;
+		ok = DecodeJpegScan(&cachedHeader, pTables, &cached) == S_OK && DecodeJpegScan(&header, &plain) == S_OK;
+		ok = ok && CompareNV12Frames(&cached, &plain, &diff) && diff.maxDiffY == 0 && diff.maxDiffUV == 0;
+		ReleaseFrame(&cached);
+		ReleaseFrame(&plain);
+	}
+	return ok;
+}
+
+// Adds one to the first quantizer of the first DQT segment.
+static std::vector<uint8_t> ChangeDqt(std::vector<uint8_t> jpeg)
+{
+	for (size_t i = 2; i + 5 < jpeg.size(); ++i) {
+		if (jpeg[i] == 0xFF && jpeg[i + 1] == JPEG_DQT) {
+			jpeg[i + 5] = (uint8_t)(jpeg[i + 5] == 255 ? 254 : jpeg[i + 5] + 1);
+			break;
+		}
+	}
+	return jpeg;
+}
+
+static void TestHitsAndMisses()
+{
+	JpegHeaderCache cache;
+
+	// Different pictures, same tables: one miss, then hits.
+	for (uint32_t seed = 1; seed <= 6; ++seed) {
+		TEST_CHECK(DecodeMatches(&cache, Encode(seed, WIDTH, 75, 0, true)));
+	}
+	TEST_CHECK(cache.Misses() == 1 && cache.Hits() == 5);
+
+	// A changed quantizer must not decode with the cached tables.
+	std::vector<uint8_t> jpeg = Encode(7, WIDTH, 75, 0, true);
+	TEST_CHECK(DecodeMatches(&cache, ChangeDqt(jpeg)));
+	TEST_CHECK(cache.Misses() == 2);
+	TEST_CHECK(DecodeMatches(&cache, Encode(8, WIDTH, 50, 0, true)));
+	TEST_CHECK(cache.Misses() == 3);
+
+	// No DHT (the Annex K defaults apply), another size, restart markers.
+	TEST_CHECK(DecodeMatches(&cache, Encode(9, WIDTH, 75, 0, false)));
+	TEST_CHECK(cache.Misses() == 4);
+	TEST_CHECK(DecodeMatches(&cache, Encode(10, WIDTH + 16, 75, 0, true)));
+	TEST_CHECK(cache.Misses() == 5);
+	TEST_CHECK(DecodeMatches(&cache, Encode(11, WIDTH, 75, 2, true)));
+	TEST_CHECK(cache.Misses() == 6 && cache.Hits() == 5);
+
+	// The first format was evicted by the capacity of 4, the latest ones hit.
+	TEST_CHECK(DecodeMatches(&cache, Encode(12, WIDTH, 75, 0, true)));
+	TEST_CHECK(cache.Misses() == 7);
+	TEST_CHECK(DecodeMatches(&cache, Encode(13, WIDTH, 75, 2, true)));
+	TEST_CHECK(DecodeMatches(&cache, Encode(14, WIDTH, 75, 0, false)));
+	TEST_CHECK(cache.Misses() == 7 && cache.Hits() == 7);
+
+	// Clear() drops the entries but not the counters.
+	cache.Clear();
+	TEST_CHECK(DecodeMatches(&cache, Encode(15, WIDTH, 75, 0, true)));
+	TEST_CHECK(cache.Misses() == 8 && cache.Hits() == 7);
+}
+
+// Two formats alternating in a cache of one: every frame misses.
+static void TestEviction()
+{
+	JpegHeaderCache cache(1);
+	std::vector<uint8_t> a = Encode(1, WIDTH, 75, 0, true);
+	std::vector<uint8_t> b = Encode(2, WIDTH, 90, 0, true);
+	for (int i = 0; i < 3; ++i) {
+		TEST_CHECK(DecodeMatches(&cache, a));
+		TEST_CHECK(DecodeMatches(&cache, b));
+	}
+	TEST_CHECK(cache.Hits() == 0 && cache.Misses() == 6);
+	TEST_CHECK(DecodeMatches(&cache, b));
+	TEST_CHECK(cache.Hits() == 1);
+}
+
+// Broken headers fail without touching the counters.
+static void TestBroken()
+{
+	JpegHeaderCache cache;
+	std::vector<uint8_t> jpeg = Encode(1, WIDTH, 75, 0, true);
+	JpegHeader header;
+	const JpegScanTables* pTables = NULL;
+	TEST_CHECK(cache.Lookup(jpeg.data(), 100, &header, &pTables) != S_OK);
+	jpeg[0] = 0;
+	TEST_CHECK(cache.Lookup(jpeg.data(), jpeg.size(), &header, &pTables) != S_OK);
+	TEST_CHECK(cache.Hits() == 0 && cache.Misses() == 0);
+}
+
+int main()
+{
+	TestHitsAndMisses();
+	TestEviction();
+	TestBroken();
+	return TestResult("JpegHeaderCacheTest");
+}
@@ -0,0 +1,157 @@
+// The decoder against libjpeg's raw (not upsampled) ISLOW output: Y must be
+// identical, UV the 2x2 average of libjpeg's chroma samples.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <jpeglib.h>
+
+#include "TestUtil.h"
+#include "SoftMJPEGDecoder.h"
+
+static std::vector<uint8_t> EncodeLibjpeg(const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height, int quality,
+	int h, int v, uint32_t restartInterval, bool gray)
+{
+	jpeg_compress_struct cinfo;
+	jpeg_error_mgr err;
+	cinfo.err = jpeg_std_error(&err);
+	jpeg_create_compress(&cinfo);
+	unsigned char* pOut = NULL;
+	unsigned long outSize = 0;
+	jpeg_mem_dest(&cinfo, &pOut, &outSize);
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	if (gray) {
+		jpeg_set_colorspace(&cinfo, JCS_GRAYSCALE);
+	}
+	jpeg_set_quality(&cinfo, quality, TRUE);
+	cinfo.comp_info[0].h_samp_factor = h;
+	cinfo.comp_info[0].v_samp_factor = v;
+	cinfo.restart_interval = restartInterval;
+	cinfo.dct_method = JDCT_ISLOW;
+	jpeg_start_compress(&cinfo, TRUE);
+	while (cinfo.next_scanline < cinfo.image_height) {
+		JSAMPROW row = (JSAMPROW)&rgb[(size_t)cinfo.next_scanline * width * 3];
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	std::vector<uint8_t> jpeg(pOut, pOut + outSize);
+	free(pOut);
+	jpeg_destroy_compress(&cinfo);
+	return jpeg;
+}
+
+// Component planes padded to whole MCUs, as libjpeg decodes them.
+struct RawPlanes
+{
+	int components;
+	int width[3];
+	int h[3];
+	int v[3];
+	int maxH;
+	int maxV;
+	std::vector<uint8_t> planes[3];
+};
+
+static void DecodeLibjpegRaw(const std::vector<uint8_t>& jpeg, RawPlanes* pRaw)
+{
+	jpeg_decompress_struct dinfo;
+	jpeg_error_mgr err;
+	dinfo.err = jpeg_std_error(&err);
+	jpeg_create_decompress(&dinfo);
+	jpeg_mem_src(&dinfo, jpeg.data(), jpeg.size());
+	jpeg_read_header(&dinfo, TRUE);
+	dinfo.raw_data_out = TRUE;
+	dinfo.dct_method = JDCT_ISLOW;
+	dinfo.do_fancy_upsampling = FALSE;
+	jpeg_start_decompress(&dinfo);
+	pRaw->components = dinfo.num_components;
+	pRaw->maxH = dinfo.max_h_samp_factor;
+	pRaw->maxV = dinfo.max_v_samp_factor;
+	int mcuRows = pRaw->maxV * 8;
+	int totalRows = ((int)dinfo.image_height + mcuRows - 1) / mcuRows * mcuRows;
+	for (int c = 0; c < pRaw->components; ++c) {
+		pRaw->h[c] = dinfo.comp_info[c].h_samp_factor;
+		pRaw->v[c] = dinfo.comp_info[c].v_samp_factor;
+		pRaw->width[c] = dinfo.comp_info[c].width_in_blocks * 8;
+		pRaw->planes[c].assign((size_t)pRaw->width[c] * (totalRows * pRaw->v[c] / pRaw->maxV), 0);
+	}
+	std::vector<JSAMPROW> rows[3];
+	JSAMPARRAY arrays[3];
+	while (dinfo.output_scanline < dinfo.output_height) {
+		int base = (int)dinfo.output_scanline;
+		for (int c = 0; c < pRaw->components; ++c) {
+			int n = pRaw->v[c] * 8;
+			int first = base * pRaw->v[c] / pRaw->maxV;
+			rows[c].resize(n);
+			for (int i = 0; i < n; ++i) {
+				rows[c][i] = &pRaw->planes[c][(size_t)(first + i) * pRaw->width[c]];
+			}
+			arrays[c] = rows[c].data();
+		}
+		jpeg_read_raw_data(&dinfo, arrays, mcuRows);
+	}
+	jpeg_finish_decompress(&dinfo);
+	jpeg_destroy_decompress(&dinfo);
+}
+
+static void Compare(uint32_t width, uint32_t height, int quality, int h, int v, uint32_t restartInterval, bool gray)
+{
+	std::vector<uint8_t> rgb = MakeTestImage(width, height, width + height + quality, 10);
+	std::vector<uint8_t> jpeg = EncodeLibjpeg(rgb, width, height, quality, h, v, restartInterval, gray);
+	RawPlanes raw;
+	DecodeLibjpegRaw(jpeg, &raw);
+
+	SoftMJPEGDecoder decoder;
+	NV12Frame frame;
+	if (decoder.DecodeOneFrame(jpeg.data(), jpeg.size(), &frame) != S_OK) {
+		TEST_CHECK(!"decode failed");
+		return;
+	}
+	uint32_t badY = 0;
+	uint32_t badUV = 0;
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			badY += frame.pY[(size_t)y * frame.pitchY + x] != raw.planes[0][(size_t)y * raw.width[0] + x];
+		}
+	}
+	for (uint32_t j = 0; j < (height + 1) / 2; ++j) {
+		for (uint32_t i = 0; i < (width + 1) / 2; ++i) {
+			for (int c = 1; c < 3; ++c) {
+				int expected = 128;
+				if (!gray) {
+					int x0 = 2 * i * raw.h[c] / raw.maxH;
+					int x1 = (2 * i + 1) * raw.h[c] / raw.maxH;
+					int y0 = 2 * j * raw.v[c] / raw.maxV;
+					int y1 = (2 * j + 1) * raw.v[c] / raw.maxV;
+					const std::vector<uint8_t>& p = raw.planes[c];
+					int w = raw.width[c];
+					expected = (p[y0 * w + x0] + p[y0 * w + x1] + p[y1 * w + x0] + p[y1 * w + x1] + 2) >> 2;
+				}
+				badUV += frame.pUV[(size_t)j * frame.pitchUV + 2 * i + c - 1] != expected;
+			}
+		}
+	}
+	if (badY || badUV) {
+		printf("%ux%u q%d %dx%d restart %u gray %d: %u Y and %u UV mismatches\n", width, height, quality, h, v,
+			restartInterval, gray, badY, badUV);
+	}
+	TEST_CHECK(badY == 0 && badUV == 0);
+	ReleaseFrame(&frame);
+}
+
+int main()
+{
+	Compare(320, 240, 75, 2, 1, 0, false);
+	Compare(320, 240, 95, 2, 2, 0, false);
+	Compare(333, 247, 90, 1, 1, 0, false);
+	Compare(1280, 720, 85, 2, 1, 80, false);
+	Compare(1920, 1080, 95, 2, 1, 7, false);
+	Compare(64, 64, 50, 1, 1, 0, true);
+	Compare(17, 9, 100, 2, 2, 1, false);
+	Compare(1920, 1080, 100, 2, 2, 0, false);
+	return TestResult("LibjpegCompareTest");
+}
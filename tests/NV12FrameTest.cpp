@@ -0,0 +1,160 @@
+// Frame descriptors and their owners: reference counting through Describe /
+// Retain / Release, the allocators' layouts and failure paths, and
+// CompareNV12Frames across layouts.
+
+#include <string.h>
+
+#include "TestUtil.h"
+#include "NV12Frame.h"
+
+// Stands in for a locked media buffer, counting the references it gets.
+class CountingFrameOwner : public IFrameOwner
+{
+public:
+	CountingFrameOwner() : refCount(1), released(false) {}
+
+	void AddRef() { refCount++; }
+	void Release()
+	{
+		if (--refCount == 0) {
+			released = true;
+		}
+	}
+
+	long refCount;
+	bool released;
+};
+
+static void TestOwnerReferences()
+{
+	uint8_t buffer[64 * 48 * 3 / 2];
+	CountingFrameOwner owner;
+	NV12Frame frame;
+	DescribeNV12Frame(buffer, 60, 45, 64, 48, &owner, &frame);
+	TEST_CHECK(owner.refCount == 2);
+	TEST_CHECK(frame.pY == buffer && frame.pUV == buffer + 64 * 48);
+	TEST_CHECK(frame.pitchY == 64 && frame.pitchUV == 64 && frame.alignedHeight == 48);
+	TEST_CHECK(frame.timestamp == 0);
+	TEST_CHECK(NV12FrameSize(&frame) == 64 * 48 + 64 * 23);
+
+	NV12Frame copy = frame;
+	RetainFrame(&copy);
+	TEST_CHECK(owner.refCount == 3);
+	ReleaseFrame(&copy);
+	TEST_CHECK(owner.refCount == 2);
+	TEST_CHECK(copy.pY == NULL && copy.pOwner == NULL);
+
+	// The provider drops its own reference while the frame is still held.
+	owner.Release();
+	TEST_CHECK(!owner.released);
+	ReleaseFrame(&frame);
+	TEST_CHECK(owner.released);
+
+	// Cleared descriptors, like those a failed decode returns, release nothing.
+	ReleaseFrame(&frame);
+	RetainFrame(&frame);
+	TEST_CHECK(owner.refCount == 0);
+
+	// Frames without an owner describe memory someone else keeps alive.
+	DescribeNV12Frame(buffer, 8, 8, 8, 8, NULL, &frame);
+	ReleaseFrame(&frame);
+	TEST_CHECK(frame.pY == NULL);
+}
+
+static bool IsZero(const uint8_t* p, size_t size)
+{
+	for (size_t i = 0; i < size; ++i) {
+		if (p[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void TestAllocate()
+{
+	NV12Frame frame;
+	memset(&frame, 0, sizeof(frame));
+	TEST_CHECK(!AllocateNV12Frame(64, 48, 32, 48, &frame));
+	TEST_CHECK(!AllocateNV12Frame(64, 48, 64, 32, &frame));
+	TEST_CHECK(!AllocateLumaFrame(64, 48, 63, 48, &frame));
+	TEST_CHECK(!AllocateLumaFrame(64, 48, 64, 47, &frame));
+	TEST_CHECK(frame.pOwner == NULL);
+
+	TEST_CHECK(AllocateNV12Frame(67, 41, 80, 48, &frame));
+	TEST_CHECK(frame.width == 67 && frame.height == 41 && frame.pitchY == 80 && frame.alignedHeight == 48);
+	TEST_CHECK(frame.pUV == frame.pY + 80 * 48);
+	bool padding = true;
+	for (uint32_t y = 0; y < 41; ++y) {
+		padding &= IsZero(frame.pY + y * 80 + 67, 80 - 67);
+	}
+	padding &= IsZero(frame.pY + 80 * 41, 80 * (48 - 41));
+	for (uint32_t y = 0; y < 21; ++y) {
+		padding &= IsZero(frame.pUV + y * 80 + 67, 80 - 67);
+	}
+	padding &= IsZero(frame.pUV + 80 * 21, 80 * (24 - 21));
+	TEST_CHECK(padding);
+	TEST_CHECK(NV12FrameSize(&frame) == 80 * 48 + 80 * 21);
+	ReleaseFrame(&frame);
+
+	TEST_CHECK(AllocateLumaFrame(67, 41, 68, 48, &frame));
+	TEST_CHECK(frame.pUV == NULL && frame.pitchUV == 0 && frame.pitchY == 68);
+	TEST_CHECK(NV12FrameSize(&frame) == 68 * 48);
+	ReleaseFrame(&frame);
+}
+
+static void FillFrame(NV12Frame* pFrame, uint32_t seed)
+{
+	TestRandom random(seed);
+	for (uint32_t y = 0; y < pFrame->height; ++y) {
+		for (uint32_t x = 0; x < pFrame->width; ++x) {
+			pFrame->pY[y * pFrame->pitchY + x] = (uint8_t)random.Next();
+		}
+	}
+	for (uint32_t y = 0; pFrame->pUV && y < (pFrame->height + 1) / 2; ++y) {
+		for (uint32_t x = 0; x < ((pFrame->width + 1) & ~1u); ++x) {
+			pFrame->pUV[y * pFrame->pitchUV + x] = (uint8_t)random.Next();
+		}
+	}
+}
+
+static void TestCompare()
+{
+	NV12Frame padded, packed, luma, other;
+	TEST_CHECK(AllocateNV12Frame(33, 17, 64, 32, &padded));
+	TEST_CHECK(AllocateNV12Frame(33, 17, 34, 17, &packed));
+	TEST_CHECK(AllocateLumaFrame(33, 17, 40, 24, &luma));
+	TEST_CHECK(AllocateNV12Frame(34, 17, 34, 17, &other));
+	FillFrame(&padded, 5);
+	FillFrame(&packed, 5);
+	FillFrame(&luma, 5);
+
+	NV12FrameDiff diff;
+	TEST_CHECK(CompareNV12Frames(&padded, &packed, &diff));
+	TEST_CHECK(diff.maxDiffY == 0 && diff.maxDiffUV == 0 && diff.meanDiffY == 0.0);
+
+	packed.pY[16 * packed.pitchY + 32] ^= 0x10;
+	packed.pUV[8 * packed.pitchUV + 33] ^= 0x04;
+	TEST_CHECK(CompareNV12Frames(&padded, &packed, &diff));
+	TEST_CHECK(diff.maxDiffY == 16 && diff.maxDiffUV == 4);
+	TEST_CHECK(diff.meanDiffY > 0.0 && diff.meanDiffUV > 0.0);
+
+	// UV is only compared when both frames have it.
+	TEST_CHECK(CompareNV12Frames(&padded, &luma, &diff));
+	TEST_CHECK(diff.maxDiffY == 0 && diff.maxDiffUV == 0);
+
+	TEST_CHECK(!CompareNV12Frames(&padded, &other, &diff));
+
+	ReleaseFrame(&padded);
+	ReleaseFrame(&packed);
+	ReleaseFrame(&luma);
+	ReleaseFrame(&other);
+}
+
+int main()
+{
+	TestOwnerReferences();
+	TestAllocate();
+	TestCompare();
+	return TestResult("NV12FrameTest");
+}
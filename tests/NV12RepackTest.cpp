@@ -0,0 +1,93 @@
+// NV12Repack and NV12RepackInPlace against a plain row by row copy, for odd
+// sizes, padded pitches, unaligned buffers and frames large enough to stream.
+
+#include <string.h>
+
+#include "TestUtil.h"
+#include "AlignedMemory.h"
+#include "NV12Repack.h"
+
+struct RepackCase
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint32_t alignedHeight;	// rows of the Y plane before UV
+};
+
+static const RepackCase s_cases[] =
+{
+	{ 2, 2, 2, 2 },
+	{ 7, 5, 8, 6 },
+	{ 63, 31, 64, 32 },
+	{ 64, 48, 64, 48 },
+	{ 320, 240, 384, 240 },
+	{ 333, 187, 352, 192 },
+	{ 640, 360, 640, 368 },	// below NV12_STREAM_THRESHOLD
+	{ 1280, 720, 1280, 720 },	// packed already, each plane is one run
+	{ 1920, 1080, 2048, 1088 },
+	{ 1919, 1081, 1920, 1088 },
+	{ 3840, 2160, 3840, 2176 },
+};
+
+static void FillRandom(uint8_t* p, size_t size, uint32_t seed)
+{
+	TestRandom random(seed);
+	for (size_t i = 0; i < size; ++i) {
+		p[i] = (uint8_t)random.Next();
+	}
+}
+
+// What both functions must produce: width bytes of every Y row, then the
+// even rounded UV rows.
+static std::vector<uint8_t> ReferencePack(const uint8_t* pY, const uint8_t* pUV, uint32_t pitch, uint32_t width,
+	uint32_t height)
+{
+	size_t uvRowBytes = (width + 1) & ~1u;
+	std::vector<uint8_t> packed;
+	for (uint32_t y = 0; y < height; ++y) {
+		packed.insert(packed.end(), pY + (size_t)y * pitch, pY + (size_t)y * pitch + width);
+	}
+	for (uint32_t y = 0; y < (height + 1) / 2; ++y) {
+		packed.insert(packed.end(), pUV + (size_t)y * pitch, pUV + (size_t)y * pitch + uvRowBytes);
+	}
+	return packed;
+}
+
+static void TestRepack(const RepackCase& c, size_t misalign)
+{
+	size_t uvOffset = (size_t)c.pitch * c.alignedHeight;
+	size_t srcSize = uvOffset + (size_t)c.pitch * ((c.height + 1) / 2);
+	size_t packedSize = NV12PackedSize(c.width, c.height);
+	uint8_t* pSrc = (uint8_t*)AlignedAlloc(srcSize + misalign);
+	uint8_t* pDst = (uint8_t*)AlignedAlloc(packedSize + misalign + 1);
+	uint8_t* src = pSrc + misalign;
+	uint8_t* dst = pDst + misalign;
+	FillRandom(src, srcSize, c.width * 31 + c.height);
+	dst[packedSize] = 0xA5;
+
+	std::vector<uint8_t> expected = ReferencePack(src, src + uvOffset, c.pitch, c.width, c.height);
+	TEST_CHECK(expected.size() == packedSize);
+
+	NV12Repack(src, c.pitch, src + uvOffset, c.pitch, c.width, c.height, dst);
+	TEST_CHECK(memcmp(dst, expected.data(), packedSize) == 0);
+	TEST_CHECK(dst[packedSize] == 0xA5);
+
+	NV12RepackInPlace(src, c.width, c.height, c.pitch, uvOffset);
+	TEST_CHECK(memcmp(src, expected.data(), packedSize) == 0);
+
+	AlignedFree(pSrc);
+	AlignedFree(pDst);
+}
+
+int main()
+{
+	for (const RepackCase& c : s_cases) {
+		// Aligned like decoder output, and not, for the unaligned loads and the row heads.
+		TestRepack(c, 0);
+		TestRepack(c, 5);
+	}
+	TEST_CHECK(NV12PackedSize(7, 5) == 7 * 5 + 8 * 3);
+	TEST_CHECK(NV12PackedSize(1920, 1080) >= NV12_STREAM_THRESHOLD);
+	return TestResult("NV12RepackTest");
+}
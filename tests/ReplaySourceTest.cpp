@@ -0,0 +1,255 @@
+// ReplaySource on the three containers, built from test encoder frames: a raw
+// JPEG stream with junk between frames, a hand made AVI with ##dc / ##db
+// chunks, padding, empty and audio chunks and an OpenDML AVIX part, and the
+// WriteIndexedMJPEG round trip. Checks frame count, bytes and timestamps,
+// then looping, pacing and truncated files.
+
+#include <string.h>
+
+#include <chrono>
+
+#include "TestUtil.h"
+#include "TestJpegEncoder.h"
+#include "ReplaySource.h"
+
+static const uint32_t FRAME_COUNT = 4;
+
+static std::vector<std::vector<uint8_t> > MakeFrames()
+{
+	std::vector<std::vector<uint8_t> > frames;
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		uint32_t width = 48 + 16 * i;
+		std::vector<uint8_t> rgb = MakeTestImage(width, 32, i + 1, 16);
+		frames.push_back(EncodeTestJpeg(rgb.data(), width, 32, MakeTestJpegParams(70 + i, 2, 1, 0, false)));
+	}
+	return frames;
+}
+
+static bool WriteFile(const char* path, const std::vector<uint8_t>& data)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		return false;
+	}
+	bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+	return fclose(f) == 0 && ok;
+}
+
+static void Append(std::vector<uint8_t>* pOut, const void* pData, size_t len)
+{
+	pOut->insert(pOut->end(), (const uint8_t*)pData, (const uint8_t*)pData + len);
+}
+
+static void AppendLE32(std::vector<uint8_t>* pOut, uint32_t v)
+{
+	uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+	Append(pOut, b, 4);
+}
+
+// id, size, body and the pad byte of odd sizes.
+static void AppendChunk(std::vector<uint8_t>* pOut, const char* id, const std::vector<uint8_t>& body)
+{
+	Append(pOut, id, 4);
+	AppendLE32(pOut, (uint32_t)body.size());
+	Append(pOut, body.data(), body.size());
+	if (body.size() & 1) {
+		pOut->push_back(0);
+	}
+}
+
+static std::vector<uint8_t> MakeList(const char* type, const std::vector<uint8_t>& chunks)
+{
+	std::vector<uint8_t> body;
+	Append(&body, type, 4);
+	Append(&body, chunks.data(), chunks.size());
+	return body;
+}
+
+// The source holds exactly 'frames', pointing into the file, with 'timestamps'.
+static bool FramesMatch(const ReplaySource& source, const std::vector<std::vector<uint8_t> >& frames,
+	const std::vector<int64_t>& timestamps)
+{
+	if (source.FrameCount() != frames.size()) {
+		return false;
+	}
+	for (uint32_t i = 0; i < source.FrameCount(); ++i) {
+		CompressedFrame frame;
+		source.GetFrame(i, &frame);
+		if (frame.len != frames[i].size() || memcmp(frame.pData, frames[i].data(), frame.len) != 0 ||
+			frame.timestamp != timestamps[i] || frame.pfnRelease != NULL) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Back to back frames with junk, a stray 0xFF and a truncated frame between them.
+static void TestJpegStream(const std::vector<std::vector<uint8_t> >& frames)
+{
+	const char* path = "ReplaySourceTest.mjpg";
+	std::vector<uint8_t> stream;
+	std::vector<int64_t> timestamps;
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		Append(&stream, frames[i].data(), frames[i].size());
+		timestamps.push_back((int64_t)(i * 10000000.0 / REPLAY_DEFAULT_FPS));
+		if (i == 1) {
+			static const uint8_t junk[] = { 0x00, 0xFF, 0x00, 0x12, 0xFF, 0xFF };
+			Append(&stream, junk, sizeof(junk));
+		}
+		if (i == 2) {
+			// SOI and the first segment, then the next frame's SOI.
+			Append(&stream, frames[0].data(), 4 + (frames[0][4] << 8 | frames[0][5]));
+		}
+	}
+	TEST_CHECK(WriteFile(path, stream));
+
+	ReplaySource source;
+	TEST_CHECK(source.Open(path) == S_OK);
+	TEST_CHECK(source.Container() == REPLAY_CONTAINER_JPEG);
+	TEST_CHECK(source.FileFps() == REPLAY_DEFAULT_FPS);
+	TEST_CHECK(FramesMatch(source, frames, timestamps));
+
+	// ReadFrame() ends, then loops with the timestamps still increasing.
+	CompressedFrame frame;
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		TEST_CHECK(source.ReadFrame(&frame) == S_OK && frame.timestamp == timestamps[i]);
+	}
+	TEST_CHECK(source.ReadFrame(&frame) == S_FALSE);
+	source.SetLoop(true);
+	CompressedFrame first;
+	source.GetFrame(0, &first);
+	TEST_CHECK(source.ReadFrame(&frame) == S_OK && frame.pData == first.pData);
+	TEST_CHECK(frame.timestamp == timestamps.back() + (int64_t)(10000000.0 / REPLAY_DEFAULT_FPS));
+	ReplayStats stats = source.GetStats();
+	TEST_CHECK(stats.framesRead == FRAME_COUNT + 1 && stats.loops == 1);
+
+	source.Rewind();
+	TEST_CHECK(source.ReadFrame(&frame) == S_OK && frame.timestamp == 0);
+	source.Close();
+	TEST_CHECK(source.FrameCount() == 0);
+	remove(path);
+}
+
+// RIFF AVI at 25 fps (avih) with the frames as 00dc / 00db chunks. The movi
+// list also holds an empty 00dc (a repeated frame that takes a period), an
+// audio chunk, a frame with padding after its EOI, and the last frame
+// continues in an OpenDML RIFF AVIX.
+static void TestAvi(const std::vector<std::vector<uint8_t> >& frames)
+{
+	const char* path = "ReplaySourceTest.avi";
+	const int64_t period = 400000;
+
+	std::vector<uint8_t> avih(56, 0);
+	avih[0] = (uint8_t)(40000 & 0xFF);	// dwMicroSecPerFrame
+	avih[1] = (uint8_t)(40000 >> 8);
+	std::vector<uint8_t> hdrl;
+	AppendChunk(&hdrl, "avih", avih);
+
+	std::vector<uint8_t> movi;
+	AppendChunk(&movi, "00dc", frames[0]);
+	AppendChunk(&movi, "00dc", std::vector<uint8_t>());
+	AppendChunk(&movi, "01wb", std::vector<uint8_t>(333, 0x55));
+	std::vector<uint8_t> padded = frames[1];
+	padded.insert(padded.end(), 7, 0);
+	AppendChunk(&movi, "00dc", padded);
+	AppendChunk(&movi, "00db", frames[2]);
+
+	std::vector<uint8_t> riffBody;
+	AppendChunk(&riffBody, "LIST", MakeList("hdrl", hdrl));
+	AppendChunk(&riffBody, "LIST", MakeList("movi", movi));
+	AppendChunk(&riffBody, "idx1", std::vector<uint8_t>(64, 0));
+
+	std::vector<uint8_t> moviX;
+	AppendChunk(&moviX, "00dc", frames[3]);
+	std::vector<uint8_t> avixBody;
+	AppendChunk(&avixBody, "LIST", MakeList("movi", moviX));
+
+	std::vector<uint8_t> file;
+	AppendChunk(&file, "RIFF", MakeList("AVI ", riffBody));
+	AppendChunk(&file, "RIFF", MakeList("AVIX", avixBody));
+	TEST_CHECK(WriteFile(path, file));
+
+	ReplaySource source;
+	TEST_CHECK(source.Open(path) == S_OK);
+	TEST_CHECK(source.Container() == REPLAY_CONTAINER_AVI);
+	TEST_CHECK(source.FileFps() == 25.0);
+	std::vector<int64_t> timestamps = { 0, 2 * period, 3 * period, 4 * period };
+	TEST_CHECK(FramesMatch(source, frames, timestamps));
+	source.Close();
+
+	// Cut in the middle of the last chunk: it is clamped to the end of the file.
+	size_t cut = frames[3].size() / 2;
+	file.resize(file.size() - (frames[3].size() & 1) - cut);
+	TEST_CHECK(WriteFile(path, file));
+	TEST_CHECK(source.Open(path) == S_OK);
+	CompressedFrame last;
+	source.GetFrame(FRAME_COUNT - 1, &last);
+	TEST_CHECK(source.FrameCount() == FRAME_COUNT && last.len == frames[3].size() - cut);
+	source.Close();
+	remove(path);
+}
+
+static void TestIndexed(const std::vector<std::vector<uint8_t> >& frames)
+{
+	const char* path = "ReplaySourceTest.idx";
+	const uint8_t* ppData[FRAME_COUNT];
+	size_t lengths[FRAME_COUNT];
+	for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+		ppData[i] = frames[i].data();
+		lengths[i] = frames[i].size();
+	}
+
+	// Variable frame rate, as recorded.
+	std::vector<int64_t> timestamps = { 1000, 334000, 1200000, 1250000 };
+	TEST_CHECK(WriteIndexedMJPEG(path, ppData, lengths, timestamps.data(), FRAME_COUNT, 29.97));
+	ReplaySource source;
+	TEST_CHECK(source.Open(path) == S_OK);
+	TEST_CHECK(source.Container() == REPLAY_CONTAINER_INDEXED);
+	TEST_CHECK(source.FileFps() > 29.969 && source.FileFps() < 29.971);
+	TEST_CHECK(FramesMatch(source, frames, timestamps));
+
+	// At the file rate frames are due at their timestamps: 125 ms in all.
+	source.SetPacing(REPLAY_FILE_RATE);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CompressedFrame frame;
+	while (source.ReadFrame(&frame) == S_OK) {
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	TEST_CHECK(ms >= 124.0);
+	source.Close();
+
+	// Without timestamps they come from the frame number and the rate.
+	TEST_CHECK(WriteIndexedMJPEG(path, ppData, lengths, NULL, FRAME_COUNT, 50.0));
+	TEST_CHECK(source.Open(path) == S_OK);
+	std::vector<int64_t> generated = { 0, 200000, 400000, 600000 };
+	TEST_CHECK(source.FileFps() == 50.0 && FramesMatch(source, frames, generated));
+	source.Close();
+
+	// An index pointing past the end of the file is rejected.
+	std::vector<uint8_t> file;
+	FILE* f = fopen(path, "rb");
+	if (f) {
+		uint8_t buffer[4096];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+			file.insert(file.end(), buffer, buffer + n);
+		}
+		fclose(f);
+	}
+	file.resize(file.size() - 1);
+	TEST_CHECK(WriteFile(path, file));
+	TEST_CHECK(source.Open(path) != S_OK);
+	TEST_CHECK(source.FrameCount() == 0);
+	remove(path);
+
+	TEST_CHECK(source.Open("ReplaySourceTest.missing") != S_OK);
+}
+
+int main()
+{
+	std::vector<std::vector<uint8_t> > frames = MakeFrames();
+	TestJpegStream(frames);
+	TestAvi(frames);
+	TestIndexed(frames);
+	return TestResult("ReplaySourceTest");
+}
@@ -0,0 +1,377 @@
+#include "TestJpegEncoder.h"
+#include "JpegParser.h"
+
+#include <math.h>
+#include <string.h>
+
+// JPEG Annex K.1 quantization tables, natural order.
+static const uint8_t s_lumaQuant[64] =
+{
+	16, 11, 10, 16, 24, 40, 51, 61,
+	12, 12, 14, 19, 26, 58, 60, 55,
+	14, 13, 16, 24, 40, 57, 69, 56,
+	14, 17, 22, 29, 51, 87, 80, 62,
+	18, 22, 37, 56, 68, 109, 103, 77,
+	24, 35, 55, 64, 81, 104, 113, 92,
+	49, 64, 78, 87, 103, 121, 120, 101,
+	72, 92, 95, 98, 112, 100, 103, 99,
+};
+
+static const uint8_t s_chromaQuant[64] =
+{
+	17, 18, 24, 47, 99, 99, 99, 99,
+	18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99,
+	47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// JPEG Annex K.3 Huffman tables, counts indexed by code length.
+static const uint8_t s_dcLumaCounts[17] = { 0, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t s_dcChromaCounts[17] = { 0, 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t s_dcSymbols[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t s_acLumaCounts[17] = { 0, 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static const uint8_t s_acLumaSymbols[162] =
+{
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+	0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+	0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+	0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA,
+};
+
+static const uint8_t s_acChromaCounts[17] = { 0, 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t s_acChromaSymbols[162] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+	0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+	0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+	0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+	0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+	0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA,
+};
+
+// Code and length of every symbol of a table (Annex C).
+struct HuffmanCodes
+{
+	uint16_t code[256];
+	uint8_t length[256];
+};
+
+static void BuildCodes(const uint8_t* pCounts, const uint8_t* pSymbols, HuffmanCodes* pCodes)
+{
+	memset(pCodes, 0, sizeof(*pCodes));
+	uint32_t code = 0;
+	uint32_t k = 0;
+	for (uint32_t len = 1; len <= 16; ++len) {
+		for (uint32_t i = 0; i < pCounts[len]; ++i, ++k) {
+			pCodes->code[pSymbols[k]] = (uint16_t)code++;
+			pCodes->length[pSymbols[k]] = (uint8_t)len;
+		}
+		code <<= 1;
+	}
+}
+
+class BitWriter
+{
+public:
+	explicit BitWriter(std::vector<uint8_t>* pOut) : m_pOut(pOut), m_acc(0), m_bits(0) {}
+
+	void Put(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = bits; i-- > 0; ) {
+			m_acc = (m_acc << 1) | ((value >> i) & 1);
+			if (++m_bits == 8) {
+				Emit();
+			}
+		}
+	}
+
+	// Pads the last byte with one bits.
+	void Flush()
+	{
+		while (m_bits) {
+			Put(1, 1);
+		}
+	}
+
+private:
+	void Emit()
+	{
+		m_pOut->push_back((uint8_t)m_acc);
+		if (m_acc == 0xFF) {
+			m_pOut->push_back(0);
+		}
+		m_acc = 0;
+		m_bits = 0;
+	}
+
+	std::vector<uint8_t>* m_pOut;
+	uint32_t m_acc;
+	uint32_t m_bits;
+};
+
+// Magnitude category of v and its extra bits (Annex F.1.2.1).
+static uint32_t Category(int v, uint32_t* pBits)
+{
+	uint32_t a = (uint32_t)(v < 0 ? -v : v);
+	uint32_t s = 0;
+	while (a >> s) {
+		s++;
+	}
+	*pBits = (uint32_t)(v < 0 ? v + (1 << s) - 1 : v) & ((1u << s) - 1);
+	return s;
+}
+
+static void EncodeBlock(BitWriter* pWriter, const int* pCoef, int* pDcPred, const HuffmanCodes* pDc,
+	const HuffmanCodes* pAc)
+{
+	uint32_t bits;
+	uint32_t s = Category(pCoef[0] - *pDcPred, &bits);
+	*pDcPred = pCoef[0];
+	pWriter->Put(pDc->code[s], pDc->length[s]);
+	pWriter->Put(bits, s);
+
+	uint32_t run = 0;
+	for (int k = 1; k < 64; ++k) {
+		int v = pCoef[g_jpegZigzag[k]];
+		if (v == 0) {
+			run++;
+			continue;
+		}
+		while (run > 15) {
+			pWriter->Put(pAc->code[0xF0], pAc->length[0xF0]);
+			run -= 16;
+		}
+		s = Category(v, &bits);
+		uint32_t rs = (run << 4) | s;
+		pWriter->Put(pAc->code[rs], pAc->length[rs]);
+		pWriter->Put(bits, s);
+		run = 0;
+	}
+	if (run) {
+		pWriter->Put(pAc->code[0], pAc->length[0]);
+	}
+}
+
+// Forward DCT of an 8x8 block of level shifted samples, quantized.
+// Separable, rows then columns, with the basis scaled by C(u) / 2.
+static void ForwardDct(const double* pBlock, const uint16_t* pQuant, int* pCoef)
+{
+	static double s_basis[8][8];
+	static bool s_init = false;
+	if (!s_init) {
+		for (int u = 0; u < 8; ++u) {
+			for (int x = 0; x < 8; ++x) {
+				s_basis[u][x] = (u ? 0.5 : 0.5 * sqrt(0.5)) * cos((2 * x + 1) * u * M_PI / 16);
+			}
+		}
+		s_init = true;
+	}
+	double rows[64];
+	for (int y = 0; y < 8; ++y) {
+		for (int u = 0; u < 8; ++u) {
+			double sum = 0.0;
+			for (int x = 0; x < 8; ++x) {
+				sum += pBlock[y * 8 + x] * s_basis[u][x];
+			}
+			rows[y * 8 + u] = sum;
+		}
+	}
+	for (int v = 0; v < 8; ++v) {
+		for (int u = 0; u < 8; ++u) {
+			double sum = 0.0;
+			for (int y = 0; y < 8; ++y) {
+				sum += rows[y * 8 + u] * s_basis[v][y];
+			}
+			double f = sum / pQuant[v * 8 + u];
+			pCoef[v * 8 + u] = (int)(f < 0.0 ? f - 0.5 : f + 0.5);
+		}
+	}
+}
+
+void RgbToYCbCr(const uint8_t* pRgb, uint8_t* pYCbCr)
+{
+	double r = pRgb[0], g = pRgb[1], b = pRgb[2];
+	double v[3] = {
+		0.299 * r + 0.587 * g + 0.114 * b,
+		128.0 - 0.168736 * r - 0.331264 * g + 0.5 * b,
+		128.0 + 0.5 * r - 0.418688 * g - 0.081312 * b,
+	};
+	for (int c = 0; c < 3; ++c) {
+		double x = floor(v[c] + 0.5);
+		pYCbCr[c] = (uint8_t)(x < 0.0 ? 0.0 : (x > 255.0 ? 255.0 : x));
+	}
+}
+
+static void PutMarker(std::vector<uint8_t>* pOut, uint8_t marker)
+{
+	pOut->push_back(0xFF);
+	pOut->push_back(marker);
+}
+
+static void PutWord(std::vector<uint8_t>* pOut, uint32_t v)
+{
+	pOut->push_back((uint8_t)(v >> 8));
+	pOut->push_back((uint8_t)v);
+}
+
+static void PutHuffmanTable(std::vector<uint8_t>* pOut, uint8_t classAndId, const uint8_t* pCounts, const uint8_t* pSymbols)
+{
+	uint32_t n = 0;
+	pOut->push_back(classAndId);
+	for (uint32_t len = 1; len <= 16; ++len) {
+		pOut->push_back(pCounts[len]);
+		n += pCounts[len];
+	}
+	pOut->insert(pOut->end(), pSymbols, pSymbols + n);
+}
+
+std::vector<uint8_t> EncodeTestJpeg(const uint8_t* pRgb, uint32_t width, uint32_t height, const TestJpegParams& params)
+{
+	uint32_t components = params.gray ? 1 : 3;
+	uint32_t h = params.gray ? 1 : params.h;
+	uint32_t v = params.gray ? 1 : params.v;
+	uint32_t mcuWidth = 8 * h;
+	uint32_t mcuHeight = 8 * v;
+	uint32_t mcusX = (width + mcuWidth - 1) / mcuWidth;
+	uint32_t mcusY = (height + mcuHeight - 1) / mcuHeight;
+	int scale = params.quality < 50 ? 5000 / params.quality : 200 - 2 * params.quality;
+	uint16_t quant[2][64];
+	std::vector<uint8_t> out;
+
+	for (int i = 0; i < 64; ++i) {
+		int q0 = (s_lumaQuant[i] * scale + 50) / 100;
+		int q1 = (s_chromaQuant[i] * scale + 50) / 100;
+		quant[0][i] = (uint16_t)(q0 < 1 ? 1 : (q0 > 255 ? 255 : q0));
+		quant[1][i] = (uint16_t)(q1 < 1 ? 1 : (q1 > 255 ? 255 : q1));
+	}
+
+	// Full resolution planes padded to whole MCUs by repeating the edges.
+	uint32_t planeWidth = mcusX * mcuWidth;
+	uint32_t planeHeight = mcusY * mcuHeight;
+	std::vector<uint8_t> planes[3];
+	for (uint32_t c = 0; c < 3; ++c) {
+		planes[c].resize((size_t)planeWidth * planeHeight);
+	}
+	for (uint32_t y = 0; y < planeHeight; ++y) {
+		for (uint32_t x = 0; x < planeWidth; ++x) {
+			uint32_t sx = x < width ? x : width - 1;
+			uint32_t sy = y < height ? y : height - 1;
+			uint8_t ycc[3];
+			RgbToYCbCr(pRgb + ((size_t)sy * width + sx) * 3, ycc);
+			for (uint32_t c = 0; c < 3; ++c) {
+				planes[c][(size_t)y * planeWidth + x] = ycc[c];
+			}
+		}
+	}
+
+	PutMarker(&out, JPEG_SOI);
+	PutMarker(&out, JPEG_DQT);
+	PutWord(&out, 2 + (params.gray ? 1 : 2) * 65);
+	for (uint32_t t = 0; t < (params.gray ? 1u : 2u); ++t) {
+		out.push_back((uint8_t)t);
+		for (int k = 0; k < 64; ++k) {
+			out.push_back((uint8_t)quant[t][g_jpegZigzag[k]]);
+		}
+	}
+	PutMarker(&out, JPEG_SOF0);
+	PutWord(&out, 8 + 3 * components);
+	out.push_back(8);
+	PutWord(&out, height);
+	PutWord(&out, width);
+	out.push_back((uint8_t)components);
+	for (uint32_t c = 0; c < components; ++c) {
+		out.push_back((uint8_t)(c + 1));
+		out.push_back((uint8_t)(c == 0 ? (h << 4) | v : 0x11));
+		out.push_back((uint8_t)(c == 0 ? 0 : 1));
+	}
+	if (params.huffmanTables) {
+		PutMarker(&out, JPEG_DHT);
+		PutWord(&out, 2 + 2 * (17 + 12) + 2 * (17 + 162));
+		PutHuffmanTable(&out, 0x00, s_dcLumaCounts, s_dcSymbols);
+		PutHuffmanTable(&out, 0x10, s_acLumaCounts, s_acLumaSymbols);
+		PutHuffmanTable(&out, 0x01, s_dcChromaCounts, s_dcSymbols);
+		PutHuffmanTable(&out, 0x11, s_acChromaCounts, s_acChromaSymbols);
+	}
+	if (params.restartInterval) {
+		PutMarker(&out, JPEG_DRI);
+		PutWord(&out, 4);
+		PutWord(&out, params.restartInterval);
+	}
+	PutMarker(&out, JPEG_SOS);
+	PutWord(&out, 6 + 2 * components);
+	out.push_back((uint8_t)components);
+	for (uint32_t c = 0; c < components; ++c) {
+		out.push_back((uint8_t)(c + 1));
+		out.push_back((uint8_t)(c == 0 ? 0x00 : 0x11));
+	}
+	out.push_back(0);
+	out.push_back(63);
+	out.push_back(0);
+
+	HuffmanCodes dcCodes[2], acCodes[2];
+	BuildCodes(s_dcLumaCounts, s_dcSymbols, &dcCodes[0]);
+	BuildCodes(s_dcChromaCounts, s_dcSymbols, &dcCodes[1]);
+	BuildCodes(s_acLumaCounts, s_acLumaSymbols, &acCodes[0]);
+	BuildCodes(s_acChromaCounts, s_acChromaSymbols, &acCodes[1]);
+
+	BitWriter writer(&out);
+	int dcPred[3] = { 0, 0, 0 };
+	double block[64];
+	int coef[64];
+	uint32_t restarts = 0;
+	for (uint32_t mcu = 0; mcu < mcusX * mcusY; ++mcu) {
+		if (params.restartInterval && mcu && mcu % params.restartInterval == 0) {
+			writer.Flush();
+			PutMarker(&out, (uint8_t)(JPEG_RST0 + (restarts++ & 7)));
+			memset(dcPred, 0, sizeof(dcPred));
+		}
+		uint32_t mx = mcu % mcusX;
+		uint32_t my = mcu / mcusX;
+		for (uint32_t c = 0; c < components; ++c) {
+			uint32_t ch = c == 0 ? h : 1;
+			uint32_t cv = c == 0 ? v : 1;
+			// Chroma blocks average h x v samples of the full resolution plane.
+			uint32_t sx = c == 0 ? 1 : h;
+			uint32_t sy = c == 0 ? 1 : v;
+			for (uint32_t by = 0; by < cv; ++by) {
+				for (uint32_t bx = 0; bx < ch; ++bx) {
+					for (uint32_t y = 0; y < 8; ++y) {
+						for (uint32_t x = 0; x < 8; ++x) {
+							uint32_t px = mx * mcuWidth + (bx * 8 + x) * sx;
+							uint32_t py = my * mcuHeight + (by * 8 + y) * sy;
+							double sum = 0.0;
+							for (uint32_t j = 0; j < sy; ++j) {
+								for (uint32_t i = 0; i < sx; ++i) {
+									sum += planes[c][(size_t)(py + j) * planeWidth + px + i];
+								}
+							}
+							block[y * 8 + x] = sum / (sx * sy) - 128.0;
+						}
+					}
+					ForwardDct(block, quant[c == 0 ? 0 : 1], coef);
+					EncodeBlock(&writer, coef, &dcPred[c], &dcCodes[c == 0 ? 0 : 1], &acCodes[c == 0 ? 0 : 1]);
+				}
+			}
+		}
+	}
+	writer.Flush();
+	PutMarker(&out, JPEG_EOI);
+	return out;
+}
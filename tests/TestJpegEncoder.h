@@ -0,0 +1,31 @@
+#ifndef __TESTJPEGENCODER_H__
+#define __TESTJPEGENCODER_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+struct TestJpegParams
+{
+	int quality;	// 1..100, scales the Annex K quantization tables like libjpeg
+	uint32_t h;	// luma sampling factors (1 or 2), chroma is 1x1
+	uint32_t v;
+	uint32_t restartInterval;	// MCUs per interval, 0 for no restart markers
+	bool gray;	// single component
+	bool huffmanTables;	// write the DHT segment, otherwise the decoder's Annex K defaults apply
+};
+
+inline TestJpegParams MakeTestJpegParams(int quality, uint32_t h, uint32_t v, uint32_t restartInterval, bool gray)
+{
+	TestJpegParams params = { quality, h, v, restartInterval, gray, true };
+	return params;
+}
+
+// JFIF RGB to YCbCr, rounded, the conversion EncodeTestJpeg uses.
+void RgbToYCbCr(const uint8_t* pRgb, uint8_t* pYCbCr);
+
+// Baseline sequential JPEG encoder for the tests, so they need no codec library.
+// Double precision DCT, Annex K Huffman tables, edges padded by replication.
+std::vector<uint8_t> EncodeTestJpeg(const uint8_t* pRgb, uint32_t width, uint32_t height, const TestJpegParams& params);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __TESTUTIL_H__
+#define __TESTUTIL_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// Checks keep going after a failure so one run reports all of them.
+static int g_testFailures = 0;
+
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			g_testFailures++; \
+		} \
+	} while (0)
+
+// Return value of main().
+inline int TestResult(const char* name)
+{
+	printf("%s: %s (%d failed checks)\n", name, g_testFailures ? "FAILED" : "passed", g_testFailures);
+	return g_testFailures ? 1 : 0;
+}
+
+// Deterministic xorshift generator, the same sequence on every platform.
+struct TestRandom
+{
+	uint32_t state;
+
+	explicit TestRandom(uint32_t seed) : state(seed ? seed : 1) {}
+
+	uint32_t Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+	uint32_t Below(uint32_t n) { return Next() % n; }
+};
+
+// Interleaved RGB test picture: smooth gradients and waves with some texture,
+// like camera frames. 'noise' adds that much random amplitude per pixel.
+inline std::vector<uint8_t> MakeTestImage(uint32_t width, uint32_t height, uint32_t seed, int noise)
+{
+	std::vector<uint8_t> rgb((size_t)width * height * 3);
+	TestRandom random(seed);
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			double v[3] = {
+				128.0 + 90.0 * sin(x * 0.07 + seed) * cos(y * 0.05),
+				(double)((x + 2 * y + seed * 13) % 256),
+				128.0 + 100.0 * cos((x + y) * 0.03 + seed),
+			};
+			uint8_t* p = &rgb[((size_t)y * width + x) * 3];
+			for (int c = 0; c < 3; ++c) {
+				if (noise) {
+					v[c] += (double)random.Below(2 * noise + 1) - noise;
+				}
+				p[c] = (uint8_t)(v[c] < 0.0 ? 0.0 : (v[c] > 255.0 ? 255.0 : v[c]));
+			}
+		}
+	}
+	return rgb;
+}
+
+#endif